@@ -8,6 +8,17 @@
 
 #include <Arduino.h>
 
+#define ALERT_TONE_CHANNEL      0       // LEDC channel used for buzzer tones
+#define ALERT_QUEUE_DEPTH       4       // Pending patterns held by the sequencer
+
+// Pattern priorities - a higher priority preempts a lower one that is playing
+enum AlertPriority {
+    ALERT_PRIORITY_STATUS = 0,      // Startup, calibration feedback
+    ALERT_PRIORITY_BATTERY = 1,     // Low battery warning
+    ALERT_PRIORITY_CUE = 2,         // Neighbouring unit alerted (mesh)
+    ALERT_PRIORITY_DETECTION = 3    // Drone detection
+};
+
 class AlertManager {
 public:
     AlertManager();
@@ -15,18 +26,40 @@ public:
     void begin(int buzzerPin, int vibrationPin);
     void update();  // Call in main loop
     
+    /**
+     * Advance alerts and the pattern sequencer to time `now` (ms).
+     * update() calls this with the clock; host code can drive a virtual one.
+     */
+    void update(unsigned long now);
+
+    /**
+     * Time source (ms) for update() and for everything that starts an
+     * alert or pattern; millis() unless replaced
+     */
+    void setClock(unsigned long (*clock)()) { _clock = clock; }
+    
     void triggerAlert(int durationMs);
     void triggerHapticOnly(int durationMs);
     void stopAlert();
     
-    void playTone(int frequency, int durationMs);
-    void playPattern(const int* pattern, int length);
+    /**
+     * Queue a tone or pattern. Both return immediately; steps are
+     * played back from update().
+     */
+    bool playTone(int frequency, int durationMs,
+                  AlertPriority priority = ALERT_PRIORITY_STATUS);
+    bool playPattern(const int* pattern, int length,
+                     AlertPriority priority = ALERT_PRIORITY_STATUS,
+                     bool withVibration = false);
+    void stopPatterns();
     
     bool isAlerting() { return _alertActive; }
+    bool isPlaying() { return _pattern != nullptr; }
 
 private:
     int _buzzerPin;
     int _vibrationPin;
+    unsigned long (*_clock)();
     
     bool _alertActive;
     bool _hapticOnly;
@@ -34,16 +67,40 @@ private:
     int _alertDuration;
     
     // Pattern playback
+    struct QueuedPattern {
+        const int* pattern;
+        int length;
+        AlertPriority priority;
+        bool withVibration;
+    };
+    
     const int* _pattern;
     int _patternLength;
     int _patternIndex;
     unsigned long _patternStepTime;
+    int _patternStepDuration;
+    AlertPriority _patternPriority;
+    bool _patternVibration;
+    bool _toneAttached;
+    int _singleTone[2];
+    
+    // Pending patterns, kept in arrival order
+    QueuedPattern _queue[ALERT_QUEUE_DEPTH];
+    int _queueCount;
     
     // Pulse state
     bool _pulseState;
     unsigned long _lastPulseTime;
     int _pulseOnTime;
     int _pulseOffTime;
+    
+    void startPattern(const QueuedPattern& entry, unsigned long now);
+    void startStep(unsigned long now);
+    void finishPattern();
+    bool popNextPattern(QueuedPattern* entry);
+    void dropPatternsBelow(AlertPriority priority);
+    void toneOn(int frequency);
+    void toneOff();
 };
 
 // Implementation
@@ -51,6 +108,7 @@ private:
 AlertManager::AlertManager() :
     _buzzerPin(-1),
     _vibrationPin(-1),
+    _clock(millis),
     _alertActive(false),
     _hapticOnly(false),
     _alertStartTime(0),
@@ -59,6 +117,12 @@ AlertManager::AlertManager() :
     _patternLength(0),
     _patternIndex(0),
     _patternStepTime(0),
+    _patternStepDuration(0),
+    _patternPriority(ALERT_PRIORITY_STATUS),
+    _patternVibration(false),
+    _toneAttached(false),
+    _singleTone{0, 0},
+    _queueCount(0),
     _pulseState(false),
     _lastPulseTime(0),
     _pulseOnTime(100),
@@ -80,7 +144,29 @@ void AlertManager::begin(int buzzerPin, int vibrationPin) {
 }
 
 void AlertManager::update() {
-    unsigned long now = millis();
+    update(_clock());
+}
+
+void AlertManager::update(unsigned long now) {
+    // Pattern sequencer - advance at most one step per elapsed duration,
+    // catching up if update() was called late
+    while (_pattern != nullptr &&
+           now - _patternStepTime >= (unsigned long)_patternStepDuration) {
+        _patternStepTime += _patternStepDuration;
+        _patternIndex += 2;
+        if (_patternIndex + 1 < _patternLength) {
+            startStep(_patternStepTime);
+        } else {
+            finishPattern();
+        }
+    }
+    
+    if (_pattern == nullptr && !_alertActive) {
+        QueuedPattern next;
+        if (popNextPattern(&next)) {
+            startPattern(next, now);
+        }
+    }
     
     if (!_alertActive) {
         return;
@@ -112,12 +198,18 @@ void AlertManager::update() {
 }
 
 void AlertManager::triggerAlert(int durationMs) {
+    // Detection alert owns the buzzer pin - abort lower priority patterns
+    dropPatternsBelow(ALERT_PRIORITY_DETECTION);
+    if (_pattern != nullptr && _patternPriority < ALERT_PRIORITY_DETECTION) {
+        finishPattern();
+    }
+    
     _alertActive = true;
     _hapticOnly = false;
-    _alertStartTime = millis();
+    _alertStartTime = _clock();
     _alertDuration = durationMs;
     _pulseState = true;
-    _lastPulseTime = millis();
+    _lastPulseTime = _alertStartTime;
     
     // Start with both on
     digitalWrite(_buzzerPin, HIGH);
@@ -131,12 +223,17 @@ void AlertManager::triggerAlert(int durationMs) {
 }
 
 void AlertManager::triggerHapticOnly(int durationMs) {
+    dropPatternsBelow(ALERT_PRIORITY_DETECTION);
+    if (_pattern != nullptr && _patternPriority < ALERT_PRIORITY_DETECTION) {
+        finishPattern();
+    }
+    
     _alertActive = true;
     _hapticOnly = true;
-    _alertStartTime = millis();
+    _alertStartTime = _clock();
     _alertDuration = durationMs;
     _pulseState = true;
-    _lastPulseTime = millis();
+    _lastPulseTime = _alertStartTime;
     
     // Vibration only
     digitalWrite(_vibrationPin, HIGH);
@@ -153,33 +250,151 @@ void AlertManager::stopAlert() {
     digitalWrite(_vibrationPin, LOW);
 }
 
-void AlertManager::playTone(int frequency, int durationMs) {
-    // Use ESP32 LEDC for tone generation
-    ledcSetup(0, frequency, 8);  // Channel 0, 8-bit resolution
-    ledcAttachPin(_buzzerPin, 0);
-    ledcWrite(0, 128);  // 50% duty cycle
-    
-    delay(durationMs);
+bool AlertManager::playTone(int frequency, int durationMs, AlertPriority priority) {
+    // Single tone is a one-step pattern; only one may be pending at a time
+    if (_pattern == _singleTone) {
+        return false;
+    }
+    for (int i = 0; i < _queueCount; i++) {
+        if (_queue[i].pattern == _singleTone) return false;
+    }
     
-    ledcWrite(0, 0);
-    ledcDetachPin(_buzzerPin);
-    pinMode(_buzzerPin, OUTPUT);
-    digitalWrite(_buzzerPin, LOW);
+    _singleTone[0] = frequency;
+    _singleTone[1] = durationMs;
+    return playPattern(_singleTone, 2, priority);
 }
 
-void AlertManager::playPattern(const int* pattern, int length) {
+bool AlertManager::playPattern(const int* pattern, int length,
+                               AlertPriority priority, bool withVibration) {
     // Pattern format: [freq1, dur1, freq2, dur2, ...]
     // freq=0 means pause
-    for (int i = 0; i < length; i += 2) {
-        int freq = pattern[i];
-        int dur = pattern[i + 1];
-        
-        if (freq > 0) {
-            playTone(freq, dur);
-        } else {
-            delay(dur);
+    if (pattern == nullptr || length < 2) {
+        return false;
+    }
+    
+    QueuedPattern entry = { pattern, length, priority, withVibration };
+    
+    // Preempt a lower priority pattern that is currently playing
+    if (_pattern != nullptr && priority > _patternPriority) {
+        finishPattern();
+        dropPatternsBelow(priority);
+    }
+    
+    if (_pattern == nullptr && _queueCount == 0 && !_alertActive) {
+        startPattern(entry, _clock());
+        return true;
+    }
+    
+    if (_queueCount >= ALERT_QUEUE_DEPTH) {
+        // Make room by evicting the oldest entry of lower priority
+        int victim = -1;
+        for (int i = 0; i < _queueCount; i++) {
+            if (_queue[i].priority < priority) {
+                victim = i;
+                break;
+            }
+        }
+        if (victim < 0) {
+            return false;
         }
+        for (int i = victim; i < _queueCount - 1; i++) {
+            _queue[i] = _queue[i + 1];
+        }
+        _queueCount--;
+    }
+    
+    _queue[_queueCount++] = entry;
+    return true;
+}
+
+void AlertManager::stopPatterns() {
+    _queueCount = 0;
+    if (_pattern != nullptr) {
+        finishPattern();
+    }
+}
+
+void AlertManager::startPattern(const QueuedPattern& entry, unsigned long now) {
+    _pattern = entry.pattern;
+    _patternLength = entry.length;
+    _patternPriority = entry.priority;
+    _patternVibration = entry.withVibration;
+    _patternIndex = 0;
+    startStep(now);
+}
+
+void AlertManager::startStep(unsigned long now) {
+    int freq = _pattern[_patternIndex];
+    _patternStepDuration = max(_pattern[_patternIndex + 1], 0);
+    _patternStepTime = now;
+    
+    if (freq > 0) {
+        toneOn(freq);
+        if (_patternVibration) digitalWrite(_vibrationPin, HIGH);
+    } else {
+        if (_toneAttached) ledcWrite(ALERT_TONE_CHANNEL, 0);
+        if (_patternVibration) digitalWrite(_vibrationPin, LOW);
+    }
+}
+
+void AlertManager::finishPattern() {
+    toneOff();
+    if (_patternVibration && !_alertActive) {
+        digitalWrite(_vibrationPin, LOW);
+    }
+    _pattern = nullptr;
+    _patternLength = 0;
+    _patternIndex = 0;
+}
+
+bool AlertManager::popNextPattern(QueuedPattern* entry) {
+    if (_queueCount == 0) {
+        return false;
+    }
+    
+    // Highest priority first, FIFO among equals
+    int best = 0;
+    for (int i = 1; i < _queueCount; i++) {
+        if (_queue[i].priority > _queue[best].priority) best = i;
     }
+    
+    *entry = _queue[best];
+    for (int i = best; i < _queueCount - 1; i++) {
+        _queue[i] = _queue[i + 1];
+    }
+    _queueCount--;
+    return true;
+}
+
+void AlertManager::dropPatternsBelow(AlertPriority priority) {
+    int kept = 0;
+    for (int i = 0; i < _queueCount; i++) {
+        if (_queue[i].priority >= priority) {
+            _queue[kept++] = _queue[i];
+        }
+    }
+    _queueCount = kept;
+}
+
+void AlertManager::toneOn(int frequency) {
+    // Use ESP32 LEDC for tone generation
+    if (!_toneAttached) {
+        ledcSetup(ALERT_TONE_CHANNEL, frequency, 8);  // 8-bit resolution
+        ledcAttachPin(_buzzerPin, ALERT_TONE_CHANNEL);
+        _toneAttached = true;
+    }
+    ledcWriteTone(ALERT_TONE_CHANNEL, frequency);  // 50% duty cycle
+}
+
+void AlertManager::toneOff() {
+    if (!_toneAttached) {
+        return;
+    }
+    ledcWrite(ALERT_TONE_CHANNEL, 0);
+    ledcDetachPin(_buzzerPin);
+    pinMode(_buzzerPin, OUTPUT);
+    digitalWrite(_buzzerPin, LOW);
+    _toneAttached = false;
 }
 
 // Predefined alert patterns
@@ -207,6 +422,12 @@ namespace AlertPatterns {
         1000, 200, 1500, 200, 2000, 300
     };
     const int CALIBRATION_DONE_LEN = 6;
+
+    // A neighbouring unit alerted
+    const int NEIGHBOR_CUE[] = {
+        1500, 80, 0, 80, 1500, 80
+    };
+    const int NEIGHBOR_CUE_LEN = 6;
 }
 
 #endif // ALERT_MANAGER_H
@@ -8,31 +8,92 @@
 
 #include <Arduino.h>
 #include <arduinoFFT.h>
+#include "profiler.h"
+#include "memory_pools.h"
+#include "dsp_arena.h"
+#include "dsp_kernels.h"
+#include "fast_math.h"
+#include <new>
+
+#if DSP_FIXED_POINT
+#include "fixed_mel.h"
+#endif
 
 class AudioProcessor {
 public:
     AudioProcessor();
     ~AudioProcessor();
 
-    void begin(int sampleRate, int fftSize, int melBins);
+    /**
+     * Take the FFT buffers from the DSP arena and the filterbank from
+     * PLACE_MEL_FILTERBANK, then build the tables; false if either refused
+     */
+    bool begin(int sampleRate, int fftSize, int melBins);
     void computeMelSpectrogram(float* audioSamples, int numSamples, float* melOutput);
     void setNoiseFloor(float* noiseFloor);
+
+    /**
+     * FFT bins to leave out of the mel bands (bit k = bin k), e.g. the
+     * wind-dominated low bins from WindDetector; 0 keeps every bin
+     */
+    void setBinMask(uint32_t mask) { _binMask = mask; }
+
     float computeRMS(float* samples, int numSamples);
     float computePeakFrequency(float* samples, int numSamples);
 
+    /**
+     * Harmonic-sum fundamental between minHz and maxHz, from the magnitude
+     * spectrum left by the last computeMelSpectrogram (no extra FFT)
+     */
+    float estimateFundamental(float minHz, float maxHz);
+
+    /**
+     * Map a mel dB value onto 0-255 over MEL_DB_FLOOR..MEL_DB_FLOOR+MEL_DB_RANGE
+     */
+    static uint8_t quantizeDb(float db);
+
+    #if DSP_FIXED_POINT
+    /**
+     * Load the next block for computeMelFixed: raw I2S words with the
+     * capture trim as a linear gain, or float samples (pre-roll replay)
+     */
+    void loadFixed(const int32_t* raw, int numSamples, float gain);
+    void loadFixed(const float* samples, int numSamples);
+
+    /**
+     * Mel bands of the loaded block in dB * 256 (fixed_mel.h)
+     */
+    void computeMelFixed(int16_t* melDbQ8);
+
+    /**
+     * Run the float and fixed paths on the same block; print the dB
+     * difference per band and the cycles each took
+     */
+    void compareFixed(const float* samples, int numSamples);
+    #endif
+
 private:
     int _sampleRate;
     int _fftSize;
     int _melBins;
 
-    double* _vReal;
-    double* _vImag;
+    float* _vReal;
+    float* _vImag;
     float* _melFilterbank;
     float* _noiseFloor;
     float* _window;
+    uint32_t _binMask;
+
+    ArduinoFFT<float>* _fft;
 
-    ArduinoFFT<double>* _fft;
+    #if DSP_FIXED_POINT
+    FixedMelFrontend* _fixed;
+    float _fixedGain;               // Last trim, and its dB * 256
+    int32_t _fixedGainDbQ8;
+    bool _fixedSpectrum;            // Last spectrum came from the fixed path
+    #endif
 
+    void loadWindowed(const float* samples, int numSamples);
     void createMelFilterbank();
     void createHannWindow();
     float hzToMel(float hz);
@@ -50,41 +111,79 @@ AudioProcessor::AudioProcessor() :
     _melFilterbank(nullptr),
     _noiseFloor(nullptr),
     _window(nullptr),
+    _binMask(0),
     _fft(nullptr)
+    #if DSP_FIXED_POINT
+    , _fixed(nullptr),
+    _fixedGain(1.0f),
+    _fixedGainDbQ8(0),
+    _fixedSpectrum(false)
+    #endif
 {
 }
 
 AudioProcessor::~AudioProcessor() {
-    if (_vReal) delete[] _vReal;
-    if (_vImag) delete[] _vImag;
-    if (_melFilterbank) delete[] _melFilterbank;
-    if (_noiseFloor) delete[] _noiseFloor;
-    if (_window) delete[] _window;
-    if (_fft) delete _fft;
+    // Everything else lives in the DSP arena for the life of the program
+    MemoryPools::instance().release(_melFilterbank);
+    if (_fft) _fft->~ArduinoFFT<float>();
+    #if DSP_FIXED_POINT
+    if (_fixed) _fixed->~FixedMelFrontend();
+    #endif
 }
 
-void AudioProcessor::begin(int sampleRate, int fftSize, int melBins) {
+bool AudioProcessor::begin(int sampleRate, int fftSize, int melBins) {
     _sampleRate = sampleRate;
     _fftSize = fftSize;
     _melBins = melBins;
 
     // Allocate buffers
-    _vReal = new double[_fftSize];
-    _vImag = new double[_fftSize];
-    _melFilterbank = new float[_melBins * (_fftSize / 2 + 1)];
-    _noiseFloor = new float[_melBins];
-    _window = new float[_fftSize];
+    DspArena& arena = DspArena::instance();
+    _vReal = arena.persistentArray<float>(_fftSize);
+    _vImag = arena.persistentArray<float>(_fftSize);
+    _window = arena.persistentArray<float>(_fftSize);
+    _noiseFloor = arena.persistentArray<float>(_melBins);
+    void* fft = arena.persistent(sizeof(ArduinoFFT<float>), alignof(ArduinoFFT<float>));
+    _melFilterbank = (float*)MemoryPools::instance().allocate("mel filterbank",
+                                                              _melBins * (_fftSize / 2 + 1) * sizeof(float),
+                                                              PLACE_MEL_FILTERBANK);
+    if (_vReal == nullptr || _vImag == nullptr || _window == nullptr || _noiseFloor == nullptr ||
+        fft == nullptr || _melFilterbank == nullptr) {
+        Serial.println("AudioProcessor: buffer allocation failed");
+        return false;
+    }
 
     // Initialize
     memset(_noiseFloor, 0, _melBins * sizeof(float));
 
-    _fft = new ArduinoFFT<double>(_vReal, _vImag, _fftSize, _sampleRate);
+    _fft = new (fft) ArduinoFFT<float>(_vReal, _vImag, _fftSize, _sampleRate);
 
     createMelFilterbank();
     createHannWindow();
 
+    #if DSP_FIXED_POINT
+    // Built from the float tables; the float path stays for compareFixed()
+    void* fixed = arena.persistent(sizeof(FixedMelFrontend), alignof(FixedMelFrontend));
+    if (fixed == nullptr) {
+        Serial.println("AudioProcessor: buffer allocation failed");
+        return false;
+    }
+    _fixed = new (fixed) FixedMelFrontend();
+    if (!_fixed->begin(_window, _melFilterbank)) {
+        Serial.println("AudioProcessor: fixed-point filterbank too large");
+        return false;
+    }
+    #endif
+
     Serial.printf("AudioProcessor initialized: SR=%d FFT=%d MEL=%d\n", 
                   _sampleRate, _fftSize, _melBins);
+    return true;
+}
+
+void AudioProcessor::loadWindowed(const float* samples, int numSamples) {
+    int n = min(numSamples, _fftSize);
+    DspKernels::multiply(samples, _window, _vReal, n);
+    memset(_vReal + n, 0, (_fftSize - n) * sizeof(float));
+    memset(_vImag, 0, _fftSize * sizeof(float));
 }
 
 void AudioProcessor::createHannWindow() {
@@ -110,8 +209,9 @@ void AudioProcessor::createMelFilterbank() {
     float melMax = hzToMel(fMax);
     
     int numFftBins = _fftSize / 2 + 1;
-    float* melPoints = new float[_melBins + 2];
-    int* fftBinPoints = new int[_melBins + 2];
+    ScratchFrame frame;
+    float* melPoints = DspArena::instance().scratchArray<float>(_melBins + 2);
+    int* fftBinPoints = DspArena::instance().scratchArray<int>(_melBins + 2);
     
     // Equally spaced mel points
     for (int i = 0; i < _melBins + 2; i++) {
@@ -146,39 +246,35 @@ void AudioProcessor::createMelFilterbank() {
             }
         }
     }
-    
-    delete[] melPoints;
-    delete[] fftBinPoints;
 }
 
 void AudioProcessor::computeMelSpectrogram(float* audioSamples, int numSamples, float* melOutput) {
     int numFftBins = _fftSize / 2 + 1;
     
-    // Apply window and copy to FFT buffer
-    for (int i = 0; i < _fftSize; i++) {
-        if (i < numSamples) {
-            _vReal[i] = audioSamples[i] * _window[i];
-        } else {
-            _vReal[i] = 0.0;
+    {
+        PROFILE_SCOPE(STAGE_FFT);
+
+        loadWindowed(audioSamples, numSamples);
+        _fft->compute(FFTDirection::Forward);
+
+        // Only the non-negative half feeds the mel bands
+        DspKernels::magnitude(_vReal, _vImag, _vReal, numFftBins);
+        for (uint32_t mask = _binMask, k = 0; mask != 0; k++, mask >>= 1) {
+            if (mask & 1) _vReal[k] = 0.0f;
         }
-        _vImag[i] = 0.0;
     }
-    
-    // Compute FFT
-    _fft->windowing(FFTWindow::Rectangle, FFTDirection::Forward);  // Window already applied
-    _fft->compute(FFTDirection::Forward);
-    _fft->complexToMagnitude();
+    #if DSP_FIXED_POINT
+    _fixedSpectrum = false;
+    #endif
     
     // Apply mel filterbank
+    PROFILE_SCOPE(STAGE_MEL);
     for (int m = 0; m < _melBins; m++) {
-        float sum = 0.0f;
-        for (int k = 0; k < numFftBins; k++) {
-            sum += _melFilterbank[m * numFftBins + k] * (float)_vReal[k];
-        }
+        float sum = DspKernels::dot(&_melFilterbank[m * numFftBins], _vReal, numFftBins);
         
         // Convert to dB
         sum = max(sum, 1e-10f);  // Avoid log(0)
-        melOutput[m] = 20.0f * log10(sum);
+        melOutput[m] = FastMath::db20(sum);
         
         // Subtract noise floor if calibrated
         if (_noiseFloor[m] != 0.0f) {
@@ -190,33 +286,30 @@ void AudioProcessor::computeMelSpectrogram(float* audioSamples, int numSamples,
 
 void AudioProcessor::setNoiseFloor(float* noiseFloor) {
     memcpy(_noiseFloor, noiseFloor, _melBins * sizeof(float));
+    #if DSP_FIXED_POINT
+    _fixed->setNoiseFloor(noiseFloor);
+    #endif
     Serial.println("Noise floor updated");
 }
 
+uint8_t AudioProcessor::quantizeDb(float db) {
+    float q = (db - MEL_DB_FLOOR) * (255.0f / MEL_DB_RANGE);
+    return (uint8_t)constrain(q, 0.0f, 255.0f);
+}
+
 float AudioProcessor::computeRMS(float* samples, int numSamples) {
-    float sum = 0.0f;
-    for (int i = 0; i < numSamples; i++) {
-        sum += samples[i] * samples[i];
-    }
-    return sqrt(sum / numSamples);
+    return DspKernels::rms(samples, numSamples);
 }
 
 float AudioProcessor::computePeakFrequency(float* samples, int numSamples) {
-    // Copy to FFT buffer
-    for (int i = 0; i < _fftSize; i++) {
-        if (i < numSamples) {
-            _vReal[i] = samples[i] * _window[i];
-        } else {
-            _vReal[i] = 0.0;
-        }
-        _vImag[i] = 0.0;
-    }
-    
+    loadWindowed(samples, numSamples);
     _fft->compute(FFTDirection::Forward);
-    _fft->complexToMagnitude();
+
+    // The loudest bin is the same in power, no roots needed
+    DspKernels::power(_vReal, _vImag, _vReal, _fftSize / 2);
     
     // Find peak
-    double maxMag = 0.0;
+    float maxMag = 0.0f;
     int maxIndex = 0;
     for (int i = 1; i < _fftSize / 2; i++) {
         if (_vReal[i] > maxMag) {
@@ -228,4 +321,92 @@ float AudioProcessor::computePeakFrequency(float* samples, int numSamples) {
     return (float)maxIndex * _sampleRate / _fftSize;
 }
 
+float AudioProcessor::estimateFundamental(float minHz, float maxHz) {
+    // Score each 1 Hz candidate by the magnitude at its first harmonics.
+    // The upper harmonics resolve f0 well below the FFT bin spacing.
+    const int harmonics = 5;
+    float binHz = (float)_sampleRate / _fftSize;
+    int lastBin = _fftSize / 2;
+
+    float bestScore = 0.0f;
+    float bestHz = 0.0f;
+    for (float f = minHz; f <= maxHz; f += 1.0f) {
+        float score = 0.0f;
+        for (int h = 1; h <= harmonics; h++) {
+            int bin = (int)(h * f / binHz + 0.5f);
+            if (bin >= lastBin) break;
+            #if DSP_FIXED_POINT
+            score += _fixedSpectrum ? (float)_fixed->magnitude(bin) : _vReal[bin];
+            #else
+            score += _vReal[bin];
+            #endif
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            bestHz = f;
+        }
+    }
+    return bestHz;
+}
+
+#if DSP_FIXED_POINT
+void AudioProcessor::loadFixed(const int32_t* raw, int numSamples, float gain) {
+    if (gain != _fixedGain) {
+        _fixedGain = gain;
+        _fixedGainDbQ8 = (int32_t)lrintf(20.0f * log10f(gain) * 256.0f);
+    }
+    _fixed->loadInt32(raw, min(numSamples, _fftSize), 8, _fixedGainDbQ8);
+}
+
+void AudioProcessor::loadFixed(const float* samples, int numSamples) {
+    _fixed->loadFloat(samples, min(numSamples, _fftSize));
+}
+
+void AudioProcessor::computeMelFixed(int16_t* melDbQ8) {
+    {
+        PROFILE_SCOPE(STAGE_FFT);
+        _fixed->transform();
+        _fixed->maskBins(_binMask);
+    }
+    PROFILE_SCOPE(STAGE_MEL);
+    _fixed->project(melDbQ8);
+    _fixedSpectrum = true;
+}
+
+void AudioProcessor::compareFixed(const float* samples, int numSamples) {
+    ScratchFrame frame;
+    float* melFloat = DspArena::instance().scratchArray<float>(_melBins);
+    int16_t* melFixed = DspArena::instance().scratchArray<int16_t>(_melBins);
+    if (melFloat == nullptr || melFixed == nullptr) return;
+
+    uint32_t start = ESP.getCycleCount();
+    computeMelSpectrogram((float*)samples, numSamples, melFloat);
+    uint32_t floatCycles = ESP.getCycleCount() - start;
+
+    start = ESP.getCycleCount();
+    loadFixed(samples, numSamples);
+    computeMelFixed(melFixed);
+    uint32_t fixedCycles = ESP.getCycleCount() - start;
+
+    float worst = 0.0f;
+    float mean = 0.0f;
+    int worstBand = 0;
+    for (int m = 0; m < _melBins; m++) {
+        float err = fabsf(melFixed[m] / 256.0f - melFloat[m]);
+        mean += err / _melBins;
+        if (err > worst) {
+            worst = err;
+            worstBand = m;
+        }
+    }
+
+    uint32_t mhz = getCpuFrequencyMhz();
+    Serial.printf("mel frontend: float %lu us (%lu cycles), fixed %lu us (%lu cycles)\n",
+                  (unsigned long)(floatCycles / mhz), (unsigned long)floatCycles,
+                  (unsigned long)(fixedCycles / mhz), (unsigned long)fixedCycles);
+    Serial.printf("fixed - float: mean %.3f dB, max %.3f dB (band %d)\n",
+                  mean, worst, worstBand);
+}
+#endif
+
 #endif // AUDIO_PROCESSOR_H
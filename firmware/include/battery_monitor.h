@@ -0,0 +1,210 @@
+/**
+ * VARTA - Battery Monitor
+ * Samples the pack voltage at 1 Hz from a background task with
+ * calibrated ADC reads, median + IIR filtering and hysteresis.
+ * Also estimates state of charge and remaining runtime.
+ */
+
+#ifndef BATTERY_MONITOR_H
+#define BATTERY_MONITOR_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define BATTERY_MEDIAN_SAMPLES  5       // Burst size per tick
+#define BATTERY_IIR_ALPHA       0.3f    // Voltage smoothing per tick
+#define BATTERY_CURRENT_ALPHA   0.02f   // Current smoothing per tick (~50 s)
+#define BATTERY_CRITICAL_COUNT  3       // Consecutive ticks before critical
+#define BATTERY_TASK_CORE       0
+#define BATTERY_TASK_PRIORITY   1
+#define BATTERY_TASK_STACK      2048
+
+enum BatteryLevel {
+    BATTERY_OK,
+    BATTERY_LOW,
+    BATTERY_CRITICAL
+};
+
+// Operating mode, used to pick the expected current draw
+enum BatteryLoad {
+    LOAD_SCAN,
+    LOAD_MONITOR,
+    LOAD_ALERT,
+    LOAD_STANDBY
+};
+
+class BatteryMonitor {
+public:
+    BatteryMonitor();
+
+    bool begin(int adcPin, float dividerRatio);
+
+    // Cached values - safe to call from the hot loop, never touch the ADC
+    float getVoltage() { return _voltage; }
+    BatteryLevel getLevel() { return _level; }
+    bool isCritical() { return _level == BATTERY_CRITICAL; }
+    float getStateOfCharge() { return _stateOfCharge; }    // 0-1
+    int getRuntimeMinutes() { return _runtimeMinutes; }
+
+    void setLoad(BatteryLoad load) { _load = load; }
+
+    /**
+     * Take one filtered sample. Called by the task; exposed for
+     * setup() so the first reading is valid before the loop starts.
+     */
+    void sample();
+
+private:
+    int _adcPin;
+    float _divider;
+    TaskHandle_t _task;
+
+    volatile float _voltage;
+    volatile BatteryLevel _level;
+    volatile float _stateOfCharge;
+    volatile int _runtimeMinutes;
+    volatile BatteryLoad _load;
+
+    bool _primed;
+    int _criticalTicks;
+    float _currentMa;
+
+    float readMedianVoltage();
+    BatteryLevel classify(float voltage);
+    float estimateStateOfCharge(float voltage);
+    static void monitorTask(void* arg);
+};
+
+// Implementation
+
+// Resting voltage per Li-ion cell vs. state of charge
+static const float kCellCurve[][2] = {
+    { 3.20f, 0.00f }, { 3.45f, 0.05f }, { 3.61f, 0.10f }, { 3.67f, 0.20f },
+    { 3.71f, 0.30f }, { 3.75f, 0.40f }, { 3.79f, 0.50f }, { 3.85f, 0.60f },
+    { 3.92f, 0.70f }, { 4.00f, 0.80f }, { 4.10f, 0.90f }, { 4.20f, 1.00f }
+};
+static const int kCellCurvePoints = sizeof(kCellCurve) / sizeof(kCellCurve[0]);
+
+BatteryMonitor::BatteryMonitor() :
+    _adcPin(-1),
+    _divider(1.0f),
+    _task(nullptr),
+    _voltage(BATTERY_FULL_VOLTAGE),
+    _level(BATTERY_OK),
+    _stateOfCharge(1.0f),
+    _runtimeMinutes(0),
+    _load(LOAD_SCAN),
+    _primed(false),
+    _criticalTicks(0),
+    _currentMa(CURRENT_SCAN_MA)
+{
+}
+
+bool BatteryMonitor::begin(int adcPin, float dividerRatio) {
+    _adcPin = adcPin;
+    _divider = dividerRatio;
+
+    pinMode(_adcPin, INPUT);
+    analogSetPinAttenuation(_adcPin, ADC_11db);  // Full 0-3.1 V input range
+
+    sample();
+
+    if (xTaskCreatePinnedToCore(monitorTask, "battery", BATTERY_TASK_STACK, this,
+                                BATTERY_TASK_PRIORITY, &_task, BATTERY_TASK_CORE) != pdPASS) {
+        Serial.println("BatteryMonitor: task creation failed");
+        return false;
+    }
+
+    Serial.printf("BatteryMonitor initialized: %.2fV (%d%%)\n",
+                  (float)_voltage, (int)(_stateOfCharge * 100));
+    return true;
+}
+
+float BatteryMonitor::readMedianVoltage() {
+    // analogReadMilliVolts applies the eFuse ADC calibration
+    uint32_t mv[BATTERY_MEDIAN_SAMPLES];
+    for (int i = 0; i < BATTERY_MEDIAN_SAMPLES; i++) {
+        uint32_t v = analogReadMilliVolts(_adcPin);
+        int j = i;
+        while (j > 0 && mv[j - 1] > v) {
+            mv[j] = mv[j - 1];
+            j--;
+        }
+        mv[j] = v;
+    }
+    return mv[BATTERY_MEDIAN_SAMPLES / 2] / 1000.0f * _divider;
+}
+
+BatteryLevel BatteryMonitor::classify(float voltage) {
+    // Critical needs several consecutive ticks; recovery needs the hysteresis margin
+    if (voltage < BATTERY_CRITICAL_VOLTAGE) {
+        _criticalTicks = min(_criticalTicks + 1, BATTERY_CRITICAL_COUNT);
+    } else {
+        _criticalTicks = 0;
+    }
+
+    BatteryLevel level = _level;
+    switch (level) {
+        case BATTERY_OK:
+            if (voltage < BATTERY_LOW_VOLTAGE) level = BATTERY_LOW;
+            break;
+        case BATTERY_LOW:
+            if (voltage > BATTERY_LOW_VOLTAGE + BATTERY_HYSTERESIS_V) level = BATTERY_OK;
+            break;
+        case BATTERY_CRITICAL:
+            if (voltage > BATTERY_CRITICAL_VOLTAGE + BATTERY_HYSTERESIS_V) level = BATTERY_LOW;
+            break;
+    }
+    if (_criticalTicks >= BATTERY_CRITICAL_COUNT) {
+        level = BATTERY_CRITICAL;
+    }
+    return level;
+}
+
+float BatteryMonitor::estimateStateOfCharge(float voltage) {
+    float cell = voltage / 2.0f;  // 2S pack
+
+    if (cell <= kCellCurve[0][0]) return 0.0f;
+    for (int i = 1; i < kCellCurvePoints; i++) {
+        if (cell <= kCellCurve[i][0]) {
+            float t = (cell - kCellCurve[i - 1][0]) / (kCellCurve[i][0] - kCellCurve[i - 1][0]);
+            return kCellCurve[i - 1][1] + t * (kCellCurve[i][1] - kCellCurve[i - 1][1]);
+        }
+    }
+    return 1.0f;
+}
+
+void BatteryMonitor::sample() {
+    float raw = readMedianVoltage();
+
+    float voltage = _primed ? _voltage + BATTERY_IIR_ALPHA * (raw - _voltage) : raw;
+    _primed = true;
+
+    int modeCurrent;
+    switch (_load) {
+        case LOAD_MONITOR: modeCurrent = CURRENT_MONITOR_MA; break;
+        case LOAD_ALERT:   modeCurrent = CURRENT_ALERT_MA; break;
+        case LOAD_STANDBY: modeCurrent = CURRENT_STANDBY_MA; break;
+        default:           modeCurrent = CURRENT_SCAN_MA; break;
+    }
+    _currentMa += BATTERY_CURRENT_ALPHA * (modeCurrent - _currentMa);
+
+    float soc = estimateStateOfCharge(voltage);
+
+    _voltage = voltage;
+    _level = classify(voltage);
+    _stateOfCharge = soc;
+    _runtimeMinutes = (int)(soc * BATTERY_CAPACITY_MAH / _currentMa * 60.0f);
+}
+
+void BatteryMonitor::monitorTask(void* arg) {
+    BatteryMonitor* self = (BatteryMonitor*)arg;
+    TickType_t lastWake = xTaskGetTickCount();
+
+    for (;;) {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(BATTERY_SAMPLE_MS));
+        self->sample();
+    }
+}
+
+#endif // BATTERY_MONITOR_H
@@ -0,0 +1,425 @@
+/**
+ * VARTA - Bearing Fusion
+ * Turns bearings from several units into a position. Each unit publishes
+ * a compact BearingReport per detection (its ID, surveyed position, true
+ * bearing, confidence and harmonic f0) over a BearingTransport; whichever
+ * node or host runs BearingFusion keeps the newest report per unit and
+ * intersects the fresh ones by weighted least squares.
+ *
+ * A bearing's cross-range error grows with range, so each line is
+ * weighted by 1 / (sigma * range)^2 and the ranges are re-estimated from
+ * the fix a few times; a few Gauss-Newton steps on the bearings then
+ * remove the line fit's pull toward the units. The inverse of the normal
+ * matrix is the position covariance, scaled up when the bearings disagree
+ * by more than their sigmas allow; its eigenvectors give the uncertainty
+ * ellipse. Reports whose f0 is far from the strongest report's are left
+ * out as a different source.
+ *
+ * Two units do not always give a fix. Over random layouts (units in a
+ * 1 km square, source in 2 km, 5 degree bearings; test_bearing_fusion),
+ * about 80 % of two-unit trials solve. The rest are near-parallel, cross
+ * behind a unit, or land past FUSION_MAX_RANGE_M. The 95 % ellipse then
+ * holds the source about 86 % of the time, since two lines leave no
+ * misfit to size it from. Three units solve 94 % (ellipse 92 %), four
+ * 98 % (94 %), and eight or more over 99 % (95-96 %).
+ *
+ * Portable (no Arduino), so the same engine runs on a host over logged
+ * reports. LoopbackBus / LoopbackTransport stand in for a radio in-process.
+ */
+
+#ifndef BEARING_FUSION_H
+#define BEARING_FUSION_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+
+#define BEARING_REPORT_VERSION  2
+#define BEARING_FLAG_SHARED_TIME 0x01   // timestampMs is mesh time (time_sync.h), not the sender's uptime
+#define BEARING_LOOPBACK_DEPTH  64      // Reports held by a loopback bus
+#define FUSION_IRLS_PASSES      4       // Range re-estimates per solve
+#define FUSION_REFINE_STEPS     4       // Gauss-Newton steps on the bearings after the line fit
+#define FUSION_REFINE_HALVINGS  4       // Step halvings tried before a refinement stops
+#define FUSION_MIN_RANGE_M      10.0f   // Floor for a line's range weight
+#define FUSION_MIN_GEOMETRY     1e-3f   // Normal-matrix eigenvalue ratio; below is near-parallel
+#define FUSION_ELLIPSE_SCALE    2.4477f // sqrt(chi2(2 dof, 95 %)): 1-sigma axes to 95 %
+
+struct __attribute__((packed)) BearingReport {
+    uint8_t version;
+    uint8_t nodeId;
+    uint16_t seq;
+    uint32_t timestampMs;       // Sender's clock, or mesh time with BEARING_FLAG_SHARED_TIME
+    int16_t eastDm;             // Sender position from the site origin, decimetres
+    int16_t northDm;
+    uint16_t bearingCdeg;       // True bearing (clockwise from north), 0.01 degree
+    uint8_t confidence;         // 0-255
+    uint16_t f0Dhz;             // Harmonic f0, 0.1 Hz; 0 = unknown
+    uint8_t flags;              // BEARING_FLAG_*
+};
+
+static_assert(sizeof(BearingReport) == 18, "BearingReport layout changed; bump BEARING_REPORT_VERSION");
+
+struct FusionFix {
+    float eastM;                // Source position from the site origin
+    float northM;
+    float majorM;               // 95 % ellipse semi-axes
+    float minorM;
+    float axisDeg;              // Major axis bearing, 0-180
+    float residualDeg;          // RMS bearing misfit of the lines used
+    int nodes;
+};
+
+/**
+ * Anything that moves reports between units: radio, serial, a log file.
+ * receive() returns reports from other units only, false when none wait.
+ */
+class BearingTransport {
+public:
+    virtual ~BearingTransport() {}
+    virtual bool send(const BearingReport& report) = 0;
+    virtual bool receive(BearingReport* report) = 0;
+};
+
+/**
+ * Shared in-process medium: every transport on the bus sees every report
+ */
+class LoopbackBus {
+public:
+    LoopbackBus() : _written(0) {}
+
+    void post(const BearingReport& report) {
+        _ring[_written % BEARING_LOOPBACK_DEPTH] = report;
+        _written++;
+    }
+
+    uint32_t written() { return _written; }
+    const BearingReport& at(uint32_t index) { return _ring[index % BEARING_LOOPBACK_DEPTH]; }
+
+private:
+    BearingReport _ring[BEARING_LOOPBACK_DEPTH];
+    uint32_t _written;
+};
+
+class LoopbackTransport : public BearingTransport {
+public:
+    LoopbackTransport(LoopbackBus& bus, uint8_t nodeId) :
+        _bus(bus), _nodeId(nodeId), _read(bus.written()), _dropped(0) {}
+
+    bool send(const BearingReport& report) override {
+        _bus.post(report);
+        return true;
+    }
+
+    bool receive(BearingReport* report) override {
+        // A reader that fell a whole ring behind loses the oldest reports
+        uint32_t written = _bus.written();
+        if (written - _read > BEARING_LOOPBACK_DEPTH) {
+            _dropped += written - _read - BEARING_LOOPBACK_DEPTH;
+            _read = written - BEARING_LOOPBACK_DEPTH;
+        }
+        while (_read != written) {
+            const BearingReport& r = _bus.at(_read++);
+            if (r.nodeId != _nodeId) {
+                *report = r;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t getDropped() { return _dropped; }
+
+private:
+    LoopbackBus& _bus;
+    uint8_t _nodeId;
+    uint32_t _read;
+    uint32_t _dropped;
+};
+
+class BearingFusion {
+public:
+    BearingFusion();
+
+    /**
+     * Pack this unit's detection; bearingDeg is already true (heading applied)
+     */
+    static BearingReport makeReport(uint8_t nodeId, uint16_t seq, uint32_t timestampMs,
+                                    float eastM, float northM, float bearingDeg,
+                                    float confidence, float f0Hz, uint8_t flags = 0);
+
+    /**
+     * Keep `report` as its unit's newest. Freshness is judged by
+     * receivedMs on the fusing node's clock, so senders need no common
+     * time base; with one, pass the report's own time mapped onto that
+     * clock instead. False if the version is unknown or the node table
+     * is full.
+     */
+    bool submit(const BearingReport& report, uint32_t receivedMs);
+
+    /**
+     * Intersect the reports received within FUSION_WINDOW_MS of nowMs.
+     * False with fewer than FUSION_MIN_NODES usable lines, near-parallel
+     * geometry, or a fix behind the units or beyond FUSION_MAX_RANGE_M.
+     */
+    bool solve(uint32_t nowMs, FusionFix* fix);
+
+    int getNodeCount() { return _count; }
+
+private:
+    struct NodeSlot {
+        BearingReport report;
+        uint32_t receivedMs;
+    };
+
+    struct Line {
+        float east;             // Unit position
+        float north;
+        float sinB;             // Bearing direction (east, north) = (sin, cos)
+        float cosB;
+        float sigmaRad;         // Bearing sigma at this confidence
+    };
+
+    NodeSlot _nodes[FUSION_MAX_NODES];
+    int _count;
+
+    static bool intersect(const Line* lines, int n, FusionFix* fix);
+    static float bearingMiss(const Line& line, float de, float dn);
+    static float misfit(const Line* lines, int n, float e, float north);
+    static bool inRange(const Line* lines, int n, float e, float north);
+};
+
+// Implementation
+
+BearingFusion::BearingFusion() :
+    _count(0)
+{
+    memset(_nodes, 0, sizeof(_nodes));
+}
+
+BearingReport BearingFusion::makeReport(uint8_t nodeId, uint16_t seq, uint32_t timestampMs,
+                                        float eastM, float northM, float bearingDeg,
+                                        float confidence, float f0Hz, uint8_t flags) {
+    BearingReport r;
+    r.version = BEARING_REPORT_VERSION;
+    r.nodeId = nodeId;
+    r.seq = seq;
+    r.timestampMs = timestampMs;
+    r.eastDm = (int16_t)lrintf(fmaxf(-32768.0f, fminf(32767.0f, eastM * 10.0f)));
+    r.northDm = (int16_t)lrintf(fmaxf(-32768.0f, fminf(32767.0f, northM * 10.0f)));
+    float bearing = fmodf(bearingDeg, 360.0f);
+    if (bearing < 0.0f) bearing += 360.0f;
+    r.bearingCdeg = (uint16_t)(lrintf(bearing * 100.0f) % 36000);
+    r.confidence = (uint8_t)lrintf(fmaxf(0.0f, fminf(1.0f, confidence)) * 255.0f);
+    r.f0Dhz = (uint16_t)lrintf(fmaxf(0.0f, fminf(6553.5f, f0Hz)) * 10.0f);
+    r.flags = flags;
+    return r;
+}
+
+bool BearingFusion::submit(const BearingReport& report, uint32_t receivedMs) {
+    if (report.version != BEARING_REPORT_VERSION) return false;
+
+    int slot = -1;
+    for (int i = 0; i < _count; i++) {
+        if (_nodes[i].report.nodeId == report.nodeId) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        if (_count >= FUSION_MAX_NODES) return false;
+        slot = _count++;
+    }
+
+    _nodes[slot].report = report;
+    _nodes[slot].receivedMs = receivedMs;
+    return true;
+}
+
+bool BearingFusion::solve(uint32_t nowMs, FusionFix* fix) {
+    // The strongest fresh report names the source; others must agree on f0
+    int strongest = -1;
+    for (int i = 0; i < _count; i++) {
+        if (nowMs - _nodes[i].receivedMs > FUSION_WINDOW_MS) continue;
+        if (strongest < 0 || _nodes[i].report.confidence > _nodes[strongest].report.confidence) {
+            strongest = i;
+        }
+    }
+    if (strongest < 0) return false;
+    float refF0 = _nodes[strongest].report.f0Dhz * 0.1f;
+
+    Line lines[FUSION_MAX_NODES];
+    int n = 0;
+    for (int i = 0; i < _count; i++) {
+        const BearingReport& r = _nodes[i].report;
+        if (nowMs - _nodes[i].receivedMs > FUSION_WINDOW_MS) continue;
+
+        float f0 = r.f0Dhz * 0.1f;
+        if (refF0 > 0.0f && f0 > 0.0f && fabsf(f0 - refF0) > FUSION_F0_TOLERANCE_HZ) continue;
+
+        float bearing = r.bearingCdeg * (0.01f * (float)M_PI / 180.0f);
+        float confidence = fmaxf(r.confidence / 255.0f, 0.1f);
+        lines[n].east = r.eastDm * 0.1f;
+        lines[n].north = r.northDm * 0.1f;
+        lines[n].sinB = sinf(bearing);
+        lines[n].cosB = cosf(bearing);
+        lines[n].sigmaRad = FUSION_BEARING_SIGMA_DEG * ((float)M_PI / 180.0f) / confidence;
+        n++;
+    }
+    if (n < FUSION_MIN_NODES) return false;
+
+    if (!intersect(lines, n, fix)) return false;
+
+    // Ghost fixes: the lines cross behind a unit, or far past any range we hear
+    for (int i = 0; i < n; i++) {
+        float de = fix->eastM - lines[i].east;
+        float dn = fix->northM - lines[i].north;
+        if (de * lines[i].sinB + dn * lines[i].cosB < 0.0f) return false;
+    }
+    return inRange(lines, n, fix->eastM, fix->northM);
+}
+
+float BearingFusion::bearingMiss(const Line& line, float de, float dn) {
+    // Measured minus predicted bearing to (de, dn) from the unit, in (-pi, pi]
+    return atan2f(line.sinB * dn - line.cosB * de, line.cosB * dn + line.sinB * de);
+}
+
+float BearingFusion::misfit(const Line* lines, int n, float e, float north) {
+    // Sum of squared bearing misses in sigmas
+    float chi2 = 0.0f;
+    for (int i = 0; i < n; i++) {
+        float miss = bearingMiss(lines[i], e - lines[i].east, north - lines[i].north) / lines[i].sigmaRad;
+        chi2 += miss * miss;
+    }
+    return chi2;
+}
+
+bool BearingFusion::inRange(const Line* lines, int n, float e, float north) {
+    for (int i = 0; i < n; i++) {
+        float de = e - lines[i].east;
+        float dn = north - lines[i].north;
+        if (de * de + dn * dn > FUSION_MAX_RANGE_M * FUSION_MAX_RANGE_M) return false;
+    }
+    return true;
+}
+
+bool BearingFusion::intersect(const Line* lines, int n, FusionFix* fix) {
+    // Line i: nx * (e - east) + ny * (n - north) = 0 with normal (cos, -sin)
+    float e = 0.0f, north = 0.0f;
+    float a11 = 0.0f, a12 = 0.0f, a22 = 0.0f;
+    bool haveFix = false;
+
+    for (int pass = 0; pass < FUSION_IRLS_PASSES; pass++) {
+        float b1 = 0.0f, b2 = 0.0f;
+        a11 = a12 = a22 = 0.0f;
+        for (int i = 0; i < n; i++) {
+            const Line& l = lines[i];
+            float range = 1.0f;     // First pass: angular weights only
+            if (haveFix) {
+                float de = e - l.east;
+                float dn = north - l.north;
+                range = fmaxf(sqrtf(de * de + dn * dn), FUSION_MIN_RANGE_M);
+            }
+            float sigma = l.sigmaRad * range;
+            float w = 1.0f / (sigma * sigma);
+            float nx = l.cosB;
+            float ny = -l.sinB;
+            float d = nx * l.east + ny * l.north;
+            a11 += w * nx * nx;
+            a12 += w * nx * ny;
+            a22 += w * ny * ny;
+            b1 += w * nx * d;
+            b2 += w * ny * d;
+        }
+
+        // Near-parallel lines leave one direction unconstrained
+        float trace = a11 + a22;
+        float det = a11 * a22 - a12 * a12;
+        if (trace <= 0.0f || det <= FUSION_MIN_GEOMETRY * trace * trace) return false;
+
+        e = (a22 * b1 - a12 * b2) / det;
+        north = (a11 * b2 - a12 * b1) / det;
+        haveFix = true;
+    }
+
+    // A bearing error tilts a line as well as moving it, which biases
+    // the line fit toward the units by more than its own ellipse once
+    // there are more than a few; refine on the bearings themselves.
+    // Steps that would worsen the misfit are halved. Weak geometry, where
+    // the bearings barely pin the range, keeps the line fit rather than
+    // sliding out past FUSION_MAX_RANGE_M
+    float chi2 = misfit(lines, n, e, north);
+    for (int step = 0; step < FUSION_REFINE_STEPS; step++) {
+        float h11 = 0.0f, h12 = 0.0f, h22 = 0.0f;
+        float g1 = 0.0f, g2 = 0.0f;
+        for (int i = 0; i < n; i++) {
+            const Line& l = lines[i];
+            float de = e - l.east;
+            float dn = north - l.north;
+            float r2 = fmaxf(de * de + dn * dn, FUSION_MIN_RANGE_M * FUSION_MIN_RANGE_M);
+            float miss = bearingMiss(l, de, dn);
+            float j1 = dn / r2;     // d(bearing to the fix) / d(east, north)
+            float j2 = -de / r2;
+            float w = 1.0f / (l.sigmaRad * l.sigmaRad);
+            h11 += w * j1 * j1;
+            h12 += w * j1 * j2;
+            h22 += w * j2 * j2;
+            g1 += w * j1 * miss;
+            g2 += w * j2 * miss;
+        }
+
+        float trace = h11 + h22;
+        float det = h11 * h22 - h12 * h12;
+        if (trace <= 0.0f || det <= FUSION_MIN_GEOMETRY * trace * trace) break;
+        float stepE = (h22 * g1 - h12 * g2) / det;
+        float stepN = (h11 * g2 - h12 * g1) / det;
+
+        bool accepted = false;
+        float tried = chi2;
+        for (int halve = 0; halve < FUSION_REFINE_HALVINGS && !accepted; halve++) {
+            tried = misfit(lines, n, e + stepE, north + stepN);
+            accepted = tried <= chi2 && inRange(lines, n, e + stepE, north + stepN);
+            if (!accepted) {
+                stepE *= 0.5f;
+                stepN *= 0.5f;
+            }
+        }
+        if (!accepted) break;
+        e += stepE;
+        north += stepN;
+        chi2 = tried;
+        a11 = h11;
+        a12 = h12;
+        a22 = h22;
+    }
+
+    // RMS bearing misfit at the fix
+    float sumSqRad = 0.0f;
+    for (int i = 0; i < n; i++) {
+        float missRad = bearingMiss(lines[i], e - lines[i].east, north - lines[i].north);
+        sumSqRad += missRad * missRad;
+    }
+    float inflate = n > 2 ? fmaxf(1.0f, chi2 / (n - 2)) : 1.0f;
+
+    // Covariance = inverse of the last step's normal matrix; ellipse from
+    // its eigenvalues
+    float det = a11 * a22 - a12 * a12;
+    float c11 = inflate * a22 / det;
+    float c22 = inflate * a11 / det;
+    float c12 = -inflate * a12 / det;
+    float mean = 0.5f * (c11 + c22);
+    float spread = sqrtf(0.25f * (c11 - c22) * (c11 - c22) + c12 * c12);
+    float angle = 0.5f * atan2f(2.0f * c12, c11 - c22);     // Major axis, from east
+
+    fix->eastM = e;
+    fix->northM = north;
+    fix->majorM = FUSION_ELLIPSE_SCALE * sqrtf(mean + spread);
+    fix->minorM = FUSION_ELLIPSE_SCALE * sqrtf(fmaxf(mean - spread, 0.0f));
+    float axis = 90.0f - angle * (180.0f / (float)M_PI);
+    fix->axisDeg = fmodf(axis + 180.0f, 180.0f);
+    fix->residualDeg = sqrtf(sumSqRad / n) * (180.0f / (float)M_PI);
+    fix->nodes = n;
+    return true;
+}
+
+#endif // BEARING_FUSION_H
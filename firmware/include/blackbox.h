@@ -0,0 +1,535 @@
+/**
+ * VARTA - Black Box Recorder
+ * Keeps the last few seconds of all four channels in a PSRAM ring
+ * alongside a per-hop confidence/bearing trace. A trigger freezes a
+ * window around the event and a background task streams it straight
+ * from the ring to LittleFS, one chunk per hop, so flash stalls land in
+ * the I2S wait instead of the DSP burst.
+ *
+ * File layout (little-endian): BlackBoxHeader, hopCount BlackBoxHop
+ * records, then frameCount interleaved int16 frames - raw, or as
+ * AudioEncoder blocks of up to one chunk each when codec is set.
+ * Decoder: firmware/tools/blackbox_extract.py
+ *
+ * Dump protocol: "BLACKBOX <name> <size>\n", then "BLACKBOX-DATA <offset>
+ * <length>\n" + raw bytes per chunk, one chunk per hop. Other serial
+ * output can land between chunks but never inside one.
+ */
+
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "config.h"
+#include "logger.h"
+#include "audio_codec.h"
+#include "profiler.h"
+#include "crc.h"
+#include "memory_pools.h"
+
+#define BLACKBOX_CHANNELS       4
+#define BLACKBOX_VERSION        2
+#define BLACKBOX_DIR            "/bb"
+#define BLACKBOX_HOP_RECORDS    1024    // Trace history, well past the audio ring
+#define BLACKBOX_CHUNK_BYTES    8192    // Flash write per hop
+#define BLACKBOX_TASK_CORE      0       // Off the DSP core
+#define BLACKBOX_TASK_PRIORITY  1
+#define BLACKBOX_TASK_STACK     4096
+#define BLACKBOX_DUMP_CHUNK     1024    // Serial bytes per hop while dumping
+
+#define BLACKBOX_SAMPLE_RATE    (SAMPLE_RATE / BLACKBOX_DECIMATION)
+#define BLACKBOX_CHUNK_FRAMES   (BLACKBOX_CHUNK_BYTES / (BLACKBOX_CHANNELS * sizeof(int16_t)))
+
+#if BLACKBOX_PRE_MS + BLACKBOX_POST_MS >= BLACKBOX_RING_SECONDS * 1000
+#error "Black box window must be shorter than the ring"
+#endif
+
+enum BlackBoxReason {
+    BLACKBOX_REASON_ALERT,
+    BLACKBOX_REASON_MANUAL
+};
+
+struct __attribute__((packed)) BlackBoxHeader {
+    char magic[4];              // "VBB1"
+    uint16_t version;
+    uint16_t channels;
+    uint32_t sampleRate;
+    uint32_t frameCount;
+    uint32_t triggerFrame;      // Offset of the trigger within the window
+    uint32_t hopCount;
+    uint32_t uptimeMs;          // At the trigger
+    uint32_t modelCrc;          // CRC32 of the flatbuffer in model_data.h
+    uint8_t reason;
+    uint8_t codec;              // AudioCodec
+    uint8_t reserved[2];
+    char firmware[16];
+};
+
+struct __attribute__((packed)) BlackBoxHop {
+    int32_t frame;              // Relative to the window start
+    float confidence;
+    float bearing;
+    uint8_t state;
+    uint8_t reserved[3];
+};
+
+class BlackBox {
+public:
+    BlackBox();
+
+    bool begin(uint32_t modelCrc);
+
+    /**
+     * Append one capture block. Decimates and converts in place into the
+     * ring; no staging copy. Called from the capture path on the loop task.
+     */
+    void append(const float* const* channels, int numSamples);
+
+    /**
+     * Tag the current position with the hop's detector output
+     */
+    void recordHop(float confidence, float bearing, uint8_t state);
+
+    /**
+     * Freeze a window around now. Ignored while a previous one is pending.
+     */
+    bool trigger(BlackBoxReason reason);
+
+    /**
+     * Release one chunk of flash writing and send one chunk of a pending
+     * dump. Call once per hop, after the burst.
+     */
+    void service();
+
+    bool isBusy() { return _state != BB_RECORDING; }
+    uint32_t getDroppedFrames() { return _droppedFrames; }
+
+    /**
+     * Start streaming the newest finished recording (never the one being
+     * written); service() sends it a chunk at a time
+     */
+    void dumpLatest();
+    bool isDumping() { return (bool)_dumpFile; }
+
+    /**
+     * Encode the newest second of the ring with each codec and print
+     * compression ratio and cycles per sample. Blocks the caller.
+     */
+    void benchmarkCodecs();
+
+private:
+    enum State {
+        BB_RECORDING,
+        BB_POST_TRIGGER,        // Waiting for the post-trigger audio
+        BB_PERSISTING           // Window frozen, task writing it out
+    };
+
+    int16_t* _ring;
+    uint32_t _ringFrames;
+    BlackBoxHop* _hops;
+    uint32_t _hopFrames[BLACKBOX_HOP_RECORDS];  // Absolute frame of each hop
+    uint32_t _hopHead;
+    uint32_t _modelCrc;
+    bool _ready;
+
+    // Absolute frame counters; only differences are used, so wrap is harmless
+    volatile uint32_t _writeFrame;
+    volatile uint32_t _readFrame;           // Task's progress through the window
+    volatile State _state;
+    uint32_t _droppedFrames;
+
+    uint32_t _triggerFrame;
+    uint32_t _windowStart;
+    uint32_t _windowEnd;
+    uint32_t _triggerMs;
+    BlackBoxReason _reason;
+    uint32_t _nextIndex;
+    volatile uint32_t _openIndex;           // Recording the task is writing, or UINT32_MAX
+
+    File _dumpFile;
+    uint32_t _dumpIndex;                    // Kept by makeRoom() while dumping
+    size_t _dumpOffset;
+
+    AudioEncoder _encoder;
+    uint8_t* _encoded;                      // One encoded chunk
+
+    TaskHandle_t _task;
+
+    void startPersist();
+    void serviceDump();
+    bool persist();
+    bool makeRoom(size_t bytes);
+    static void persistTask(void* arg);
+};
+
+// Implementation
+
+BlackBox::BlackBox() :
+    _ring(nullptr),
+    _ringFrames(0),
+    _hops(nullptr),
+    _hopHead(0),
+    _modelCrc(0),
+    _ready(false),
+    _writeFrame(0),
+    _readFrame(0),
+    _state(BB_RECORDING),
+    _droppedFrames(0),
+    _triggerFrame(0),
+    _windowStart(0),
+    _windowEnd(0),
+    _triggerMs(0),
+    _reason(BLACKBOX_REASON_MANUAL),
+    _nextIndex(0),
+    _openIndex(UINT32_MAX),
+    _dumpIndex(UINT32_MAX),
+    _dumpOffset(0),
+    _encoded(nullptr),
+    _task(nullptr)
+{
+}
+
+bool BlackBox::begin(uint32_t modelCrc) {
+    _modelCrc = modelCrc;
+    _ringFrames = (uint32_t)BLACKBOX_SAMPLE_RATE * BLACKBOX_RING_SECONDS;
+
+    MemoryPools& pools = MemoryPools::instance();
+    _ring = (int16_t*)pools.allocate("blackbox ring",
+                                     _ringFrames * BLACKBOX_CHANNELS * sizeof(int16_t), PLACE_BLACKBOX);
+    _hops = (BlackBoxHop*)pools.allocate("blackbox hops",
+                                         BLACKBOX_HOP_RECORDS * sizeof(BlackBoxHop), PLACE_BLACKBOX);
+
+    _encoder.begin(BLACKBOX_CODEC, BLACKBOX_CHANNELS);
+    _encoded = (uint8_t*)pools.allocate("blackbox encode",
+                                        _encoder.maxBlockBytes(BLACKBOX_CHUNK_FRAMES), POOL_INTERNAL);
+
+    if (_ring == nullptr || _hops == nullptr || _encoded == nullptr) {
+        Serial.println("BlackBox: buffer allocation failed");
+        return false;
+    }
+
+    if (!LittleFS.begin(true)) {
+        Serial.println("BlackBox: LittleFS mount failed");
+        return false;
+    }
+    LittleFS.mkdir(BLACKBOX_DIR);
+
+    // Continue numbering after the newest recording on flash
+    File dir = LittleFS.open(BLACKBOX_DIR);
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+        uint32_t index = strtoul(f.name(), nullptr, 10);
+        _nextIndex = max(_nextIndex, index + 1);
+    }
+    dir.close();
+
+    if (xTaskCreatePinnedToCore(persistTask, "blackbox", BLACKBOX_TASK_STACK, this,
+                                BLACKBOX_TASK_PRIORITY, &_task, BLACKBOX_TASK_CORE) != pdPASS) {
+        Serial.println("BlackBox: task creation failed");
+        return false;
+    }
+
+    _ready = true;
+    Serial.printf("BlackBox: %lu s ring at %d Hz, next recording %05lu\n",
+                  (unsigned long)BLACKBOX_RING_SECONDS, BLACKBOX_SAMPLE_RATE,
+                  (unsigned long)_nextIndex);
+    return true;
+}
+
+void BlackBox::append(const float* const* channels, int numSamples) {
+    if (!_ready) return;
+
+    for (int i = 0; i + BLACKBOX_DECIMATION <= numSamples; i += BLACKBOX_DECIMATION) {
+        // Never overwrite the part of a frozen window the task hasn't written
+        if (_state == BB_PERSISTING && _writeFrame - _readFrame >= _ringFrames) {
+            _droppedFrames++;
+            continue;
+        }
+
+        int16_t* frame = &_ring[(_writeFrame % _ringFrames) * BLACKBOX_CHANNELS];
+        for (int ch = 0; ch < BLACKBOX_CHANNELS; ch++) {
+            // Boxcar average as a cheap anti-alias before decimating
+            float sum = 0;
+            for (int k = 0; k < BLACKBOX_DECIMATION; k++) {
+                sum += channels[ch][i + k];
+            }
+            float v = sum * (32767.0f / BLACKBOX_DECIMATION);
+            frame[ch] = (int16_t)constrain(v, -32768.0f, 32767.0f);
+        }
+        _writeFrame++;
+    }
+
+    if (_state == BB_POST_TRIGGER && (int32_t)(_writeFrame - _windowEnd) >= 0) {
+        startPersist();
+    }
+}
+
+void BlackBox::recordHop(float confidence, float bearing, uint8_t state) {
+    if (!_ready) return;
+
+    uint32_t slot = _hopHead % BLACKBOX_HOP_RECORDS;
+    _hopFrames[slot] = _writeFrame;
+    _hops[slot].confidence = confidence;
+    _hops[slot].bearing = bearing;
+    _hops[slot].state = state;
+    _hopHead++;
+}
+
+bool BlackBox::trigger(BlackBoxReason reason) {
+    if (!_ready || _state != BB_RECORDING) {
+        return false;
+    }
+
+    uint32_t pre = (uint32_t)BLACKBOX_SAMPLE_RATE * BLACKBOX_PRE_MS / 1000;
+    uint32_t post = (uint32_t)BLACKBOX_SAMPLE_RATE * BLACKBOX_POST_MS / 1000;
+
+    _triggerFrame = _writeFrame;
+    _windowStart = _triggerFrame - min(pre, _triggerFrame);     // Shorter just after boot
+    _windowEnd = _triggerFrame + post;
+    _triggerMs = millis();
+    _reason = reason;
+    _state = BB_POST_TRIGGER;
+
+    LOG_INFO("BlackBox: triggered (%s)", reason == BLACKBOX_REASON_ALERT ? "alert" : "manual");
+    return true;
+}
+
+void BlackBox::startPersist() {
+    _readFrame = _windowStart;
+    _state = BB_PERSISTING;
+}
+
+void BlackBox::service() {
+    if (_state == BB_PERSISTING) {
+        xTaskNotifyGive(_task);
+    }
+    if (_dumpFile) {
+        serviceDump();
+    }
+}
+
+bool BlackBox::makeRoom(size_t bytes) {
+    // Oldest recordings go first; names are zero-padded so order is numeric
+    while (LittleFS.totalBytes() - LittleFS.usedBytes() < bytes + 2 * BLACKBOX_CHUNK_BYTES) {
+        File dir = LittleFS.open(BLACKBOX_DIR);
+        uint32_t oldest = UINT32_MAX;
+        for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+            uint32_t index = strtoul(f.name(), nullptr, 10);
+            if (index != _dumpIndex) oldest = min(oldest, index);
+        }
+        dir.close();
+
+        char path[32];
+        snprintf(path, sizeof(path), BLACKBOX_DIR "/%05lu.vbb", (unsigned long)oldest);
+        if (oldest == UINT32_MAX || !LittleFS.remove(path)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BlackBox::persist() {
+    uint32_t frameCount = _windowEnd - _windowStart;
+    size_t audioBytes = (size_t)frameCount * BLACKBOX_CHANNELS * sizeof(int16_t);
+
+    // Hops inside the window; the loop keeps adding newer ones meanwhile
+    uint32_t hopEnd = _hopHead;
+    uint32_t hopBegin = hopEnd - min(hopEnd, (uint32_t)BLACKBOX_HOP_RECORDS);
+    uint32_t hopCount = 0;
+    for (uint32_t h = hopBegin; h < hopEnd; h++) {
+        uint32_t offset = _hopFrames[h % BLACKBOX_HOP_RECORDS] - _windowStart;
+        if (offset < frameCount) hopCount++;
+    }
+
+    if (!makeRoom(sizeof(BlackBoxHeader) + hopCount * sizeof(BlackBoxHop) + audioBytes)) {
+        LOG_ERROR("BlackBox: no space for recording");
+        return false;
+    }
+
+    // Claim the index before publishing it, so dumpLatest() never sees
+    // a _nextIndex whose file is still open
+    uint32_t index = _nextIndex;
+    _openIndex = index;
+    _nextIndex = index + 1;
+    char path[32];
+    snprintf(path, sizeof(path), BLACKBOX_DIR "/%05lu.vbb", (unsigned long)index);
+    File file = LittleFS.open(path, "w");
+    if (!file) {
+        LOG_ERROR("BlackBox: cannot create recording");
+        _openIndex = UINT32_MAX;
+        return false;
+    }
+
+    BlackBoxHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "VBB1", 4);
+    header.version = BLACKBOX_VERSION;
+    header.channels = BLACKBOX_CHANNELS;
+    header.sampleRate = BLACKBOX_SAMPLE_RATE;
+    header.frameCount = frameCount;
+    header.triggerFrame = _triggerFrame - _windowStart;
+    header.hopCount = hopCount;
+    header.uptimeMs = _triggerMs;
+    header.modelCrc = _modelCrc;
+    header.reason = _reason;
+    header.codec = BLACKBOX_CODEC;
+    strncpy(header.firmware, FIRMWARE_VERSION, sizeof(header.firmware) - 1);
+    file.write((const uint8_t*)&header, sizeof(header));
+
+    for (uint32_t h = hopBegin; h < hopEnd; h++) {
+        uint32_t slot = h % BLACKBOX_HOP_RECORDS;
+        uint32_t offset = _hopFrames[slot] - _windowStart;
+        if (offset >= frameCount) continue;
+        BlackBoxHop hop = _hops[slot];
+        hop.frame = (int32_t)offset;
+        file.write((const uint8_t*)&hop, sizeof(hop));
+    }
+
+    // Audio out of the ring, one chunk per hop permit: raw straight from
+    // PSRAM, or through the encoder
+    size_t written = 0;
+    while (_readFrame != _windowEnd) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        uint32_t pos = _readFrame % _ringFrames;
+        uint32_t frames = min(min((uint32_t)BLACKBOX_CHUNK_FRAMES, _windowEnd - _readFrame),
+                              _ringFrames - pos);
+        const int16_t* src = &_ring[pos * BLACKBOX_CHANNELS];
+        const uint8_t* data = (const uint8_t*)src;
+        size_t bytes = frames * BLACKBOX_CHANNELS * sizeof(int16_t);
+        if (BLACKBOX_CODEC != CODEC_NONE) {
+            data = _encoded;
+            bytes = _encoder.encodeBlock(src, frames, _encoded,
+                                         _encoder.maxBlockBytes(BLACKBOX_CHUNK_FRAMES));
+        }
+
+        written += bytes;
+        if (file.write(data, bytes) != bytes) {
+            LOG_ERROR("BlackBox: write failed");
+            file.close();
+            LittleFS.remove(path);
+            _openIndex = UINT32_MAX;
+            return false;
+        }
+        _readFrame += frames;
+    }
+
+    file.close();
+    _openIndex = UINT32_MAX;
+    LOG_INFO("BlackBox: saved %05lu (%lu frames, %lu hops, audio %lu%% of raw)",
+             (unsigned long)index, (unsigned long)frameCount, (unsigned long)hopCount,
+             (unsigned long)(written * 100 / max(audioBytes, (size_t)1)));
+    return true;
+}
+
+void BlackBox::persistTask(void* arg) {
+    BlackBox* self = (BlackBox*)arg;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (self->_state != BB_PERSISTING) continue;
+
+        self->persist();
+        self->_state = BB_RECORDING;
+    }
+}
+
+void BlackBox::benchmarkCodecs() {
+    if (!_ready || isBusy()) {
+        Serial.println("BlackBox: busy, try again after the recording is saved");
+        return;
+    }
+
+    uint32_t end = _writeFrame;
+    uint32_t frames = min((uint32_t)BLACKBOX_SAMPLE_RATE, min(end, _ringFrames));
+    if (frames < BLACKBOX_CHUNK_FRAMES) {
+        Serial.println("BlackBox: not enough audio yet");
+        return;
+    }
+
+    static const AudioCodec codecs[] = { CODEC_LPC_RICE, CODEC_IMA_ADPCM };
+    static const char* names[] = { "lpc-rice", "ima-adpcm" };
+
+    Serial.println("codec       ratio   cycles/sample   MB/hour");
+    for (int c = 0; c < 2; c++) {
+        AudioEncoder encoder;
+        encoder.begin(codecs[c], BLACKBOX_CHANNELS);
+
+        size_t encodedBytes = 0;
+        uint32_t ticks = 0;
+        for (uint32_t f = end - frames; f != end; ) {
+            uint32_t pos = f % _ringFrames;
+            uint32_t n = min(min((uint32_t)BLACKBOX_CHUNK_FRAMES, end - f), _ringFrames - pos);
+            uint32_t t0 = Profiler::now();
+            encodedBytes += encoder.encodeBlock(&_ring[pos * BLACKBOX_CHANNELS], n, _encoded,
+                                                encoder.maxBlockBytes(BLACKBOX_CHUNK_FRAMES));
+            ticks += Profiler::now() - t0;
+            f += n;
+        }
+
+        size_t rawBytes = (size_t)frames * BLACKBOX_CHANNELS * sizeof(int16_t);
+        float cycles = (float)Profiler::ticksToUs(ticks) * getCpuFrequencyMhz() /
+                       (frames * BLACKBOX_CHANNELS);
+        float mbPerHour = (float)encodedBytes / frames * BLACKBOX_SAMPLE_RATE * 3600.0f / 1e6f;
+        Serial.printf("%-10s %6.2f %15.1f %9.0f\n", names[c],
+                      (float)rawBytes / max(encodedBytes, (size_t)1), cycles, mbPerHour);
+    }
+}
+
+void BlackBox::dumpLatest() {
+    if (!_ready) return;
+    if (_dumpFile) {
+        Serial.println("BLACKBOX busy");
+        return;
+    }
+
+    // Newest recording, stepping past the one the task has open
+    uint32_t next = _nextIndex;
+    uint32_t index = next - 1;
+    if (next > 0 && index == _openIndex) index--;
+    if (next == 0 || index == UINT32_MAX) {
+        Serial.println("BLACKBOX none");
+        return;
+    }
+
+    char path[32];
+    snprintf(path, sizeof(path), BLACKBOX_DIR "/%05lu.vbb", (unsigned long)index);
+    _dumpFile = LittleFS.open(path, "r");
+    if (!_dumpFile) {
+        Serial.println("BLACKBOX none");
+        return;
+    }
+
+    _dumpIndex = index;
+    _dumpOffset = 0;
+    Serial.printf("BLACKBOX %s %u\n", path, (unsigned)_dumpFile.size());
+}
+
+void BlackBox::serviceDump() {
+    // Only what the TX buffer takes now, so the loop never blocks on the host
+    int room = Serial.availableForWrite() - 32;     // Less the chunk line
+    size_t length = min((size_t)max(room, 0), (size_t)BLACKBOX_DUMP_CHUNK);
+    size_t remaining = _dumpFile.size() - _dumpOffset;
+    length = min(length, remaining);
+
+    if (length > 0) {
+        static uint8_t buffer[BLACKBOX_DUMP_CHUNK];     // Loop task only
+        size_t n = _dumpFile.read(buffer, length);
+        if (n == 0) {
+            LOG_ERROR("BlackBox: dump read failed at %u", (unsigned)_dumpOffset);
+            remaining = 0;
+        } else {
+            Serial.printf("BLACKBOX-DATA %u %u\n", (unsigned)_dumpOffset, (unsigned)n);
+            Serial.write(buffer, n);
+            _dumpOffset += n;
+            remaining -= n;
+        }
+    }
+
+    if (remaining == 0) {
+        _dumpFile.close();
+        _dumpIndex = UINT32_MAX;
+    }
+}
+
+#endif // BLACKBOX_H
@@ -0,0 +1,214 @@
+/**
+ * VARTA - Boot Sequencer
+ * Runs setup steps concurrently on both cores in dependency order.
+ * Core 1 steps run on the calling (setup) task, core 0 steps on a
+ * helper task. run() returns once every foreground step is done, so
+ * detection can start; background steps (core 0 only) carry on behind
+ * the loop. The timeline is logged when the last step finishes.
+ *
+ * A step returns false when it fails. Steps that depend on it, directly
+ * or through another skipped step, are skipped instead of run against
+ * state that was never set up.
+ *
+ * A worker whose next step is waiting on the other core polls once per
+ * tick; steps take milliseconds, so that costs nothing measurable and
+ * keeps task handles out of the picture.
+ */
+
+#ifndef BOOT_SEQUENCER_H
+#define BOOT_SEQUENCER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "logger.h"
+
+#define BOOT_MAX_STEPS          16
+#define BOOT_TASK_CORE          0
+#define BOOT_TASK_PRIORITY      1
+#define BOOT_TASK_STACK         8192    // Tensor allocation runs here
+
+class BootSequencer {
+public:
+    typedef bool (*StepFunction)();       // False: failed
+
+    BootSequencer();
+
+    /**
+     * Register a step; returns its id for use in later steps' after mask
+     * (1 << id). Steps on the same core start in registration order as
+     * their dependencies allow. Background steps are forced to core 0.
+     */
+    int add(const char* name, StepFunction fn, int core, uint32_t after = 0,
+            bool background = false);
+
+    /**
+     * Run all steps; returns when the foreground ones are done
+     */
+    void run();
+
+    bool isComplete() { return _done == (1u << _count) - 1; }
+
+    /**
+     * Steps that failed or were skipped, as a mask of ids
+     */
+    uint32_t getFailed() { return _failed; }
+
+    /**
+     * Log each step's start/end relative to reset
+     */
+    void logTimeline();
+
+private:
+    struct Step {
+        const char* name;
+        StepFunction fn;
+        uint8_t core;
+        bool background;
+        bool started;
+        bool skipped;
+        uint32_t after;
+        uint32_t startMs;
+        uint32_t endMs;
+    };
+
+    Step _steps[BOOT_MAX_STEPS];
+    int _count;
+    volatile uint32_t _done;
+    volatile uint32_t _failed;
+    portMUX_TYPE _mux;
+
+    void work(int core);
+    int claim(int core, bool* remaining);
+    void finish(int id, bool ok);
+    static void helperTask(void* arg);
+};
+
+// Implementation
+
+BootSequencer::BootSequencer() :
+    _count(0),
+    _done(0),
+    _failed(0),
+    _mux(portMUX_INITIALIZER_UNLOCKED)
+{
+}
+
+int BootSequencer::add(const char* name, StepFunction fn, int core, uint32_t after,
+                       bool background) {
+    if (_count >= BOOT_MAX_STEPS) {
+        Serial.println("BootSequencer: too many steps");
+        return -1;
+    }
+
+    Step& s = _steps[_count];
+    s.name = name;
+    s.fn = fn;
+    s.core = background ? BOOT_TASK_CORE : (core ? 1 : 0);
+    s.background = background;
+    s.started = false;
+    s.skipped = false;
+    s.after = after;
+    s.startMs = 0;
+    s.endMs = 0;
+    return _count++;
+}
+
+int BootSequencer::claim(int core, bool* remaining) {
+    // First step on this core whose dependencies are met
+    int id = -1;
+    *remaining = false;
+
+    portENTER_CRITICAL(&_mux);
+    for (int i = 0; i < _count; i++) {
+        Step& s = _steps[i];
+        if (s.started || s.core != core) continue;
+        *remaining = true;
+        if ((s.after & _done) == s.after) {
+            s.started = true;
+            id = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    return id;
+}
+
+void BootSequencer::finish(int id, bool ok) {
+    _steps[id].endMs = millis();
+
+    portENTER_CRITICAL(&_mux);
+    if (!ok) _failed |= 1u << id;
+    _done |= 1u << id;
+    bool last = isComplete();
+    portEXIT_CRITICAL(&_mux);
+
+    if (last) {
+        logTimeline();
+    }
+}
+
+void BootSequencer::work(int core) {
+    for (;;) {
+        bool remaining;
+        int id = claim(core, &remaining);
+        if (id < 0) {
+            if (!remaining) return;
+            vTaskDelay(1);
+            continue;
+        }
+
+        // Dependencies are done by now, so _failed is final for them
+        Step& s = _steps[id];
+        s.startMs = millis();
+        s.skipped = (s.after & _failed) != 0;
+        bool ok = !s.skipped && s.fn();
+        finish(id, ok);
+    }
+}
+
+void BootSequencer::helperTask(void* arg) {
+    BootSequencer* self = (BootSequencer*)arg;
+    self->work(BOOT_TASK_CORE);
+    vTaskDelete(nullptr);
+}
+
+void BootSequencer::run() {
+    int self = 1 - BOOT_TASK_CORE;
+
+    if (xTaskCreatePinnedToCore(helperTask, "boot", BOOT_TASK_STACK, this, BOOT_TASK_PRIORITY,
+                                nullptr, BOOT_TASK_CORE) != pdPASS) {
+        // No helper: everything runs here, in order
+        Serial.println("BootSequencer: task creation failed, booting serially");
+        for (int i = 0; i < _count; i++) {
+            _steps[i].core = self;
+        }
+        work(self);
+        return;
+    }
+
+    // Our own steps, then wait for the helper's foreground ones
+    work(self);
+    for (;;) {
+        bool pending = false;
+        portENTER_CRITICAL(&_mux);
+        for (int i = 0; i < _count; i++) {
+            if (!_steps[i].background && !(_done & (1u << i))) pending = true;
+        }
+        portEXIT_CRITICAL(&_mux);
+        if (!pending) break;
+        vTaskDelay(1);
+    }
+}
+
+void BootSequencer::logTimeline() {
+    for (int i = 0; i < _count; i++) {
+        const Step& s = _steps[i];
+        const char* result = s.skipped ? " SKIPPED" : (_failed & (1u << i)) ? " FAILED" : "";
+        LOG_INFO("Boot: %-11s core %d %5lu - %5lu ms%s%s", s.name, (int)s.core,
+                 (unsigned long)s.startMs, (unsigned long)s.endMs,
+                 s.background ? " (background)" : "", result);
+    }
+}
+
+#endif // BOOT_SEQUENCER_H
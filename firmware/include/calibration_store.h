@@ -0,0 +1,185 @@
+/**
+ * VARTA - Calibration Store
+ * Keeps calibration state (mel noise floor, mic gain and delay trims, the
+ * standby detector's learned floor) in NVS so a reboot comes up calibrated.
+ * One versioned, CRC-checked blob; anything that doesn't match the
+ * current layout is ignored and the unit starts uncalibrated.
+ *
+ * Host builds (no ARDUINO) store the blob in a file instead.
+ */
+
+#ifndef CALIBRATION_STORE_H
+#define CALIBRATION_STORE_H
+
+#include <stddef.h>
+#include <string.h>
+#include "config.h"
+#include "crc.h"
+
+#define CALIBRATION_VERSION     2       // 2: mic delays
+#define CALIBRATION_NAMESPACE   "varta"
+#define CALIBRATION_KEY         "cal"
+#define CALIBRATION_MICS        4
+#define CALIBRATION_WAKE_SAVE_DB 3.0f   // Re-save the wake floor once it moves this far
+#define CALIBRATION_HOST_DIR    "."     // Host stand-in: <dir>/<namespace>.<key>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <Preferences.h>
+typedef Preferences CalibrationNvs;
+#define CALIBRATION_PRINTLN(msg)    Serial.println(msg)
+#else
+#include <stdio.h>
+#define CALIBRATION_PRINTLN(msg)    puts(msg)
+
+// File-backed stand-in with the subset of the Preferences API used here
+class CalibrationNvs {
+public:
+    bool begin(const char* name, bool readOnly = false) {
+        _name = name;
+        return true;
+    }
+    void end() {}
+
+    size_t getBytes(const char* key, void* buf, size_t maxLen) {
+        FILE* f = fopen(path(key), "rb");
+        if (f == nullptr) return 0;
+        size_t n = fread(buf, 1, maxLen, f);
+        fclose(f);
+        return n;
+    }
+
+    size_t putBytes(const char* key, const void* value, size_t len) {
+        FILE* f = fopen(path(key), "wb");
+        if (f == nullptr) return 0;
+        size_t n = fwrite(value, 1, len, f);
+        fclose(f);
+        return n;
+    }
+
+    bool remove(const char* key) { return ::remove(path(key)) == 0; }
+
+private:
+    const char* _name;
+    char _path[128];
+
+    const char* path(const char* key) {
+        snprintf(_path, sizeof(_path), CALIBRATION_HOST_DIR "/%s.%s", _name, key);
+        return _path;
+    }
+};
+#endif
+
+struct CalibrationData {
+    uint16_t version;
+    uint16_t melBins;                       // Layout check beyond the version
+    float noiseFloor[MEL_BINS];             // dB per band; 0 = not calibrated
+    float micGain[CALIBRATION_MICS];        // Capture trims, 1 = none
+    float micDelay[CALIBRATION_MICS];       // Capture delay (samples) about the array mean
+    float wakeFloorDb;                      // Standby detector floor; 0 = not learned
+    uint32_t crc;                           // CRC32 of everything above
+};
+
+class CalibrationStore {
+public:
+    CalibrationStore();
+
+    /**
+     * Load the stored blob. False if there is none or it doesn't match
+     * this build; data() then holds defaults.
+     */
+    bool begin();
+
+    CalibrationData& data() { return _data; }
+    bool isLoaded() { return _loaded; }
+
+    /**
+     * Write data() back. Blocks for the NVS write (a few ms); call it
+     * from calibration or mode changes, never per hop.
+     */
+    bool save();
+
+    void clear();
+
+private:
+    CalibrationData _data;
+    bool _loaded;
+
+    void setDefaults();
+    static uint32_t checksum(const CalibrationData& data);
+};
+
+// Implementation
+
+CalibrationStore::CalibrationStore() :
+    _loaded(false)
+{
+    setDefaults();
+}
+
+void CalibrationStore::setDefaults() {
+    memset(&_data, 0, sizeof(_data));
+    for (int i = 0; i < CALIBRATION_MICS; i++) {
+        _data.micGain[i] = 1.0f;
+    }
+}
+
+uint32_t CalibrationStore::checksum(const CalibrationData& data) {
+    return crc32((const uint8_t*)&data, offsetof(CalibrationData, crc));
+}
+
+bool CalibrationStore::begin() {
+    CalibrationNvs nvs;
+    if (!nvs.begin(CALIBRATION_NAMESPACE, true)) {
+        return false;
+    }
+
+    CalibrationData stored;
+    size_t n = nvs.getBytes(CALIBRATION_KEY, &stored, sizeof(stored));
+    nvs.end();
+
+    if (n != sizeof(stored) || stored.version != CALIBRATION_VERSION ||
+        stored.melBins != MEL_BINS || stored.crc != checksum(stored)) {
+        if (n > 0) {
+            CALIBRATION_PRINTLN("CalibrationStore: stored calibration is stale, ignoring");
+        }
+        return false;
+    }
+
+    _data = stored;
+    _loaded = true;
+    return true;
+}
+
+bool CalibrationStore::save() {
+    _data.version = CALIBRATION_VERSION;
+    _data.melBins = MEL_BINS;
+    _data.crc = checksum(_data);
+
+    CalibrationNvs nvs;
+    if (!nvs.begin(CALIBRATION_NAMESPACE, false)) {
+        CALIBRATION_PRINTLN("CalibrationStore: NVS open failed");
+        return false;
+    }
+    bool ok = nvs.putBytes(CALIBRATION_KEY, &_data, sizeof(_data)) == sizeof(_data);
+    nvs.end();
+
+    if (!ok) {
+        CALIBRATION_PRINTLN("CalibrationStore: NVS write failed");
+        return false;
+    }
+    _loaded = true;
+    return true;
+}
+
+void CalibrationStore::clear() {
+    CalibrationNvs nvs;
+    if (nvs.begin(CALIBRATION_NAMESPACE, false)) {
+        nvs.remove(CALIBRATION_KEY);
+        nvs.end();
+    }
+    setDefaults();
+    _loaded = false;
+}
+
+#endif // CALIBRATION_STORE_H
@@ -8,6 +8,8 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#define FIRMWARE_VERSION    "0.1-alpha"
+
 // =============================================================================
 // HARDWARE CONFIGURATION
 // =============================================================================
@@ -63,10 +65,25 @@
 #define MEL_BINS            128     // Mel frequency bins
 #define SPEC_TIME_FRAMES    32      // Time frames for ML input (1 second)
 
+#define DSP_SIMD_ENABLED    true    // ESP-DSP (PIE) kernels on the ESP32-S3, see dsp_kernels.h
+#define DSP_FIXED_POINT     false   // Q15 block-floating-point mel front end, see fixed_mel.h
+#define FAST_MATH_ENABLED   true    // Approximate log2/sqrt/atan2 on per-bin paths, see fast_math.h
+
 // Microphone array geometry
 #define MIC_SPACING_MM      50.0f   // Distance between adjacent mics
 #define SPEED_OF_SOUND      343.0f  // m/s at 20°C
 
+// Mic gain/delay calibration (mic_calibrator.h)
+#define MIC_CAL_MIN_HZ          300.0f  // Band for the ambient run, below the
+#define MIC_CAL_MAX_HZ          1400.0f // array's first coherence null
+#define MIC_CAL_TONE_HZ         1034.0f // Buzzer tone ('g' on serial), snapped to a bin
+#define MIC_CAL_TONE_MS         3000
+#define MIC_CAL_BUZZER_X_MM     0.0f    // Buzzer position about the array centre
+#define MIC_CAL_BUZZER_Y_MM     -40.0f  // (+X right, +Y front)
+#define MIC_CAL_MIN_COHERENCE   0.2f    // Mean coherence with mic 1 needed to trust a run
+#define MIC_CAL_MAX_GAIN_RATIO  2.0f    // Offsets beyond these mean a fault, not a spread
+#define MIC_CAL_MAX_DELAY       2.0f    // Samples
+
 // =============================================================================
 // DETECTION CONFIGURATION
 // =============================================================================
@@ -92,6 +109,19 @@
 #define DIRECTION_SMOOTHING         0.3f    // EMA alpha for direction (0-1)
 #define MIN_CORRELATION             0.5f    // Minimum cross-correlation for valid TDOA
 
+// =============================================================================
+// WIND NOISE
+// =============================================================================
+
+// Low-band bins the mics disagree on (wind_detector.h) are dropped from
+// the mel features and direction finding; gusts skip inference
+#define WIND_ENABLED                true
+#define WIND_MAX_HZ                 500.0f  // Highest frequency checked
+#define WIND_COHERENCE_MAX          0.5f    // Diagonal-pair coherence below this is wind
+#define WIND_MIN_DBFS               -70.0f  // Quieter bins are never flagged
+#define WIND_SMOOTHING              0.3f    // EMA alpha for the spectra (0-1)
+#define WIND_GUST_LEVEL             0.6f    // Wind level that suppresses inference
+
 // =============================================================================
 // POWER MANAGEMENT
 // =============================================================================
@@ -99,9 +129,132 @@
 #define BATTERY_LOW_VOLTAGE         6.8f    // 2S low voltage warning (V)
 #define BATTERY_CRITICAL_VOLTAGE    6.4f    // 2S critical - shutdown (V)
 #define BATTERY_FULL_VOLTAGE        8.4f    // 2S full charge (V)
+#define BATTERY_HYSTERESIS_V        0.15f   // Recovery margin above low/critical (V)
+#define BATTERY_CAPACITY_MAH        2500    // Pack capacity for runtime estimate
+#define BATTERY_SAMPLE_MS           1000    // Battery monitor sample period
+
+// Estimated average current draw per mode (mA at pack voltage) - not yet
+// measured on a unit. Replace with bench readings; the runtime estimate
+// scales with them.
+#define CURRENT_SCAN_MA             210
+#define CURRENT_MONITOR_MA          230
+#define CURRENT_ALERT_MA            290
+#define CURRENT_STANDBY_MA          95
 
 #define SLEEP_TIMEOUT_MS            0       // 0 = no auto-sleep
-#define CPU_FREQ_MHZ                240     // ESP32-S3 frequency
+#define CPU_FREQ_MHZ                240     // ESP32-S3 maximum frequency
+#define CPU_FREQ_MIN_MHZ            80      // Frequency while waiting for audio
+#define PM_ENABLED                  true    // Dynamic frequency scaling
+#define PM_UTIL_HIGH                0.70f   // Step CPU up above this hop utilization
+#define PM_UTIL_LOW                 0.30f   // Step CPU down below this
+#define PM_REPORT_INTERVAL_MS       10000   // Serial power report (0 = off)
+
+// Wake-on-sound standby (single mic, minimum clock, full pipeline off).
+// Capture stays at SAMPLE_RATE: the INMP441 needs a 2.048-4.096 MHz bit
+// clock (32-64 kHz frames) and sleeps below it, so a slower I2S rate isn't
+// an option. The wake detector decimates in software instead.
+#define STANDBY_ENABLED             false   // Opt-in for long watches
+#define STANDBY_IDLE_MS             60000   // Quiet time in SCAN before standby
+#define STANDBY_PREROLL_FRAMES      SPEC_TIME_FRAMES    // Audio replayed on wake
+
+// =============================================================================
+// BLACK BOX RECORDER
+// =============================================================================
+
+#define BLACKBOX_ENABLED            true
+#define BLACKBOX_DECIMATION         2       // Stored at SAMPLE_RATE / 2, 16-bit
+#define BLACKBOX_RING_SECONDS       10      // PSRAM history, all 4 mics (~1.8 MB)
+#define BLACKBOX_PRE_MS             3000    // Saved before the trigger
+#define BLACKBOX_POST_MS            2000    // Saved after the trigger
+#define BLACKBOX_CODEC              CODEC_LPC_RICE  // CODEC_NONE, CODEC_LPC_RICE or CODEC_IMA_ADPCM
+
+// =============================================================================
+// EVENT JOURNAL
+// =============================================================================
+
+#define JOURNAL_ENABLED             true    // One record per detection event, "journal" partition
+#define JOURNAL_SNAPSHOT_BINS       32      // Mel snapshot, MEL_BINS averaged down
+#define JOURNAL_SNAPSHOT_FRAMES     16      // ... and SPEC_TIME_FRAMES
+#define JOURNAL_BATCH_RECORDS       4       // Write as soon as this many are queued
+#define JOURNAL_FLUSH_MS            30000   // Longest a record waits in RAM
+
+// =============================================================================
+// BEARING FUSION
+// =============================================================================
+
+// Each unit publishes its bearings; any unit (or a host) holding reports
+// from FUSION_MIN_NODES units intersects them into a position
+#define FUSION_ENABLED              true
+#define NODE_ID                     1       // Unique within a deployment
+#define NODE_EAST_M                 0.0f    // Surveyed position from the site origin
+#define NODE_NORTH_M                0.0f
+#define NODE_HEADING_DEG            0.0f    // Compass heading of the unit's front (M1-M2 side)
+#define FUSION_MAX_NODES            32
+#define FUSION_MIN_NODES            2
+#define FUSION_WINDOW_MS            1000    // Reports older than this are not fused
+#define FUSION_INTERVAL_MS          250     // Solve period while reports are fresh
+#define FUSION_BEARING_SIGMA_DEG    5.0f    // Bearing error (1 sigma) at full confidence
+#define FUSION_F0_TOLERANCE_HZ      15.0f   // Reports further from the strongest f0 are another source
+#define FUSION_MAX_RANGE_M          2000.0f // Fixes further from any unit are rejected
+
+// =============================================================================
+// MESH LINK
+// =============================================================================
+
+// ESP-NOW broadcast between units (mesh_link.h): bearing reports for
+// fusion and alert cues. Keeps the WiFi radio on (~+70 mA).
+#define MESH_ENABLED                false
+#define MESH_CHANNEL                1       // All units on one WiFi channel
+#define MESH_TTL                    2       // Relay hops beyond the first, for alert cues
+#define MESH_BEARING_TTL            0       // Bearings: fused by units in direct range; >0 for sparse sites
+#define MESH_RELAY_BACKOFF_MS       30      // A relay waits a random 1 to this...
+#define MESH_RELAY_SUPPRESS         2       // ... and is dropped once this many other copies are overheard
+#define MESH_BATCH_MS               40      // Longest a bearing waits for company
+#define MESH_FRAMES_PER_S           10      // Sustained frame rate per unit
+#define MESH_FRAME_BURST            4       // Frames allowed back to back
+#define MESH_ALERT_REPEATS          2       // Sends per cue (broadcasts are unacknowledged)
+
+// =============================================================================
+// TIME SYNC
+// =============================================================================
+
+// Shared mesh time (time_sync.h) for bearing reports, cues and journal
+// events. Rides on the mesh, so needs MESH_ENABLED.
+#define TIME_SYNC_ENABLED           true
+#define TIME_SYNC_MASTER_ID         1       // Unit whose clock is mesh time
+#define TIME_SYNC_INTERVAL_MS       1000    // Master's SYNC period
+#define TIME_SYNC_DELAY_EVERY       4       // Path delay measured every this many SYNCs
+
+// =============================================================================
+// MEMORY PLACEMENT
+// =============================================================================
+
+// Budgets for the buffers placed through MemoryPools (memory_pools.h);
+// the rest of the heap is left to IDF, FreeRTOS stacks and
+// library allocations. 'm' on serial prints placement and high-water marks.
+#define MEMORY_BUDGET_INTERNAL_KB   (DSP_FIXED_POINT ? 256 : 224)
+#define MEMORY_BUDGET_DMA_KB        8
+#define MEMORY_BUDGET_PSRAM_KB      4096
+
+// Per-buffer pool. Measure the hot kernels in each pool with 'k' on serial.
+// Internal SRAM is single-cycle; PSRAM goes through a 32 KB data cache, so
+// sequential streams run close to internal speed once prefetched, while
+// strided or random access larger than the cache (FFT butterflies, the
+// TFLite arena) pays a PSRAM line fill on most touches. 'k' prints cold
+// (cache evicted first) and warm latencies per pool. They have not been
+// recorded on a unit yet; put the 240 MHz table here when they are.
+#define PLACE_TENSOR_ARENA          POOL_INTERNAL   // 100 KB, random access every inference
+#define PLACE_DSP_ARENA             POOL_INTERNAL   // Audio, FFT and spectrogram buffers, scratch
+#define PLACE_MEL_FILTERBANK        POOL_PSRAM      // 525 KB dense, read sequentially once per hop
+#define PLACE_PREROLL               POOL_PSRAM      // Standby pre-roll, written per block
+#define PLACE_BLACKBOX              POOL_PSRAM      // ~1.8 MB ring, streamed
+#define PLACE_TFT_LINES             POOL_DMA        // SPI line buffers
+
+// DSP arena (dsp_arena.h): persistent state carved out at boot, scratch
+// reset every hop
+#define DSP_ARENA_PERSISTENT_KB     (DSP_FIXED_POINT ? 116 : 80)    // Audio 32 + FFT 24 + spectrogram 16 KB, tables
+                                                                    // (+ fixed front end 30 KB, uint8 frames 4 KB)
+#define DSP_ARENA_SCRATCH_KB        12      // I2S block 8 KB, mel frames
 
 // =============================================================================
 // DEBUG CONFIGURATION
@@ -109,9 +262,23 @@
 
 #define SERIAL_BAUD                 115200
 #define DEBUG_ENABLED               true
-#define DEBUG_PRINT_FFT             false
-#define DEBUG_PRINT_DETECTION       true
-#define DEBUG_PRINT_DIRECTION       true
+#define PROFILER_ENABLED            true    // Per-stage latency histograms
+#define BOOT_DETECT_BUDGET_MS       2000    // Warn if the first full-window inference is later
+
+// Log levels - LOG_* calls above LOG_LEVEL compile out entirely
+#define LOG_LEVEL_NONE              0
+#define LOG_LEVEL_ERROR             1
+#define LOG_LEVEL_WARN              2
+#define LOG_LEVEL_INFO              3       // Detections, alerts, mode changes
+#define LOG_LEVEL_DEBUG             4       // Per-detection TDOAs
+#ifndef LOG_LEVEL
+#define LOG_LEVEL                   LOG_LEVEL_INFO  // esp32s3-debug overrides to DEBUG
+#endif
+
+// Binary telemetry over USB CDC (decode with firmware/tools/telemetry_monitor.py)
+#define TELEMETRY_ENABLED           false   // Replaces text diagnostics when true
+#define TELEMETRY_MEL_FRAMES        true    // Stream every mel frame (~12 KB/s)
+#define TELEMETRY_PROFILE_MS        1000    // Profiler summary period
 
 // =============================================================================
 // MODEL CONFIGURATION
@@ -121,5 +288,7 @@
 #define MODEL_INPUT_HEIGHT          SPEC_TIME_FRAMES
 #define MODEL_INPUT_CHANNELS        1
 #define MODEL_ARENA_SIZE            (100 * 1024)    // TFLite arena size (bytes)
+#define MEL_DB_FLOOR                -80.0f  // Mel dB mapped to 0 (model input / uint8 snapshots)
+#define MEL_DB_RANGE                80.0f   // dB span mapped to 0-1 / 0-255
 
 #endif // CONFIG_H
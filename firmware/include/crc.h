@@ -0,0 +1,24 @@
+/**
+ * VARTA - CRC
+ * CRC-32 (IEEE 802.3, as zlib.crc32) for model fingerprints and on-flash
+ * records.
+ */
+
+#ifndef CRC_H
+#define CRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+inline uint32_t crc32(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+#endif // CRC_H
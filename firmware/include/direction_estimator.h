@@ -8,6 +8,8 @@
 #define DIRECTION_ESTIMATOR_H
 
 #include <Arduino.h>
+#include "dsp_kernels.h"
+#include "fast_math.h"
 
 class DirectionEstimator {
 public:
@@ -26,6 +28,17 @@ public:
      */
     float getConfidence() { return _lastConfidence; }
 
+    /**
+     * TDOAs (samples) behind the last estimate: 1-2, 1-4, 3-2, 3-4
+     */
+    const float* getLastTdoa() { return _lastTdoa; }
+
+    /**
+     * Per-mic capture delay (samples, mic late = positive) from
+     * calibration; taken out of each pair's TDOA
+     */
+    void setMicDelays(const float* delaySamples);
+
 private:
     float _micSpacingM;
     float _speedOfSound;
@@ -33,10 +46,12 @@ private:
     float _maxDelaySamples;
     float _lastConfidence;
     float _smoothedDirection;
+    float _lastTdoa[4];
+    float _micDelay[4];
     
     /**
      * Cross-correlate two signals and find peak delay
-     * Returns delay in samples (positive = sig2 leads sig1)
+     * Returns delay in samples (positive = sig2 lags sig1)
      */
     float crossCorrelate(float* sig1, float* sig2, int numSamples, float* confidence);
     
@@ -56,6 +71,8 @@ DirectionEstimator::DirectionEstimator() :
     _lastConfidence(0),
     _smoothedDirection(0)
 {
+    memset(_lastTdoa, 0, sizeof(_lastTdoa));
+    memset(_micDelay, 0, sizeof(_micDelay));
 }
 
 void DirectionEstimator::begin(float micSpacingMm, float speedOfSound, int sampleRate) {
@@ -73,50 +90,62 @@ void DirectionEstimator::begin(float micSpacingMm, float speedOfSound, int sampl
                   micSpacingMm, _maxDelaySamples);
 }
 
+void DirectionEstimator::setMicDelays(const float* delaySamples) {
+    memcpy(_micDelay, delaySamples, sizeof(_micDelay));
+}
+
 float DirectionEstimator::crossCorrelate(float* sig1, float* sig2, int numSamples, float* confidence) {
     int maxLag = (int)ceil(_maxDelaySamples) + 5;  // Some margin
     maxLag = min(maxLag, numSamples / 4);  // Don't search too far
     
-    float maxCorr = -1e10f;
+    // Lags are ranked by corr * |corr| / (norm1 * norm2), the signed square
+    // of the normalized correlation, so only the winner needs a root
+    float maxScore = -1e10f;
     int bestLag = 0;
+    float prevScore = 0.0f;
+    float leftScore = 0.0f;                 // Neighbours of the peak, for interpolation
+    float rightScore = 0.0f;
+    bool peakJustSet = false;
+
+    // sig1 is compared over a fixed span, so its energy is the same at every lag
+    const float* ref = sig1 + maxLag;
+    int span = numSamples - 2 * maxLag;
+    float norm1 = DspKernels::energy(ref, span);
     
     // Compute correlation at different lags
     for (int lag = -maxLag; lag <= maxLag; lag++) {
-        float corr = 0.0f;
-        float norm1 = 0.0f;
-        float norm2 = 0.0f;
-        int count = 0;
+        const float* shifted = sig2 + maxLag + lag;
+        float corr = DspKernels::dot(ref, shifted, span);
+        float norm2 = DspKernels::energy(shifted, span);
         
-        for (int i = maxLag; i < numSamples - maxLag; i++) {
-            int j = i + lag;
-            if (j >= 0 && j < numSamples) {
-                corr += sig1[i] * sig2[j];
-                norm1 += sig1[i] * sig1[i];
-                norm2 += sig2[j] * sig2[j];
-                count++;
-            }
-        }
+        float normSq = norm1 * norm2;
+        float score = normSq > 1e-20f ? corr * fabsf(corr) / normSq : 0.0f;
         
-        // Normalized correlation
-        float norm = sqrt(norm1 * norm2);
-        if (norm > 1e-10f) {
-            corr /= norm;
-        } else {
-            corr = 0.0f;
+        if (peakJustSet) {
+            rightScore = score;
+            peakJustSet = false;
         }
-        
-        if (corr > maxCorr) {
-            maxCorr = corr;
+        if (score > maxScore) {
+            maxScore = score;
             bestLag = lag;
+            leftScore = prevScore;
+            peakJustSet = true;
         }
+        prevScore = score;
     }
+    float maxCorr = maxScore < 0.0f ? -FastMath::sqrt(-maxScore) : FastMath::sqrt(maxScore);
     
-    // Subsample interpolation using parabolic fit
+    // Subsample interpolation: parabola through the normalized
+    // correlation at bestLag-1, bestLag, bestLag+1 (calibrated mic delays
+    // are fractions of a sample)
     float refinedLag = (float)bestLag;
-    if (abs(bestLag) < maxLag - 1) {
-        // Get correlation at bestLag-1, bestLag, bestLag+1
-        // (Simplified - recompute or cache)
-        // For now, just use integer lag
+    if (abs(bestLag) < maxLag) {
+        float left = leftScore < 0.0f ? -FastMath::sqrt(-leftScore) : FastMath::sqrt(leftScore);
+        float right = rightScore < 0.0f ? -FastMath::sqrt(-rightScore) : FastMath::sqrt(rightScore);
+        float curvature = left - 2.0f * maxCorr + right;
+        if (curvature < 0.0f) {
+            refinedLag += constrain(0.5f * (left - right) / curvature, -0.5f, 0.5f);
+        }
     }
     
     *confidence = maxCorr;
@@ -136,11 +165,15 @@ float DirectionEstimator::tdoaToAzimuth(float tdoa12, float tdoa14, float tdoa32
      *     M4 -------- M3       |
      *                          +--→ X axis
      * 
-     * TDOA12: positive = sound from right (M2 side)
-     * TDOA14: positive = sound from rear (M4 side)
+     * TDOAab is how much later Mb hears the sound than Ma:
+     * TDOA12: positive = sound from left (M1 side)
+     * TDOA34: positive = sound from right (M3 side)
+     * TDOA14: positive = sound from front (M1 side)
+     * TDOA32: positive = sound from rear (M3 side)
      * 
-     * We use the horizontal (M1-M2, M4-M3) and vertical (M1-M4, M2-M3) pairs
-     * to estimate X and Y components of arrival direction.
+     * We use the horizontal (M1-M2, M3-M4) and vertical (M1-M4, M3-M2) pairs
+     * to estimate X and Y components of arrival direction. Each parallel
+     * pair runs the opposite way, so they are differenced, not summed.
      */
     
     // Convert TDOA (in samples) to time difference (in seconds)
@@ -150,12 +183,12 @@ float DirectionEstimator::tdoaToAzimuth(float tdoa12, float tdoa14, float tdoa32
     float dt34 = tdoa34 / _sampleRate;
     
     // Average the parallel pairs for robustness
-    float dtX = (dt12 + dt34) / 2.0f;  // Left-right
-    float dtY = (dt14 + dt32) / 2.0f;  // Front-back (note: M3-M2 = -(M2-M3))
+    float dtX = (dt12 - dt34) / 2.0f;  // Left-right: positive = source on the left
+    float dtY = (dt14 - dt32) / 2.0f;  // Front-back: positive = source in front
     
-    // Convert to sine of arrival angle
+    // Convert to sine of arrival angle, +X right and +Y front
     // sin(θ) = (c * Δt) / d
-    float sinX = (_speedOfSound * dtX) / _micSpacingM;
+    float sinX = -(_speedOfSound * dtX) / _micSpacingM;
     float sinY = (_speedOfSound * dtY) / _micSpacingM;
     
     // Clamp to valid range
@@ -163,8 +196,8 @@ float DirectionEstimator::tdoaToAzimuth(float tdoa12, float tdoa14, float tdoa32
     sinY = constrain(sinY, -1.0f, 1.0f);
     
     // Convert to azimuth angle
-    // atan2 gives angle from +X axis, we want angle from +Y axis (front)
-    float azimuth = atan2(sinX, -sinY) * 180.0f / PI;
+    // atan2(x, y) gives the angle from +Y (front), clockwise
+    float azimuth = FastMath::atan2(sinX, sinY) * 180.0f / PI;
     
     // Normalize to 0-360
     if (azimuth < 0) azimuth += 360.0f;
@@ -175,11 +208,15 @@ float DirectionEstimator::tdoaToAzimuth(float tdoa12, float tdoa14, float tdoa32
 float DirectionEstimator::estimateDirection(float* mic1, float* mic2, float* mic3, float* mic4, int numSamples) {
     float conf12, conf14, conf32, conf34;
     
-    // Compute TDOA for each mic pair
-    float tdoa12 = crossCorrelate(mic1, mic2, numSamples, &conf12);
-    float tdoa14 = crossCorrelate(mic1, mic4, numSamples, &conf14);
-    float tdoa32 = crossCorrelate(mic3, mic2, numSamples, &conf32);
-    float tdoa34 = crossCorrelate(mic3, mic4, numSamples, &conf34);
+    // Compute TDOA for each mic pair, less the pair's calibrated capture skew
+    float tdoa12 = crossCorrelate(mic1, mic2, numSamples, &conf12) - (_micDelay[1] - _micDelay[0]);
+    float tdoa14 = crossCorrelate(mic1, mic4, numSamples, &conf14) - (_micDelay[3] - _micDelay[0]);
+    float tdoa32 = crossCorrelate(mic3, mic2, numSamples, &conf32) - (_micDelay[1] - _micDelay[2]);
+    float tdoa34 = crossCorrelate(mic3, mic4, numSamples, &conf34) - (_micDelay[3] - _micDelay[2]);
+    _lastTdoa[0] = tdoa12;
+    _lastTdoa[1] = tdoa14;
+    _lastTdoa[2] = tdoa32;
+    _lastTdoa[3] = tdoa34;
     
     // Average confidence
     _lastConfidence = (conf12 + conf14 + conf32 + conf34) / 4.0f;
@@ -205,11 +242,6 @@ float DirectionEstimator::estimateDirection(float* mic1, float* mic2, float* mic
     if (_smoothedDirection < 0) _smoothedDirection += 360.0f;
     if (_smoothedDirection >= 360.0f) _smoothedDirection -= 360.0f;
     
-    #if DEBUG_PRINT_DIRECTION
-    Serial.printf("TDOA: [%.1f, %.1f, %.1f, %.1f] conf=%.2f -> %.1f°\n",
-                  tdoa12, tdoa14, tdoa32, tdoa34, _lastConfidence, _smoothedDirection);
-    #endif
-    
     return _smoothedDirection;
 }
 
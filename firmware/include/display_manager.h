@@ -0,0 +1,444 @@
+/**
+ * VARTA - Display Manager
+ * Retained-mode OLED dashboard with dirty-page tracking and
+ * asynchronous I2C flushing from a low-priority task
+ */
+
+#ifndef DISPLAY_MANAGER_H
+#define DISPLAY_MANAGER_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_SSD1306.h>
+#include "config.h"
+
+#define DISPLAY_PAGES           (OLED_HEIGHT / 8)   // SSD1306 pages (8 rows each)
+#define DISPLAY_TASK_CORE       0       // Keep I2C off the DSP core (loop runs on 1)
+#define DISPLAY_TASK_PRIORITY   1       // Just above idle
+#define DISPLAY_TASK_STACK      3072
+#define DISPLAY_I2C_CHUNK       32      // Data bytes per I2C write transaction
+
+// Dashboard widgets
+enum DisplayWidget {
+    WIDGET_STATUS     = 1 << 0,
+    WIDGET_CONFIDENCE = 1 << 1,
+    WIDGET_BEARING    = 1 << 2,
+    WIDGET_COUNT      = 1 << 3,
+    WIDGET_BATTERY    = 1 << 4,
+    WIDGET_MUTE       = 1 << 5,
+    WIDGET_WIND       = 1 << 6,
+    WIDGET_ALL        = 0x7F
+};
+
+class DisplayManager {
+public:
+    DisplayManager(Adafruit_SSD1306& display);
+
+    /**
+     * Start the flush task. Call after display.begin();
+     * from then on only the flush task touches the I2C bus.
+     * Until it succeeds, render(), flush(), commit() and setStartLine()
+     * do nothing, so a headless unit can call them safely.
+     */
+    bool begin(uint8_t i2cAddress);
+    bool isReady() { return _task != nullptr; }
+
+    // Widget model - each setter marks its widget dirty only on a visible change
+    void setStatus(const char* label, bool alert);
+    void setConfidence(float confidence);
+    void setBearing(float degrees);
+    void setDetections(int count, int required);
+    void setBattery(float voltage);
+    void setMuted(bool muted);
+    void setWind(float level);
+
+    /**
+     * Redraw dirty widgets into the frame buffer and queue the
+     * touched pages for transfer. Never blocks on I2C.
+     */
+    void render();
+
+    /**
+     * Queue the whole frame buffer, for screens drawn directly with
+     * Adafruit_GFX calls. The dashboard is fully redrawn on the next render().
+     */
+    void flush();
+
+    /**
+     * Mark a rectangle of the frame buffer for transfer
+     */
+    void markDirty(int x, int y, int w, int h);
+
+    /**
+     * Queue the regions marked so far for transfer
+     */
+    void commit();
+
+    /**
+     * Queue a display start line change (hardware vertical scroll).
+     * Sent by the flush task after any pending pages.
+     */
+    void setStartLine(uint8_t line);
+
+    bool isIdle() { return _pendingPages == 0 && !_startLinePending; }
+
+private:
+    Adafruit_SSD1306& _display;
+    uint8_t _address;
+    TaskHandle_t _task;
+    SemaphoreHandle_t _lock;
+
+    // Widget state as last drawn
+    const char* _statusLabel;
+    bool _alert;
+    int _barWidth;
+    int _bearing;
+    int _count;
+    int _required;
+    int _batteryDecivolts;
+    bool _muted;
+    int _windPercent;
+    uint8_t _dirtyWidgets;
+
+    // Dirty column span per page, accumulated between commits
+    uint8_t _dirtyPages;
+    uint8_t _dirtyX0[DISPLAY_PAGES];
+    uint8_t _dirtyX1[DISPLAY_PAGES];
+
+    // Snapshot handed to the flush task (guarded by _lock)
+    uint8_t _txBuffer[OLED_WIDTH * DISPLAY_PAGES];
+    volatile uint8_t _pendingPages;
+    uint8_t _pendingX0[DISPLAY_PAGES];
+    uint8_t _pendingX1[DISPLAY_PAGES];
+    uint8_t _pendingStartLine;
+    volatile bool _startLinePending;
+
+    void drawWidget(uint8_t widget);
+    void sendPage(int page, int x0, int x1, const uint8_t* data);
+    static void flushTask(void* arg);
+};
+
+// Implementation
+
+DisplayManager::DisplayManager(Adafruit_SSD1306& display) :
+    _display(display),
+    _address(0),
+    _task(nullptr),
+    _lock(nullptr),
+    _statusLabel(nullptr),
+    _alert(false),
+    _barWidth(-1),
+    _bearing(-1),
+    _count(-1),
+    _required(-1),
+    _batteryDecivolts(-1),
+    _muted(false),
+    _windPercent(0),
+    _dirtyWidgets(WIDGET_ALL),
+    _dirtyPages(0),
+    _pendingPages(0),
+    _pendingStartLine(0),
+    _startLinePending(false)
+{
+}
+
+bool DisplayManager::begin(uint8_t i2cAddress) {
+    _address = i2cAddress;
+
+    _lock = xSemaphoreCreateMutex();
+    if (_lock == nullptr) {
+        Serial.println("DisplayManager: mutex allocation failed");
+        return false;
+    }
+
+    if (xTaskCreatePinnedToCore(flushTask, "display", DISPLAY_TASK_STACK, this,
+                                DISPLAY_TASK_PRIORITY, &_task, DISPLAY_TASK_CORE) != pdPASS) {
+        Serial.println("DisplayManager: task creation failed");
+        return false;
+    }
+
+    Serial.println("DisplayManager initialized");
+    return true;
+}
+
+void DisplayManager::setStatus(const char* label, bool alert) {
+    if (label != _statusLabel) {
+        _statusLabel = label;
+        _dirtyWidgets |= WIDGET_STATUS;
+    }
+    if (alert != _alert) {
+        _alert = alert;
+        _dirtyWidgets |= WIDGET_STATUS;
+    }
+}
+
+void DisplayManager::setConfidence(float confidence) {
+    int barWidth = (int)(constrain(confidence, 0.0f, 1.0f) * 60);
+    if (barWidth != _barWidth) {
+        _barWidth = barWidth;
+        _dirtyWidgets |= WIDGET_CONFIDENCE;
+    }
+}
+
+void DisplayManager::setBearing(float degrees) {
+    int bearing = (int)(degrees + 0.5f) % 360;
+    if (bearing != _bearing) {
+        _bearing = bearing;
+        _dirtyWidgets |= WIDGET_BEARING;
+    }
+}
+
+void DisplayManager::setDetections(int count, int required) {
+    if (count != _count || required != _required) {
+        _count = count;
+        _required = required;
+        _dirtyWidgets |= WIDGET_COUNT;
+    }
+}
+
+void DisplayManager::setBattery(float voltage) {
+    int decivolts = (int)(voltage * 10.0f + 0.5f);
+    if (decivolts != _batteryDecivolts) {
+        _batteryDecivolts = decivolts;
+        _dirtyWidgets |= WIDGET_BATTERY;
+    }
+}
+
+void DisplayManager::setMuted(bool muted) {
+    if (muted != _muted) {
+        _muted = muted;
+        _dirtyWidgets |= WIDGET_MUTE;
+    }
+}
+
+void DisplayManager::setWind(float level) {
+    // 10% steps; light breeze (under 10%) leaves the field blank
+    int percent = (int)(constrain(level, 0.0f, 1.0f) * 10.0f) * 10;
+    if (percent != _windPercent) {
+        _windPercent = percent;
+        _dirtyWidgets |= WIDGET_WIND;
+    }
+}
+
+void DisplayManager::render() {
+    if (_dirtyWidgets == 0 || !isReady()) {
+        return;
+    }
+
+    if (_dirtyWidgets == WIDGET_ALL) {
+        _display.clearDisplay();
+        markDirty(0, 0, OLED_WIDTH, OLED_HEIGHT);
+    }
+
+    _display.setTextSize(1);
+    _display.setTextColor(SSD1306_WHITE);
+
+    for (uint8_t widget = WIDGET_STATUS; widget <= WIDGET_WIND; widget <<= 1) {
+        if (_dirtyWidgets & widget) {
+            drawWidget(widget);
+        }
+    }
+    _dirtyWidgets = 0;
+
+    commit();
+}
+
+void DisplayManager::drawWidget(uint8_t widget) {
+    switch (widget) {
+        case WIDGET_STATUS:
+            // Status line plus alert indicator box
+            _display.fillRect(0, 0, OLED_WIDTH, 10, SSD1306_BLACK);
+            _display.setCursor(0, 0);
+            _display.print("VARTA ");
+            _display.print(_statusLabel ? _statusLabel : "---");
+            if (_alert) {
+                _display.fillRect(100, 0, 28, 10, SSD1306_WHITE);
+                _display.setTextColor(SSD1306_BLACK);
+                _display.setCursor(102, 1);
+                _display.print("!!!");
+                _display.setTextColor(SSD1306_WHITE);
+            }
+            markDirty(0, 0, OLED_WIDTH, 10);
+            break;
+
+        case WIDGET_CONFIDENCE:
+            _display.fillRect(0, 12, 97, 8, SSD1306_BLACK);
+            _display.setCursor(0, 12);
+            _display.print("Conf: ");
+            _display.drawRect(35, 12, 62, 8, SSD1306_WHITE);
+            _display.fillRect(36, 13, _barWidth, 6, SSD1306_WHITE);
+            markDirty(0, 12, 97, 8);
+            break;
+
+        case WIDGET_BEARING:
+            _display.fillRect(0, 24, 64, 8, SSD1306_BLACK);
+            _display.setCursor(0, 24);
+            _display.printf("Dir: %d%c", _bearing, 0xF8);  // Degree symbol
+            markDirty(0, 24, 64, 8);
+            break;
+
+        case WIDGET_COUNT:
+            _display.fillRect(0, 36, 80, 8, SSD1306_BLACK);
+            _display.setCursor(0, 36);
+            _display.printf("Det: %d/%d", _count, _required);
+            markDirty(0, 36, 80, 8);
+            break;
+
+        case WIDGET_BATTERY:
+            _display.fillRect(0, 48, 78, 8, SSD1306_BLACK);
+            _display.setCursor(0, 48);
+            _display.printf("Batt: %d.%dV", _batteryDecivolts / 10, _batteryDecivolts % 10);
+            markDirty(0, 48, 78, 8);
+            break;
+
+        case WIDGET_MUTE:
+            _display.fillRect(80, 48, 24, 8, SSD1306_BLACK);
+            if (_muted) {
+                _display.setCursor(80, 48);
+                _display.print("MUTE");
+            }
+            markDirty(80, 48, 24, 8);
+            break;
+
+        case WIDGET_WIND:
+            _display.fillRect(66, 24, 62, 8, SSD1306_BLACK);
+            if (_windPercent > 0) {
+                _display.setCursor(66, 24);
+                _display.printf("Wind %d%%", _windPercent);
+            }
+            markDirty(66, 24, 62, 8);
+            break;
+    }
+}
+
+void DisplayManager::flush() {
+    if (!isReady()) return;
+
+    markDirty(0, 0, OLED_WIDTH, OLED_HEIGHT);
+    commit();
+
+    // Whatever was drawn replaced the dashboard
+    _dirtyWidgets = WIDGET_ALL;
+}
+
+void DisplayManager::markDirty(int x, int y, int w, int h) {
+    int x0 = constrain(x, 0, OLED_WIDTH - 1);
+    int x1 = constrain(x + w - 1, 0, OLED_WIDTH - 1);
+    int p0 = constrain(y, 0, OLED_HEIGHT - 1) / 8;
+    int p1 = constrain(y + h - 1, 0, OLED_HEIGHT - 1) / 8;
+
+    for (int p = p0; p <= p1; p++) {
+        if (_dirtyPages & (1 << p)) {
+            _dirtyX0[p] = min((int)_dirtyX0[p], x0);
+            _dirtyX1[p] = max((int)_dirtyX1[p], x1);
+        } else {
+            _dirtyPages |= (1 << p);
+            _dirtyX0[p] = x0;
+            _dirtyX1[p] = x1;
+        }
+    }
+}
+
+void DisplayManager::setStartLine(uint8_t line) {
+    if (!isReady()) return;
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _pendingStartLine = line % OLED_HEIGHT;
+    _startLinePending = true;
+    xSemaphoreGive(_lock);
+
+    xTaskNotifyGive(_task);
+}
+
+void DisplayManager::commit() {
+    if (_dirtyPages == 0 || !isReady()) {
+        return;
+    }
+
+    // Snapshot the dirty spans; the flush task only ever reads _txBuffer
+    const uint8_t* frame = _display.getBuffer();
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    for (int p = 0; p < DISPLAY_PAGES; p++) {
+        if (!(_dirtyPages & (1 << p))) continue;
+
+        int x0 = _dirtyX0[p];
+        int x1 = _dirtyX1[p];
+        memcpy(&_txBuffer[p * OLED_WIDTH + x0], &frame[p * OLED_WIDTH + x0], x1 - x0 + 1);
+
+        if (_pendingPages & (1 << p)) {
+            _pendingX0[p] = min(_pendingX0[p], (uint8_t)x0);
+            _pendingX1[p] = max(_pendingX1[p], (uint8_t)x1);
+        } else {
+            _pendingX0[p] = x0;
+            _pendingX1[p] = x1;
+        }
+    }
+    _pendingPages |= _dirtyPages;
+    xSemaphoreGive(_lock);
+
+    _dirtyPages = 0;
+
+    xTaskNotifyGive(_task);
+}
+
+void DisplayManager::sendPage(int page, int x0, int x1, const uint8_t* data) {
+    // Restrict the GDDRAM window to the span, then stream it in chunks
+    Wire.beginTransmission(_address);
+    Wire.write((uint8_t)0x00);  // Command stream
+    Wire.write((uint8_t)SSD1306_COLUMNADDR);
+    Wire.write((uint8_t)x0);
+    Wire.write((uint8_t)x1);
+    Wire.write((uint8_t)SSD1306_PAGEADDR);
+    Wire.write((uint8_t)page);
+    Wire.write((uint8_t)page);
+    Wire.endTransmission();
+
+    int count = x1 - x0 + 1;
+    for (int i = 0; i < count; i += DISPLAY_I2C_CHUNK) {
+        int n = min(DISPLAY_I2C_CHUNK, count - i);
+        Wire.beginTransmission(_address);
+        Wire.write((uint8_t)0x40);  // Data stream
+        Wire.write(&data[i], n);
+        Wire.endTransmission();
+    }
+}
+
+void DisplayManager::flushTask(void* arg) {
+    DisplayManager* self = (DisplayManager*)arg;
+    uint8_t page[OLED_WIDTH];
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Send one page at a time so commit() never waits on the bus
+        for (int p = 0; p < DISPLAY_PAGES; p++) {
+            xSemaphoreTake(self->_lock, portMAX_DELAY);
+            if (!(self->_pendingPages & (1 << p))) {
+                xSemaphoreGive(self->_lock);
+                continue;
+            }
+            int x0 = self->_pendingX0[p];
+            int x1 = self->_pendingX1[p];
+            memcpy(page, &self->_txBuffer[p * OLED_WIDTH + x0], x1 - x0 + 1);
+            self->_pendingPages &= ~(1 << p);
+            xSemaphoreGive(self->_lock);
+
+            self->sendPage(p, x0, x1, page);
+        }
+
+        xSemaphoreTake(self->_lock, portMAX_DELAY);
+        bool sendStartLine = self->_startLinePending;
+        uint8_t line = self->_pendingStartLine;
+        self->_startLinePending = false;
+        xSemaphoreGive(self->_lock);
+
+        if (sendStartLine) {
+            Wire.beginTransmission(self->_address);
+            Wire.write((uint8_t)0x00);  // Command stream
+            Wire.write((uint8_t)(0x40 | line));  // SETSTARTLINE
+            Wire.endTransmission();
+        }
+    }
+}
+
+#endif // DISPLAY_MANAGER_H
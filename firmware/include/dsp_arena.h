@@ -0,0 +1,161 @@
+/**
+ * VARTA - DSP Arena
+ * Bump allocator for the signal path. The persistent region holds
+ * long-lived state (audio and FFT buffers, spectrogram, tables) carved
+ * out once at boot; the scratch region holds per-hop temporaries and is
+ * reset at the end of every hop. Both come from one PLACE_DSP_ARENA pool
+ * allocation, so the steady state does no heap work and the audio loop's
+ * stack stays small and fixed.
+ *
+ * Scratch belongs to the audio loop task. A function that can run
+ * outside a hop (calibration, standby) wraps its temporaries in a
+ * ScratchFrame so they unwind with its scope.
+ */
+
+#ifndef DSP_ARENA_H
+#define DSP_ARENA_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "memory_pools.h"
+
+#define DSP_ARENA_ALIGN     16      // PIE vector loads (ESP-DSP kernels)
+
+class DspArena {
+public:
+    static DspArena& instance();
+
+    /**
+     * Take both regions from the memory pools; false if they refused
+     */
+    bool begin();
+
+    /**
+     * Long-lived block, never freed. nullptr (and a report) when the
+     * persistent region is exhausted.
+     */
+    void* persistent(size_t bytes, size_t align = DSP_ARENA_ALIGN);
+
+    /**
+     * Temporary block, valid until the enclosing ScratchFrame closes or
+     * the hop ends
+     */
+    void* scratch(size_t bytes, size_t align = DSP_ARENA_ALIGN);
+
+    template <typename T> T* persistentArray(size_t count) {
+        return (T*)persistent(count * sizeof(T), alignof(T) > DSP_ARENA_ALIGN ? alignof(T) : DSP_ARENA_ALIGN);
+    }
+    template <typename T> T* scratchArray(size_t count) {
+        return (T*)scratch(count * sizeof(T), alignof(T) > DSP_ARENA_ALIGN ? alignof(T) : DSP_ARENA_ALIGN);
+    }
+
+    size_t mark() { return _scratchUsed; }
+    void release(size_t mark) { _scratchUsed = mark; }
+
+    /**
+     * Drop everything allocated in scratch this hop
+     */
+    void endHop() { _scratchUsed = 0; }
+
+    /**
+     * Persistent use, scratch high-water mark and the calling task's
+     * minimum free stack
+     */
+    void printReport();
+
+private:
+    uint8_t* _persistentBase;
+    size_t _persistentUsed;
+    uint8_t* _scratchBase;
+    size_t _scratchUsed;
+    size_t _scratchPeak;
+    portMUX_TYPE _mux;
+
+    DspArena();
+    static size_t alignUp(size_t offset, size_t align) { return (offset + align - 1) & ~(align - 1); }
+};
+
+/**
+ * Releases the scratch allocated within the enclosing scope
+ */
+class ScratchFrame {
+public:
+    ScratchFrame() : _mark(DspArena::instance().mark()) {}
+    ~ScratchFrame() { DspArena::instance().release(_mark); }
+
+private:
+    size_t _mark;
+};
+
+// Implementation
+
+DspArena& DspArena::instance() {
+    static DspArena arena;
+    return arena;
+}
+
+DspArena::DspArena() :
+    _persistentBase(nullptr),
+    _persistentUsed(0),
+    _scratchBase(nullptr),
+    _scratchUsed(0),
+    _scratchPeak(0),
+    _mux(portMUX_INITIALIZER_UNLOCKED)
+{
+}
+
+bool DspArena::begin() {
+    MemoryPools& pools = MemoryPools::instance();
+    _persistentBase = (uint8_t*)pools.allocate("dsp persistent", DSP_ARENA_PERSISTENT_KB * 1024UL,
+                                               PLACE_DSP_ARENA, DSP_ARENA_ALIGN);
+    _scratchBase = (uint8_t*)pools.allocate("dsp scratch", DSP_ARENA_SCRATCH_KB * 1024UL,
+                                            PLACE_DSP_ARENA, DSP_ARENA_ALIGN);
+    return _persistentBase != nullptr && _scratchBase != nullptr;
+}
+
+void* DspArena::persistent(size_t bytes, size_t align) {
+    if (_persistentBase == nullptr) return nullptr;
+
+    // Boot steps on either core may carve out their state
+    portENTER_CRITICAL(&_mux);
+    size_t offset = alignUp(_persistentUsed, align);
+    bool fits = offset + bytes <= DSP_ARENA_PERSISTENT_KB * 1024UL;
+    if (fits) {
+        _persistentUsed = offset + bytes;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    if (!fits) {
+        Serial.printf("DspArena: persistent region full (%u + %u of %u bytes)\n",
+                      (unsigned)_persistentUsed, (unsigned)bytes,
+                      (unsigned)(DSP_ARENA_PERSISTENT_KB * 1024UL));
+        return nullptr;
+    }
+    return _persistentBase + offset;
+}
+
+void* DspArena::scratch(size_t bytes, size_t align) {
+    if (_scratchBase == nullptr) return nullptr;
+
+    size_t offset = alignUp(_scratchUsed, align);
+    if (offset + bytes > DSP_ARENA_SCRATCH_KB * 1024UL) {
+        Serial.printf("DspArena: scratch region full (%u + %u of %u bytes)\n",
+                      (unsigned)_scratchUsed, (unsigned)bytes,
+                      (unsigned)(DSP_ARENA_SCRATCH_KB * 1024UL));
+        return nullptr;
+    }
+
+    _scratchUsed = offset + bytes;
+    if (_scratchUsed > _scratchPeak) _scratchPeak = _scratchUsed;
+    return _scratchBase + offset;
+}
+
+void DspArena::printReport() {
+    Serial.printf("dsp arena: persistent %u of %u bytes, scratch peak %u of %u bytes\n",
+                  (unsigned)_persistentUsed, (unsigned)(DSP_ARENA_PERSISTENT_KB * 1024UL),
+                  (unsigned)_scratchPeak, (unsigned)(DSP_ARENA_SCRATCH_KB * 1024UL));
+    Serial.printf("stack: %u bytes never used by this task\n",
+                  (unsigned)uxTaskGetStackHighWaterMark(nullptr));
+}
+
+#endif // DSP_ARENA_H
@@ -0,0 +1,283 @@
+/**
+ * VARTA - DSP Kernels
+ * The inner loops of the signal path behind one API: window multiply,
+ * gain, dot product (mel projection, correlation), energy/RMS, complex
+ * magnitude and I2S int-to-float conversion.
+ *
+ * On the ESP32-S3 (DSP_SIMD_ENABLED) the multiply, gain and dot product
+ * kernels go to ESP-DSP, which uses the PIE vector unit; everything else,
+ * and every kernel on host builds, uses the portable versions in
+ * DspKernels::Scalar. Those keep four independent accumulators and no
+ * branches in the loop so the compiler can pipeline or vectorize them.
+ *
+ * Magnitudes take their square roots from fast_math.h.
+ *
+ * Float sums in a different order differ in the last bits; selfTest()
+ * checks the active and the scalar kernels against a double-precision
+ * reference and times both. test/test_dsp_kernels.cpp runs the same
+ * comparison off-target.
+ */
+
+#ifndef DSP_KERNELS_H
+#define DSP_KERNELS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+#include "fast_math.h"
+
+#if defined(ARDUINO) && DSP_SIMD_ENABLED
+#include <esp_dsp.h>
+#define DSP_KERNELS_ESP_DSP 1
+#else
+#define DSP_KERNELS_ESP_DSP 0
+#endif
+
+#define DSP_SELFTEST_SAMPLES    HOP_SIZE    // 4 blocks of this fit in the DSP scratch region
+#define DSP_SELFTEST_RUNS       16
+#define DSP_SELFTEST_TOLERANCE  1e-4f   // Relative, for reordered float sums
+
+namespace DspKernels {
+
+namespace Scalar {
+
+inline void multiply(const float* a, const float* b, float* out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = a[i] * b[i];
+    }
+}
+
+inline void scale(const float* in, float gain, float* out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = in[i] * gain;
+    }
+}
+
+inline float dot(const float* a, const float* b, int n) {
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) {
+        s0 += a[i] * b[i];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+inline void magnitude(const float* re, const float* im, float* out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = sqrtf(re[i] * re[i] + im[i] * im[i]);
+    }
+}
+
+inline void power(const float* re, const float* im, float* out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = re[i] * re[i] + im[i] * im[i];
+    }
+}
+
+inline void int32ToFloat(const int32_t* in, int shift, float scale, float* out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = (float)(in[i] >> shift) * scale;
+    }
+}
+
+} // namespace Scalar
+
+/**
+ * out[i] = a[i] * b[i]; out may alias a or b
+ */
+inline void multiply(const float* a, const float* b, float* out, int n) {
+#if DSP_KERNELS_ESP_DSP
+    dsps_mul_f32(a, b, out, n, 1, 1, 1);
+#else
+    Scalar::multiply(a, b, out, n);
+#endif
+}
+
+/**
+ * out[i] = in[i] * gain; out may alias in
+ */
+inline void scale(const float* in, float gain, float* out, int n) {
+#if DSP_KERNELS_ESP_DSP
+    dsps_mulc_f32(in, out, n, gain, 1, 1);
+#else
+    Scalar::scale(in, gain, out, n);
+#endif
+}
+
+inline float dot(const float* a, const float* b, int n) {
+#if DSP_KERNELS_ESP_DSP
+    float result = 0.0f;
+    dsps_dotprod_f32(a, b, &result, n);
+    return result;
+#else
+    return Scalar::dot(a, b, n);
+#endif
+}
+
+inline float energy(const float* x, int n) {
+    return dot(x, x, n);
+}
+
+inline float rms(const float* x, int n) {
+    return n > 0 ? sqrtf(energy(x, n) / n) : 0.0f;
+}
+
+/**
+ * out[i] = |re[i] + j im[i]|; out may alias re
+ */
+inline void magnitude(const float* re, const float* im, float* out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = FastMath::sqrt(re[i] * re[i] + im[i] * im[i]);
+    }
+}
+
+/**
+ * out[i] = |re[i] + j im[i]|^2, for ranking bins without the root;
+ * out may alias re
+ */
+inline void power(const float* re, const float* im, float* out, int n) {
+    Scalar::power(re, im, out, n);
+}
+
+/**
+ * out[i] = (in[i] >> shift) * scale, for left-aligned I2S words
+ */
+inline void int32ToFloat(const int32_t* in, int shift, float scale, float* out, int n) {
+    Scalar::int32ToFloat(in, shift, scale, out, n);
+}
+
+inline const char* implementation() {
+    return DSP_KERNELS_ESP_DSP ? "esp-dsp" : "scalar";
+}
+
+/**
+ * Run each kernel through both paths on the same pseudo-random block,
+ * compare both with a double-precision reference computed here (not
+ * through either path), and report the worst relative error and the
+ * best-of-N time of each. `scratch` needs 4 * DSP_SELFTEST_SAMPLES
+ * floats. Returns false if either path is outside DSP_SELFTEST_TOLERANCE.
+ */
+bool selfTest(float* scratch);
+
+} // namespace DspKernels
+
+// Implementation
+
+namespace DspKernels {
+
+static float relativeError(const float* a, const float* b, int n) {
+    float worst = 0.0f;
+    for (int i = 0; i < n; i++) {
+        float ref = fabsf(b[i]) > 1e-6f ? fabsf(b[i]) : 1e-6f;
+        float err = fabsf(a[i] - b[i]) / ref;
+        if (err > worst) worst = err;
+    }
+    return worst;
+}
+
+bool selfTest(float* scratch) {
+    const int n = DSP_SELFTEST_SAMPLES;
+    float* a = scratch;
+    float* b = scratch + n;
+    float* out = scratch + 2 * n;
+    float* ref = scratch + 3 * n;
+
+    // xorshift, so both paths and every run see the same data
+    uint32_t state = 0x2545F491;
+    int32_t raw[64];
+    for (int i = 0; i < n; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        a[i] = (float)(int32_t)state * (1.0f / 2147483648.0f);
+        b[i] = (float)(state & 0xFFFF) * (1.0f / 65536.0f);
+        if (i < 64) raw[i] = (int32_t)state;
+    }
+
+    enum { MULTIPLY, SCALE, DOT, MAGNITUDE, CONVERT, KERNELS };
+    static const char* names[KERNELS] = { "multiply", "scale", "dot", "magnitude", "int2float" };
+    uint32_t best[KERNELS][2];
+    float error[KERNELS][2];
+    for (int k = 0; k < KERNELS; k++) {
+        best[k][0] = best[k][1] = UINT32_MAX;
+        error[k][0] = error[k][1] = 0.0f;
+    }
+
+    // Each path into out, checked against ref from double arithmetic
+    auto keep = [&](int kernel, int path, uint32_t start, int count) {
+        uint32_t t = DSP_SELFTEST_NOW() - start;
+        if (t < best[kernel][path]) best[kernel][path] = t;
+        float e = relativeError(out, ref, count);
+        if (e > error[kernel][path]) error[kernel][path] = e;
+    };
+    const float gain = 0.73f;
+    const float convertScale = 1.0f / 8388608.0f;
+    for (int run = 0; run < DSP_SELFTEST_RUNS; run++) {
+        for (int i = 0; i < n; i++) ref[i] = (float)((double)a[i] * b[i]);
+        uint32_t t = DSP_SELFTEST_NOW();
+        multiply(a, b, out, n);
+        keep(MULTIPLY, 0, t, n);
+        t = DSP_SELFTEST_NOW();
+        Scalar::multiply(a, b, out, n);
+        keep(MULTIPLY, 1, t, n);
+
+        for (int i = 0; i < n; i++) ref[i] = (float)((double)a[i] * gain);
+        t = DSP_SELFTEST_NOW();
+        scale(a, gain, out, n);
+        keep(SCALE, 0, t, n);
+        t = DSP_SELFTEST_NOW();
+        Scalar::scale(a, gain, out, n);
+        keep(SCALE, 1, t, n);
+
+        // Mel-like: all terms positive
+        double sum = 0.0;
+        for (int i = 0; i < n; i++) sum += (double)b[i] * b[i];
+        ref[0] = (float)sum;
+        t = DSP_SELFTEST_NOW();
+        out[0] = dot(b, b, n);
+        keep(DOT, 0, t, 1);
+        t = DSP_SELFTEST_NOW();
+        out[0] = Scalar::dot(b, b, n);
+        keep(DOT, 1, t, 1);
+
+        for (int i = 0; i < n; i++) ref[i] = (float)sqrt((double)a[i] * a[i] + (double)b[i] * b[i]);
+        t = DSP_SELFTEST_NOW();
+        magnitude(a, b, out, n);
+        keep(MAGNITUDE, 0, t, n);
+        t = DSP_SELFTEST_NOW();
+        Scalar::magnitude(a, b, out, n);
+        keep(MAGNITUDE, 1, t, n);
+
+        for (int i = 0; i < 64; i++) ref[i] = (float)(floor(raw[i] / 256.0) * convertScale);     // >> 8 floors
+        t = DSP_SELFTEST_NOW();
+        int32ToFloat(raw, 8, convertScale, out, 64);
+        keep(CONVERT, 0, t, 64);
+        t = DSP_SELFTEST_NOW();
+        Scalar::int32ToFloat(raw, 8, convertScale, out, 64);
+        keep(CONVERT, 1, t, 64);
+    }
+
+    bool ok = true;
+    DSP_SELFTEST_PRINTF("%-10s %8s %8s  rel err vs double (us, best of %d, n=%d)\n",
+                        "kernel", implementation(), "scalar", DSP_SELFTEST_RUNS, n);
+    for (int k = 0; k < KERNELS; k++) {
+        bool pass = error[k][0] <= DSP_SELFTEST_TOLERANCE && error[k][1] <= DSP_SELFTEST_TOLERANCE;
+        ok = ok && pass;
+        DSP_SELFTEST_PRINTF("%-10s %8lu %8lu  %.1e %.1e%s\n", names[k],
+                            (unsigned long)(best[k][0] / DSP_SELFTEST_TICKS_US),
+                            (unsigned long)(best[k][1] / DSP_SELFTEST_TICKS_US),
+                            (double)error[k][0], (double)error[k][1], pass ? "" : "  MISMATCH");
+    }
+    return ok;
+}
+
+} // namespace DspKernels
+
+#endif // DSP_KERNELS_H
@@ -0,0 +1,106 @@
+/**
+ * VARTA - Energy Model
+ * Accumulates time spent per power state and predicts average draw and
+ * runtime per charge. Plain C++ with no Arduino dependency so recorded
+ * timings can be replayed through the same model on a host.
+ */
+
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include <stdint.h>
+
+// Estimated ESP32-S3 core + board figures (mW at 3.3 V rail) - not yet
+// measured on a unit. Replace with bench readings; the runtime prediction
+// scales with them.
+#define ENERGY_ACTIVE_80MHZ_MW      66.0f
+#define ENERGY_ACTIVE_160MHZ_MW     99.0f
+#define ENERGY_ACTIVE_240MHZ_MW     132.0f
+#define ENERGY_IDLE_MW              43.0f   // Clock-gated idle at min frequency
+#define ENERGY_PERIPHERALS_MW       520.0f  // 4 mics, OLED, LED ring, boost losses
+#define ENERGY_CONVERTER_EFFICIENCY 0.85f
+
+class EnergyModel {
+public:
+    EnergyModel();
+
+    void reset();
+
+    // Feed elapsed time per state (microseconds)
+    void addActive(int cpuMhz, uint32_t us);
+    void addIdle(uint32_t us);
+
+    /**
+     * Average draw from the pack (mW) over everything accumulated
+     */
+    float averagePowerMw() const;
+
+    /**
+     * Hours per charge at the averaged draw
+     */
+    float predictRuntimeHours(float capacityMah, float packVoltage) const;
+
+    float activeFraction() const;
+
+private:
+    double _energyUj;       // Rail energy (uJ == mW * us / 1000)
+    uint64_t _activeUs;
+    uint64_t _idleUs;
+
+    static float activePowerMw(int cpuMhz);
+};
+
+// Implementation
+
+EnergyModel::EnergyModel() {
+    reset();
+}
+
+void EnergyModel::reset() {
+    _energyUj = 0.0;
+    _activeUs = 0;
+    _idleUs = 0;
+}
+
+float EnergyModel::activePowerMw(int cpuMhz) {
+    // Piecewise linear between characterized frequencies
+    if (cpuMhz <= 80) return ENERGY_ACTIVE_80MHZ_MW;
+    if (cpuMhz <= 160) {
+        return ENERGY_ACTIVE_80MHZ_MW +
+               (ENERGY_ACTIVE_160MHZ_MW - ENERGY_ACTIVE_80MHZ_MW) * (cpuMhz - 80) / 80.0f;
+    }
+    if (cpuMhz >= 240) return ENERGY_ACTIVE_240MHZ_MW;
+    return ENERGY_ACTIVE_160MHZ_MW +
+           (ENERGY_ACTIVE_240MHZ_MW - ENERGY_ACTIVE_160MHZ_MW) * (cpuMhz - 160) / 80.0f;
+}
+
+void EnergyModel::addActive(int cpuMhz, uint32_t us) {
+    _activeUs += us;
+    _energyUj += (double)activePowerMw(cpuMhz) * us / 1000.0;
+}
+
+void EnergyModel::addIdle(uint32_t us) {
+    _idleUs += us;
+    _energyUj += (double)ENERGY_IDLE_MW * us / 1000.0;
+}
+
+float EnergyModel::averagePowerMw() const {
+    uint64_t total = _activeUs + _idleUs;
+    if (total == 0) return 0.0f;
+
+    float coreMw = (float)(_energyUj * 1000.0 / total);
+    return (coreMw + ENERGY_PERIPHERALS_MW) / ENERGY_CONVERTER_EFFICIENCY;
+}
+
+float EnergyModel::predictRuntimeHours(float capacityMah, float packVoltage) const {
+    float mw = averagePowerMw();
+    if (mw <= 0.0f) return 0.0f;
+    return capacityMah * packVoltage / mw;
+}
+
+float EnergyModel::activeFraction() const {
+    uint64_t total = _activeUs + _idleUs;
+    return total ? (float)_activeUs / total : 0.0f;
+}
+
+#endif // ENERGY_MODEL_H
@@ -0,0 +1,147 @@
+/**
+ * VARTA - ESP-NOW Radio
+ * MeshRadio over ESP-NOW broadcast: no pairing, no access point, one
+ * WiFi channel shared by all units. Frames arrive in the WiFi task's
+ * receive callback, stamped on esp_timer there, and wait in a small
+ * ring until MeshLink::poll() takes them on the loop task.
+ */
+
+#ifndef ESPNOW_RADIO_H
+#define ESPNOW_RADIO_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+#include <esp_timer.h>
+#include "config.h"
+#include "mesh_link.h"
+
+#define ESPNOW_RX_DEPTH     8       // Frames held between polls
+
+class EspNowRadio : public MeshRadio {
+public:
+    static EspNowRadio& instance();
+
+    /**
+     * Station mode on `channel`, ESP-NOW up, broadcast peer added
+     */
+    bool begin(uint8_t channel);
+
+    bool broadcast(const uint8_t* frame, int length) override;
+    int receive(uint8_t* frame, int capacity, uint64_t* arrivalUs) override;
+    uint64_t clockUs() override { return (uint64_t)esp_timer_get_time(); }
+
+    uint32_t getOverflows() { return _overflows; }
+
+private:
+    uint8_t _frames[ESPNOW_RX_DEPTH][MESH_FRAME_MAX];
+    int _lengths[ESPNOW_RX_DEPTH];
+    uint64_t _arrivals[ESPNOW_RX_DEPTH];
+    int _head;
+    int _count;
+    uint32_t _overflows;
+    bool _ready;
+    portMUX_TYPE _mux;
+
+    EspNowRadio();
+    void arrive(const uint8_t* data, int length);
+
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    static void onReceive(const esp_now_recv_info_t* info, const uint8_t* data, int length);
+#else
+    static void onReceive(const uint8_t* mac, const uint8_t* data, int length);
+#endif
+};
+
+// Implementation
+
+static const uint8_t ESPNOW_BROADCAST[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+EspNowRadio& EspNowRadio::instance() {
+    static EspNowRadio radio;
+    return radio;
+}
+
+EspNowRadio::EspNowRadio() :
+    _head(0),
+    _count(0),
+    _overflows(0),
+    _ready(false),
+    _mux(portMUX_INITIALIZER_UNLOCKED)
+{
+}
+
+bool EspNowRadio::begin(uint8_t channel) {
+    WiFi.mode(WIFI_STA);
+    WiFi.disconnect();
+    esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+
+    if (esp_now_init() != ESP_OK) {
+        Serial.println("ESP-NOW init failed");
+        return false;
+    }
+    esp_now_register_recv_cb(onReceive);
+
+    esp_now_peer_info_t peer;
+    memset(&peer, 0, sizeof(peer));
+    memcpy(peer.peer_addr, ESPNOW_BROADCAST, sizeof(ESPNOW_BROADCAST));
+    peer.channel = channel;
+    peer.encrypt = false;
+    if (esp_now_add_peer(&peer) != ESP_OK) {
+        Serial.println("ESP-NOW broadcast peer failed");
+        return false;
+    }
+
+    _ready = true;
+    Serial.printf("ESP-NOW up on channel %d, MAC %s\n", channel, WiFi.macAddress().c_str());
+    return true;
+}
+
+bool EspNowRadio::broadcast(const uint8_t* frame, int length) {
+    if (!_ready) return false;
+    return esp_now_send(ESPNOW_BROADCAST, frame, length) == ESP_OK;
+}
+
+int EspNowRadio::receive(uint8_t* frame, int capacity, uint64_t* arrivalUs) {
+    portENTER_CRITICAL(&_mux);
+    int length = 0;
+    if (_count > 0) {
+        length = min(_lengths[_head], capacity);
+        memcpy(frame, _frames[_head], length);
+        *arrivalUs = _arrivals[_head];
+        _head = (_head + 1) % ESPNOW_RX_DEPTH;
+        _count--;
+    }
+    portEXIT_CRITICAL(&_mux);
+    return length;
+}
+
+void EspNowRadio::arrive(const uint8_t* data, int length) {
+    if (length <= 0 || length > MESH_FRAME_MAX) return;
+    uint64_t now = (uint64_t)esp_timer_get_time();
+
+    portENTER_CRITICAL(&_mux);
+    if (_count < ESPNOW_RX_DEPTH) {
+        int slot = (_head + _count) % ESPNOW_RX_DEPTH;
+        memcpy(_frames[slot], data, length);
+        _lengths[slot] = length;
+        _arrivals[slot] = now;
+        _count++;
+    } else {
+        _overflows++;
+    }
+    portEXIT_CRITICAL(&_mux);
+}
+
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+void EspNowRadio::onReceive(const esp_now_recv_info_t* info, const uint8_t* data, int length) {
+    instance().arrive(data, length);
+}
+#else
+void EspNowRadio::onReceive(const uint8_t* mac, const uint8_t* data, int length) {
+    instance().arrive(data, length);
+}
+#endif
+
+#endif // ESPNOW_RADIO_H
@@ -0,0 +1,446 @@
+/**
+ * VARTA - Event Journal
+ * Append-only log of detection events in the raw "journal" partition,
+ * kept across power cycles. Sectors are used round-robin, so each is
+ * erased once per pass over the partition and wear is spread evenly.
+ * The sector after the write position is always erased ahead; the
+ * oldest events are what that costs.
+ *
+ * The loop only copies records into a RAM queue. A background task
+ * writes them in batches, one flash operation per hop permit, so erases
+ * land in the I2S wait instead of the DSP burst.
+ *
+ * Sector: [magic:4][sequence:4], then records of
+ * [length:2][type:1][0][payload][crc32:4] padded to 4 bytes. An erased
+ * length (0xFFFF) ends the sector.
+ * Reader: firmware/tools/journal_reader.py
+ *
+ * Dump protocol: "JOURNAL <size>\n", then "JOURNAL-DATA <offset> <length>\n"
+ * + raw partition bytes per chunk, one chunk per service() call. Other
+ * serial output can land between chunks but never inside one.
+ */
+
+#ifndef EVENT_JOURNAL_H
+#define EVENT_JOURNAL_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include "config.h"
+#include "logger.h"
+#include "crc.h"
+
+#define JOURNAL_PARTITION       "journal"
+#define JOURNAL_MAGIC           0x314E4A56      // "VJN1"
+#define JOURNAL_SECTOR_SIZE     4096
+#define JOURNAL_QUEUE_RECORDS   8
+#define JOURNAL_POLL_MS         500
+#define JOURNAL_PERMIT_MS       200     // Go ahead anyway when no hops run (standby)
+#define JOURNAL_TASK_CORE       0       // Off the DSP core
+#define JOURNAL_TASK_PRIORITY   1
+#define JOURNAL_TASK_STACK      3072
+#define JOURNAL_DUMP_CHUNK      1024    // Serial bytes per hop while dumping
+
+enum JournalRecordType {
+    JOURNAL_BOOT      = 1,
+    JOURNAL_DETECTION = 2
+};
+
+struct __attribute__((packed)) JournalSectorHeader {
+    uint32_t magic;
+    uint32_t sequence;          // Increments per sector opened; newest wins
+};
+
+struct __attribute__((packed)) JournalRecordHeader {
+    uint16_t length;            // Payload bytes
+    uint8_t type;               // JournalRecordType
+    uint8_t reserved;
+};
+
+struct __attribute__((packed)) JournalBoot {
+    char firmware[16];
+    uint32_t modelCrc;
+};
+
+struct __attribute__((packed)) JournalDetection {
+    uint32_t startMs;           // Uptime at the first detection
+    uint32_t durationMs;        // First to last detection
+    uint16_t detections;
+    uint8_t batteryPercent;
+    uint8_t alerted;
+    float peakConfidence;
+    float bearingStart;
+    float bearingEnd;
+    float bearingMean;          // Circular mean
+    float bearingSpread;        // Circular standard deviation (degrees)
+    float fundamentalHz;        // Harmonic f0 at the peak
+    uint8_t snapshot[JOURNAL_SNAPSHOT_FRAMES][JOURNAL_SNAPSHOT_BINS];  // Mel at the peak, oldest first
+    uint32_t meshTimeMs;        // Mesh time at the first detection (time_sync.h); 0 = not synced
+};
+
+class EventJournal {
+public:
+    EventJournal();
+
+    /**
+     * Find the partition, recover the write position and queue a boot
+     * record. Reads one header per sector plus the newest sector.
+     */
+    bool begin(uint32_t modelCrc);
+
+    /**
+     * Queue an event for the writer. Never touches flash; false (and
+     * counted) if the queue is full.
+     */
+    bool append(const JournalDetection& event);
+
+    /**
+     * Release one flash operation and send the next chunk of a running
+     * dump. Call once per hop, after the burst.
+     */
+    void service();
+
+    /**
+     * Start streaming the whole partition; service() sends it a chunk
+     * at a time
+     */
+    void dump();
+    bool isDumping() { return _dumping; }
+
+    uint32_t getDropped() { return _dropped; }
+
+private:
+    struct Pending {
+        uint8_t type;
+        uint16_t length;
+        uint32_t queuedMs;
+        uint8_t payload[sizeof(JournalDetection)];
+    };
+
+    const esp_partition_t* _partition;
+    uint32_t _sectorCount;
+    uint32_t _sector;                       // Sector being appended to
+    uint32_t _sequence;
+    uint32_t _writeOffset;                  // Within _sector
+    bool _eraseAhead;                       // Next sector still holds data
+    bool _ready;
+
+    Pending _queue[JOURNAL_QUEUE_RECORDS];
+    volatile int _head;
+    volatile int _tail;
+    uint32_t _dropped;
+    portMUX_TYPE _mux;
+
+    volatile bool _writing;
+    TaskHandle_t _task;
+
+    bool _dumping;
+    uint32_t _dumpOffset;
+    uint8_t _stage[JOURNAL_SECTOR_SIZE];    // One batch, never more than a sector
+
+    bool enqueue(uint8_t type, const void* payload, uint16_t length);
+    void recover();
+    void flush();
+    bool program(int length);
+    bool openNextSector();
+    bool eraseSector(uint32_t sector);
+    void waitForPermit();
+    void serviceDump();
+    static int recordSize(int length) { return (sizeof(JournalRecordHeader) + length + 4 + 3) & ~3; }
+    static void writerTask(void* arg);
+};
+
+// Implementation
+
+EventJournal::EventJournal() :
+    _partition(nullptr),
+    _sectorCount(0),
+    _sector(0),
+    _sequence(0),
+    _writeOffset(0),
+    _eraseAhead(false),
+    _ready(false),
+    _head(0),
+    _tail(0),
+    _dropped(0),
+    _mux(portMUX_INITIALIZER_UNLOCKED),
+    _writing(false),
+    _task(nullptr),
+    _dumping(false),
+    _dumpOffset(0)
+{
+}
+
+bool EventJournal::begin(uint32_t modelCrc) {
+    _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                          JOURNAL_PARTITION);
+    if (_partition == nullptr) {
+        Serial.println("EventJournal: no journal partition");
+        return false;
+    }
+    _sectorCount = _partition->size / JOURNAL_SECTOR_SIZE;
+    if (_sectorCount < 2) {
+        Serial.println("EventJournal: partition too small");
+        return false;
+    }
+
+    recover();
+
+    JournalBoot boot;
+    memset(&boot, 0, sizeof(boot));
+    strncpy(boot.firmware, FIRMWARE_VERSION, sizeof(boot.firmware) - 1);
+    boot.modelCrc = modelCrc;
+    enqueue(JOURNAL_BOOT, &boot, sizeof(boot));
+
+    if (xTaskCreatePinnedToCore(writerTask, "journal", JOURNAL_TASK_STACK, this,
+                                JOURNAL_TASK_PRIORITY, &_task, JOURNAL_TASK_CORE) != pdPASS) {
+        Serial.println("EventJournal: task creation failed");
+        return false;
+    }
+
+    _ready = true;
+    Serial.printf("EventJournal: %lu sectors, writing sector %lu at %lu\n",
+                  (unsigned long)_sectorCount, (unsigned long)_sector,
+                  (unsigned long)_writeOffset);
+    return true;
+}
+
+void EventJournal::recover() {
+    // Newest sector by sequence (wrap-safe compare)
+    bool found = false;
+    for (uint32_t s = 0; s < _sectorCount; s++) {
+        JournalSectorHeader header;
+        esp_partition_read(_partition, s * JOURNAL_SECTOR_SIZE, &header, sizeof(header));
+        if (header.magic != JOURNAL_MAGIC) continue;
+        if (!found || (int32_t)(header.sequence - _sequence) > 0) {
+            found = true;
+            _sector = s;
+            _sequence = header.sequence;
+        }
+    }
+
+    if (!found) {
+        // Blank or foreign partition: start at sector 0 on the first write
+        _sector = _sectorCount - 1;
+        _sequence = 0;
+        _writeOffset = JOURNAL_SECTOR_SIZE;
+        _eraseAhead = true;
+        return;
+    }
+
+    // Walk the records to the first erased slot. A torn record (power
+    // lost mid-write) closes the sector; the next write opens a new one.
+    uint32_t base = _sector * JOURNAL_SECTOR_SIZE;
+    uint32_t offset = sizeof(JournalSectorHeader);
+    while (offset + sizeof(JournalRecordHeader) <= JOURNAL_SECTOR_SIZE) {
+        JournalRecordHeader rec;
+        esp_partition_read(_partition, base + offset, &rec, sizeof(rec));
+        if (rec.length == 0xFFFF) break;
+
+        int size = recordSize(rec.length);
+        if (offset + size > JOURNAL_SECTOR_SIZE) {
+            offset = JOURNAL_SECTOR_SIZE;
+            break;
+        }
+        int body = sizeof(rec) + rec.length;
+        uint32_t stored;
+        esp_partition_read(_partition, base + offset, _stage, body);
+        esp_partition_read(_partition, base + offset + body, &stored, sizeof(stored));
+        if (crc32(_stage, body) != stored) {
+            offset = JOURNAL_SECTOR_SIZE;
+            break;
+        }
+        offset += size;
+    }
+    _writeOffset = offset;
+
+    // The next sector should already be erased; not if power was lost
+    // between opening this one and erasing ahead
+    uint32_t next[2];
+    esp_partition_read(_partition, ((_sector + 1) % _sectorCount) * JOURNAL_SECTOR_SIZE,
+                       next, sizeof(next));
+    _eraseAhead = (next[0] != 0xFFFFFFFF || next[1] != 0xFFFFFFFF);
+}
+
+bool EventJournal::append(const JournalDetection& event) {
+    if (!_ready) return false;
+    return enqueue(JOURNAL_DETECTION, &event, sizeof(event));
+}
+
+bool EventJournal::enqueue(uint8_t type, const void* payload, uint16_t length) {
+    uint32_t now = millis();
+    bool queued = false;
+
+    portENTER_CRITICAL(&_mux);
+    int next = (_head + 1) % JOURNAL_QUEUE_RECORDS;
+    if (next == _tail) {
+        _dropped++;
+    } else {
+        Pending& p = _queue[_head];
+        p.type = type;
+        p.length = length;
+        p.queuedMs = now;
+        memcpy(p.payload, payload, length);
+        _head = next;
+        queued = true;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    return queued;
+}
+
+void EventJournal::service() {
+    if (_writing) {
+        xTaskNotifyGive(_task);
+    }
+    if (_dumping) {
+        serviceDump();
+    }
+}
+
+void EventJournal::waitForPermit() {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(JOURNAL_PERMIT_MS));
+}
+
+bool EventJournal::eraseSector(uint32_t sector) {
+    waitForPermit();
+    if (esp_partition_erase_range(_partition, sector * JOURNAL_SECTOR_SIZE,
+                                  JOURNAL_SECTOR_SIZE) != ESP_OK) {
+        LOG_ERROR("EventJournal: erase failed (sector %lu)", (unsigned long)sector);
+        return false;
+    }
+    return true;
+}
+
+bool EventJournal::program(int length) {
+    if (length == 0) return true;
+
+    waitForPermit();
+    if (esp_partition_write(_partition, _sector * JOURNAL_SECTOR_SIZE + _writeOffset,
+                            _stage, length) != ESP_OK) {
+        LOG_ERROR("EventJournal: write failed (sector %lu)", (unsigned long)_sector);
+        return false;
+    }
+    _writeOffset += length;
+    return true;
+}
+
+bool EventJournal::openNextSector() {
+    // Already erased; stamp it, then erase the one after (the oldest)
+    _sector = (_sector + 1) % _sectorCount;
+    JournalSectorHeader header = { JOURNAL_MAGIC, ++_sequence };
+
+    waitForPermit();
+    if (esp_partition_write(_partition, _sector * JOURNAL_SECTOR_SIZE,
+                            &header, sizeof(header)) != ESP_OK) {
+        LOG_ERROR("EventJournal: write failed (sector %lu)", (unsigned long)_sector);
+        _writeOffset = JOURNAL_SECTOR_SIZE;
+        return false;
+    }
+    _writeOffset = sizeof(header);
+
+    _eraseAhead = !eraseSector((_sector + 1) % _sectorCount);
+    return !_eraseAhead;
+}
+
+void EventJournal::flush() {
+    _writing = true;
+
+    if (_eraseAhead) {
+        _eraseAhead = !eraseSector((_sector + 1) % _sectorCount);
+    }
+
+    // Pack queued records into one write per sector touched
+    int staged = 0;
+    int written = 0;
+    while (!_eraseAhead && _tail != _head) {
+        const Pending& p = _queue[_tail];
+        int size = recordSize(p.length);
+
+        if (_writeOffset + staged + size > JOURNAL_SECTOR_SIZE) {
+            if (!program(staged) || !openNextSector()) break;
+            staged = 0;
+            continue;
+        }
+
+        uint8_t* rec = _stage + staged;
+        JournalRecordHeader header = { p.length, p.type, 0 };
+        int body = sizeof(header) + p.length;
+        memcpy(rec, &header, sizeof(header));
+        memcpy(rec + sizeof(header), p.payload, p.length);
+        uint32_t crc = crc32(rec, body);
+        memcpy(rec + body, &crc, sizeof(crc));
+        memset(rec + body + sizeof(crc), 0xFF, size - body - sizeof(crc));
+        staged += size;
+        written++;
+
+        portENTER_CRITICAL(&_mux);
+        _tail = (_tail + 1) % JOURNAL_QUEUE_RECORDS;
+        portEXIT_CRITICAL(&_mux);
+    }
+    program(staged);
+
+    _writing = false;
+    LOG_DEBUG("EventJournal: %d records, sector %lu at %lu", written,
+              (unsigned long)_sector, (unsigned long)_writeOffset);
+}
+
+void EventJournal::writerTask(void* arg) {
+    EventJournal* self = (EventJournal*)arg;
+
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(JOURNAL_POLL_MS));
+
+        // Batch: wait for a few records, or until the oldest has waited long enough
+        int queued = (self->_head - self->_tail + JOURNAL_QUEUE_RECORDS) % JOURNAL_QUEUE_RECORDS;
+        if (queued == 0) continue;
+        if (queued < JOURNAL_BATCH_RECORDS &&
+            millis() - self->_queue[self->_tail].queuedMs < JOURNAL_FLUSH_MS) {
+            continue;
+        }
+        self->flush();
+    }
+}
+
+void EventJournal::dump() {
+    if (!_ready) {
+        Serial.println("JOURNAL none");
+        return;
+    }
+    if (_dumping) {
+        Serial.println("JOURNAL busy");
+        return;
+    }
+
+    _dumping = true;
+    _dumpOffset = 0;
+    Serial.printf("JOURNAL %lu\n", (unsigned long)(_sectorCount * JOURNAL_SECTOR_SIZE));
+}
+
+void EventJournal::serviceDump() {
+    // Only what the TX buffer takes now, so the loop never blocks on the
+    // host. A record the writer lands mid-dump may come out torn; the
+    // reader drops it on its CRC.
+    int room = Serial.availableForWrite() - 32;     // Less the chunk line
+    uint32_t length = min((uint32_t)max(room, 0), (uint32_t)JOURNAL_DUMP_CHUNK);
+    uint32_t remaining = _sectorCount * JOURNAL_SECTOR_SIZE - _dumpOffset;
+    length = min(length, remaining);
+
+    if (length > 0) {
+        static uint8_t buffer[JOURNAL_DUMP_CHUNK];      // Loop task only
+        if (esp_partition_read(_partition, _dumpOffset, buffer, length) != ESP_OK) {
+            LOG_ERROR("EventJournal: dump read failed at %lu", (unsigned long)_dumpOffset);
+            remaining = 0;
+        } else {
+            Serial.printf("JOURNAL-DATA %lu %lu\n", (unsigned long)_dumpOffset, (unsigned long)length);
+            Serial.write(buffer, length);
+            _dumpOffset += length;
+            remaining -= length;
+        }
+    }
+
+    if (remaining == 0) {
+        _dumping = false;
+    }
+}
+
+#endif // EVENT_JOURNAL_H
@@ -0,0 +1,241 @@
+/**
+ * VARTA - Fast Math
+ * Bounded-error replacements for the libm calls on the per-bin paths:
+ * log2 from the float's exponent plus a polynomial over the mantissa
+ * (mel and wake-detector dB), square root from the reciprocal-root bit
+ * trick with two Newton steps (FFT magnitudes), and a polynomial
+ * atan2 (azimuth). Each bound is stated next to its function and checked
+ * by selfTest(), which also times a hop's worth of calls against libm.
+ *
+ * FAST_MATH_ENABLED false routes everything back to libm, for A/B runs.
+ */
+
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+
+#define FAST_MATH_LOG2_MAX_ERROR    2e-4f   // Absolute, in octaves (~0.001 dB)
+#define FAST_MATH_SQRT_MAX_ERROR    1e-5f   // Relative
+#define FAST_MATH_ATAN2_MAX_ERROR   2e-5f   // Absolute, radians (~0.001 degrees)
+
+#define FAST_MATH_DB10_PER_OCTAVE   3.0103000f  // 10 log10(2)
+#define FAST_MATH_DB20_PER_OCTAVE   6.0205999f  // 20 log10(2)
+
+namespace FastMath {
+
+namespace Approx {
+
+inline uint32_t bits(float x) {
+    uint32_t i;
+    memcpy(&i, &x, sizeof(i));
+    return i;
+}
+
+inline float fromBits(uint32_t i) {
+    float x;
+    memcpy(&x, &i, sizeof(x));
+    return x;
+}
+
+/**
+ * Positive normal x only: exponent field plus a degree-4 fit of
+ * log2(1 + t) on the mantissa, exact at powers of two
+ */
+inline float log2(float x) {
+    uint32_t i = bits(x);
+    float exponent = (float)((int32_t)((i >> 23) & 0xFF) - 127);
+    float t = fromBits((i & 0x007FFFFF) | 0x3F800000) - 1.0f;
+    float poly = t * (1.4390150f + t * (-0.67994671f + t * (0.32560124f + t * -0.084772033f)));
+    return exponent + poly;
+}
+
+/**
+ * x zero or positive normal (a denormal comes back several times too
+ * small); the initial guess is within 3.5 % and each Newton step
+ * squares the error
+ */
+inline float rsqrt(float x) {
+    float y = fromBits(0x5F375A86 - (bits(x) >> 1));
+    float half = 0.5f * x;
+    y = y * (1.5f - half * y * y);
+    y = y * (1.5f - half * y * y);
+    return y;
+}
+
+inline float sqrt(float x) {
+    return x * rsqrt(x);    // 0 * finite guess = 0
+}
+
+/**
+ * Octant reduction to [0, 1], then a degree-9 odd polynomial
+ * (Abramowitz & Stegun 4.4.49, |error| <= 1e-5 rad)
+ */
+inline float atan2(float y, float x) {
+    float ax = fabsf(x);
+    float ay = fabsf(y);
+    float hi = ax > ay ? ax : ay;
+    float lo = ax > ay ? ay : ax;
+    if (hi == 0.0f) return 0.0f;
+
+    float z = lo / hi;
+    float z2 = z * z;
+    float a = z * (0.9998660f + z2 * (-0.3302995f + z2 * (0.1801410f +
+                   z2 * (-0.0851330f + z2 * 0.0208351f))));
+    if (ay > ax) a = 1.57079633f - a;
+    if (x < 0.0f) a = 3.14159265f - a;
+    return y < 0.0f ? -a : a;
+}
+
+} // namespace Approx
+
+inline float log2(float x) {
+#if FAST_MATH_ENABLED
+    return Approx::log2(x);
+#else
+    return log2f(x);
+#endif
+}
+
+/**
+ * 10 log10 of a power; 20 log10 of an amplitude. Positive normal input.
+ */
+inline float db10(float power) { return FAST_MATH_DB10_PER_OCTAVE * log2(power); }
+inline float db20(float amplitude) { return FAST_MATH_DB20_PER_OCTAVE * log2(amplitude); }
+
+inline float sqrt(float x) {
+#if FAST_MATH_ENABLED
+    return Approx::sqrt(x);
+#else
+    return sqrtf(x);
+#endif
+}
+
+inline float atan2(float y, float x) {
+#if FAST_MATH_ENABLED
+    return Approx::atan2(y, x);
+#else
+    return atan2f(y, x);
+#endif
+}
+
+/**
+ * Sweep each approximation against libm and assert its bound, then time
+ * a hop's worth of calls both ways (MEL_BINS logs, FFT_SIZE / 2 + 1 roots,
+ * one atan2). `scratch` needs 2 * (FFT_SIZE / 2 + 1) floats.
+ */
+bool selfTest(float* scratch);
+
+} // namespace FastMath
+
+// Implementation
+
+// Self-test clock, shared with dsp_kernels.h
+#ifdef ARDUINO
+#include <Arduino.h>
+#define DSP_SELFTEST_NOW()      ESP.getCycleCount()
+#define DSP_SELFTEST_TICKS_US   getCpuFrequencyMhz()
+#define DSP_SELFTEST_PRINTF     Serial.printf
+#else
+#include <chrono>
+#include <stdio.h>
+#define DSP_SELFTEST_NOW()      ((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>( \
+                                    std::chrono::steady_clock::now().time_since_epoch()).count())
+#define DSP_SELFTEST_TICKS_US   1000
+#define DSP_SELFTEST_PRINTF     printf
+#endif
+
+#define FAST_MATH_BENCH_RUNS    16
+
+namespace FastMath {
+
+bool selfTest(float* scratch) {
+    // Bounds over 1e-20 .. 1e20, a ratio step fine enough to hit every
+    // mantissa region many times
+    float logError = 0.0f;
+    float sqrtError = 0.0f;
+    for (float x = 1e-20f; x < 1e20f; x *= 1.00137f) {
+        float e = fabsf(Approx::log2(x) - log2f(x));
+        if (e > logError) logError = e;
+        float ref = sqrtf(x);
+        e = fabsf(Approx::sqrt(x) - ref) / ref;
+        if (e > sqrtError) sqrtError = e;
+    }
+
+    // Every direction, at the radii tdoaToAzimuth() sees and beyond
+    float atanError = 0.0f;
+    for (int step = 0; step < 3600; step++) {
+        float angle = (step - 1800) * (3.14159265f / 1800.0f);
+        for (float r = 1e-3f; r < 1e3f; r *= 10.0f) {
+            float y = r * sinf(angle);
+            float x = r * cosf(angle);
+            float e = fabsf(Approx::atan2(y, x) - atan2f(y, x));
+            if (e > 3.14159265f) e = fabsf(e - 6.28318531f);    // +-pi are the same direction
+            if (e > atanError) atanError = e;
+        }
+    }
+
+    // One hop: a mel frame of logs, a spectrum of roots, one bearing
+    const int bins = FFT_SIZE / 2 + 1;
+    float* in = scratch;
+    float* out = scratch + bins;
+    for (int i = 0; i < bins; i++) {
+        in[i] = 1e-6f + (float)((i * 7919) % 1000) * 0.37f;
+    }
+
+    enum { LOG, SQRT, ATAN2, FUNCTIONS };
+    static const char* names[FUNCTIONS] = { "log2", "sqrt", "atan2" };
+    uint32_t best[FUNCTIONS][2];
+    for (int f = 0; f < FUNCTIONS; f++) {
+        best[f][0] = best[f][1] = UINT32_MAX;
+    }
+    auto keep = [&](int function, int path, uint32_t start) {
+        uint32_t t = DSP_SELFTEST_NOW() - start;
+        if (t < best[function][path]) best[function][path] = t;
+    };
+    for (int run = 0; run < FAST_MATH_BENCH_RUNS; run++) {
+        uint32_t t = DSP_SELFTEST_NOW();
+        for (int m = 0; m < MEL_BINS; m++) out[m] = Approx::log2(in[m]);
+        keep(LOG, 0, t);
+        t = DSP_SELFTEST_NOW();
+        for (int m = 0; m < MEL_BINS; m++) out[m] = log2f(in[m]);
+        keep(LOG, 1, t);
+
+        t = DSP_SELFTEST_NOW();
+        for (int k = 0; k < bins; k++) out[k] = Approx::sqrt(in[k]);
+        keep(SQRT, 0, t);
+        t = DSP_SELFTEST_NOW();
+        for (int k = 0; k < bins; k++) out[k] = sqrtf(in[k]);
+        keep(SQRT, 1, t);
+
+        t = DSP_SELFTEST_NOW();
+        out[0] = Approx::atan2(in[1], -in[2]);
+        keep(ATAN2, 0, t);
+        t = DSP_SELFTEST_NOW();
+        out[0] = atan2f(in[1], -in[2]);
+        keep(ATAN2, 1, t);
+    }
+
+    const float bound[FUNCTIONS] = { FAST_MATH_LOG2_MAX_ERROR, FAST_MATH_SQRT_MAX_ERROR,
+                                     FAST_MATH_ATAN2_MAX_ERROR };
+    const float error[FUNCTIONS] = { logError, sqrtError, atanError };
+    bool ok = true;
+    DSP_SELFTEST_PRINTF("%-10s %8s %8s  max err / bound (us per hop, best of %d)\n",
+                        "function", "fast", "libm", FAST_MATH_BENCH_RUNS);
+    for (int f = 0; f < FUNCTIONS; f++) {
+        bool pass = error[f] <= bound[f];
+        ok = ok && pass;
+        DSP_SELFTEST_PRINTF("%-10s %8lu %8lu  %.1e / %.0e%s\n", names[f],
+                            (unsigned long)(best[f][0] / DSP_SELFTEST_TICKS_US),
+                            (unsigned long)(best[f][1] / DSP_SELFTEST_TICKS_US),
+                            (double)error[f], (double)bound[f], pass ? "" : "  OUT OF BOUND");
+    }
+    return ok;
+}
+
+} // namespace FastMath
+
+#endif // FAST_MATH_H
@@ -0,0 +1,382 @@
+/**
+ * VARTA - Fixed-Point Mel Frontend
+ * Integer version of the mel pipeline for DSP_FIXED_POINT builds:
+ * Q15 samples and window, a radix-2 Q15 FFT with block floating point,
+ * integer magnitude, Q12 sparse mel projection into 64-bit sums and a
+ * table log2, ending in Q8.8 dB. Each block carries one exponent, set
+ * when the samples are loaded and raised whenever an FFT stage has to
+ * shift to stay in range, so quiet and loud blocks keep the same
+ * relative precision.
+ *
+ * Tables come from AudioProcessor's float window and filterbank so the
+ * two paths describe the same bands. Portable (no Arduino), so it can be
+ * checked against the float path on a host.
+ *
+ * Against a double-precision DFT of the same tables (test/test_fixed_mel.cpp,
+ * 0 to -80 dBFS): bands within 50 dB of the block's loudest band agree to
+ * 0.3 dB, within 60 dB to 0.93 dB, and broadband input stays within
+ * 2.1 dB / 7 quantizeDbQ8 codes there. About 78 dB under the loudest band
+ * is one LSB of the 16-bit FFT; bands further down read that floor or
+ * silence, whatever their true level.
+ */
+
+#ifndef FIXED_MEL_H
+#define FIXED_MEL_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+
+#define FIXED_MEL_FFT_BINS      (FFT_SIZE / 2 + 1)
+#define FIXED_MEL_MAX_WEIGHTS   (FFT_SIZE + 2 * MEL_BINS)   // Triangles overlap about twice
+#define FIXED_MEL_WEIGHT_BITS   12      // Q12 filter weights
+#define FIXED_MEL_MAG_BITS      4       // Magnitudes keep 4 fractional bits
+#define FIXED_MEL_LOG_TABLE     32      // log2 interpolation segments over [1, 2)
+#define FIXED_MEL_DB_MIN_Q8     (-32768)
+
+class FixedMelFrontend {
+public:
+    FixedMelFrontend();
+
+    /**
+     * Build the Q15 window, twiddles and sparse Q12 filterbank from the
+     * float tables (window[FFT_SIZE], filterbank[MEL_BINS][FFT bins]).
+     * False if the filterbank has more nonzero weights than fit.
+     */
+    bool begin(const float* window, const float* filterbank);
+
+    /**
+     * Load a block of left-aligned I2S words, `shift` bits above the
+     * sample (8 for the INMP441's 24 bits in 32). gainDbQ8 (dB * 256) is
+     * added to every band of this block, for the capture trim the float
+     * path applies to the samples.
+     */
+    void loadInt32(const int32_t* raw, int count, int shift, int32_t gainDbQ8 = 0);
+
+    /**
+     * Load a block of float samples in [-1, 1] (replayed audio)
+     */
+    void loadFloat(const float* samples, int count);
+
+    /**
+     * Window and FFT the loaded block, then take the bin magnitudes
+     */
+    void transform();
+
+    /**
+     * Mel bands of the last transform(): MEL_BINS values in dB * 256,
+     * with the gain and noise floor applied the way the float path
+     * applies them
+     */
+    void project(int16_t* melDbQ8);
+
+    void compute(int16_t* melDbQ8) { transform(); project(melDbQ8); }
+
+    /**
+     * Zero the bins set in `mask` (bit k = bin k) before project()
+     */
+    void maskBins(uint32_t mask);
+
+    void setNoiseFloor(const float* noiseFloorDb);
+
+    /**
+     * Magnitude of FFT bin `bin` from the last compute(), in the block's
+     * own scale (comparable across bins, not across blocks)
+     */
+    uint32_t magnitude(int bin) { return _magnitude[bin]; }
+
+    static uint8_t quantizeDbQ8(int16_t dbQ8);
+
+private:
+    int16_t _input[FFT_SIZE];
+    int _inputExponent;                     // Real value = _input * 2^exponent
+    int _spectrumExponent;                  // ... and _magnitude * 2^exponent after transform()
+    int16_t _window[FFT_SIZE];              // Q15
+    int16_t _cos[FFT_SIZE / 2];             // Q15 twiddles, W^k = cos - j sin
+    int16_t _sin[FFT_SIZE / 2];
+    int16_t _re[FFT_SIZE];
+    int16_t _im[FFT_SIZE];
+    uint32_t _magnitude[FIXED_MEL_FFT_BINS];    // Q4
+    uint16_t _weights[FIXED_MEL_MAX_WEIGHTS];   // Q12, band after band
+    uint16_t _bandStart[MEL_BINS];
+    uint16_t _bandLength[MEL_BINS];
+    uint16_t _bandOffset[MEL_BINS];
+    int16_t _noiseFloorQ8[MEL_BINS];        // 0 = none
+    int32_t _log2Table[FIXED_MEL_LOG_TABLE + 1];    // log2(1 + i / size), Q16
+    int32_t _gainDbQ8;
+    int _log2Size;
+
+    int fft();
+    static int stageShift(const int16_t* re, const int16_t* im, int n);
+    static int32_t roundShift(int32_t x, int shift);
+    static uint32_t isqrt(uint32_t x);
+    int32_t log2Q16(uint64_t x);
+};
+
+// Implementation
+
+FixedMelFrontend::FixedMelFrontend() :
+    _inputExponent(0),
+    _spectrumExponent(0),
+    _gainDbQ8(0),
+    _log2Size(0)
+{
+    memset(_input, 0, sizeof(_input));
+    memset(_noiseFloorQ8, 0, sizeof(_noiseFloorQ8));
+}
+
+bool FixedMelFrontend::begin(const float* window, const float* filterbank) {
+    while ((1 << _log2Size) < FFT_SIZE) _log2Size++;
+
+    for (int i = 0; i < FFT_SIZE; i++) {
+        _window[i] = (int16_t)lrintf(window[i] * 32767.0f);
+    }
+    for (int k = 0; k < FFT_SIZE / 2; k++) {
+        double angle = 2.0 * M_PI * k / FFT_SIZE;
+        _cos[k] = (int16_t)lrint(cos(angle) * 32767.0);
+        _sin[k] = (int16_t)lrint(sin(angle) * 32767.0);
+    }
+    for (int i = 0; i <= FIXED_MEL_LOG_TABLE; i++) {
+        _log2Table[i] = (int32_t)lrint(log2(1.0 + (double)i / FIXED_MEL_LOG_TABLE) * 65536.0);
+    }
+
+    // Keep each band's nonzero span only
+    int used = 0;
+    for (int m = 0; m < MEL_BINS; m++) {
+        const float* row = &filterbank[m * FIXED_MEL_FFT_BINS];
+        int first = 0;
+        int last = -1;
+        for (int k = 0; k < FIXED_MEL_FFT_BINS; k++) {
+            if (row[k] != 0.0f) {
+                if (last < 0) first = k;
+                last = k;
+            }
+        }
+
+        int length = last - first + 1;
+        if (used + length > FIXED_MEL_MAX_WEIGHTS) {
+            return false;
+        }
+        _bandStart[m] = first;
+        _bandLength[m] = length;
+        _bandOffset[m] = used;
+        for (int k = 0; k < length; k++) {
+            _weights[used++] = (uint16_t)lrintf(row[first + k] * (1 << FIXED_MEL_WEIGHT_BITS));
+        }
+    }
+    return true;
+}
+
+void FixedMelFrontend::setNoiseFloor(const float* noiseFloorDb) {
+    for (int m = 0; m < MEL_BINS; m++) {
+        _noiseFloorQ8[m] = (int16_t)lrintf(noiseFloorDb[m] * 256.0f);
+    }
+}
+
+void FixedMelFrontend::loadInt32(const int32_t* raw, int count, int shift, int32_t gainDbQ8) {
+    if (count > FFT_SIZE) count = FFT_SIZE;
+
+    // Peak sets the block exponent: the loudest sample lands in [2^14, 2^15)
+    uint32_t peak = 0;
+    for (int i = 0; i < count; i++) {
+        int32_t s = raw[i] >> shift;
+        uint32_t mag = s < 0 ? (uint32_t)(-s) : (uint32_t)s;
+        if (mag > peak) peak = mag;
+    }
+    int bits = peak ? 32 - __builtin_clz(peak) : 15;
+    int down = shift + bits - 15;
+
+    // Quiet blocks shift up so the window and FFT rounding stay 15 bits
+    // under the block's peak
+    for (int i = 0; i < count; i++) {
+        int32_t s = down >= 0 ? raw[i] >> down : (raw[i] >> shift) * (1 << (15 - bits));
+        _input[i] = (int16_t)(s > 32767 ? 32767 : s);
+    }
+    memset(&_input[count], 0, (FFT_SIZE - count) * sizeof(int16_t));
+
+    // Full scale is 2^31 in the raw word
+    _inputExponent = down - 31;
+    _gainDbQ8 = gainDbQ8;
+}
+
+void FixedMelFrontend::loadFloat(const float* samples, int count) {
+    if (count > FFT_SIZE) count = FFT_SIZE;
+
+    float peak = 0.0f;
+    for (int i = 0; i < count; i++) {
+        float mag = fabsf(samples[i]);
+        if (mag > peak) peak = mag;
+    }
+    int exponent = 0;
+    frexpf(peak > 0.0f ? peak : 1.0f, &exponent);    // peak < 2^exponent
+
+    float scale = ldexpf(1.0f, 15 - exponent);
+    for (int i = 0; i < count; i++) {
+        int32_t s = (int32_t)lrintf(samples[i] * scale);
+        _input[i] = (int16_t)(s > 32767 ? 32767 : (s < -32768 ? -32768 : s));
+    }
+    memset(&_input[count], 0, (FFT_SIZE - count) * sizeof(int16_t));
+
+    _inputExponent = exponent - 15;
+    _gainDbQ8 = 0;
+}
+
+int FixedMelFrontend::stageShift(const int16_t* re, const int16_t* im, int n) {
+    // A radix-2 butterfly can grow a component by 1 + sqrt(2); pick the
+    // shift that keeps the stage's output inside 16 bits
+    int peak = 0;
+    for (int i = 0; i < n; i++) {
+        int r = re[i] < 0 ? -re[i] : re[i];
+        int q = im[i] < 0 ? -im[i] : im[i];
+        if (r > peak) peak = r;
+        if (q > peak) peak = q;
+    }
+    if (peak < 8192) return 0;
+    if (peak < 16384) return 1;
+    return 2;
+}
+
+int32_t FixedMelFrontend::roundShift(int32_t x, int shift) {
+    // Round half to even. Half-up leaves +1/4 LSB (shift 1) or +1/8 LSB
+    // (shift 2) on every value of a scaled stage; the later stages sum
+    // that offset into bin 0, where it read as a DC band 20+ dB too loud
+    if (shift == 0) return x;
+    return (x + (1 << (shift - 1)) - 1 + ((x >> shift) & 1)) >> shift;
+}
+
+int FixedMelFrontend::fft() {
+    const int n = FFT_SIZE;
+
+    // Bit-reversed load
+    for (int i = 0; i < n; i++) {
+        int j = 0;
+        for (int b = 0; b < _log2Size; b++) {
+            j |= ((i >> b) & 1) << (_log2Size - 1 - b);
+        }
+        _re[j] = _input[i];
+    }
+    memset(_im, 0, sizeof(_im));
+
+    int scaled = 0;
+    for (int half = 1; half < n; half <<= 1) {
+        int shift = stageShift(_re, _im, n);
+        int step = n / (2 * half);
+        scaled += shift;
+
+        for (int base = 0; base < n; base += 2 * half) {
+            for (int k = 0; k < half; k++) {
+                int a = base + k;
+                int b = a + half;
+                int32_t wr = _cos[k * step];
+                int32_t wi = _sin[k * step];
+
+                // t = W * x[b], W = wr - j wi
+                int32_t tr = (wr * _re[b] + wi * _im[b] + (1 << 14)) >> 15;
+                int32_t ti = (wr * _im[b] - wi * _re[b] + (1 << 14)) >> 15;
+
+                int32_t ar = _re[a];
+                int32_t ai = _im[a];
+                _re[a] = (int16_t)roundShift(ar + tr, shift);
+                _im[a] = (int16_t)roundShift(ai + ti, shift);
+                _re[b] = (int16_t)roundShift(ar - tr, shift);
+                _im[b] = (int16_t)roundShift(ai - ti, shift);
+            }
+        }
+    }
+    return scaled;
+}
+
+uint32_t FixedMelFrontend::isqrt(uint32_t x) {
+    uint32_t result = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= result + bit) {
+            x -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return result;
+}
+
+int32_t FixedMelFrontend::log2Q16(uint64_t x) {
+    int whole = 63 - __builtin_clzll(x);
+
+    // 16 bits of mantissa below the leading one: 5 index, 11 interpolation
+    uint32_t mantissa = whole >= 16 ? (uint32_t)(x >> (whole - 16)) : (uint32_t)(x << (16 - whole));
+    mantissa &= 0xFFFF;
+    int index = mantissa >> 11;
+    int32_t frac = mantissa & 0x7FF;
+    int32_t step = _log2Table[index + 1] - _log2Table[index];
+    int32_t interp = _log2Table[index] + ((step * frac) >> 11);
+
+    return (whole << 16) + interp;
+}
+
+void FixedMelFrontend::transform() {
+    // Window in place; the FFT reads _input in bit-reversed order
+    for (int i = 0; i < FFT_SIZE; i++) {
+        _input[i] = (int16_t)(((int32_t)_input[i] * _window[i] + (1 << 14)) >> 15);
+    }
+    _spectrumExponent = _inputExponent + fft();
+
+    // Magnitude with FIXED_MEL_MAG_BITS fractional bits: integer root,
+    // then one Newton step for the fraction
+    for (int k = 0; k < FIXED_MEL_FFT_BINS; k++) {
+        uint32_t power = (uint32_t)((int32_t)_re[k] * _re[k]) + (uint32_t)((int32_t)_im[k] * _im[k]);
+        uint32_t root = isqrt(power);
+        uint32_t rest = power - root * root;
+        _magnitude[k] = (root << FIXED_MEL_MAG_BITS) +
+                        ((rest << FIXED_MEL_MAG_BITS) + root) / (2 * root + 1);
+    }
+}
+
+void FixedMelFrontend::maskBins(uint32_t mask) {
+    for (int k = 0; mask != 0 && k < FIXED_MEL_FFT_BINS; k++, mask >>= 1) {
+        if (mask & 1) _magnitude[k] = 0;
+    }
+}
+
+void FixedMelFrontend::project(int16_t* melDbQ8) {
+    // 20 log10(sum * 2^(exponent - weight bits - magnitude bits)):
+    // log2 in Q16 times dB per octave in Q24 is Q40, >> 32 leaves Q8
+    const int64_t dbPerOctaveQ24 = 101008905;     // 20 log10(2) * 2^24
+    const int32_t offsetQ16 = (_spectrumExponent - FIXED_MEL_WEIGHT_BITS - FIXED_MEL_MAG_BITS) * 65536;
+
+    for (int m = 0; m < MEL_BINS; m++) {
+        const uint16_t* w = &_weights[_bandOffset[m]];
+        const uint32_t* mag = &_magnitude[_bandStart[m]];
+        uint64_t sum = 0;
+        for (int k = 0; k < _bandLength[m]; k++) {
+            sum += (uint64_t)((uint32_t)w[k] * mag[k]);
+        }
+
+        int32_t db;
+        if (sum == 0) {
+            db = FIXED_MEL_DB_MIN_Q8;
+        } else {
+            int64_t log2 = (int64_t)log2Q16(sum) + offsetQ16;
+            db = (int32_t)((log2 * dbPerOctaveQ24) >> 32) + _gainDbQ8;
+        }
+
+        if (_noiseFloorQ8[m] != 0) {
+            db -= _noiseFloorQ8[m];
+            if (db < 0) db = 0;
+        }
+        melDbQ8[m] = (int16_t)(db < -32768 ? -32768 : (db > 32767 ? 32767 : db));
+    }
+}
+
+uint8_t FixedMelFrontend::quantizeDbQ8(int16_t dbQ8) {
+    // Same mapping as AudioProcessor::quantizeDb, in integers
+    int32_t floorQ8 = (int32_t)(MEL_DB_FLOOR * 256.0f);
+    int32_t rangeQ8 = (int32_t)(MEL_DB_RANGE * 256.0f);
+    int32_t q = ((int32_t)dbQ8 - floorQ8) * 255 / rangeQ8;
+    return (uint8_t)(q < 0 ? 0 : (q > 255 ? 255 : q));
+}
+
+#endif // FIXED_MEL_H
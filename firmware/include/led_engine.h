@@ -0,0 +1,265 @@
+/**
+ * VARTA - LED Engine
+ * Renders the WS2812B direction ring from a fixed-rate task.
+ * Animations are time-based, unchanged frames are not resent, and
+ * frames are streamed by the RMT peripheral without waiting for completion.
+ */
+
+#ifndef LED_ENGINE_H
+#define LED_ENGINE_H
+
+#include <Arduino.h>
+#include <driver/rmt.h>
+#include "config.h"
+#include "profiler.h"
+
+#define LED_FRAME_MS            20      // Frame period (50 Hz)
+#define LED_MAX_TARGETS         4       // Simultaneous bearings rendered in ALERT
+#define LED_RMT_CHANNEL         RMT_CHANNEL_0
+#define LED_TASK_CORE           0       // Off the DSP core
+#define LED_TASK_PRIORITY       1
+#define LED_TASK_STACK          2048
+
+// Animation timing
+#define LED_BREATHE_PERIOD_MS   1300    // SCAN breathing cycle
+#define LED_BREATHE_MAX         30      // Peak blue level while breathing
+#define LED_SELF_TEST_STEP_MS   100     // Chase step per LED at startup
+
+// WS2812B bit timing in RMT ticks (40 MHz, 25 ns per tick)
+#define WS2812_T0H              16      // 0.40 us
+#define WS2812_T0L              34      // 0.85 us
+#define WS2812_T1H              32      // 0.80 us
+#define WS2812_T1L              18      // 0.45 us
+
+enum LedMode {
+    LED_MODE_OFF,
+    LED_MODE_SELF_TEST,     // Green chase once around the ring, then SCAN
+    LED_MODE_SCAN,          // Subtle blue breathing
+    LED_MODE_ALERT,         // Red at each target bearing
+    LED_MODE_LOW_BATTERY    // Solid red
+};
+
+class LedEngine {
+public:
+    LedEngine();
+
+    bool begin(int pin, uint8_t brightness);
+
+    void setMode(LedMode mode);
+
+    /**
+     * Bearings (degrees, 0 = LED 0) and confidences (0-1) shown in ALERT.
+     * Each target is split between the two nearest LEDs.
+     */
+    void setTargets(const float* bearings, const float* confidences, int count);
+
+    LedMode getMode() { return _mode; }
+
+private:
+    int _pin;
+    uint8_t _brightness;
+    TaskHandle_t _task;
+    portMUX_TYPE _mux;
+
+    // Model written by the caller, read by the task under _mux
+    LedMode _mode;
+    unsigned long _modeStartTime;
+    int _targetCount;
+    float _bearings[LED_MAX_TARGETS];
+    float _confidences[LED_MAX_TARGETS];
+
+    // Last frame handed to the RMT peripheral (GRB order)
+    uint8_t _frame[LED_COUNT * 3];
+    bool _frameValid;
+    rmt_item32_t _items[LED_COUNT * 24];
+
+    void renderFrame(unsigned long now, uint8_t* rgb);
+    bool transmit(const uint8_t* rgb);
+    static void frameTask(void* arg);
+};
+
+// Implementation
+
+LedEngine::LedEngine() :
+    _pin(-1),
+    _brightness(255),
+    _task(nullptr),
+    _mux(portMUX_INITIALIZER_UNLOCKED),
+    _mode(LED_MODE_OFF),
+    _modeStartTime(0),
+    _targetCount(0),
+    _frameValid(false)
+{
+    memset(_frame, 0, sizeof(_frame));
+}
+
+bool LedEngine::begin(int pin, uint8_t brightness) {
+    _pin = pin;
+    _brightness = brightness;
+
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)_pin, LED_RMT_CHANNEL);
+    config.clk_div = 2;  // 80 MHz APB -> 40 MHz
+    config.mem_block_num = 1;
+
+    if (rmt_config(&config) != ESP_OK ||
+        rmt_driver_install(LED_RMT_CHANNEL, 0, 0) != ESP_OK) {
+        Serial.println("LedEngine: RMT init failed");
+        return false;
+    }
+
+    if (xTaskCreatePinnedToCore(frameTask, "leds", LED_TASK_STACK, this,
+                                LED_TASK_PRIORITY, &_task, LED_TASK_CORE) != pdPASS) {
+        Serial.println("LedEngine: task creation failed");
+        return false;
+    }
+
+    Serial.println("LedEngine initialized");
+    return true;
+}
+
+void LedEngine::setMode(LedMode mode) {
+    portENTER_CRITICAL(&_mux);
+    if (mode != _mode) {
+        _mode = mode;
+        _modeStartTime = millis();
+    }
+    portEXIT_CRITICAL(&_mux);
+}
+
+void LedEngine::setTargets(const float* bearings, const float* confidences, int count) {
+    count = constrain(count, 0, LED_MAX_TARGETS);
+
+    portENTER_CRITICAL(&_mux);
+    for (int i = 0; i < count; i++) {
+        _bearings[i] = bearings[i];
+        _confidences[i] = confidences[i];
+    }
+    _targetCount = count;
+    portEXIT_CRITICAL(&_mux);
+}
+
+void LedEngine::renderFrame(unsigned long now, uint8_t* rgb) {
+    // Snapshot the model so the caller is never held up by rendering
+    portENTER_CRITICAL(&_mux);
+    LedMode mode = _mode;
+    unsigned long elapsed = now - _modeStartTime;
+    int targetCount = _targetCount;
+    float bearings[LED_MAX_TARGETS];
+    float confidences[LED_MAX_TARGETS];
+    for (int i = 0; i < targetCount; i++) {
+        bearings[i] = _bearings[i];
+        confidences[i] = _confidences[i];
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    float red[LED_COUNT] = {0};
+    float green[LED_COUNT] = {0};
+    float blue[LED_COUNT] = {0};
+
+    switch (mode) {
+        case LED_MODE_SELF_TEST: {
+            int step = elapsed / LED_SELF_TEST_STEP_MS;
+            if (step < LED_COUNT) {
+                green[step] = 50;
+            } else {
+                setMode(LED_MODE_SCAN);
+            }
+            break;
+        }
+
+        case LED_MODE_SCAN: {
+            // Triangle wave, independent of how often anything else runs
+            unsigned long phase = now % LED_BREATHE_PERIOD_MS;
+            unsigned long half = LED_BREATHE_PERIOD_MS / 2;
+            float level = (phase < half) ? (float)phase / half
+                                         : (float)(LED_BREATHE_PERIOD_MS - phase) / half;
+            for (int i = 0; i < LED_COUNT; i++) {
+                blue[i] = level * LED_BREATHE_MAX;
+            }
+            break;
+        }
+
+        case LED_MODE_ALERT: {
+            const float degreesPerLed = 360.0f / LED_COUNT;
+            for (int t = 0; t < targetCount; t++) {
+                float pos = fmod(bearings[t], 360.0f);
+                if (pos < 0) pos += 360.0f;
+                pos /= degreesPerLed;
+
+                int i0 = (int)pos % LED_COUNT;
+                int i1 = (i0 + 1) % LED_COUNT;
+                float frac = pos - floor(pos);
+                float intensity = constrain(confidences[t], 0.0f, 1.0f) * 255.0f;
+
+                red[i0] += intensity * (1.0f - frac);
+                red[i1] += intensity * frac;
+            }
+            break;
+        }
+
+        case LED_MODE_LOW_BATTERY:
+            for (int i = 0; i < LED_COUNT; i++) {
+                red[i] = 50;
+            }
+            break;
+
+        case LED_MODE_OFF:
+        default:
+            break;
+    }
+
+    // GRB wire order with global brightness applied
+    for (int i = 0; i < LED_COUNT; i++) {
+        rgb[i * 3 + 0] = (uint8_t)(((int)min(green[i], 255.0f) * (_brightness + 1)) >> 8);
+        rgb[i * 3 + 1] = (uint8_t)(((int)min(red[i], 255.0f) * (_brightness + 1)) >> 8);
+        rgb[i * 3 + 2] = (uint8_t)(((int)min(blue[i], 255.0f) * (_brightness + 1)) >> 8);
+    }
+}
+
+bool LedEngine::transmit(const uint8_t* rgb) {
+    // Previous frame still streaming - retry on the next tick
+    if (rmt_wait_tx_done(LED_RMT_CHANNEL, 0) != ESP_OK) {
+        return false;
+    }
+
+    int item = 0;
+    for (int i = 0; i < LED_COUNT * 3; i++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            bool one = (rgb[i] >> bit) & 1;
+            _items[item].level0 = 1;
+            _items[item].duration0 = one ? WS2812_T1H : WS2812_T0H;
+            _items[item].level1 = 0;
+            _items[item].duration1 = one ? WS2812_T1L : WS2812_T0L;
+            item++;
+        }
+    }
+
+    // Returns immediately; the RMT ISR refills channel memory from _items
+    rmt_write_items(LED_RMT_CHANNEL, _items, item, false);
+    return true;
+}
+
+void LedEngine::frameTask(void* arg) {
+    LedEngine* self = (LedEngine*)arg;
+    TickType_t lastWake = xTaskGetTickCount();
+    uint8_t rgb[LED_COUNT * 3];
+
+    for (;;) {
+        {
+            PROFILE_SCOPE(STAGE_LEDS);
+            self->renderFrame(millis(), rgb);
+
+            // Only touch the wire when the frame actually changed
+            if (!self->_frameValid || memcmp(rgb, self->_frame, sizeof(rgb)) != 0) {
+                if (self->transmit(rgb)) {
+                    memcpy(self->_frame, rgb, sizeof(rgb));
+                    self->_frameValid = true;
+                }
+            }
+        }
+
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(LED_FRAME_MS));
+    }
+}
+
+#endif // LED_ENGINE_H
@@ -0,0 +1,278 @@
+/**
+ * VARTA - Logger
+ * Deferred-format logging. LOG_* calls store the format string pointer
+ * (which doubles as the message ID) and raw 32-bit arguments in a fixed
+ * ring; formatting happens later in a background task, or in the loop
+ * when telemetry owns the serial port. Calls above LOG_LEVEL compile
+ * to nothing, arguments included.
+ *
+ * Format strings must be literals, and %s arguments must outlive the
+ * ring (literals or static buffers).
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define LOG_MAX_ARGS            6
+#define LOG_RING_SIZE           64      // Records, ~40 bytes each
+#define LOG_LINE_MAX            160
+#define LOG_FLUSH_MS            50
+#define LOG_TASK_CORE           0       // Off the DSP core
+#define LOG_TASK_PRIORITY       1
+#define LOG_TASK_STACK          3072
+
+enum LogArgType {
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_FLOAT,
+    LOG_ARG_STR
+};
+
+struct LogArg {
+    uint8_t type;
+    uintptr_t bits;             // 32 bits on the ESP32
+};
+
+inline LogArg toLogArg(int v)               { LogArg a = { LOG_ARG_INT, (uintptr_t)(uint32_t)v }; return a; }
+inline LogArg toLogArg(long v)              { LogArg a = { LOG_ARG_INT, (uintptr_t)(uint32_t)v }; return a; }
+inline LogArg toLogArg(unsigned int v)      { LogArg a = { LOG_ARG_UINT, (uintptr_t)(uint32_t)v }; return a; }
+inline LogArg toLogArg(unsigned long v)     { LogArg a = { LOG_ARG_UINT, (uintptr_t)(uint32_t)v }; return a; }
+inline LogArg toLogArg(bool v)              { return toLogArg((int)v); }
+inline LogArg toLogArg(char v)              { return toLogArg((int)v); }
+inline LogArg toLogArg(uint8_t v)           { return toLogArg((unsigned int)v); }
+inline LogArg toLogArg(const char* v)       { LogArg a = { LOG_ARG_STR, (uintptr_t)v }; return a; }
+inline LogArg toLogArg(float v) {
+    LogArg a = { LOG_ARG_FLOAT, 0 };
+    memcpy(&a.bits, &v, sizeof(v));
+    return a;
+}
+inline LogArg toLogArg(double v)            { return toLogArg((float)v); }
+
+class Logger {
+public:
+    static Logger& instance();
+
+    /**
+     * Start the formatting task. Without it, records wait for drain().
+     */
+    bool begin();
+
+    template<typename... Args>
+    void write(uint8_t level, const char* format, Args... args) {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+        LogArg packed[] = { LogArg(), toLogArg(args)... };
+        push(level, format, packed + 1, sizeof...(Args));
+    }
+
+    /**
+     * Format the oldest record into line. Returns its level, or -1 if
+     * the ring is empty.
+     */
+    int drain(char* line, int size);
+
+    uint32_t getDropped() { return _dropped; }
+
+private:
+    struct Record {
+        const char* format;
+        uint32_t timestampMs;
+        uint8_t level;
+        uint8_t argCount;
+        uint8_t types[LOG_MAX_ARGS];
+        uintptr_t args[LOG_MAX_ARGS];
+    };
+
+    Record _ring[LOG_RING_SIZE];
+    int _head;
+    int _tail;
+    uint32_t _dropped;
+    uint32_t _reportedDropped;
+    portMUX_TYPE _mux;
+    TaskHandle_t _task;
+
+    Logger();
+    void push(uint8_t level, const char* format, const LogArg* args, int count);
+    static int format(const Record& r, char* line, int size);
+    static void flushTask(void* arg);
+};
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) Logger::instance().write(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) Logger::instance().write(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) Logger::instance().write(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) Logger::instance().write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+// Implementation
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger() :
+    _head(0),
+    _tail(0),
+    _dropped(0),
+    _reportedDropped(0),
+    _mux(portMUX_INITIALIZER_UNLOCKED),
+    _task(nullptr)
+{
+}
+
+bool Logger::begin() {
+    if (xTaskCreatePinnedToCore(flushTask, "log", LOG_TASK_STACK, this,
+                                LOG_TASK_PRIORITY, &_task, LOG_TASK_CORE) != pdPASS) {
+        Serial.println("Logger: task creation failed");
+        return false;
+    }
+    return true;
+}
+
+void Logger::push(uint8_t level, const char* format, const LogArg* args, int count) {
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&_mux);
+    int next = (_head + 1) % LOG_RING_SIZE;
+    if (next == _tail) {
+        _dropped++;
+    } else {
+        Record& r = _ring[_head];
+        r.format = format;
+        r.timestampMs = now;
+        r.level = level;
+        r.argCount = count;
+        for (int i = 0; i < count; i++) {
+            r.types[i] = args[i].type;
+            r.args[i] = args[i].bits;
+        }
+        _head = next;
+    }
+    portEXIT_CRITICAL(&_mux);
+}
+
+int Logger::drain(char* line, int size) {
+    // Report drops once, ahead of whatever survived them
+    uint32_t dropped = _dropped;
+    if (dropped != _reportedDropped) {
+        snprintf(line, size, "[log] %lu records dropped",
+                 (unsigned long)(dropped - _reportedDropped));
+        _reportedDropped = dropped;
+        return LOG_LEVEL_WARN;
+    }
+
+    Record r;
+    portENTER_CRITICAL(&_mux);
+    bool empty = (_tail == _head);
+    if (!empty) {
+        r = _ring[_tail];
+        _tail = (_tail + 1) % LOG_RING_SIZE;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    if (empty) {
+        return -1;
+    }
+
+    format(r, line, size);
+    return r.level;
+}
+
+int Logger::format(const Record& r, char* line, int size) {
+    static const char levelTag[] = "-EWID";
+
+    int n = snprintf(line, size, "%8lu %c ", (unsigned long)r.timestampMs,
+                     levelTag[r.level < sizeof(levelTag) - 1 ? r.level : 0]);
+    int arg = 0;
+    const char* p = r.format;
+
+    while (*p && n < size - 1) {
+        if (*p != '%') {
+            line[n++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            line[n++] = '%';
+            p += 2;
+            continue;
+        }
+
+        // Copy one conversion spec ("%-8.2lf") and format its argument alone
+        char spec[16];
+        int len = 0;
+        bool isLong = false;
+        spec[len++] = *p++;
+        while (*p && !strchr("diuxXcsfeEgGp", *p) && len < (int)sizeof(spec) - 2) {
+            if (*p == 'l') isLong = true;
+            spec[len++] = *p++;
+        }
+        if (!*p) break;
+        spec[len++] = *p++;
+        spec[len] = '\0';
+
+        if (arg >= r.argCount) {
+            n += snprintf(line + n, size - n, "?");
+            continue;
+        }
+
+        uintptr_t bits = r.args[arg];
+        switch (r.types[arg++]) {
+            case LOG_ARG_FLOAT: {
+                float f;
+                memcpy(&f, &bits, sizeof(f));
+                n += snprintf(line + n, size - n, spec, (double)f);
+                break;
+            }
+            case LOG_ARG_STR:
+                n += snprintf(line + n, size - n, spec, (const char*)bits);
+                break;
+            case LOG_ARG_UINT:
+                n += isLong ? snprintf(line + n, size - n, spec, (unsigned long)bits)
+                            : snprintf(line + n, size - n, spec, (unsigned int)bits);
+                break;
+            case LOG_ARG_INT:
+            default:
+                n += isLong ? snprintf(line + n, size - n, spec, (long)(int32_t)bits)
+                            : snprintf(line + n, size - n, spec, (int)(int32_t)bits);
+                break;
+        }
+    }
+
+    n = min(n, size - 1);
+    line[n] = '\0';
+    return n;
+}
+
+void Logger::flushTask(void* arg) {
+    Logger* self = (Logger*)arg;
+    char line[LOG_LINE_MAX];
+
+    for (;;) {
+        while (self->drain(line, sizeof(line)) >= 0) {
+            Serial.println(line);
+        }
+        vTaskDelay(pdMS_TO_TICKS(LOG_FLUSH_MS));
+    }
+}
+
+#endif // LOGGER_H
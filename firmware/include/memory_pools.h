@@ -0,0 +1,321 @@
+/**
+ * VARTA - Memory Pools
+ * Central allocation layer for the large buffers. Each buffer names a
+ * pool (fast internal SRAM, DMA-capable internal SRAM, or PSRAM) through
+ * its PLACE_* setting in config.h; the pools track what was placed where
+ * against a per-pool budget and keep high-water marks for the report.
+ *
+ * A request that would exceed its pool's budget, or that the heap can't
+ * satisfy, fails (nullptr) with a report of everything placed so far, so
+ * the boot stops in ERROR with the reason on serial instead of limping
+ * along with a buffer silently landing in the wrong memory.
+ */
+
+#ifndef MEMORY_POOLS_H
+#define MEMORY_POOLS_H
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include "config.h"
+
+#define MEMORY_MAX_ALLOCATIONS  24
+#define MEMORY_BENCH_BYTES      (16 * 1024)     // Working set per kernel benchmark
+#define MEMORY_BENCH_RUNS       8
+#define MEMORY_BENCH_EVICT_BYTES (128 * 1024)   // 4x the largest S3 data cache
+#define MEMORY_BENCH_LINE       16              // Touch stride, <= the cache line
+
+enum MemoryPool {
+    POOL_INTERNAL,      // Internal SRAM, single-cycle from both cores
+    POOL_DMA,           // Internal SRAM reachable by the peripheral DMA
+    POOL_PSRAM,         // Octal PSRAM behind the data cache
+    POOL_COUNT
+};
+
+struct PoolAllocation {
+    const char* name;
+    void* ptr;
+    size_t bytes;
+    MemoryPool pool;
+};
+
+class MemoryPools {
+public:
+    static MemoryPools& instance();
+
+    /**
+     * Allocate `bytes` from `pool`, aligned to `align` (a power of two).
+     * Returns nullptr, after printing the report, if the pool's budget or
+     * the heap can't take it.
+     */
+    void* allocate(const char* name, size_t bytes, MemoryPool pool, size_t align = 4);
+    void release(void* ptr);
+
+    bool isOverBudget() { return _overBudget; }
+
+    size_t allocated(MemoryPool pool) { return _allocated[pool]; }
+    size_t peak(MemoryPool pool) { return _peak[pool]; }
+
+    /**
+     * Per pool: budget, placed bytes and their high-water mark, plus the
+     * heap's free / minimum-ever-free / largest block; then each buffer
+     */
+    void printReport();
+
+    /**
+     * Time the hot kernels' access patterns (sequential MAC as in the mel
+     * projection and FIR, strided butterflies as in the FFT, block copy
+     * as in frame shifting) with their data in each pool. Cold runs
+     * start after streaming MEMORY_BENCH_EVICT_BYTES of other PSRAM
+     * through the cache, so PSRAM data isn't timed from the cache;
+     * warm runs repeat each kernel straight after.
+     */
+    void benchmark();
+
+    static const char* poolName(MemoryPool pool);
+
+private:
+    PoolAllocation _allocations[MEMORY_MAX_ALLOCATIONS];
+    int _count;
+    size_t _allocated[POOL_COUNT];
+    size_t _peak[POOL_COUNT];
+    bool _overBudget;
+    portMUX_TYPE _mux;
+
+    MemoryPools();
+    static uint32_t caps(MemoryPool pool);
+    static size_t budget(MemoryPool pool);
+    static uint32_t benchMac(const float* a, int n);
+    static uint32_t benchStrided(float* a, int n);
+    static uint32_t benchCopy(float* dst, const float* src, int n);
+    static void evictCache(const uint8_t* other);
+};
+
+// Implementation
+
+MemoryPools& MemoryPools::instance() {
+    static MemoryPools pools;
+    return pools;
+}
+
+MemoryPools::MemoryPools() :
+    _count(0),
+    _overBudget(false),
+    _mux(portMUX_INITIALIZER_UNLOCKED)
+{
+    memset(_allocations, 0, sizeof(_allocations));
+    memset(_allocated, 0, sizeof(_allocated));
+    memset(_peak, 0, sizeof(_peak));
+}
+
+uint32_t MemoryPools::caps(MemoryPool pool) {
+    switch (pool) {
+        case POOL_DMA:   return MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+        case POOL_PSRAM: return MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+        default:         return MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    }
+}
+
+size_t MemoryPools::budget(MemoryPool pool) {
+    switch (pool) {
+        case POOL_DMA:   return MEMORY_BUDGET_DMA_KB * 1024UL;
+        case POOL_PSRAM: return MEMORY_BUDGET_PSRAM_KB * 1024UL;
+        default:         return MEMORY_BUDGET_INTERNAL_KB * 1024UL;
+    }
+}
+
+const char* MemoryPools::poolName(MemoryPool pool) {
+    static const char* names[POOL_COUNT] = { "internal", "dma", "psram" };
+    return names[pool];
+}
+
+void* MemoryPools::allocate(const char* name, size_t bytes, MemoryPool pool, size_t align) {
+    // Boot steps allocate from both cores; reserve the slot and budget first
+    portENTER_CRITICAL(&_mux);
+    bool full = _count >= MEMORY_MAX_ALLOCATIONS;
+    size_t used = _allocated[pool];
+    bool fits = !full && used + bytes <= budget(pool);
+    int slot = -1;
+    if (fits) {
+        slot = _count++;
+        _allocations[slot].name = name;
+        _allocations[slot].ptr = nullptr;
+        _allocations[slot].bytes = bytes;
+        _allocations[slot].pool = pool;
+        _allocated[pool] += bytes;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    if (full) {
+        Serial.printf("MemoryPools: no slot for %s\n", name);
+        return nullptr;
+    }
+    if (!fits) {
+        Serial.printf("MemoryPools: %s (%u bytes) exceeds the %s budget (%u of %u KB used)\n",
+                      name, (unsigned)bytes, poolName(pool),
+                      (unsigned)(used / 1024), (unsigned)(budget(pool) / 1024));
+        _overBudget = true;
+        printReport();
+        return nullptr;
+    }
+
+    void* ptr = heap_caps_aligned_alloc(align, bytes, caps(pool));
+
+    portENTER_CRITICAL(&_mux);
+    if (ptr != nullptr) {
+        _allocations[slot].ptr = ptr;
+        if (_allocated[pool] > _peak[pool]) _peak[pool] = _allocated[pool];
+    } else {
+        _allocated[pool] -= bytes;
+        _allocations[slot].bytes = 0;       // Shown as failed in the report
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    if (ptr == nullptr) {
+        Serial.printf("MemoryPools: %s (%u bytes) does not fit in %s (largest block %u)\n",
+                      name, (unsigned)bytes, poolName(pool),
+                      (unsigned)heap_caps_get_largest_free_block(caps(pool)));
+        printReport();
+    }
+    return ptr;
+}
+
+void MemoryPools::release(void* ptr) {
+    if (ptr == nullptr) return;
+
+    portENTER_CRITICAL(&_mux);
+    for (int i = 0; i < _count; i++) {
+        if (_allocations[i].ptr == ptr) {
+            _allocated[_allocations[i].pool] -= _allocations[i].bytes;
+            _allocations[i] = _allocations[--_count];
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    heap_caps_free(ptr);
+}
+
+void MemoryPools::printReport() {
+    Serial.println("pool       budget   placed     peak |  heap free  min free   largest (KB)");
+    for (int p = 0; p < POOL_COUNT; p++) {
+        MemoryPool pool = (MemoryPool)p;
+        Serial.printf("%-8s %8u %8u %8u | %9u %9u %9u\n", poolName(pool),
+                      (unsigned)(budget(pool) / 1024), (unsigned)(_allocated[p] / 1024),
+                      (unsigned)(_peak[p] / 1024),
+                      (unsigned)(heap_caps_get_free_size(caps(pool)) / 1024),
+                      (unsigned)(heap_caps_get_minimum_free_size(caps(pool)) / 1024),
+                      (unsigned)(heap_caps_get_largest_free_block(caps(pool)) / 1024));
+    }
+    for (int i = 0; i < _count; i++) {
+        const PoolAllocation& a = _allocations[i];
+        if (a.ptr == nullptr) {
+            Serial.printf("  %-16s %-8s   FAILED\n", a.name, poolName(a.pool));
+        } else {
+            Serial.printf("  %-16s %-8s %8u bytes\n", a.name, poolName(a.pool), (unsigned)a.bytes);
+        }
+    }
+}
+
+uint32_t MemoryPools::benchMac(const float* a, int n) {
+    uint32_t start = ESP.getCycleCount();
+    volatile float sink = 0.0f;
+    float acc = 0.0f;
+    for (int i = 0; i < n; i++) {
+        acc += a[i] * a[n - 1 - i];
+    }
+    sink = acc;
+    (void)sink;
+    return ESP.getCycleCount() - start;
+}
+
+uint32_t MemoryPools::benchStrided(float* a, int n) {
+    // Radix-2 butterfly order: every stage walks the buffer at a new stride
+    uint32_t start = ESP.getCycleCount();
+    for (int half = n / 2; half >= 1; half /= 2) {
+        for (int base = 0; base < n; base += 2 * half) {
+            for (int k = 0; k < half; k++) {
+                float t = a[base + k + half];
+                a[base + k + half] = a[base + k] - t;
+                a[base + k] += t;
+            }
+        }
+    }
+    return ESP.getCycleCount() - start;
+}
+
+uint32_t MemoryPools::benchCopy(float* dst, const float* src, int n) {
+    uint32_t start = ESP.getCycleCount();
+    memcpy(dst, src, n * sizeof(float));
+    return ESP.getCycleCount() - start;
+}
+
+void MemoryPools::evictCache(const uint8_t* other) {
+    // Reading this much other PSRAM replaces every line (dirty ones are
+    // written back here, outside the timed kernel)
+    volatile uint8_t sink = 0;
+    for (int i = 0; i < MEMORY_BENCH_EVICT_BYTES; i += MEMORY_BENCH_LINE) {
+        sink += other[i];
+    }
+    (void)sink;
+}
+
+void MemoryPools::benchmark() {
+    int n = MEMORY_BENCH_BYTES / sizeof(float);
+
+    uint8_t* evict = (uint8_t*)heap_caps_malloc(MEMORY_BENCH_EVICT_BYTES, caps(POOL_PSRAM));
+    if (evict == nullptr) {
+        Serial.println("benchmark: no PSRAM for the cache eviction buffer");
+        return;
+    }
+    memset(evict, 0, MEMORY_BENCH_EVICT_BYTES);
+
+    Serial.printf("kernel latency per placement, %d KB working set, best of %d (us)\n",
+                  MEMORY_BENCH_BYTES / 1024, MEMORY_BENCH_RUNS);
+    Serial.println("            ------ cold cache ------   ------ warm cache ------");
+    Serial.println("pool         mac  strided     copy        mac  strided     copy");
+    for (int p = 0; p < POOL_COUNT; p++) {
+        // Scratch stays outside the accounting; the pool's heap is what's measured
+        float* a = (float*)heap_caps_malloc(MEMORY_BENCH_BYTES, caps((MemoryPool)p));
+        float* b = (float*)heap_caps_malloc(MEMORY_BENCH_BYTES, caps((MemoryPool)p));
+        if (a == nullptr || b == nullptr) {
+            Serial.printf("%-8s  (no memory)\n", poolName((MemoryPool)p));
+            heap_caps_free(a);
+            heap_caps_free(b);
+            continue;
+        }
+
+        for (int i = 0; i < n; i++) {
+            a[i] = (float)(i & 255) * (1.0f / 256.0f);
+        }
+
+        enum { MAC, STRIDED, COPY, KERNELS };
+        uint32_t cold[KERNELS], warm[KERNELS];
+        for (int k = 0; k < KERNELS; k++) {
+            cold[k] = warm[k] = UINT32_MAX;
+        }
+        for (int run = 0; run < MEMORY_BENCH_RUNS; run++) {
+            for (int k = 0; k < KERNELS; k++) {
+                evictCache(evict);
+                for (int pass = 0; pass < 2; pass++) {
+                    uint32_t t = k == MAC ? benchMac(a, n)
+                               : k == STRIDED ? benchStrided(a, n)
+                               : benchCopy(b, a, n);
+                    uint32_t& best = pass == 0 ? cold[k] : warm[k];
+                    best = min(best, t);
+                }
+            }
+        }
+
+        uint32_t mhz = getCpuFrequencyMhz();
+        Serial.printf("%-8s %8lu %8lu %8lu   %8lu %8lu %8lu\n", poolName((MemoryPool)p),
+                      (unsigned long)(cold[MAC] / mhz), (unsigned long)(cold[STRIDED] / mhz),
+                      (unsigned long)(cold[COPY] / mhz), (unsigned long)(warm[MAC] / mhz),
+                      (unsigned long)(warm[STRIDED] / mhz), (unsigned long)(warm[COPY] / mhz));
+
+        heap_caps_free(a);
+        heap_caps_free(b);
+    }
+    heap_caps_free(evict);
+}
+
+#endif // MEMORY_POOLS_H
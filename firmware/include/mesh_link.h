@@ -0,0 +1,691 @@
+/**
+ * VARTA - Mesh Link
+ * Shares detections between units over a broadcast radio with as little
+ * airtime as possible. Three message kinds ride in small batched frames:
+ * bearing reports (for BearingFusion), alert cues (so one unit's alert
+ * can cue its neighbours) and time messages (for TimeSync).
+ *
+ * Frame: [magic][version][sender][count] then `count` messages of
+ * [type][ttl][body], body size fixed by type. Little-endian, no padding.
+ *
+ * - Batching: a message waits up to MESH_BATCH_MS for company, or until
+ *   a frame is full.
+ * - Rate limiting: a token bucket caps frames per second. A newer
+ *   bearing from the same unit replaces the queued one, so a busy link
+ *   sends fresh bearings late rather than stale ones on time.
+ * - Deduplication: (type, origin, seq) of recent messages, so repeats
+ *   and relayed copies are delivered once.
+ * - Relay: messages arriving with ttl > 0 are rebroadcast with ttl - 1,
+ *   reaching units beyond direct range. Each relay first waits a random
+ *   1 to MESH_RELAY_BACKOFF_MS and is cancelled once MESH_RELAY_SUPPRESS
+ *   other copies are overheard meanwhile, so a dense site relays each
+ *   message a few times per hop instead of once per unit. One copy is
+ *   not enough: on a line, the nearer neighbour's relay would cancel the
+ *   farther one's and shorten the reach by a hop. Cues go out with MESH_TTL;
+ *   bearings with MESH_BEARING_TTL, 0 by default, because they are the
+ *   bulk of the traffic and fusion needs only units that hear each
+ *   other. Time messages are sent with ttl 0: a relay's queueing would
+ *   read as clock offset.
+ * - Timestamps: frames are stamped on the radio's microsecond clock as
+ *   they go out and as they arrive, for TimeSync.
+ * - Alert cues, first-hand or relayed, go out at once and then
+ *   MESH_ALERT_REPEATS - 1 more times a batch interval apart; broadcasts
+ *   are not acknowledged.
+ *
+ * Portable (no Arduino): the radio is a MeshRadio, ESP-NOW on the device
+ * (espnow_radio.h) and MemoryAir / MemoryRadio, with loss and a range
+ * model, on a host. Call from one task only.
+ */
+
+#ifndef MESH_LINK_H
+#define MESH_LINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "config.h"
+#include "bearing_fusion.h"
+
+#define MESH_MAGIC              0x56    // 'V'
+#define MESH_VERSION            2       // 2: AlertCue flags
+#define MESH_FRAME_MAX          250     // ESP-NOW payload limit
+#define MESH_FRAME_HEADER       4
+#define MESH_QUEUE_DEPTH        24      // Outgoing messages, including relays
+#define MESH_INBOX_DEPTH        32      // Delivered bearings waiting for receive()
+#define MESH_CUE_INBOX_DEPTH    8
+#define MESH_TIME_INBOX_DEPTH   8       // Delay requests from every unit land on the master
+#define MESH_TIME_SENT_DEPTH    4       // Send stamps of own time messages
+#define MESH_DEDUP_DEPTH        128     // Recent (type, origin, seq) keys
+
+enum MeshMessageType {
+    MESH_MSG_BEARING = 1,
+    MESH_MSG_ALERT = 2,
+    MESH_MSG_TIME = 3
+};
+
+struct __attribute__((packed)) AlertCue {
+    uint8_t nodeId;
+    uint16_t seq;
+    uint32_t timestampMs;       // Sender's clock, or mesh time with BEARING_FLAG_SHARED_TIME
+    uint16_t bearingCdeg;       // True bearing, 0.01 degree
+    uint8_t confidence;         // 0-255
+    uint8_t flags;              // BEARING_FLAG_*
+};
+
+struct __attribute__((packed)) TimeMessage {
+    uint8_t nodeId;
+    uint16_t seq;               // Sender's time message count
+    uint8_t kind;               // TimeSyncKind (time_sync.h)
+    uint8_t target;             // Addressed unit, for replies
+    uint16_t ref;               // seq of the message timeUs refers to
+    uint64_t timeUs;            // Sender's microsecond clock
+};
+
+static_assert(sizeof(AlertCue) <= sizeof(BearingReport) && sizeof(TimeMessage) <= sizeof(BearingReport),
+              "Queued bodies are sized for a BearingReport");
+
+struct MeshStats {
+    uint32_t framesSent;
+    uint32_t framesReceived;
+    uint32_t framesRejected;    // Bad magic, version or length
+    uint32_t messagesSent;
+    uint32_t duplicates;
+    uint32_t relayed;           // Relays queued
+    uint32_t suppressed;        // ... and cancelled on an overheard copy
+    uint32_t coalesced;         // Queued bearings replaced by a newer one
+    uint32_t dropped;           // Queue full
+    uint32_t rateLimited;       // Frames held back by the token bucket
+};
+
+/**
+ * Broadcast medium. receive() copies one waiting frame into `frame`,
+ * stamps its arrival on clockUs(), and returns its length, or 0 when
+ * none wait.
+ */
+class MeshRadio {
+public:
+    virtual ~MeshRadio() {}
+    virtual bool broadcast(const uint8_t* frame, int length) = 0;
+    virtual int receive(uint8_t* frame, int capacity, uint64_t* arrivalUs) = 0;
+    virtual uint64_t clockUs() = 0;
+};
+
+class MeshLink : public BearingTransport {
+public:
+    MeshLink(MeshRadio& radio, uint8_t nodeId);
+
+    // BearingTransport
+    bool send(const BearingReport& report) override;
+    bool receive(BearingReport* report) override;
+
+    /**
+     * Queue a cue for the neighbours; bearingDeg is true (heading applied),
+     * flags as for a bearing report
+     */
+    bool sendAlert(uint32_t timestampMs, float bearingDeg, float confidence, uint8_t flags = 0);
+    bool receiveAlert(AlertCue* cue);
+
+    /**
+     * Time messages: sent on the next pass, never relayed. timeSent()
+     * gives the radio-clock send stamp of one of ours once it is out.
+     */
+    bool sendTime(const TimeMessage& message);
+    bool receiveTime(TimeMessage* message, uint64_t* arrivalUs);
+    bool timeSent(uint16_t seq, uint64_t* sentUs);
+
+    /**
+     * Drain the radio, then send a frame if one is due and the rate
+     * limit allows. Call every loop pass.
+     */
+    void poll(uint32_t nowMs);
+
+    const MeshStats& getStats() { return _stats; }
+
+private:
+    struct Pending {
+        uint8_t type;
+        uint8_t ttl;
+        uint8_t sendsLeft;
+        bool urgent;            // Cue or time message not yet sent: goes out on the next pass
+        bool relay;             // Not sent yet and still cancellable by overheard copies
+        uint8_t overheard;      // Copies heard since it was queued
+        uint8_t origin;
+        uint16_t seq;
+        uint32_t queuedMs;
+        uint32_t holdUntilMs;   // Relay backoff: not sent before this
+        uint8_t body[sizeof(BearingReport)];
+    };
+
+    MeshRadio& _radio;
+    uint8_t _nodeId;
+    uint32_t _nowMs;
+
+    Pending _queue[MESH_QUEUE_DEPTH];
+    int _queued;
+
+    BearingReport _inbox[MESH_INBOX_DEPTH];
+    int _inboxHead;
+    int _inboxCount;
+    AlertCue _cues[MESH_CUE_INBOX_DEPTH];
+    int _cueHead;
+    int _cueCount;
+    TimeMessage _times[MESH_TIME_INBOX_DEPTH];
+    uint64_t _timeArrivals[MESH_TIME_INBOX_DEPTH];
+    int _timeHead;
+    int _timeCount;
+    uint16_t _sentSeq[MESH_TIME_SENT_DEPTH];
+    uint64_t _sentUs[MESH_TIME_SENT_DEPTH];
+    int _sentNext;
+
+    uint32_t _seen[MESH_DEDUP_DEPTH];
+    int _seenNext;
+
+    float _tokens;
+    uint32_t _lastRefillMs;
+    bool _held;                 // A due frame is waiting for a token
+    uint16_t _cueSeq;
+    uint32_t _random;
+
+    MeshStats _stats;
+
+    static int bodySize(uint8_t type);
+    static uint32_t key(uint8_t type, uint8_t origin, uint16_t seq);
+    bool seen(uint32_t k);
+    void remember(uint32_t k);
+    bool enqueue(uint8_t type, uint8_t ttl, uint8_t sends, uint8_t origin, uint16_t seq, const void* body,
+                 uint32_t holdMs = 0);
+    void suppressRelay(uint8_t type, uint8_t origin, uint16_t seq);
+    bool ready(const Pending& p) { return (int32_t)(_nowMs - p.holdUntilMs) >= 0; }
+    uint32_t backoffMs();
+    void deliver(uint8_t type, const uint8_t* body, uint64_t arrivalUs);
+    void handleFrame(const uint8_t* frame, int length, uint64_t arrivalUs);
+    bool flushDue();
+    void flush();
+};
+
+// Host backend
+
+#define MEMORY_AIR_MAX_NODES    64
+#define MEMORY_AIR_DEPTH        16      // Frames queued per receiver
+
+class MemoryRadio;
+
+/**
+ * In-memory broadcast medium for host simulation: each frame reaches each
+ * other radio in range, independently lost with probability `loss`.
+ * Time is the simulation's true microsecond clock, set by the caller;
+ * a frame arrives latencyUs plus up to jitterUs later.
+ */
+class MemoryAir {
+public:
+    MemoryAir(float loss, uint32_t seed) :
+        _loss(loss), _state(seed ? seed : 1), _count(0), _inRange(nullptr),
+        _nowUs(0), _latencyUs(0), _jitterUs(0) {}
+
+    /**
+     * Range model; nullptr (the default) means every radio hears every other
+     */
+    void setRange(bool (*inRange)(int from, int to)) { _inRange = inRange; }
+
+    void setTime(uint64_t trueUs) { _nowUs = trueUs; }
+    uint64_t getTime() { return _nowUs; }
+    void setLatency(uint32_t latencyUs, uint32_t jitterUs) {
+        _latencyUs = latencyUs;
+        _jitterUs = jitterUs;
+    }
+
+    int attach(MemoryRadio* radio) {
+        if (_count >= MEMORY_AIR_MAX_NODES) return -1;
+        _radios[_count] = radio;
+        return _count++;
+    }
+
+    void transmit(int from, const uint8_t* frame, int length);
+
+private:
+    float _loss;
+    uint32_t _state;
+    MemoryRadio* _radios[MEMORY_AIR_MAX_NODES];
+    int _count;
+    bool (*_inRange)(int from, int to);
+    uint64_t _nowUs;
+    uint32_t _latencyUs;
+    uint32_t _jitterUs;
+
+    float random() {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return (_state >> 8) * (1.0f / 16777216.0f);
+    }
+};
+
+class MemoryRadio : public MeshRadio {
+public:
+    explicit MemoryRadio(MemoryAir& air) :
+        _air(air), _head(0), _count(0), _overflows(0), _rate(1.0), _offsetUs(0) {
+        _index = air.attach(this);
+    }
+
+    /**
+     * This unit's clock: offsetUs + rate * true time
+     */
+    void setClock(double rate, int64_t offsetUs) {
+        _rate = rate;
+        _offsetUs = offsetUs;
+    }
+
+    uint64_t localAt(uint64_t trueUs) { return (uint64_t)(_offsetUs + (int64_t)(_rate * trueUs)); }
+
+    uint64_t clockUs() override { return localAt(_air.getTime()); }
+
+    bool broadcast(const uint8_t* frame, int length) override {
+        _air.transmit(_index, frame, length);
+        return true;
+    }
+
+    int receive(uint8_t* frame, int capacity, uint64_t* arrivalUs) override {
+        if (_count == 0) return 0;
+        int length = _lengths[_head] < capacity ? _lengths[_head] : capacity;
+        memcpy(frame, _frames[_head], length);
+        *arrivalUs = _arrivals[_head];
+        _head = (_head + 1) % MEMORY_AIR_DEPTH;
+        _count--;
+        return length;
+    }
+
+    void arrive(const uint8_t* frame, int length, uint64_t trueUs) {
+        if (_count >= MEMORY_AIR_DEPTH) {
+            _overflows++;
+            return;
+        }
+        int slot = (_head + _count) % MEMORY_AIR_DEPTH;
+        memcpy(_frames[slot], frame, length);
+        _lengths[slot] = length;
+        _arrivals[slot] = localAt(trueUs);
+        _count++;
+    }
+
+    uint32_t getOverflows() { return _overflows; }
+
+private:
+    MemoryAir& _air;
+    int _index;
+    uint8_t _frames[MEMORY_AIR_DEPTH][MESH_FRAME_MAX];
+    int _lengths[MEMORY_AIR_DEPTH];
+    uint64_t _arrivals[MEMORY_AIR_DEPTH];
+    int _head;
+    int _count;
+    uint32_t _overflows;
+    double _rate;
+    int64_t _offsetUs;
+};
+
+// Implementation
+
+inline void MemoryAir::transmit(int from, const uint8_t* frame, int length) {
+    for (int i = 0; i < _count; i++) {
+        if (i == from) continue;
+        if (_inRange != nullptr && !_inRange(from, i)) continue;
+        if (random() < _loss) continue;
+        _radios[i]->arrive(frame, length, _nowUs + _latencyUs + (uint64_t)(random() * _jitterUs));
+    }
+}
+
+MeshLink::MeshLink(MeshRadio& radio, uint8_t nodeId) :
+    _radio(radio),
+    _nodeId(nodeId),
+    _nowMs(0),
+    _queued(0),
+    _inboxHead(0),
+    _inboxCount(0),
+    _cueHead(0),
+    _cueCount(0),
+    _timeHead(0),
+    _timeCount(0),
+    _sentNext(0),
+    _seenNext(0),
+    _tokens(MESH_FRAME_BURST),
+    _lastRefillMs(0),
+    _held(false),
+    _cueSeq(0),
+    _random(0x9E3779B9u * (nodeId + 1u))     // Units back off differently
+{
+    memset(_seen, 0, sizeof(_seen));        // Key 0 is never a real message
+    memset(_sentSeq, 0, sizeof(_sentSeq));
+    memset(_sentUs, 0, sizeof(_sentUs));       // 0: not sent
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+int MeshLink::bodySize(uint8_t type) {
+    switch (type) {
+        case MESH_MSG_BEARING: return sizeof(BearingReport);
+        case MESH_MSG_ALERT:   return sizeof(AlertCue);
+        case MESH_MSG_TIME:    return sizeof(TimeMessage);
+        default:               return -1;
+    }
+}
+
+uint32_t MeshLink::key(uint8_t type, uint8_t origin, uint16_t seq) {
+    return ((uint32_t)type << 24) | ((uint32_t)origin << 16) | seq;
+}
+
+bool MeshLink::seen(uint32_t k) {
+    for (int i = 0; i < MESH_DEDUP_DEPTH; i++) {
+        if (_seen[i] == k) return true;
+    }
+    return false;
+}
+
+void MeshLink::remember(uint32_t k) {
+    _seen[_seenNext] = k;
+    _seenNext = (_seenNext + 1) % MESH_DEDUP_DEPTH;
+}
+
+uint32_t MeshLink::backoffMs() {
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    return _random % (MESH_RELAY_BACKOFF_MS + 1);
+}
+
+bool MeshLink::enqueue(uint8_t type, uint8_t ttl, uint8_t sends, uint8_t origin, uint16_t seq,
+                       const void* body, uint32_t holdMs) {
+    // Only the newest bearing per unit is worth airtime
+    if (type == MESH_MSG_BEARING) {
+        for (int i = 0; i < _queued; i++) {
+            if (_queue[i].type == MESH_MSG_BEARING && _queue[i].origin == origin) {
+                memcpy(_queue[i].body, body, sizeof(BearingReport));
+                _queue[i].seq = seq;
+                _queue[i].ttl = ttl;
+                _queue[i].relay = holdMs > 0;
+                _queue[i].overheard = 0;
+                _queue[i].holdUntilMs = _nowMs + holdMs;
+                _stats.coalesced++;
+                return true;
+            }
+        }
+    }
+
+    if (_queued >= MESH_QUEUE_DEPTH) {
+        // Make room by dropping the oldest bearing; cues are kept
+        int victim = -1;
+        for (int i = 0; i < _queued; i++) {
+            if (_queue[i].type == MESH_MSG_BEARING) {
+                victim = i;
+                break;
+            }
+        }
+        _stats.dropped++;
+        if (victim < 0) return false;
+        memmove(&_queue[victim], &_queue[victim + 1], (_queued - victim - 1) * sizeof(Pending));
+        _queued--;
+    }
+
+    Pending& p = _queue[_queued++];
+    p.type = type;
+    p.ttl = ttl;
+    p.sendsLeft = sends;
+    p.urgent = type != MESH_MSG_BEARING;
+    p.relay = holdMs > 0;
+    p.overheard = 0;
+    p.origin = origin;
+    p.seq = seq;
+    p.queuedMs = _nowMs + holdMs;
+    p.holdUntilMs = _nowMs + holdMs;
+    memcpy(p.body, body, bodySize(type));
+    return true;
+}
+
+void MeshLink::suppressRelay(uint8_t type, uint8_t origin, uint16_t seq) {
+    // Enough units in range already carried it on; ours would add little
+    for (int i = 0; i < _queued; i++) {
+        Pending& p = _queue[i];
+        if (p.relay && p.type == type && p.origin == origin && p.seq == seq) {
+            if (++p.overheard < MESH_RELAY_SUPPRESS) return;
+            memmove(&_queue[i], &_queue[i + 1], (_queued - i - 1) * sizeof(Pending));
+            _queued--;
+            _stats.suppressed++;
+            return;
+        }
+    }
+}
+
+bool MeshLink::send(const BearingReport& report) {
+    remember(key(MESH_MSG_BEARING, report.nodeId, report.seq));
+    return enqueue(MESH_MSG_BEARING, MESH_BEARING_TTL, 1, report.nodeId, report.seq, &report);
+}
+
+bool MeshLink::receive(BearingReport* report) {
+    if (_inboxCount == 0) return false;
+    *report = _inbox[_inboxHead];
+    _inboxHead = (_inboxHead + 1) % MESH_INBOX_DEPTH;
+    _inboxCount--;
+    return true;
+}
+
+bool MeshLink::sendAlert(uint32_t timestampMs, float bearingDeg, float confidence, uint8_t flags) {
+    // Same field encoding as a bearing report
+    BearingReport r = BearingFusion::makeReport(_nodeId, 0, timestampMs, 0.0f, 0.0f,
+                                                bearingDeg, confidence, 0.0f);
+    AlertCue cue;
+    cue.nodeId = _nodeId;
+    cue.seq = _cueSeq++;
+    cue.timestampMs = timestampMs;
+    cue.bearingCdeg = r.bearingCdeg;
+    cue.confidence = r.confidence;
+    cue.flags = flags;
+
+    remember(key(MESH_MSG_ALERT, cue.nodeId, cue.seq));
+    return enqueue(MESH_MSG_ALERT, MESH_TTL, MESH_ALERT_REPEATS, cue.nodeId, cue.seq, &cue);
+}
+
+bool MeshLink::receiveAlert(AlertCue* cue) {
+    if (_cueCount == 0) return false;
+    *cue = _cues[_cueHead];
+    _cueHead = (_cueHead + 1) % MESH_CUE_INBOX_DEPTH;
+    _cueCount--;
+    return true;
+}
+
+bool MeshLink::sendTime(const TimeMessage& message) {
+    remember(key(MESH_MSG_TIME, message.nodeId, message.seq));
+    return enqueue(MESH_MSG_TIME, 0, 1, message.nodeId, message.seq, &message);
+}
+
+bool MeshLink::receiveTime(TimeMessage* message, uint64_t* arrivalUs) {
+    if (_timeCount == 0) return false;
+    *message = _times[_timeHead];
+    *arrivalUs = _timeArrivals[_timeHead];
+    _timeHead = (_timeHead + 1) % MESH_TIME_INBOX_DEPTH;
+    _timeCount--;
+    return true;
+}
+
+bool MeshLink::timeSent(uint16_t seq, uint64_t* sentUs) {
+    for (int i = 0; i < MESH_TIME_SENT_DEPTH; i++) {
+        if (_sentUs[i] != 0 && _sentSeq[i] == seq) {
+            *sentUs = _sentUs[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+void MeshLink::deliver(uint8_t type, const uint8_t* body, uint64_t arrivalUs) {
+    // A full inbox drops the oldest: newer messages matter more
+    if (type == MESH_MSG_TIME) {
+        if (_timeCount == MESH_TIME_INBOX_DEPTH) {
+            _timeHead = (_timeHead + 1) % MESH_TIME_INBOX_DEPTH;
+            _timeCount--;
+        }
+        int slot = (_timeHead + _timeCount) % MESH_TIME_INBOX_DEPTH;
+        memcpy(&_times[slot], body, sizeof(TimeMessage));
+        _timeArrivals[slot] = arrivalUs;
+        _timeCount++;
+    } else if (type == MESH_MSG_BEARING) {
+        if (_inboxCount == MESH_INBOX_DEPTH) {
+            _inboxHead = (_inboxHead + 1) % MESH_INBOX_DEPTH;
+            _inboxCount--;
+        }
+        memcpy(&_inbox[(_inboxHead + _inboxCount) % MESH_INBOX_DEPTH], body, sizeof(BearingReport));
+        _inboxCount++;
+    } else {
+        if (_cueCount == MESH_CUE_INBOX_DEPTH) {
+            _cueHead = (_cueHead + 1) % MESH_CUE_INBOX_DEPTH;
+            _cueCount--;
+        }
+        memcpy(&_cues[(_cueHead + _cueCount) % MESH_CUE_INBOX_DEPTH], body, sizeof(AlertCue));
+        _cueCount++;
+    }
+}
+
+void MeshLink::handleFrame(const uint8_t* frame, int length, uint64_t arrivalUs) {
+    if (length < MESH_FRAME_HEADER || frame[0] != MESH_MAGIC || frame[1] != MESH_VERSION) {
+        _stats.framesRejected++;
+        return;
+    }
+    _stats.framesReceived++;
+
+    int count = frame[3];
+    int offset = MESH_FRAME_HEADER;
+    for (int i = 0; i < count; i++) {
+        if (offset + 2 > length) break;
+        uint8_t type = frame[offset];
+        uint8_t ttl = frame[offset + 1];
+        int size = bodySize(type);
+        if (size < 0 || offset + 2 + size > length) {
+            _stats.framesRejected++;
+            return;
+        }
+        const uint8_t* body = frame + offset + 2;
+        offset += 2 + size;
+
+        uint8_t origin;
+        uint16_t seq;
+        if (type == MESH_MSG_BEARING) {
+            origin = body[offsetof(BearingReport, nodeId)];
+            memcpy(&seq, body + offsetof(BearingReport, seq), sizeof(seq));
+        } else if (type == MESH_MSG_TIME) {
+            origin = body[offsetof(TimeMessage, nodeId)];
+            memcpy(&seq, body + offsetof(TimeMessage, seq), sizeof(seq));
+        } else {
+            origin = body[offsetof(AlertCue, nodeId)];
+            memcpy(&seq, body + offsetof(AlertCue, seq), sizeof(seq));
+        }
+
+        uint32_t k = key(type, origin, seq);
+        if (origin == _nodeId || seen(k)) {
+            _stats.duplicates++;
+            suppressRelay(type, origin, seq);
+            continue;
+        }
+        remember(k);
+        deliver(type, body, arrivalUs);
+
+        if (ttl > 0) {
+            _stats.relayed++;
+            enqueue(type, ttl - 1, type == MESH_MSG_ALERT ? MESH_ALERT_REPEATS : 1, origin, seq, body,
+                    1 + backoffMs());
+        }
+    }
+}
+
+bool MeshLink::flushDue() {
+    if (_queued == 0) return false;
+
+    // Relays still backing off neither count nor go out
+    int bytes = MESH_FRAME_HEADER;
+    bool urgent = false;
+    bool any = false;
+    uint32_t oldest = _nowMs;
+    for (int i = 0; i < _queued; i++) {
+        if (!ready(_queue[i])) continue;
+        any = true;
+        bytes += 2 + bodySize(_queue[i].type);
+        if (_queue[i].urgent) urgent = true;
+        if ((int32_t)(_queue[i].queuedMs - oldest) < 0) oldest = _queue[i].queuedMs;
+    }
+    if (!any) return false;
+    bool full = bytes >= MESH_FRAME_MAX;
+
+    // New cues and time messages go out on the next pass; everything
+    // else waits for company
+    return urgent || full || _nowMs - oldest >= MESH_BATCH_MS;
+}
+
+void MeshLink::flush() {
+    uint8_t frame[MESH_FRAME_MAX];
+    frame[0] = MESH_MAGIC;
+    frame[1] = MESH_VERSION;
+    frame[2] = _nodeId;
+    int length = MESH_FRAME_HEADER;
+    int count = 0;
+
+    // Queue order, so cues and relays keep their place
+    uint16_t timeSeqs[MESH_TIME_SENT_DEPTH];
+    int timeCount = 0;
+    int kept = 0;
+    for (int i = 0; i < _queued; i++) {
+        Pending& p = _queue[i];
+        int size = 2 + bodySize(p.type);
+        if (ready(p) && length + size <= MESH_FRAME_MAX && count < 255) {
+            frame[length] = p.type;
+            frame[length + 1] = p.ttl;
+            memcpy(frame + length + 2, p.body, size - 2);
+            length += size;
+            count++;
+            if (p.type == MESH_MSG_TIME && timeCount < MESH_TIME_SENT_DEPTH) {
+                timeSeqs[timeCount++] = p.seq;
+            }
+            p.sendsLeft--;
+            p.urgent = false;
+            p.relay = false;
+            p.queuedMs = _nowMs;        // A repeat waits one batch interval
+        }
+        if (p.sendsLeft > 0) {
+            _queue[kept++] = p;
+        }
+    }
+    _queued = kept;
+    frame[3] = count;
+
+    uint64_t sentUs = _radio.clockUs();
+    if (_radio.broadcast(frame, length)) {
+        _stats.framesSent++;
+        _stats.messagesSent += count;
+        for (int i = 0; i < timeCount; i++) {
+            _sentSeq[_sentNext] = timeSeqs[i];
+            _sentUs[_sentNext] = sentUs;
+            _sentNext = (_sentNext + 1) % MESH_TIME_SENT_DEPTH;
+        }
+    }
+}
+
+void MeshLink::poll(uint32_t nowMs) {
+    _nowMs = nowMs;
+
+    uint8_t frame[MESH_FRAME_MAX];
+    uint64_t arrivalUs;
+    int length;
+    while ((length = _radio.receive(frame, sizeof(frame), &arrivalUs)) > 0) {
+        handleFrame(frame, length, arrivalUs);
+    }
+
+    // Token bucket: MESH_FRAMES_PER_S sustained, MESH_FRAME_BURST at once
+    _tokens += (nowMs - _lastRefillMs) * (MESH_FRAMES_PER_S / 1000.0f);
+    if (_tokens > MESH_FRAME_BURST) _tokens = MESH_FRAME_BURST;
+    _lastRefillMs = nowMs;
+
+    if (!flushDue()) return;
+    if (_tokens < 1.0f) {
+        if (!_held) _stats.rateLimited++;
+        _held = true;
+        return;
+    }
+    _tokens -= 1.0f;
+    _held = false;
+    flush();
+}
+
+#endif // MESH_LINK_H
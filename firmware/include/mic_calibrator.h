@@ -0,0 +1,250 @@
+/**
+ * VARTA - Mic Calibrator
+ * Estimates each mic's gain and capture delay relative to the array, so
+ * part-to-part sensitivity and port sealing stop showing up as bearing
+ * error.
+ *
+ * Each capture block is cut into MIC_CAL_SEGMENT-sample segments. The
+ * segments are Hann windowed and DFT'd at the bins between MIC_CAL_MIN_HZ
+ * and MIC_CAL_MAX_HZ. Per mic, the calibrator sums the power and the
+ * cross-spectrum against mic 1. A mic that captures late by d samples
+ * shows a cross-spectrum phase of w * d, so its delay is the weighted
+ * phase slope across the band. The band sits below the array's first
+ * spatial-coherence null, so the phase never wraps.
+ *
+ * Two sources:
+ * - Ambient: diffuse noise reaches every mic equally and has no mean
+ *   phase between them. Needs a spot with no dominant source; one would
+ *   show up as its own TDOA.
+ * - Tone: the buzzer plays a tone on one bin. Its position
+ *   (MIC_CAL_BUZZER_*) is known, so the spreading loss and path delay to
+ *   each mic are taken out before the offsets are solved.
+ *
+ * The results are relative to the array mean (gains average 1, delays
+ * average 0).
+ *
+ * Plain C++ (no Arduino dependency) so mismatched arrays can be simulated off-target.
+ */
+
+#ifndef MIC_CALIBRATOR_H
+#define MIC_CALIBRATOR_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+
+#define MIC_CAL_SEGMENT         256     // Analysis length (172 Hz bins at 44.1 kHz)
+#define MIC_CAL_MAX_BINS        16
+#define MIC_CAL_MIN_SEGMENTS    64      // Fewer and finish() refuses
+
+enum MicCalSource {
+    MIC_CAL_AMBIENT = 0,
+    MIC_CAL_TONE = 1
+};
+
+struct MicCalResult {
+    float gain[4];                          // Multiply capture by this
+    float delaySamples[4];                  // Mic captures this late
+    float coherence;                        // Mean magnitude-squared coherence with mic 1
+    int segments;
+};
+
+class MicCalibrator {
+public:
+    MicCalibrator();
+
+    /**
+     * Start a run. For MIC_CAL_TONE, `toneHz` is snapped to the nearest
+     * analysis bin; getToneHz() returns what the buzzer should play.
+     */
+    void begin(int sampleRate, MicCalSource source, float toneHz = 0.0f);
+
+    /**
+     * One capture block of the four mics, as captured (any trims applied)
+     */
+    void process(const float* const* mics, int numSamples);
+
+    /**
+     * Solve the offsets. False, with `result` untouched, if there weren't
+     * enough segments, coherence was below MIC_CAL_MIN_COHERENCE (wind,
+     * or a dead mic), or an offset is outside MIC_CAL_MAX_GAIN_RATIO /
+     * MIC_CAL_MAX_DELAY.
+     */
+    bool finish(MicCalResult* result);
+
+    float getToneHz() { return _firstBin * _binHz; }
+    int getSegments() { return _segments; }
+
+private:
+    int _sampleRate;
+    MicCalSource _source;
+    float _binHz;
+    int _firstBin;
+    int _bins;
+
+    float _window[MIC_CAL_SEGMENT];
+    float _cos[MIC_CAL_SEGMENT];
+    float _sin[MIC_CAL_SEGMENT];
+
+    // Sums over segments, per bin: power per mic, cross with mic 1
+    double _power[4][MIC_CAL_MAX_BINS];
+    double _crossRe[4][MIC_CAL_MAX_BINS];
+    double _crossIm[4][MIC_CAL_MAX_BINS];
+    int _segments;
+
+    void expectedPath(float* delaySamples, float* loss);
+};
+
+// Implementation
+
+MicCalibrator::MicCalibrator() :
+    _sampleRate(44100),
+    _source(MIC_CAL_AMBIENT),
+    _binHz(0),
+    _firstBin(0),
+    _bins(0),
+    _segments(0)
+{
+}
+
+void MicCalibrator::begin(int sampleRate, MicCalSource source, float toneHz) {
+    _sampleRate = sampleRate;
+    _source = source;
+    _binHz = (float)sampleRate / MIC_CAL_SEGMENT;
+
+    if (source == MIC_CAL_TONE) {
+        _firstBin = (int)(toneHz / _binHz + 0.5f);
+        if (_firstBin < 1) _firstBin = 1;
+        _bins = 1;
+    } else {
+        _firstBin = (int)ceilf(MIC_CAL_MIN_HZ / _binHz);
+        if (_firstBin < 1) _firstBin = 1;
+        _bins = (int)(MIC_CAL_MAX_HZ / _binHz) - _firstBin + 1;
+        if (_bins > MIC_CAL_MAX_BINS) _bins = MIC_CAL_MAX_BINS;
+        if (_bins < 1) _bins = 1;
+    }
+
+    for (int i = 0; i < MIC_CAL_SEGMENT; i++) {
+        _window[i] = 0.5f * (1.0f - cosf(2.0f * (float)M_PI * i / MIC_CAL_SEGMENT));
+        _cos[i] = cosf(2.0f * (float)M_PI * i / MIC_CAL_SEGMENT);
+        _sin[i] = sinf(2.0f * (float)M_PI * i / MIC_CAL_SEGMENT);
+    }
+
+    memset(_power, 0, sizeof(_power));
+    memset(_crossRe, 0, sizeof(_crossRe));
+    memset(_crossIm, 0, sizeof(_crossIm));
+    _segments = 0;
+}
+
+void MicCalibrator::process(const float* const* mics, int numSamples) {
+    for (int start = 0; start + MIC_CAL_SEGMENT <= numSamples; start += MIC_CAL_SEGMENT) {
+        for (int b = 0; b < _bins; b++) {
+            int k = _firstBin + b;
+            float re[4];
+            float im[4];
+            for (int ch = 0; ch < 4; ch++) {
+                const float* x = mics[ch] + start;
+                float sumRe = 0.0f;
+                float sumIm = 0.0f;
+                int phase = 0;
+                for (int i = 0; i < MIC_CAL_SEGMENT; i++) {
+                    float v = x[i] * _window[i];
+                    sumRe += v * _cos[phase];
+                    sumIm -= v * _sin[phase];
+                    phase = (phase + k) & (MIC_CAL_SEGMENT - 1);
+                }
+                re[ch] = sumRe;
+                im[ch] = sumIm;
+                _power[ch][b] += (double)sumRe * sumRe + (double)sumIm * sumIm;
+            }
+            // X_1 conj(X_ch): phase w * (delay_ch - delay_1)
+            for (int ch = 0; ch < 4; ch++) {
+                _crossRe[ch][b] += (double)re[0] * re[ch] + (double)im[0] * im[ch];
+                _crossIm[ch][b] += (double)im[0] * re[ch] - (double)re[0] * im[ch];
+            }
+        }
+        _segments++;
+    }
+}
+
+void MicCalibrator::expectedPath(float* delaySamples, float* loss) {
+    // Mic positions (mm) about the array centre, M1 front left, clockwise
+    const float h = MIC_SPACING_MM / 2.0f;
+    const float micX[4] = { -h, h, h, -h };
+    const float micY[4] = { h, h, -h, -h };
+
+    for (int ch = 0; ch < 4; ch++) {
+        if (_source != MIC_CAL_TONE) {
+            delaySamples[ch] = 0.0f;
+            loss[ch] = 1.0f;
+            continue;
+        }
+        float dx = MIC_CAL_BUZZER_X_MM - micX[ch];
+        float dy = MIC_CAL_BUZZER_Y_MM - micY[ch];
+        float distanceMm = sqrtf(dx * dx + dy * dy);
+        delaySamples[ch] = distanceMm / 1000.0f / SPEED_OF_SOUND * _sampleRate;
+        loss[ch] = 1.0f / (distanceMm > 1.0f ? distanceMm : 1.0f);     // Amplitude, 1/r
+    }
+}
+
+bool MicCalibrator::finish(MicCalResult* result) {
+    if (_segments < MIC_CAL_MIN_SEGMENTS) return false;
+
+    float pathDelay[4];
+    float pathLoss[4];
+    expectedPath(pathDelay, pathLoss);
+
+    float gain[4];
+    float delay[4];
+    float coherence = 0.0f;
+
+    for (int ch = 0; ch < 4; ch++) {
+        double power = 0.0;
+        double slopeNum = 0.0;
+        double slopeDen = 0.0;
+        for (int b = 0; b < _bins; b++) {
+            power += _power[ch][b];
+
+            // Least-squares phase slope through the origin, each bin
+            // weighted by its cross-spectrum magnitude
+            double w = 2.0 * M_PI * (_firstBin + b) / MIC_CAL_SEGMENT;
+            double magnitude = sqrt(_crossRe[ch][b] * _crossRe[ch][b] + _crossIm[ch][b] * _crossIm[ch][b]);
+            double phase = atan2(_crossIm[ch][b], _crossRe[ch][b]);
+            slopeNum += magnitude * w * phase;
+            slopeDen += magnitude * w * w;
+
+            if (ch > 0) {
+                double denom = _power[0][b] * _power[ch][b];
+                coherence += denom > 0.0 ? (float)(magnitude * magnitude / denom) : 0.0f;
+            }
+        }
+        if (power <= 0.0 || slopeDen <= 0.0) return false;
+
+        float amplitude = sqrtf((float)(power / (_segments * _bins)));
+        gain[ch] = pathLoss[ch] / amplitude;
+        delay[ch] = (float)(slopeNum / slopeDen) - (pathDelay[ch] - pathDelay[0]);
+    }
+    coherence /= 3 * _bins;
+    if (coherence < MIC_CAL_MIN_COHERENCE) return false;
+
+    // Relative to the array mean
+    float gainMean = (gain[0] + gain[1] + gain[2] + gain[3]) / 4.0f;
+    float delayMean = (delay[0] + delay[1] + delay[2] + delay[3]) / 4.0f;
+    for (int ch = 0; ch < 4; ch++) {
+        gain[ch] /= gainMean;
+        delay[ch] -= delayMean;
+        if (gain[ch] > MIC_CAL_MAX_GAIN_RATIO || gain[ch] < 1.0f / MIC_CAL_MAX_GAIN_RATIO ||
+            fabsf(delay[ch]) > MIC_CAL_MAX_DELAY) {
+            return false;
+        }
+    }
+
+    memcpy(result->gain, gain, sizeof(gain));
+    memcpy(result->delaySamples, delay, sizeof(delay));
+    result->coherence = coherence;
+    result->segments = _segments;
+    return true;
+}
+
+#endif // MIC_CALIBRATOR_H
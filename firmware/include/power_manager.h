@@ -0,0 +1,218 @@
+/**
+ * VARTA - Power Manager
+ * Dynamic frequency scaling around the per-hop DSP burst.
+ * PM locks keep the CPU at the governed maximum only while a burst runs;
+ * between bursts the core drops to CPU_FREQ_MIN_MHZ while blocked on I2S.
+ * There is no light sleep: capture never stops, and the I2S driver holds
+ * its own no-light-sleep lock from i2s_start for its APLL clock.
+ *
+ * The energy model is fed from the profiler's stage totals: hop time is
+ * active at the governed clock, capture time is idle, and the rest of the
+ * loop runs at the minimum clock. With PROFILER_ENABLED false there are
+ * no stage totals and everything counts at the minimum clock.
+ */
+
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <esp_pm.h>
+#include "config.h"
+#include "energy_model.h"
+#include "profiler.h"
+
+#define PM_UTIL_ALPHA           0.05f   // Utilization smoothing per hop
+#define PM_GOVERNOR_HOLD_HOPS   64      // Minimum hops between frequency changes
+
+class PowerManager {
+public:
+    PowerManager();
+
+    void begin(int hopSize, int sampleRate);
+
+    // Bracket the DSP + inference work of one hop
+    void beginBurst();
+    void endBurst();
+
+    /**
+     * Call after each i2s_read: books the time since the last call
+     */
+    void endCapture();
+
+    /**
+     * Pin the clock to CPU_FREQ_MIN_MHZ while only the wake detector runs
+     */
+    void setStandby(bool standby);
+
+    int getCpuMhz() { return _cpuMhz; }
+    float getUtilization() { return _utilization; }
+    EnergyModel& getEnergyModel() { return _energy; }
+
+    void printReport(float packVoltage);
+
+private:
+    bool _pmAvailable;
+    esp_pm_lock_handle_t _cpuLock;
+
+    uint32_t _hopUs;
+    int _cpuMhz;
+    float _utilization;
+    int _hopsSinceChange;
+    bool _standby;
+
+    unsigned long _burstStart;
+    unsigned long _lastAccount;
+    uint64_t _hopTotalUs;                   // Profiler totals at _lastAccount
+    uint64_t _captureTotalUs;
+
+    EnergyModel _energy;
+
+    void applyFrequency(int mhz);
+    void govern();
+    void account();
+};
+
+// Implementation
+
+PowerManager::PowerManager() :
+    _pmAvailable(false),
+    _cpuLock(nullptr),
+    _hopUs(11610),
+    _cpuMhz(CPU_FREQ_MHZ),
+    _utilization(0.0f),
+    _hopsSinceChange(0),
+    _standby(false),
+    _burstStart(0),
+    _lastAccount(0),
+    _hopTotalUs(0),
+    _captureTotalUs(0)
+{
+}
+
+void PowerManager::begin(int hopSize, int sampleRate) {
+    _hopUs = (uint32_t)((uint64_t)hopSize * 1000000 / sampleRate);
+    _cpuMhz = CPU_FREQ_MHZ;
+
+#if PM_ENABLED
+    // Needs CONFIG_PM_ENABLE in the core's sdkconfig; otherwise fall back
+    // to switching the CPU clock directly from the governor
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "dsp", &_cpuLock) == ESP_OK) {
+        _pmAvailable = true;
+    }
+#endif
+
+    applyFrequency(_cpuMhz);
+    _lastAccount = micros();
+    _hopTotalUs = Profiler::instance().getTotalUs(STAGE_HOP);
+    _captureTotalUs = Profiler::instance().getTotalUs(STAGE_CAPTURE);
+
+    Serial.printf("PowerManager initialized: %s, %d MHz, hop=%luus\n",
+                  _pmAvailable ? "DFS" : "fixed clock", _cpuMhz, (unsigned long)_hopUs);
+}
+
+void PowerManager::applyFrequency(int mhz) {
+#if PM_ENABLED
+    if (_pmAvailable) {
+        esp_pm_config_esp32s3_t config = {};
+        config.max_freq_mhz = mhz;
+        config.min_freq_mhz = CPU_FREQ_MIN_MHZ;
+        config.light_sleep_enable = false;  // Blocked by the I2S driver anyway
+        if (esp_pm_configure(&config) == ESP_OK) {
+            _cpuMhz = mhz;
+            return;
+        }
+        _pmAvailable = false;
+    }
+#endif
+    setCpuFrequencyMhz(mhz);
+    _cpuMhz = mhz;
+}
+
+void PowerManager::endCapture() {
+    account();
+}
+
+void PowerManager::account() {
+    // Totals lag by the scopes still open (this capture, the current
+    // hop); only the differences matter, so the lag washes out
+    Profiler& profiler = Profiler::instance();
+    uint64_t hopTotal = profiler.getTotalUs(STAGE_HOP);
+    uint64_t captureTotal = profiler.getTotalUs(STAGE_CAPTURE);
+    unsigned long now = micros();
+    uint32_t wall = now - _lastAccount;
+
+    if (hopTotal >= _hopTotalUs && captureTotal >= _captureTotalUs) {
+        uint32_t active = (uint32_t)(hopTotal - _hopTotalUs);
+        uint32_t idle = (uint32_t)(captureTotal - _captureTotalUs);
+        if (active > wall) active = wall;
+        if (idle > wall - active) idle = wall - active;
+
+        _energy.addActive(_cpuMhz, active);
+        _energy.addIdle(idle);
+        _energy.addActive(_pmAvailable ? CPU_FREQ_MIN_MHZ : _cpuMhz, wall - active - idle);
+    }
+    // else the profiler was reset ('r'); start over from its new totals
+
+    _hopTotalUs = hopTotal;
+    _captureTotalUs = captureTotal;
+    _lastAccount = now;
+}
+
+void PowerManager::setStandby(bool standby) {
+    if (standby == _standby) return;
+    _standby = standby;
+
+    // Resume at full clock; the governor steps down again if there is headroom
+    applyFrequency(standby ? CPU_FREQ_MIN_MHZ : CPU_FREQ_MHZ);
+    _hopsSinceChange = 0;
+}
+
+void PowerManager::beginBurst() {
+    if (_pmAvailable) {
+        esp_pm_lock_acquire(_cpuLock);
+    }
+    _burstStart = micros();
+}
+
+void PowerManager::endBurst() {
+    unsigned long now = micros();
+    uint32_t busy = now - _burstStart;
+
+    if (_pmAvailable) {
+        esp_pm_lock_release(_cpuLock);
+    }
+
+    float util = (float)busy / _hopUs;
+    _utilization += PM_UTIL_ALPHA * (util - _utilization);
+    govern();
+}
+
+void PowerManager::govern() {
+    if (_standby || ++_hopsSinceChange < PM_GOVERNOR_HOLD_HOPS) return;
+
+    // Steps are 80/160/240 MHz - the PLL-derived S3 frequencies
+    int target = _cpuMhz;
+    if (_utilization > PM_UTIL_HIGH && _cpuMhz < CPU_FREQ_MHZ) {
+        target = min(_cpuMhz + 80, CPU_FREQ_MHZ);
+    } else if (_utilization < PM_UTIL_LOW && _cpuMhz > CPU_FREQ_MIN_MHZ) {
+        // Only step down if the burst would still fit below the high mark
+        float projected = _utilization * _cpuMhz / (_cpuMhz - 80);
+        if (projected < PM_UTIL_HIGH) {
+            target = max(_cpuMhz - 80, CPU_FREQ_MIN_MHZ);
+        }
+    }
+
+    if (target != _cpuMhz) {
+        applyFrequency(target);
+        _hopsSinceChange = 0;
+    }
+}
+
+void PowerManager::printReport(float packVoltage) {
+    Serial.printf("PM: %d MHz util=%.0f%% active=%.0f%% avg=%.0fmW est=%.1fh\n",
+                  _cpuMhz, _utilization * 100.0f, _energy.activeFraction() * 100.0f,
+                  _energy.averagePowerMw(),
+                  _energy.predictRuntimeHours(BATTERY_CAPACITY_MAH, packVoltage));
+}
+
+#endif // POWER_MANAGER_H
@@ -0,0 +1,239 @@
+/**
+ * VARTA - Stage Profiler
+ * Scoped per-stage timing with log-linear (HDR-style) latency histograms
+ * in fixed memory. Uses esp_timer on the ESP32-S3 (1 us, independent of
+ * the CPU clock, which the power governor changes mid-hop) and
+ * steady_clock on native builds. With PROFILER_ENABLED false the
+ * PROFILE_SCOPE macro compiles to nothing.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_timer.h>
+#else
+#include <chrono>
+#include <stdio.h>
+#endif
+
+// Histogram layout: 8 linear buckets, then 8 sub-buckets per octave
+// up to 2^20 us (~1 s) - about 12% resolution at any magnitude
+#define PROFILER_SUB_BITS       3
+#define PROFILER_SUB_BUCKETS    (1 << PROFILER_SUB_BITS)
+#define PROFILER_MAX_EXPONENT   20
+#define PROFILER_BUCKETS        (PROFILER_SUB_BUCKETS * (PROFILER_MAX_EXPONENT - PROFILER_SUB_BITS + 1))
+
+enum ProfileStage {
+    STAGE_CAPTURE,
+    STAGE_CONVERT,
+    STAGE_FFT,
+    STAGE_MEL,
+    STAGE_INFERENCE,
+    STAGE_DIRECTION,
+    STAGE_DISPLAY,
+    STAGE_LEDS,
+    STAGE_RECORD,       // Black box append
+    STAGE_HOP,          // Whole hop, capture excluded
+    STAGE_COUNT
+};
+
+struct StageSummary {
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint32_t meanUs;
+    uint32_t p50Us;
+    uint32_t p90Us;
+    uint32_t p99Us;
+};
+
+class Profiler {
+public:
+    static Profiler& instance();
+
+    // Raw timestamps in clock ticks (us on device, ns on native)
+    static uint32_t now();
+    static uint32_t ticksToUs(uint32_t ticks);
+
+    void record(ProfileStage stage, uint32_t us);
+    void reset();
+
+    void summarize(ProfileStage stage, StageSummary* out);
+
+    /**
+     * Time recorded against a stage since the last reset (us)
+     */
+    uint64_t getTotalUs(ProfileStage stage) { return _stages[stage].sumUs; }
+    static const char* stageName(ProfileStage stage);
+
+    /**
+     * Print a table of all stages (count, mean, p50/p90/p99, max in us)
+     */
+    void printReport();
+
+private:
+    struct Histogram {
+        uint32_t buckets[PROFILER_BUCKETS];
+        uint32_t count;
+        uint32_t minUs;
+        uint32_t maxUs;
+        uint64_t sumUs;
+    };
+
+    Histogram _stages[STAGE_COUNT];
+
+    Profiler();
+    static int bucketFor(uint32_t us);
+    static uint32_t bucketValue(int index);
+    static uint32_t percentile(const Histogram& h, float fraction);
+};
+
+/**
+ * Records the lifetime of the enclosing scope against a stage
+ */
+class ScopedProfile {
+public:
+    ScopedProfile(ProfileStage stage) : _stage(stage), _start(Profiler::now()) {}
+    ~ScopedProfile() {
+        Profiler::instance().record(_stage, Profiler::ticksToUs(Profiler::now() - _start));
+    }
+
+private:
+    ProfileStage _stage;
+    uint32_t _start;
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(stage) ScopedProfile PROFILE_CONCAT(_profile_, __LINE__)(stage)
+#else
+#define PROFILE_SCOPE(stage) do {} while (0)
+#endif
+
+// Implementation
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler() {
+    reset();
+}
+
+uint32_t Profiler::now() {
+#ifdef ARDUINO
+    return (uint32_t)esp_timer_get_time();
+#else
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+uint32_t Profiler::ticksToUs(uint32_t ticks) {
+#ifdef ARDUINO
+    return ticks;
+#else
+    return ticks / 1000;
+#endif
+}
+
+int Profiler::bucketFor(uint32_t us) {
+    if (us < PROFILER_SUB_BUCKETS) {
+        return us;
+    }
+    if (us >= (1UL << PROFILER_MAX_EXPONENT)) {
+        return PROFILER_BUCKETS - 1;
+    }
+
+    int exponent = 31 - __builtin_clz(us);
+    int sub = (us >> (exponent - PROFILER_SUB_BITS)) & (PROFILER_SUB_BUCKETS - 1);
+    return PROFILER_SUB_BUCKETS * (exponent - PROFILER_SUB_BITS + 1) + sub;
+}
+
+uint32_t Profiler::bucketValue(int index) {
+    if (index < PROFILER_SUB_BUCKETS) {
+        return index;
+    }
+
+    // Lower edge of the bucket
+    int exponent = index / PROFILER_SUB_BUCKETS - 1 + PROFILER_SUB_BITS;
+    int sub = index % PROFILER_SUB_BUCKETS;
+    return (uint32_t)(PROFILER_SUB_BUCKETS + sub) << (exponent - PROFILER_SUB_BITS);
+}
+
+void Profiler::record(ProfileStage stage, uint32_t us) {
+    Histogram& h = _stages[stage];
+    h.buckets[bucketFor(us)]++;
+    h.count++;
+    h.sumUs += us;
+    if (us < h.minUs) h.minUs = us;
+    if (us > h.maxUs) h.maxUs = us;
+}
+
+void Profiler::reset() {
+    memset(_stages, 0, sizeof(_stages));
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        _stages[i].minUs = UINT32_MAX;
+    }
+}
+
+uint32_t Profiler::percentile(const Histogram& h, float fraction) {
+    uint32_t target = (uint32_t)(h.count * fraction);
+    uint32_t seen = 0;
+    for (int i = 0; i < PROFILER_BUCKETS; i++) {
+        seen += h.buckets[i];
+        if (seen > target) {
+            return bucketValue(i);
+        }
+    }
+    return h.maxUs;
+}
+
+void Profiler::summarize(ProfileStage stage, StageSummary* out) {
+    const Histogram& h = _stages[stage];
+    out->count = h.count;
+    out->minUs = h.count ? h.minUs : 0;
+    out->maxUs = h.maxUs;
+    out->meanUs = h.count ? (uint32_t)(h.sumUs / h.count) : 0;
+    out->p50Us = percentile(h, 0.50f);
+    out->p90Us = percentile(h, 0.90f);
+    out->p99Us = percentile(h, 0.99f);
+}
+
+const char* Profiler::stageName(ProfileStage stage) {
+    static const char* names[STAGE_COUNT] = {
+        "capture", "convert", "fft", "mel", "inference",
+        "direction", "display", "leds", "record", "hop"
+    };
+    return names[stage];
+}
+
+void Profiler::printReport() {
+#ifdef ARDUINO
+    Serial.println("stage       count    mean     p50     p90     p99     max (us)");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        StageSummary s;
+        summarize((ProfileStage)i, &s);
+        Serial.printf("%-10s %6lu %7lu %7lu %7lu %7lu %7lu\n", stageName((ProfileStage)i),
+                      (unsigned long)s.count, (unsigned long)s.meanUs, (unsigned long)s.p50Us,
+                      (unsigned long)s.p90Us, (unsigned long)s.p99Us, (unsigned long)s.maxUs);
+    }
+#else
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        StageSummary s;
+        summarize((ProfileStage)i, &s);
+        printf("%-10s %6u %7u %7u %7u %7u %7u\n", stageName((ProfileStage)i),
+               s.count, s.meanUs, s.p50Us, s.p90Us, s.p99Us, s.maxUs);
+    }
+#endif
+}
+
+#endif // PROFILER_H
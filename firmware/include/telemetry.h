@@ -0,0 +1,277 @@
+/**
+ * VARTA - Telemetry
+ * Versioned binary messages, COBS-framed with a CRC16, queued into a TX
+ * ring and drained to USB CDC without blocking. Every frame is wrapped
+ * in 0x00 delimiters so stray text output stays separable on the host.
+ *
+ * Frame (before COBS): [version][type][seq:2][timestamp_ms:4][payload][crc16:2]
+ * All fields little-endian. Decoder: firmware/tools/telemetry_monitor.py
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "profiler.h"
+#include "audio_processor.h"
+#include "bearing_fusion.h"
+
+#define TELEMETRY_VERSION       1
+#define TELEMETRY_TX_BUFFER     8192    // Bytes queued for the CDC endpoint
+#define TELEMETRY_MAX_PAYLOAD   192
+
+enum TelemetryType {
+    TLM_HOP         = 0x01,     // Per-hop confidence, bearing, state
+    TLM_MEL_FRAME   = 0x02,     // Quantized mel frame
+    TLM_DIRECTION   = 0x03,     // Raw TDOAs behind a bearing estimate
+    TLM_PROFILE     = 0x04,     // One profiler stage summary
+    TLM_ALERT       = 0x05,     // Alert raised
+    TLM_LOG         = 0x06,     // Formatted log line
+    TLM_FIX         = 0x07,     // Fused multi-unit position
+    TLM_WIND        = 0x08      // Wind level changed
+};
+
+struct __attribute__((packed)) TelemetryHeader {
+    uint8_t version;
+    uint8_t type;
+    uint16_t seq;
+    uint32_t timestampMs;
+};
+
+struct __attribute__((packed)) TlmHop {
+    float confidence;
+    float bearing;
+    uint8_t state;
+    uint8_t detectionCount;
+};
+
+struct __attribute__((packed)) TlmDirection {
+    float tdoa[4];              // Samples: 1-2, 1-4, 3-2, 3-4
+    float correlation;
+    float azimuth;
+};
+
+struct __attribute__((packed)) TlmProfile {
+    uint8_t stage;
+    uint32_t count;
+    uint32_t meanUs;
+    uint32_t p50Us;
+    uint32_t p90Us;
+    uint32_t p99Us;
+    uint32_t maxUs;
+};
+
+struct __attribute__((packed)) TlmAlert {
+    float bearing;
+    float confidence;
+    uint8_t muted;
+};
+
+struct __attribute__((packed)) TlmFix {
+    float eastM;
+    float northM;
+    float majorM;
+    float minorM;
+    float axisDeg;
+    float residualDeg;
+    uint8_t nodes;
+};
+
+struct __attribute__((packed)) TlmWind {
+    float level;
+    float cutoffHz;
+    uint8_t maskedBins;
+    uint8_t gust;
+};
+
+class Telemetry {
+public:
+    Telemetry();
+
+    /**
+     * Queue one message. Never blocks; returns false (and counts a drop)
+     * if the ring has no room. Call from the loop task only.
+     */
+    bool send(TelemetryType type, const void* payload, int length);
+
+    void sendHop(float confidence, float bearing, uint8_t state, uint8_t detectionCount);
+    void sendMelFrame(const float* melFrame, int melBins);
+    void sendDirection(const float* tdoa, float correlation, float azimuth);
+    void sendProfile();
+    void sendAlert(float bearing, float confidence, bool muted);
+    void sendFix(const FusionFix& fix);
+    void sendWind(float level, float cutoffHz, int maskedBins, bool gust);
+    void sendLog(uint8_t level, const char* line);
+
+    /**
+     * Move as much queued data to the CDC endpoint as it will take right now
+     */
+    void pump();
+
+    uint32_t getDropped() { return _dropped; }
+
+private:
+    uint8_t _ring[TELEMETRY_TX_BUFFER];
+    int _head;
+    int _tail;
+    uint16_t _seq;
+    uint32_t _dropped;
+
+    int freeSpace();
+    void pushByte(uint8_t b);
+    static uint16_t crc16(const uint8_t* data, int length);
+};
+
+// Implementation
+
+Telemetry::Telemetry() :
+    _head(0),
+    _tail(0),
+    _seq(0),
+    _dropped(0)
+{
+}
+
+int Telemetry::freeSpace() {
+    return (_tail - _head - 1 + TELEMETRY_TX_BUFFER) % TELEMETRY_TX_BUFFER;
+}
+
+void Telemetry::pushByte(uint8_t b) {
+    _ring[_head] = b;
+    _head = (_head + 1) % TELEMETRY_TX_BUFFER;
+}
+
+uint16_t Telemetry::crc16(const uint8_t* data, int length) {
+    // CRC-16/CCITT-FALSE
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+bool Telemetry::send(TelemetryType type, const void* payload, int length) {
+    if (length > TELEMETRY_MAX_PAYLOAD) {
+        return false;
+    }
+
+    uint8_t raw[sizeof(TelemetryHeader) + TELEMETRY_MAX_PAYLOAD + 2];
+    TelemetryHeader header = { TELEMETRY_VERSION, (uint8_t)type, _seq, (uint32_t)millis() };
+    memcpy(raw, &header, sizeof(header));
+    memcpy(raw + sizeof(header), payload, length);
+    int rawLength = sizeof(header) + length;
+    uint16_t crc = crc16(raw, rawLength);
+    raw[rawLength++] = crc & 0xFF;
+    raw[rawLength++] = crc >> 8;
+
+    // COBS adds one byte per 254 plus the code byte; two delimiters around it
+    int worstCase = rawLength + rawLength / 254 + 1 + 2;
+    if (freeSpace() < worstCase) {
+        _dropped++;
+        return false;
+    }
+    _seq++;
+
+    pushByte(0x00);
+
+    // COBS encode straight into the ring, back-patching each code byte
+    int codeIndex = _head;
+    uint8_t code = 1;
+    pushByte(0);
+    for (int i = 0; i < rawLength; i++) {
+        if (raw[i] == 0) {
+            _ring[codeIndex] = code;
+            codeIndex = _head;
+            code = 1;
+            pushByte(0);
+        } else {
+            pushByte(raw[i]);
+            if (++code == 0xFF) {
+                _ring[codeIndex] = code;
+                codeIndex = _head;
+                code = 1;
+                pushByte(0);
+            }
+        }
+    }
+    _ring[codeIndex] = code;
+
+    pushByte(0x00);
+    return true;
+}
+
+void Telemetry::sendHop(float confidence, float bearing, uint8_t state, uint8_t detectionCount) {
+    TlmHop msg = { confidence, bearing, state, detectionCount };
+    send(TLM_HOP, &msg, sizeof(msg));
+}
+
+void Telemetry::sendMelFrame(const float* melFrame, int melBins) {
+    uint8_t quantized[TELEMETRY_MAX_PAYLOAD];
+    int bins = min(melBins, TELEMETRY_MAX_PAYLOAD);
+    for (int i = 0; i < bins; i++) {
+        quantized[i] = AudioProcessor::quantizeDb(melFrame[i]);
+    }
+    send(TLM_MEL_FRAME, quantized, bins);
+}
+
+void Telemetry::sendDirection(const float* tdoa, float correlation, float azimuth) {
+    TlmDirection msg;
+    memcpy(msg.tdoa, tdoa, sizeof(msg.tdoa));
+    msg.correlation = correlation;
+    msg.azimuth = azimuth;
+    send(TLM_DIRECTION, &msg, sizeof(msg));
+}
+
+void Telemetry::sendProfile() {
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        StageSummary s;
+        Profiler::instance().summarize((ProfileStage)i, &s);
+        TlmProfile msg = { (uint8_t)i, s.count, s.meanUs, s.p50Us, s.p90Us, s.p99Us, s.maxUs };
+        send(TLM_PROFILE, &msg, sizeof(msg));
+    }
+}
+
+void Telemetry::sendAlert(float bearing, float confidence, bool muted) {
+    TlmAlert msg = { bearing, confidence, (uint8_t)muted };
+    send(TLM_ALERT, &msg, sizeof(msg));
+}
+
+void Telemetry::sendFix(const FusionFix& fix) {
+    TlmFix msg = { fix.eastM, fix.northM, fix.majorM, fix.minorM, fix.axisDeg, fix.residualDeg,
+                   (uint8_t)fix.nodes };
+    send(TLM_FIX, &msg, sizeof(msg));
+}
+
+void Telemetry::sendWind(float level, float cutoffHz, int maskedBins, bool gust) {
+    TlmWind msg = { level, cutoffHz, (uint8_t)maskedBins, (uint8_t)gust };
+    send(TLM_WIND, &msg, sizeof(msg));
+}
+
+void Telemetry::sendLog(uint8_t level, const char* line) {
+    uint8_t msg[TELEMETRY_MAX_PAYLOAD];
+    int length = min((int)strlen(line), TELEMETRY_MAX_PAYLOAD - 1);
+    msg[0] = level;
+    memcpy(msg + 1, line, length);
+    send(TLM_LOG, msg, length + 1);
+}
+
+void Telemetry::pump() {
+    while (_tail != _head) {
+        int room = Serial.availableForWrite();
+        if (room <= 0) {
+            return;
+        }
+
+        // Contiguous run up to the ring end or the write index
+        int run = (_head > _tail) ? _head - _tail : TELEMETRY_TX_BUFFER - _tail;
+        run = min(run, room);
+        Serial.write(&_ring[_tail], run);
+        _tail = (_tail + run) % TELEMETRY_TX_BUFFER;
+    }
+}
+
+#endif // TELEMETRY_H
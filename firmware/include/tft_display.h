@@ -0,0 +1,252 @@
+/**
+ * VARTA - TFT Display
+ * Minimal ILI9341 driver for streaming scroll lines over SPI DMA.
+ * Lines are queued to the SPI driver and never waited on.
+ */
+
+#ifndef TFT_DISPLAY_H
+#define TFT_DISPLAY_H
+
+#include <Arduino.h>
+#include <driver/spi_master.h>
+#include <driver/gpio.h>
+#include "config.h"
+#include "memory_pools.h"
+
+#define TFT_WIDTH           240     // Portrait orientation
+#define TFT_HEIGHT          320     // Hardware scroll axis
+#define TFT_SPI_HOST        SPI2_HOST
+#define TFT_SPI_CLOCK_HZ    (40 * 1000 * 1000)
+#define TFT_TRANS_PER_LINE  8       // cmd/data pairs: CASET, PASET, RAMWR, VSCRSADD
+#define TFT_LINE_BUFFERS    2       // One line in flight while the next is filled
+
+// ILI9341 commands
+#define ILI9341_SWRESET     0x01
+#define ILI9341_SLPOUT      0x11
+#define ILI9341_DISPON      0x29
+#define ILI9341_CASET       0x2A
+#define ILI9341_PASET       0x2B
+#define ILI9341_RAMWR       0x2C
+#define ILI9341_VSCRDEF     0x33
+#define ILI9341_MADCTL      0x36
+#define ILI9341_VSCRSADD    0x37
+#define ILI9341_COLMOD      0x3A
+
+class TftDisplay {
+public:
+    TftDisplay();
+
+    bool begin();
+
+    /**
+     * Pointer to the next free line buffer (TFT_WIDTH RGB565 pixels,
+     * big-endian), or nullptr if the previous lines are still in flight
+     */
+    uint16_t* acquireLine();
+
+    /**
+     * Queue the acquired line at the bottom of the screen and scroll
+     * everything up by one pixel
+     */
+    void pushLine();
+
+    /**
+     * Blank the screen and reset the scroll offset (blocking - not for the hop path)
+     */
+    void clear();
+
+private:
+    spi_device_handle_t _spi;
+    spi_transaction_t _trans[TFT_LINE_BUFFERS][TFT_TRANS_PER_LINE];
+    uint16_t* _lines[TFT_LINE_BUFFERS];
+    int _inFlight;
+    int _nextBuffer;
+    int _head;              // Frame memory row receiving the next line
+    bool _ready;
+
+    void reap();
+    void sendCommand(uint8_t cmd, const uint8_t* data, int len);
+    void setupTransaction(spi_transaction_t* t, bool isData, const uint8_t* bytes, int len);
+    static void IRAM_ATTR preTransfer(spi_transaction_t* t);
+};
+
+// Implementation
+
+TftDisplay::TftDisplay() :
+    _spi(nullptr),
+    _inFlight(0),
+    _nextBuffer(0),
+    _head(0),
+    _ready(false)
+{
+    memset(_trans, 0, sizeof(_trans));
+    memset(_lines, 0, sizeof(_lines));
+}
+
+void IRAM_ATTR TftDisplay::preTransfer(spi_transaction_t* t) {
+    // D/C line selects command (0) or data (1)
+    gpio_set_level((gpio_num_t)TFT_DC_PIN, (int)(intptr_t)t->user);
+}
+
+bool TftDisplay::begin() {
+    pinMode(TFT_DC_PIN, OUTPUT);
+    pinMode(TFT_RST_PIN, OUTPUT);
+
+    spi_bus_config_t bus = {};
+    bus.mosi_io_num = TFT_MOSI_PIN;
+    bus.miso_io_num = -1;
+    bus.sclk_io_num = TFT_SCK_PIN;
+    bus.quadwp_io_num = -1;
+    bus.quadhd_io_num = -1;
+    bus.max_transfer_sz = TFT_WIDTH * sizeof(uint16_t);
+
+    spi_device_interface_config_t dev = {};
+    dev.clock_speed_hz = TFT_SPI_CLOCK_HZ;
+    dev.mode = 0;
+    dev.spics_io_num = TFT_CS_PIN;
+    dev.queue_size = TFT_TRANS_PER_LINE * TFT_LINE_BUFFERS;
+    dev.pre_cb = preTransfer;
+
+    if (spi_bus_initialize(TFT_SPI_HOST, &bus, SPI_DMA_CH_AUTO) != ESP_OK ||
+        spi_bus_add_device(TFT_SPI_HOST, &dev, &_spi) != ESP_OK) {
+        Serial.println("TFT SPI init failed");
+        return false;
+    }
+
+    for (int i = 0; i < TFT_LINE_BUFFERS; i++) {
+        _lines[i] = (uint16_t*)MemoryPools::instance().allocate("tft line",
+                                                                TFT_WIDTH * sizeof(uint16_t),
+                                                                PLACE_TFT_LINES);
+        if (_lines[i] == nullptr) {
+            Serial.println("TFT line buffer allocation failed");
+            return false;
+        }
+    }
+
+    // Hardware reset
+    digitalWrite(TFT_RST_PIN, LOW);
+    delay(10);
+    digitalWrite(TFT_RST_PIN, HIGH);
+    delay(120);
+
+    sendCommand(ILI9341_SWRESET, nullptr, 0);
+    delay(120);
+    sendCommand(ILI9341_SLPOUT, nullptr, 0);
+    delay(120);
+
+    const uint8_t colmod = 0x55;            // 16 bits per pixel
+    const uint8_t madctl = 0x48;            // Portrait, BGR
+    const uint8_t vscrdef[] = {             // Whole height scrolls
+        0, 0, TFT_HEIGHT >> 8, TFT_HEIGHT & 0xFF, 0, 0
+    };
+    sendCommand(ILI9341_COLMOD, &colmod, 1);
+    sendCommand(ILI9341_MADCTL, &madctl, 1);
+    sendCommand(ILI9341_VSCRDEF, vscrdef, sizeof(vscrdef));
+    sendCommand(ILI9341_DISPON, nullptr, 0);
+
+    _ready = true;
+    clear();
+
+    Serial.println("TFT initialized");
+    return true;
+}
+
+void TftDisplay::sendCommand(uint8_t cmd, const uint8_t* data, int len) {
+    spi_transaction_t t;
+    setupTransaction(&t, false, &cmd, 1);
+    spi_device_polling_transmit(_spi, &t);
+
+    if (len > 0) {
+        setupTransaction(&t, true, data, len);
+        spi_device_polling_transmit(_spi, &t);
+    }
+}
+
+void TftDisplay::setupTransaction(spi_transaction_t* t, bool isData, const uint8_t* bytes, int len) {
+    memset(t, 0, sizeof(*t));
+    t->length = len * 8;
+    t->user = (void*)(intptr_t)(isData ? 1 : 0);
+    if (len <= 4) {
+        t->flags = SPI_TRANS_USE_TXDATA;
+        memcpy(t->tx_data, bytes, len);
+    } else {
+        t->tx_buffer = bytes;
+    }
+}
+
+void TftDisplay::clear() {
+    if (!_ready) return;
+
+    // Drain queued lines before switching to polling transfers
+    while (_inFlight > 0) {
+        spi_transaction_t* done;
+        spi_device_get_trans_result(_spi, &done, portMAX_DELAY);
+        _inFlight--;
+    }
+
+    memset(_lines[0], 0, TFT_WIDTH * sizeof(uint16_t));
+    const uint8_t caset[] = { 0, 0, (TFT_WIDTH - 1) >> 8, (TFT_WIDTH - 1) & 0xFF };
+    for (int row = 0; row < TFT_HEIGHT; row++) {
+        const uint8_t paset[] = { (uint8_t)(row >> 8), (uint8_t)row, (uint8_t)(row >> 8), (uint8_t)row };
+        sendCommand(ILI9341_CASET, caset, sizeof(caset));
+        sendCommand(ILI9341_PASET, paset, sizeof(paset));
+        sendCommand(ILI9341_RAMWR, (const uint8_t*)_lines[0], TFT_WIDTH * sizeof(uint16_t));
+    }
+
+    const uint8_t vscrsadd[] = { 0, 0 };
+    sendCommand(ILI9341_VSCRSADD, vscrsadd, sizeof(vscrsadd));
+    _head = 0;
+}
+
+void TftDisplay::reap() {
+    spi_transaction_t* done;
+    while (_inFlight > 0 && spi_device_get_trans_result(_spi, &done, 0) == ESP_OK) {
+        _inFlight--;
+    }
+}
+
+uint16_t* TftDisplay::acquireLine() {
+    if (!_ready) return nullptr;
+
+    reap();
+
+    // The buffer we are about to hand out belongs to the line queued two
+    // pushes ago; it is free once at most one line is still queued
+    if (_inFlight > TFT_TRANS_PER_LINE * (TFT_LINE_BUFFERS - 1)) {
+        return nullptr;
+    }
+    return _lines[_nextBuffer];
+}
+
+void TftDisplay::pushLine() {
+    spi_transaction_t* t = _trans[_nextBuffer];
+
+    int row = _head;
+    int scroll = (_head + 1) % TFT_HEIGHT;  // Newest line ends up at the bottom
+
+    const uint8_t caset[] = { 0, 0, (TFT_WIDTH - 1) >> 8, (TFT_WIDTH - 1) & 0xFF };
+    const uint8_t paset[] = { (uint8_t)(row >> 8), (uint8_t)row, (uint8_t)(row >> 8), (uint8_t)row };
+    const uint8_t vscrsadd[] = { (uint8_t)(scroll >> 8), (uint8_t)scroll };
+    const uint8_t cmds[] = { ILI9341_CASET, ILI9341_PASET, ILI9341_RAMWR, ILI9341_VSCRSADD };
+
+    setupTransaction(&t[0], false, &cmds[0], 1);
+    setupTransaction(&t[1], true, caset, sizeof(caset));
+    setupTransaction(&t[2], false, &cmds[1], 1);
+    setupTransaction(&t[3], true, paset, sizeof(paset));
+    setupTransaction(&t[4], false, &cmds[2], 1);
+    setupTransaction(&t[5], true, (const uint8_t*)_lines[_nextBuffer], TFT_WIDTH * sizeof(uint16_t));
+    setupTransaction(&t[6], false, &cmds[3], 1);
+    setupTransaction(&t[7], true, vscrsadd, sizeof(vscrsadd));
+
+    // Small payloads live in tx_data, so only the pixel buffer must outlive this call
+    for (int i = 0; i < TFT_TRANS_PER_LINE; i++) {
+        if (spi_device_queue_trans(_spi, &t[i], 0) == ESP_OK) {
+            _inFlight++;
+        }
+    }
+
+    _nextBuffer = (_nextBuffer + 1) % TFT_LINE_BUFFERS;
+    _head = scroll;
+}
+
+#endif // TFT_DISPLAY_H
@@ -0,0 +1,423 @@
+/**
+ * VARTA - Time Sync
+ * A shared timebase for the units on a mesh, so that bearings, cues and
+ * journal events from different units can be compared. PTP-lite over
+ * MeshLink: one unit (TIME_SYNC_MASTER_ID) is the clock, and the others
+ * keep a model of it.
+ *
+ * - The master broadcasts a SYNC every TIME_SYNC_INTERVAL_MS. Each SYNC
+ *   carries the send stamp of the previous one, because a frame's send
+ *   time is only known once it is out (two-step, follow-up folded in).
+ * - Each other unit pairs those send stamps with its own arrival stamps.
+ *   It fits master = a + rate * local over the recent pairs; the slope
+ *   is the drift. Pairs far off the fit are rejected, and a run of them
+ *   (the master restarted) starts the fit again.
+ * - Every TIME_SYNC_DELAY_EVERY syncs, a unit times a DELAY_REQ /
+ *   DELAY_RESP round trip against the fit to get the one-way path delay.
+ *   The median of the recent measurements is used, so a reply that sat
+ *   in a queue does not skew it.
+ * - SampleClock maps I2S sample indices onto the local clock, so any
+ *   sample, and so any hop, gets a mesh-time stamp.
+ *
+ * Mesh time is the master's esp_timer, in microseconds since its boot.
+ * Only units in radio range of the master sync; the rest keep local time
+ * and say so through isSynced().
+ *
+ * Portable (no Arduino): a host drives it with MemoryAir and skewed
+ * MemoryRadio clocks.
+ */
+
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+#include "mesh_link.h"
+
+#define TIME_SYNC_FIT_POINTS    32      // Sync pairs in the clock fit
+#define TIME_SYNC_MIN_POINTS    4       // Before the fit is trusted
+#define TIME_SYNC_OUTLIER_US    2000    // Pair rejected this far off the fit
+#define TIME_SYNC_MAX_REJECTS   3       // Rejects in a row before refitting from scratch
+#define TIME_SYNC_ARRIVALS      4       // SYNC arrivals awaiting their send stamp
+#define TIME_SYNC_DELAY_SAMPLES 7       // Path delay: median of the last few round trips
+#define TIME_SYNC_HOLDOVER_MS   60000   // Synced this long after the last SYNC
+#define SAMPLE_CLOCK_MARKS      32      // Capture blocks in the sample clock's window
+
+enum TimeSyncKind {
+    TIME_SYNC_SYNC = 1,         // timeUs: send stamp of SYNC `ref`
+    TIME_SYNC_DELAY_REQ = 2,
+    TIME_SYNC_DELAY_RESP = 3    // timeUs: arrival stamp of `target`'s DELAY_REQ `ref`
+};
+
+struct TimeSyncStats {
+    uint32_t syncs;             // Pairs accepted into the fit
+    uint32_t outliers;
+    uint32_t resets;
+    uint32_t delayRequests;
+    uint32_t delayReplies;
+};
+
+/**
+ * Least-squares line ref = a + rate * local over the last
+ * TIME_SYNC_FIT_POINTS pairs, computed about the newest pair so the
+ * doubles only ever hold short spans.
+ */
+class ClockFit {
+public:
+    ClockFit() : _resets(0) { reset(); }
+
+    void reset();
+
+    /**
+     * False if the pair was rejected as an outlier
+     */
+    bool add(uint64_t localUs, uint64_t refUs);
+
+    int points() { return _count; }
+    uint32_t getResets() { return _resets; }
+    uint64_t toRef(uint64_t localUs);
+    uint64_t toLocal(uint64_t refUs);
+    float getDriftPpm() { return (float)((_rate - 1.0) * 1e6); }
+
+private:
+    uint64_t _local[TIME_SYNC_FIT_POINTS];
+    uint64_t _ref[TIME_SYNC_FIT_POINTS];
+    int _next;
+    int _count;
+    int _rejects;
+    uint32_t _resets;
+    uint64_t _anchorLocal;
+    uint64_t _anchorRef;
+    double _offset;             // Fit at the anchor, relative to _anchorRef
+    double _rate;
+
+    void refit();
+};
+
+/**
+ * Maps capture sample indices to the local microsecond clock. A block
+ * is stamped when the I2S driver hands it over, which is never before
+ * its last sample and sometimes well after (the loop was busy), so the
+ * earliest-looking stamp in the window wins. The I2S and CPU clocks
+ * share the crystal, so the rate is the nominal one. The driver's
+ * buffering adds a constant that is the same on every unit.
+ */
+class SampleClock {
+public:
+    explicit SampleClock(uint32_t sampleRate);
+
+    /**
+     * The block ending just before sample `endIndex` came out of the
+     * driver at localUs
+     */
+    void mark(uint64_t endIndex, uint64_t localUs);
+
+    bool isValid() { return _count > 0; }
+    uint64_t toLocalUs(uint64_t sampleIndex);
+
+private:
+    double _usPerSample;
+    int64_t _offsets[SAMPLE_CLOCK_MARKS];   // localUs - endIndex * _usPerSample
+    int _next;
+    int _count;
+    int64_t _offset;                        // Smallest in the window
+};
+
+class TimeSync {
+public:
+    TimeSync(MeshLink& link, uint8_t nodeId, uint8_t masterId);
+
+    /**
+     * Handle time messages from the link and send what is due. Call
+     * after MeshLink::poll(), every loop pass; localUs on the radio's clock.
+     */
+    void poll(uint64_t localUs);
+
+    bool isMaster() { return _nodeId == _masterId; }
+    bool isSynced(uint64_t localUs);
+
+    /**
+     * Local clock to mesh time and back. Until the first fit, mesh time
+     * is taken to be local time.
+     */
+    uint64_t toMeshUs(uint64_t localUs);
+    uint64_t toLocalUs(uint64_t meshUs);
+
+    float getDriftPpm() { return isMaster() ? 0.0f : _fit.getDriftPpm(); }
+    uint32_t getPathDelayUs() { return _pathDelayUs; }
+    const TimeSyncStats& getStats() { return _stats; }
+
+private:
+    MeshLink& _link;
+    uint8_t _nodeId;
+    uint8_t _masterId;
+    uint16_t _seq;
+
+    // Master
+    uint64_t _nextSyncUs;
+    uint16_t _lastSyncSeq;
+    bool _syncSent;
+
+    // Others
+    ClockFit _fit;
+    uint16_t _arrivalSeq[TIME_SYNC_ARRIVALS];
+    uint64_t _arrivalUs[TIME_SYNC_ARRIVALS];
+    int _arrivalNext;
+    uint64_t _lastSyncUs;
+    int _syncsToDelay;
+    bool _delayPending;
+    uint16_t _delaySeq;
+    uint64_t _delaySentUs;
+    int _delayAge;
+    uint32_t _delays[TIME_SYNC_DELAY_SAMPLES];
+    int _delayNext;
+    int _delayCount;
+    uint32_t _pathDelayUs;
+
+    TimeSyncStats _stats;
+
+    void send(uint8_t kind, uint8_t target, uint16_t ref, uint64_t timeUs);
+    void handleSync(const TimeMessage& message, uint64_t arrivalUs);
+    void handleDelayReply(const TimeMessage& message);
+};
+
+// Implementation
+
+void ClockFit::reset() {
+    _next = 0;
+    _count = 0;
+    _rejects = 0;
+    _anchorLocal = 0;
+    _anchorRef = 0;
+    _offset = 0.0;
+    _rate = 1.0;
+}
+
+bool ClockFit::add(uint64_t localUs, uint64_t refUs) {
+    if (_count >= TIME_SYNC_MIN_POINTS) {
+        int64_t error = (int64_t)(refUs - toRef(localUs));
+        if (error > TIME_SYNC_OUTLIER_US || error < -TIME_SYNC_OUTLIER_US) {
+            if (++_rejects < TIME_SYNC_MAX_REJECTS) return false;
+            reset();    // Consistently off: the reference itself moved
+            _resets++;
+        }
+    }
+    _rejects = 0;
+
+    _local[_next] = localUs;
+    _ref[_next] = refUs;
+    _next = (_next + 1) % TIME_SYNC_FIT_POINTS;
+    if (_count < TIME_SYNC_FIT_POINTS) _count++;
+    _anchorLocal = localUs;
+    _anchorRef = refUs;
+    refit();
+    return true;
+}
+
+void ClockFit::refit() {
+    double meanX = 0.0;
+    double meanY = 0.0;
+    for (int i = 0; i < _count; i++) {
+        meanX += (double)(int64_t)(_local[i] - _anchorLocal);
+        meanY += (double)(int64_t)(_ref[i] - _anchorRef);
+    }
+    meanX /= _count;
+    meanY /= _count;
+
+    double sxx = 0.0;
+    double sxy = 0.0;
+    for (int i = 0; i < _count; i++) {
+        double dx = (double)(int64_t)(_local[i] - _anchorLocal) - meanX;
+        double dy = (double)(int64_t)(_ref[i] - _anchorRef) - meanY;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+
+    // One pair, or pairs too close together to give a slope: offset only
+    _rate = sxx > 1e6 ? sxy / sxx : 1.0;
+    _offset = meanY - _rate * meanX;
+}
+
+uint64_t ClockFit::toRef(uint64_t localUs) {
+    double dx = (double)(int64_t)(localUs - _anchorLocal);
+    return _anchorRef + (int64_t)llround(_offset + _rate * dx);
+}
+
+uint64_t ClockFit::toLocal(uint64_t refUs) {
+    double dy = (double)(int64_t)(refUs - _anchorRef);
+    return _anchorLocal + (int64_t)llround((dy - _offset) / _rate);
+}
+
+SampleClock::SampleClock(uint32_t sampleRate) :
+    _usPerSample(1e6 / sampleRate),
+    _next(0),
+    _count(0),
+    _offset(0)
+{
+}
+
+void SampleClock::mark(uint64_t endIndex, uint64_t localUs) {
+    _offsets[_next] = (int64_t)localUs - llround(endIndex * _usPerSample);
+    _next = (_next + 1) % SAMPLE_CLOCK_MARKS;
+    if (_count < SAMPLE_CLOCK_MARKS) _count++;
+
+    _offset = _offsets[0];
+    for (int i = 1; i < _count; i++) {
+        if (_offsets[i] < _offset) _offset = _offsets[i];
+    }
+}
+
+uint64_t SampleClock::toLocalUs(uint64_t sampleIndex) {
+    return (uint64_t)(_offset + llround(sampleIndex * _usPerSample));
+}
+
+TimeSync::TimeSync(MeshLink& link, uint8_t nodeId, uint8_t masterId) :
+    _link(link),
+    _nodeId(nodeId),
+    _masterId(masterId),
+    _seq(0),
+    _nextSyncUs(0),
+    _lastSyncSeq(0),
+    _syncSent(false),
+    _arrivalNext(0),
+    _lastSyncUs(0),
+    _syncsToDelay(1 + nodeId % TIME_SYNC_DELAY_EVERY),    // Spread the requests over the syncs
+    _delayPending(false),
+    _delaySeq(0),
+    _delaySentUs(0),
+    _delayAge(0),
+    _delayNext(0),
+    _delayCount(0),
+    _pathDelayUs(0)
+{
+    memset(_arrivalSeq, 0, sizeof(_arrivalSeq));
+    memset(_arrivalUs, 0, sizeof(_arrivalUs));      // 0: empty
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void TimeSync::send(uint8_t kind, uint8_t target, uint16_t ref, uint64_t timeUs) {
+    TimeMessage m;
+    m.nodeId = _nodeId;
+    m.seq = _seq++;
+    m.kind = kind;
+    m.target = target;
+    m.ref = ref;
+    m.timeUs = timeUs;
+    _link.sendTime(m);
+}
+
+void TimeSync::poll(uint64_t localUs) {
+    TimeMessage message;
+    uint64_t arrivalUs;
+    while (_link.receiveTime(&message, &arrivalUs)) {
+        if (isMaster()) {
+            if (message.kind == TIME_SYNC_DELAY_REQ) {
+                send(TIME_SYNC_DELAY_RESP, message.nodeId, message.seq, arrivalUs);
+            }
+        } else if (message.nodeId == _masterId) {
+            if (message.kind == TIME_SYNC_SYNC) {
+                handleSync(message, arrivalUs);
+            } else if (message.kind == TIME_SYNC_DELAY_RESP && message.target == _nodeId) {
+                handleDelayReply(message);
+            }
+        }
+    }
+
+    if (isMaster()) {
+        if ((int64_t)(localUs - _nextSyncUs) < 0) return;
+        _nextSyncUs = localUs + (uint64_t)TIME_SYNC_INTERVAL_MS * 1000;
+
+        // Follow up the previous SYNC if it made it out
+        uint64_t sentUs = 0;
+        if (!_syncSent || !_link.timeSent(_lastSyncSeq, &sentUs)) sentUs = 0;
+        uint16_t ref = _lastSyncSeq;
+        _lastSyncSeq = _seq;
+        _syncSent = true;
+        send(TIME_SYNC_SYNC, 0, ref, sentUs);
+        return;
+    }
+
+    if (_delayPending && _delaySentUs == 0) {
+        _link.timeSent(_delaySeq, &_delaySentUs);
+    }
+}
+
+void TimeSync::handleSync(const TimeMessage& message, uint64_t arrivalUs) {
+    _arrivalSeq[_arrivalNext] = message.seq;
+    _arrivalUs[_arrivalNext] = arrivalUs;
+    _arrivalNext = (_arrivalNext + 1) % TIME_SYNC_ARRIVALS;
+
+    if (message.timeUs != 0) {
+        for (int i = 0; i < TIME_SYNC_ARRIVALS; i++) {
+            if (_arrivalUs[i] == 0 || _arrivalSeq[i] != message.ref) continue;
+            if (_fit.add(_arrivalUs[i], message.timeUs)) {
+                _stats.syncs++;
+                _lastSyncUs = arrivalUs;
+            } else {
+                _stats.outliers++;
+            }
+            _stats.resets = _fit.getResets();
+            break;
+        }
+    }
+
+    // A lost request or reply is given up after a round of syncs
+    if (_delayPending && ++_delayAge > TIME_SYNC_DELAY_EVERY) {
+        _delayPending = false;
+    }
+    if (!_delayPending && _fit.points() > 0 && --_syncsToDelay <= 0) {
+        _syncsToDelay = TIME_SYNC_DELAY_EVERY;
+        _delaySeq = _seq;
+        _delaySentUs = 0;
+        _delayAge = 0;
+        _delayPending = true;
+        _stats.delayRequests++;
+        send(TIME_SYNC_DELAY_REQ, _masterId, 0, 0);
+    }
+}
+
+void TimeSync::handleDelayReply(const TimeMessage& message) {
+    if (!_delayPending || message.ref != _delaySeq || _delaySentUs == 0) return;
+    _delayPending = false;
+    _stats.delayReplies++;
+
+    // The fit maps local time to master time minus the path delay d (it
+    // pairs send stamps with arrivals), and the reply stamps the request
+    // d after it left: arrival = fit(sent) + 2d
+    int64_t roundTrip = (int64_t)(message.timeUs - _fit.toRef(_delaySentUs));
+    uint32_t delay = roundTrip > 0 ? (uint32_t)(roundTrip / 2) : 0;
+
+    _delays[_delayNext] = delay;
+    _delayNext = (_delayNext + 1) % TIME_SYNC_DELAY_SAMPLES;
+    if (_delayCount < TIME_SYNC_DELAY_SAMPLES) _delayCount++;
+
+    uint32_t sorted[TIME_SYNC_DELAY_SAMPLES];
+    memcpy(sorted, _delays, _delayCount * sizeof(uint32_t));
+    for (int i = 1; i < _delayCount; i++) {
+        uint32_t v = sorted[i];
+        int j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+    }
+    _pathDelayUs = sorted[_delayCount / 2];
+}
+
+bool TimeSync::isSynced(uint64_t localUs) {
+    if (isMaster()) return true;
+    return _fit.points() >= TIME_SYNC_MIN_POINTS && _delayCount > 0 &&
+           localUs - _lastSyncUs < (uint64_t)TIME_SYNC_HOLDOVER_MS * 1000;
+}
+
+uint64_t TimeSync::toMeshUs(uint64_t localUs) {
+    if (isMaster() || _fit.points() == 0) return localUs;
+    return _fit.toRef(localUs) + _pathDelayUs;
+}
+
+uint64_t TimeSync::toLocalUs(uint64_t meshUs) {
+    if (isMaster() || _fit.points() == 0) return meshUs;
+    return _fit.toLocal(meshUs - _pathDelayUs);
+}
+
+#endif // TIME_SYNC_H
@@ -0,0 +1,253 @@
+/**
+ * VARTA - Wake Detector
+ * Tiny energy + harmonicity detector for standby mode. Runs on one mic,
+ * decimated, so the full FFT/CNN pipeline only wakes on a likely motor.
+ * Plain C++ (no Arduino dependency) so recordings can be replayed off-target.
+ */
+
+#ifndef WAKE_DETECTOR_H
+#define WAKE_DETECTOR_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "dsp_kernels.h"
+#include "fast_math.h"
+
+#define WAKE_DECIMATION         4       // 44.1 kHz -> 11.025 kHz
+#define WAKE_FRAME_SAMPLES      256     // Decimated samples per decision (~23 ms)
+#define WAKE_ENERGY_MARGIN_DB   9.0f    // Frame energy above tracked floor
+#define WAKE_HARMONIC_MIN       0.6f    // Normalized autocorrelation peak
+#define WAKE_FLOOR_ALPHA        0.02f   // Noise floor tracking per non-motor frame
+#define WAKE_HOLD_FRAMES        3       // Consecutive hits before triggering
+#define WAKE_HIGHPASS_HZ        100.0f  // Under the lowest motor fundamental, over most wind
+
+class WakeDetector {
+public:
+    struct Stats {
+        uint32_t frames;
+        uint32_t energyHits;
+        uint32_t harmonicHits;
+        uint32_t triggers;
+    };
+
+    WakeDetector();
+
+    void begin(int sampleRate, float minF0, float maxF0);
+    void reset();
+
+    /**
+     * Feed full-rate INMP441 samples (24-bit left-aligned in 32).
+     * Returns true when a wake trigger fires.
+     */
+    bool process(const int32_t* raw, int count);
+
+    float getNoiseFloorDb() { return _floorDb; }
+
+    /**
+     * Floor learned in an earlier session (0 = none). After reset() the
+     * floor primes from the first frame but no higher than one margin
+     * above the hint, so a drone already audible at that frame still
+     * triggers. A quieter first frame is taken as is.
+     */
+    void setFloorHint(float db) { _floorHintDb = db; }
+    const Stats& getStats() { return _stats; }
+
+private:
+    int _minLag;
+    int _maxLag;
+
+    // Decimator
+    int32_t _accum;
+    int _accumCount;
+
+    // Two one-pole high-passes
+    float _hpAlpha;
+    float _hpState[2];
+
+    float _frame[WAKE_FRAME_SAMPLES];
+    int _frameFill;
+
+    float _floorDb;
+    float _floorHintDb;
+    bool _floorPrimed;
+    int _hitFrames;
+    Stats _stats;
+
+    bool analyzeFrame();
+    float harmonicity();
+};
+
+// Implementation
+
+WakeDetector::WakeDetector() :
+    _minLag(2),
+    _maxLag(2),
+    _hpAlpha(0.05f),
+    _floorHintDb(0.0f)
+{
+    reset();
+}
+
+void WakeDetector::begin(int sampleRate, float minF0, float maxF0) {
+    float decimatedRate = (float)sampleRate / WAKE_DECIMATION;
+    _minLag = (int)(decimatedRate / maxF0);
+    _maxLag = (int)(decimatedRate / minF0 + 0.5f);
+    if (_maxLag > WAKE_FRAME_SAMPLES / 2) _maxLag = WAKE_FRAME_SAMPLES / 2;
+    if (_minLag < 2) _minLag = 2;
+    _hpAlpha = 1.0f - expf(-2.0f * (float)M_PI * WAKE_HIGHPASS_HZ / decimatedRate);
+    reset();
+}
+
+void WakeDetector::reset() {
+    _accum = 0;
+    _accumCount = 0;
+    _hpState[0] = 0.0f;
+    _hpState[1] = 0.0f;
+    _frameFill = 0;
+    _floorDb = 0.0f;
+    _floorPrimed = false;
+    _hitFrames = 0;
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+bool WakeDetector::process(const int32_t* raw, int count) {
+    bool triggered = false;
+
+    for (int i = 0; i < count; i++) {
+        // Boxcar decimation; 16-bit precision is plenty for detection
+        _accum += raw[i] >> 16;
+        if (++_accumCount < WAKE_DECIMATION) continue;
+
+        float x = (float)_accum / (WAKE_DECIMATION * 32768.0f);
+        _accum = 0;
+        _accumCount = 0;
+
+        // Wind is mostly below the motor band: strip it before both tests
+        _hpState[0] += _hpAlpha * (x - _hpState[0]);
+        x -= _hpState[0];
+        _hpState[1] += _hpAlpha * (x - _hpState[1]);
+        _frame[_frameFill++] = x - _hpState[1];
+
+        if (_frameFill == WAKE_FRAME_SAMPLES) {
+            _frameFill = 0;
+            if (analyzeFrame()) triggered = true;
+        }
+    }
+
+    return triggered;
+}
+
+bool WakeDetector::analyzeFrame() {
+    _stats.frames++;
+
+    float energy = DspKernels::energy(_frame, WAKE_FRAME_SAMPLES);
+    float db = FastMath::db10(energy / WAKE_FRAME_SAMPLES + 1e-12f);
+
+    if (!_floorPrimed) {
+        // A drone audible at the first frame lifts a hinted floor by one margin at most
+        _floorDb = (_floorHintDb != 0.0f) ? fminf(db, _floorHintDb + WAKE_ENERGY_MARGIN_DB) : db;
+        _floorPrimed = true;
+    }
+
+    // Autocorrelation only for frames over the floor. A motor never lifts
+    // the floor, so one closing in slowly still clears the margin;
+    // anything else does (wind included), following drops immediately.
+    float rise = db - _floorDb;
+    bool harmonic = rise > 0.0f && harmonicity() > WAKE_HARMONIC_MIN;
+    bool energyHit = rise > WAKE_ENERGY_MARGIN_DB;
+    if (energyHit) {
+        _stats.energyHits++;
+    }
+    if (!harmonic) {
+        _floorDb = (db < _floorDb) ? db : _floorDb + WAKE_FLOOR_ALPHA * (db - _floorDb);
+    }
+
+    bool harmonicHit = energyHit && harmonic;
+    if (harmonicHit) {
+        _stats.harmonicHits++;
+        _hitFrames++;
+    } else {
+        _hitFrames = 0;
+    }
+
+    if (_hitFrames >= WAKE_HOLD_FRAMES) {
+        _hitFrames = 0;
+        _stats.triggers++;
+        return true;
+    }
+    return false;
+}
+
+float WakeDetector::harmonicity() {
+    // Highest normalized autocorrelation peak over the motor fundamental
+    // lag range. Only local maxima count: wind is low-passed noise, whose
+    // autocorrelation is still high at short lags but only falls away.
+    float r0 = DspKernels::energy(_frame, WAKE_FRAME_SAMPLES);
+    if (r0 < 1e-12f) return 0.0f;
+
+    float best = 0.0f;
+    float before = 0.0f;
+    float at = 0.0f;
+    for (int lag = _minLag - 1; lag <= _maxLag + 1; lag++) {
+        float r = DspKernels::dot(_frame, _frame + lag, WAKE_FRAME_SAMPLES - lag);
+        // Compensate for the shrinking overlap
+        r *= (float)WAKE_FRAME_SAMPLES / (WAKE_FRAME_SAMPLES - lag);
+        if (lag > _minLag && at > before && at >= r && at > best) best = at;
+        before = at;
+        at = r;
+    }
+    return best / r0;
+}
+
+/**
+ * Ring of the most recent mic samples kept while in standby, so the
+ * spectrogram can be rebuilt from the audio that caused the wake.
+ */
+class PrerollBuffer {
+public:
+    PrerollBuffer() : _samples(nullptr), _capacity(0), _head(0), _count(0) {}
+
+    bool begin(int16_t* storage, int capacity) {
+        _samples = storage;
+        _capacity = capacity;
+        clear();
+        return _samples != nullptr;
+    }
+
+    void clear() {
+        _head = 0;
+        _count = 0;
+    }
+
+    void push(const int32_t* raw, int count) {
+        for (int i = 0; i < count; i++) {
+            _samples[_head] = (int16_t)(raw[i] >> 16);
+            _head = (_head + 1) % _capacity;
+        }
+        _count = (_count + count > _capacity) ? _capacity : _count + count;
+    }
+
+    int size() { return _count; }
+
+    /**
+     * Copy `count` samples starting `offset` samples after the oldest,
+     * normalized to [-1, 1] and scaled by `gain` (the capture trim)
+     */
+    void read(int offset, float* out, int count, float gain = 1.0f) {
+        int start = (_head - _count + offset + _capacity) % _capacity;
+        float scale = gain / 32768.0f;
+        for (int i = 0; i < count; i++) {
+            out[i] = _samples[(start + i) % _capacity] * scale;
+        }
+    }
+
+private:
+    int16_t* _samples;
+    int _capacity;
+    int _head;
+    int _count;
+};
+
+#endif // WAKE_DETECTOR_H
@@ -0,0 +1,177 @@
+/**
+ * VARTA - Waterfall Renderer
+ * Live mel spectrogram waterfall for STATE_MONITOR.
+ * Each hop draws one new line and scrolls the display in hardware,
+ * so the per-hop cost is a single LUT pass over the mel bins.
+ */
+
+#ifndef WATERFALL_RENDERER_H
+#define WATERFALL_RENDERER_H
+
+#include <Arduino.h>
+#include <Adafruit_SSD1306.h>
+#include "config.h"
+#include "display_manager.h"
+#include "audio_processor.h"
+
+#if TFT_ENABLED
+#include "tft_display.h"
+#endif
+
+#define WATERFALL_GAMMA         0.6f    // Lifts quiet bins on the 1-bit OLED
+
+class WaterfallRenderer {
+public:
+    WaterfallRenderer(Adafruit_SSD1306& display, DisplayManager& manager);
+
+    void begin();
+
+    /**
+     * Take over the screen(s) and reset the scroll position. Does
+     * nothing until the display manager is running (headless unit).
+     */
+    void start();
+
+    /**
+     * Restore the OLED for the dashboard
+     */
+    void stop();
+
+    /**
+     * Draw one mel frame (MEL_BINS dB values) as the newest line.
+     * Frequency runs left to right, time scrolls upward.
+     */
+    void pushFrame(const float* melFrame);
+
+    bool isActive() { return _active; }
+
+private:
+    Adafruit_SSD1306& _display;
+    DisplayManager& _manager;
+    bool _active;
+    int _head;                      // OLED RAM row receiving the next line
+
+    uint8_t _levelLut[256];         // Quantized dB -> OLED dither level (0-16)
+#if TFT_ENABLED
+    TftDisplay _tft;
+    uint16_t _paletteLut[256];      // Quantized dB -> RGB565 (byte-swapped for SPI)
+#endif
+
+    static const uint8_t _bayer[4][4];
+
+    void buildLuts();
+};
+
+// Implementation
+
+// 4x4 ordered dither thresholds
+const uint8_t WaterfallRenderer::_bayer[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 }
+};
+
+WaterfallRenderer::WaterfallRenderer(Adafruit_SSD1306& display, DisplayManager& manager) :
+    _display(display),
+    _manager(manager),
+    _active(false),
+    _head(0)
+{
+}
+
+void WaterfallRenderer::begin() {
+    buildLuts();
+
+#if TFT_ENABLED
+    _tft.begin();
+#endif
+}
+
+void WaterfallRenderer::buildLuts() {
+    for (int q = 0; q < 256; q++) {
+        float level = pow(q / 255.0f, WATERFALL_GAMMA);
+        _levelLut[q] = (uint8_t)(level * 16.0f + 0.5f);
+    }
+
+#if TFT_ENABLED
+    // Heat ramp: black -> blue -> magenta -> red -> yellow -> white
+    for (int q = 0; q < 256; q++) {
+        int seg = q / 51;
+        int t = (q % 51) * 5;
+        int r = 0, g = 0, b = 0;
+        switch (seg) {
+            case 0: b = t; break;
+            case 1: r = t; b = 255; break;
+            case 2: r = 255; b = 255 - t; break;
+            case 3: r = 255; g = t; break;
+            default: r = 255; g = 255; b = t; break;
+        }
+        uint16_t rgb565 = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+        _paletteLut[q] = (rgb565 >> 8) | (rgb565 << 8);
+    }
+#endif
+}
+
+void WaterfallRenderer::start() {
+    // Stay inactive, so pushFrame() never touches a missing frame buffer
+    if (!_manager.isReady()) return;
+
+    _head = 0;
+    _display.clearDisplay();
+    _manager.setStartLine(0);
+    _manager.flush();
+
+#if TFT_ENABLED
+    _tft.clear();
+#endif
+
+    _active = true;
+}
+
+void WaterfallRenderer::stop() {
+    if (!_active) return;
+
+    _active = false;
+    _display.clearDisplay();
+    _manager.setStartLine(0);
+    _manager.flush();
+}
+
+void WaterfallRenderer::pushFrame(const float* melFrame) {
+    if (!_active) return;
+
+    // OLED: one dithered row, then scroll so it lands on the bottom line
+    uint8_t* frame = _display.getBuffer();
+    int row = _head;
+    uint8_t* rowBytes = &frame[(row / 8) * OLED_WIDTH];
+    uint8_t mask = 1 << (row & 7);
+    const uint8_t* thresholds = _bayer[row & 3];
+
+    for (int x = 0; x < OLED_WIDTH; x++) {
+        uint8_t level = _levelLut[AudioProcessor::quantizeDb(melFrame[x * MEL_BINS / OLED_WIDTH])];
+        if (level > thresholds[x & 3]) {
+            rowBytes[x] |= mask;
+        } else {
+            rowBytes[x] &= ~mask;
+        }
+    }
+
+    _head = (_head + 1) % OLED_HEIGHT;
+    _manager.markDirty(0, row, OLED_WIDTH, 1);
+    _manager.commit();
+    _manager.setStartLine(_head);
+
+#if TFT_ENABLED
+    // TFT: drop the line rather than wait if the previous DMA is still running
+    uint16_t* line = _tft.acquireLine();
+    if (line != nullptr) {
+        for (int x = 0; x < TFT_WIDTH; x++) {
+            line[x] = _paletteLut[AudioProcessor::quantizeDb(melFrame[x * MEL_BINS / TFT_WIDTH])];
+        }
+        _tft.pushLine();
+    }
+#endif
+}
+
+#endif // WATERFALL_RENDERER_H
@@ -0,0 +1,261 @@
+/**
+ * VARTA - Wind Detector
+ * Flags wind noise from how little the mics agree at low frequencies.
+ * Sound below a few hundred hertz has a wavelength many times the
+ * array, so the diagonal mic pairs hear nearly the same thing
+ * (coherence near 1). Wind turbulence at the ports is local to each mic
+ * (coherence near 0).
+ *
+ * Per capture block, each channel is decimated to WIND_DECIMATION, Hann
+ * windowed, and DFT'd at the FFT bins below WIND_MAX_HZ. The decimated
+ * block has the same bin spacing as the main FFT, so a flagged bin maps
+ * straight onto the mel front end's bins. Auto- and cross-spectra of
+ * both diagonals are averaged over blocks. A bin is flagged when it is
+ * loud and incoherent, and the wind level is the incoherent share of the
+ * low-band power.
+ *
+ * The boxcar decimator lets some sound above the band alias in. That
+ * sound is coherent, so aliasing can only hide wind, not invent it.
+ *
+ * Plain C++ (no Arduino dependency) so recordings can be replayed off-target.
+ */
+
+#ifndef WIND_DETECTOR_H
+#define WIND_DETECTOR_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+
+#define WIND_DECIMATION         16      // Low band analysed at SAMPLE_RATE / 16
+#define WIND_BLOCK              (FFT_SIZE / WIND_DECIMATION)
+#define WIND_MAX_BINS           32      // Mask is one bit per FFT bin
+#define WIND_GUST_RELEASE       0.7f    // Gust ends below this share of WIND_GUST_LEVEL
+
+class WindDetector {
+public:
+    WindDetector();
+
+    void begin(int sampleRate);
+    void reset();
+
+    /**
+     * One capture block of the four mics (FFT_SIZE samples each)
+     */
+    void process(const float* const* mics, int numSamples);
+
+    /**
+     * Incoherent share of the low-band power, 0-1; 0 when the band is
+     * below WIND_MIN_DBFS
+     */
+    float getLevel() { return _level; }
+
+    /**
+     * Wind dominates the low band: not worth running inference on
+     */
+    bool isGust() { return _gust; }
+
+    /**
+     * Bit k set: FFT bin k is wind-dominated
+     */
+    uint32_t getMask() { return _mask; }
+
+    /**
+     * Upper edge of the highest flagged bin (Hz), 0 when none are
+     */
+    float getCutoffHz() { return _cutoffHz; }
+
+    /**
+     * High-pass `samples` in place at getCutoffHz(), so time-domain
+     * consumers (direction finding) skip the flagged band too. Starts
+     * from rest each block; the transient is a few ms at the lowest cutoff.
+     */
+    void suppress(float* samples, int numSamples);
+
+private:
+    int _bins;                              // Bins analysed, 1 .. _bins - 1 (DC skipped)
+    float _binHz;
+    float _minPower;                        // WIND_MIN_DBFS per bin, in DFT units
+
+    float _window[WIND_BLOCK];
+    float _cos[WIND_BLOCK];
+    float _sin[WIND_BLOCK];
+    float _low[4][WIND_BLOCK];
+
+    // Averaged spectra per bin: four autos, two diagonal crosses
+    float _auto[4][WIND_MAX_BINS];
+    float _crossRe[2][WIND_MAX_BINS];
+    float _crossIm[2][WIND_MAX_BINS];
+    bool _primed;
+
+    float _level;
+    bool _gust;
+    uint32_t _mask;
+    float _cutoffHz;
+
+    // suppress() biquad, designed for _cutoffHz
+    float _designedHz;
+    float _b0, _b1, _b2, _a1, _a2;
+
+    void design(float cutoffHz);
+};
+
+// Implementation
+
+WindDetector::WindDetector() :
+    _bins(0),
+    _binHz(0),
+    _minPower(0),
+    _primed(false),
+    _level(0),
+    _gust(false),
+    _mask(0),
+    _cutoffHz(0),
+    _designedHz(0),
+    _b0(1), _b1(0), _b2(0), _a1(0), _a2(0)
+{
+}
+
+void WindDetector::begin(int sampleRate) {
+    float lowRate = (float)sampleRate / WIND_DECIMATION;
+    _binHz = lowRate / WIND_BLOCK;
+    _bins = (int)(WIND_MAX_HZ / _binHz) + 1;
+    if (_bins > WIND_MAX_BINS) _bins = WIND_MAX_BINS;
+    if (_bins > WIND_BLOCK / 2) _bins = WIND_BLOCK / 2;
+
+    float windowSum = 0.0f;
+    for (int i = 0; i < WIND_BLOCK; i++) {
+        _window[i] = 0.5f * (1.0f - cosf(2.0f * (float)M_PI * i / WIND_BLOCK));
+        _cos[i] = cosf(2.0f * (float)M_PI * i / WIND_BLOCK);
+        _sin[i] = sinf(2.0f * (float)M_PI * i / WIND_BLOCK);
+        windowSum += _window[i];
+    }
+
+    // A full-scale sine on a bin reads |X|^2 = (windowSum / 2)^2
+    float fullScale = 0.25f * windowSum * windowSum;
+    _minPower = fullScale * powf(10.0f, WIND_MIN_DBFS / 10.0f);
+
+    reset();
+}
+
+void WindDetector::reset() {
+    memset(_auto, 0, sizeof(_auto));
+    memset(_crossRe, 0, sizeof(_crossRe));
+    memset(_crossIm, 0, sizeof(_crossIm));
+    _primed = false;
+    _level = 0.0f;
+    _gust = false;
+    _mask = 0;
+    _cutoffHz = 0.0f;
+}
+
+void WindDetector::process(const float* const* mics, int numSamples) {
+    if (_bins == 0) return;
+    int blocks = numSamples / WIND_DECIMATION;
+    if (blocks > WIND_BLOCK) blocks = WIND_BLOCK;
+
+    // Boxcar decimate and window
+    for (int ch = 0; ch < 4; ch++) {
+        const float* x = mics[ch];
+        for (int i = 0; i < blocks; i++) {
+            float sum = 0.0f;
+            for (int j = 0; j < WIND_DECIMATION; j++) sum += x[i * WIND_DECIMATION + j];
+            _low[ch][i] = sum * (_window[i] / WIND_DECIMATION);
+        }
+        for (int i = blocks; i < WIND_BLOCK; i++) _low[ch][i] = 0.0f;
+    }
+
+    // First block seeds the averages instead of blending with zeros
+    float alpha = _primed ? WIND_SMOOTHING : 1.0f;
+    _primed = true;
+
+    float totalPower = 0.0f;
+    float incoherentPower = 0.0f;
+    uint32_t mask = 0;
+    int highest = 0;
+
+    for (int k = 1; k < _bins; k++) {
+        float re[4];
+        float im[4];
+        for (int ch = 0; ch < 4; ch++) {
+            float sumRe = 0.0f;
+            float sumIm = 0.0f;
+            int phase = 0;
+            for (int i = 0; i < WIND_BLOCK; i++) {
+                sumRe += _low[ch][i] * _cos[phase];
+                sumIm -= _low[ch][i] * _sin[phase];
+                phase = (phase + k) & (WIND_BLOCK - 1);
+            }
+            re[ch] = sumRe;
+            im[ch] = sumIm;
+            float power = sumRe * sumRe + sumIm * sumIm;
+            _auto[ch][k] += alpha * (power - _auto[ch][k]);
+        }
+
+        // Diagonals M1-M3 and M2-M4: the widest spacing in the array
+        float coherence = 0.0f;
+        for (int pair = 0; pair < 2; pair++) {
+            int a = pair;
+            int b = pair + 2;
+            float cRe = re[a] * re[b] + im[a] * im[b];     // X_a conj(X_b)
+            float cIm = im[a] * re[b] - re[a] * im[b];
+            _crossRe[pair][k] += alpha * (cRe - _crossRe[pair][k]);
+            _crossIm[pair][k] += alpha * (cIm - _crossIm[pair][k]);
+
+            float denom = _auto[a][k] * _auto[b][k];
+            float cross = _crossRe[pair][k] * _crossRe[pair][k] + _crossIm[pair][k] * _crossIm[pair][k];
+            coherence += denom > 0.0f ? cross / denom : 1.0f;
+        }
+        coherence *= 0.5f;
+
+        float power = 0.25f * (_auto[0][k] + _auto[1][k] + _auto[2][k] + _auto[3][k]);
+        totalPower += power;
+        incoherentPower += power * (1.0f - coherence);
+        if (coherence < WIND_COHERENCE_MAX && power > _minPower) {
+            mask |= 1u << k;
+            highest = k;
+        }
+    }
+
+    _level = totalPower > _minPower * (_bins - 1) ? incoherentPower / totalPower : 0.0f;
+    if (_gust) {
+        _gust = _level > WIND_GUST_LEVEL * WIND_GUST_RELEASE;
+    } else {
+        _gust = _level > WIND_GUST_LEVEL;
+    }
+    _mask = mask;
+    _cutoffHz = mask ? (highest + 0.5f) * _binHz : 0.0f;
+}
+
+void WindDetector::design(float cutoffHz) {
+    // Butterworth high-pass (RBJ cookbook, Q = 1/sqrt(2)) at the full rate
+    float w0 = 2.0f * (float)M_PI * cutoffHz / (_binHz * WIND_BLOCK * WIND_DECIMATION);
+    float cw = cosf(w0);
+    float alpha = sinf(w0) * 0.70710678f;
+    float a0 = 1.0f + alpha;
+    _b0 = (1.0f + cw) * 0.5f / a0;
+    _b1 = -(1.0f + cw) / a0;
+    _b2 = _b0;
+    _a1 = -2.0f * cw / a0;
+    _a2 = (1.0f - alpha) / a0;
+    _designedHz = cutoffHz;
+}
+
+void WindDetector::suppress(float* samples, int numSamples) {
+    if (_cutoffHz <= 0.0f) return;
+    if (_cutoffHz != _designedHz) design(_cutoffHz);
+
+    float x1 = 0.0f, x2 = 0.0f, y1 = 0.0f, y2 = 0.0f;
+    for (int i = 0; i < numSamples; i++) {
+        float x = samples[i];
+        float y = _b0 * x + _b1 * x1 + _b2 * x2 - _a1 * y1 - _a2 * y2;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        samples[i] = y;
+    }
+}
+
+#endif // WIND_DETECTOR_H
@@ -10,10 +10,10 @@
 
 #include <Arduino.h>
 #include <driver/i2s.h>
+#include <esp_timer.h>
 #include <Wire.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
-#include <Adafruit_NeoPixel.h>
 #include <arduinoFFT.h>
 #include <TensorFlowLite_ESP32.h>
 #include "tensorflow/lite/micro/all_ops_resolver.h"
@@ -25,6 +25,28 @@
 #include "audio_processor.h"
 #include "direction_estimator.h"
 #include "alert_manager.h"
+#include "display_manager.h"
+#include "waterfall_renderer.h"
+#include "led_engine.h"
+#include "battery_monitor.h"
+#include "power_manager.h"
+#include "wake_detector.h"
+#include "wind_detector.h"
+#include "profiler.h"
+#include "telemetry.h"
+#include "logger.h"
+#include "blackbox.h"
+#include "bearing_fusion.h"
+#include "mesh_link.h"
+#include "espnow_radio.h"
+#include "time_sync.h"
+#include "event_journal.h"
+#include "calibration_store.h"
+#include "mic_calibrator.h"
+#include "boot_sequencer.h"
+#include "memory_pools.h"
+#include "dsp_arena.h"
+#include "crc.h"
 
 // =============================================================================
 // GLOBAL OBJECTS
@@ -32,21 +54,84 @@
 
 // Display
 Adafruit_SSD1306 display(OLED_WIDTH, OLED_HEIGHT, &Wire, -1);
+DisplayManager displayManager(display);
+WaterfallRenderer waterfall(display, displayManager);
 
 // LED Ring
-Adafruit_NeoPixel ledRing(LED_COUNT, LED_PIN, NEO_GRB + NEO_KHZ800);
+LedEngine ledEngine;
+
+// Power
+BatteryMonitor batteryMonitor;
+PowerManager powerManager;
+
+// Standby
+WakeDetector wakeDetector;
+PrerollBuffer preroll;
+unsigned long standbyEnterTime = 0;
+unsigned long lastWakeTime = 0;
+unsigned long standbyTotalMs = 0;
+
+// Calibration (noise floor, mic trims, wake floor), restored from NVS at boot
+CalibrationStore calibration;
+bool calibrationDirty = false;          // Saved from the next post-hop service point
+MicCalibrator micCalibrator;            // ~4.6 KB: too big for the loop stack; begin() resets it per run
+
+// Capture timebase: I2S sample count against esp_timer
+SampleClock sampleClock(SAMPLE_RATE);
+uint64_t capturedSamples = 0;
+uint64_t blockStartSample = 0;          // First sample of the block being processed
 
 // Audio Processing
 AudioProcessor audioProcessor;
 DirectionEstimator directionEstimator;
 AlertManager alertManager;
 
+#if WIND_ENABLED
+WindDetector windDetector;
+#endif
+
+#if TELEMETRY_ENABLED
+Telemetry telemetry;
+#endif
+
+#if BLACKBOX_ENABLED
+BlackBox blackBox;
+#endif
+
+#if MESH_ENABLED
+MeshLink meshLink(EspNowRadio::instance(), NODE_ID);
+#if TIME_SYNC_ENABLED
+TimeSync timeSync(meshLink, NODE_ID, TIME_SYNC_MASTER_ID);
+#endif
+#endif
+
+#if FUSION_ENABLED
+#if MESH_ENABLED
+BearingTransport& bearingLink = meshLink;
+#else
+// In-process stand-in when the unit is not networked
+LoopbackBus fusionBus;
+LoopbackTransport fusionLink(fusionBus, NODE_ID);
+BearingTransport& bearingLink = fusionLink;
+#endif
+BearingFusion fusion;
+uint16_t bearingSeq = 0;
+#endif
+
+#if JOURNAL_ENABLED
+EventJournal journal;
+JournalDetection journalEvent;          // Event in progress
+bool journalEventOpen = false;
+float journalBearingSin = 0.0f;         // Running sums for the circular mean
+float journalBearingCos = 0.0f;
+#endif
+
 // TensorFlow Lite
 const tflite::Model* model = nullptr;
 tflite::MicroInterpreter* interpreter = nullptr;
 TfLiteTensor* input = nullptr;
 TfLiteTensor* output = nullptr;
-uint8_t tensorArena[MODEL_ARENA_SIZE];
+uint8_t* tensorArena = nullptr;          // MODEL_ARENA_SIZE, PLACE_TENSOR_ARENA
 tflite::AllOpsResolver resolver;
 
 // State
@@ -57,6 +142,7 @@ enum SystemState {
     STATE_MONITOR,
     STATE_CALIBRATE,
     STATE_LOW_BATTERY,
+    STATE_STANDBY,
     STATE_ERROR
 };
 
@@ -69,27 +155,79 @@ unsigned long lastDetectionTime = 0;
 unsigned long lastAlertTime = 0;
 bool audioMuted = false;
 
-// Audio buffers
-float audioBuffer[4][FFT_SIZE];         // Per-microphone buffers
-float melSpectrogram[MEL_BINS * SPEC_TIME_FRAMES];
+// Audio buffers (DSP arena, persistent)
+float (*audioBuffer)[FFT_SIZE] = nullptr;   // Per-microphone buffers, [4][FFT_SIZE]
+float* melSpectrogram = nullptr;            // [SPEC_TIME_FRAMES][MEL_BINS]
 int spectrogramIndex = 0;
+int spectrogramFilled = 0;              // Frames of real audio, up to SPEC_TIME_FRAMES
+
+#if DSP_FIXED_POINT
+uint8_t* melQuantized = nullptr;            // [SPEC_TIME_FRAMES][MEL_BINS], 0-255 as the model sees it
+int8_t modelInputCode[256];                 // 0-255 -> int8 model input, from the input tensor's scale
+#define FIXED_FRONTEND_BYTES (sizeof(FixedMelFrontend) + MEL_BINS * SPEC_TIME_FRAMES)
+#else
+#define FIXED_FRONTEND_BYTES 0
+#endif
+
+// Fixed-size placements must fit before anything runs
+#define PLACED_INTERNAL(place, bytes) ((place) == POOL_INTERNAL ? (bytes) : 0)
+static_assert(PLACED_INTERNAL(PLACE_TENSOR_ARENA, MODEL_ARENA_SIZE) +
+              PLACED_INTERNAL(PLACE_DSP_ARENA, (DSP_ARENA_PERSISTENT_KB + DSP_ARENA_SCRATCH_KB) * 1024UL)
+              <= MEMORY_BUDGET_INTERNAL_KB * 1024UL,
+              "Internal SRAM placements exceed MEMORY_BUDGET_INTERNAL_KB");
+static_assert((4 * FFT_SIZE + MEL_BINS * SPEC_TIME_FRAMES) * sizeof(float) +    // bootDsp
+              3 * FFT_SIZE * sizeof(float) + MEL_BINS * sizeof(float) +  // AudioProcessor
+              FIXED_FRONTEND_BYTES
+              <= DSP_ARENA_PERSISTENT_KB * 1024UL,
+              "DSP state exceeds DSP_ARENA_PERSISTENT_KB");
+static_assert(FFT_SIZE * sizeof(int32_t) + 2 * MEL_BINS * sizeof(float)    // I2S block, mel frames
+              <= DSP_ARENA_SCRATCH_KB * 1024UL,
+              "Per-hop temporaries exceed DSP_ARENA_SCRATCH_KB");
+
+// Boot
+BootSequencer boot;
+unsigned long setupDoneMs = 0;
+volatile bool displayReady = false;     // Set by the background display step
 
 // =============================================================================
 // FORWARD DECLARATIONS
 // =============================================================================
 
-void setupI2S();
-void setupDisplay();
-void setupLEDs();
-void setupModel();
+bool setupI2S();
+bool setupDisplay();
+bool setupLEDs();
+bool setupModel();
+bool bootDsp();
+bool bootPower();
+bool bootCalibration();
+bool bootDisplay();
+bool bootLeds();
+bool bootStorage();
+bool bootMesh();
+void applyCalibration();
+bool applyMicCalibration();
+void calibrateMicsWithTone();
 void readAudioSamples();
+uint32_t blockTimeMs(bool* shared);
+void computeMelFrame(float* melFrame, uint8_t* codes);
 void processAudio();
+void updateWind();
 float runInference();
-void updateDisplay();
+void updateDisplay(float batteryVoltage);
 void updateLEDs(float direction, float confidence);
 void handleButton();
-float readBatteryVoltage();
+void handleSerialCommands();
 void enterCalibrationMode();
+bool setupStandby();
+void enterStandby();
+bool readStandbySamples();
+void wakeFromStandby();
+void journalDetection(unsigned long now);
+void journalEventEnd();
+void publishBearing(unsigned long now);
+void handleMeshCues();
+void printMeshStatus();
+void updateFusion(unsigned long now);
 
 // =============================================================================
 // SETUP
@@ -100,39 +238,100 @@ void setup() {
     Serial.println("\n=== VARTA Acoustic Drone Detector ===");
     Serial.println("Initializing...");
 
+    #if !TELEMETRY_ENABLED
+    // With telemetry on, the loop drains log records into the stream instead
+    Logger::instance().begin();
+    #endif
+
     // Initialize GPIO
     pinMode(BUZZER_PIN, OUTPUT);
     pinMode(VIBRATION_PIN, OUTPUT);
     pinMode(BUTTON_PIN, INPUT_PULLUP);
-    pinMode(BATTERY_ADC_PIN, INPUT);
 
-    // Startup indication
-    digitalWrite(BUZZER_PIN, HIGH);
-    delay(100);
-    digitalWrite(BUZZER_PIN, LOW);
+    // Detection path (I2S, model, DSP tables, alerts, calibration) in the
+    // foreground; display, LEDs and storage finish behind the loop
+    boot.add("model", setupModel, 0);
+    boot.add("i2s", setupI2S, 1);
+    int dsp = boot.add("dsp", bootDsp, 1);
+    int standby = boot.add("standby", setupStandby, 1);
+    boot.add("power", bootPower, 1);
+    boot.add("calibration", bootCalibration, 1, (1u << dsp) | (1u << standby));
+    boot.add("display", bootDisplay, 0, 0, true);
+    boot.add("leds", bootLeds, 0, 0, true);
+    boot.add("storage", bootStorage, 0, 0, true);
+    #if MESH_ENABLED
+    boot.add("mesh", bootMesh, 0, 0, true);
+    #endif
+    boot.run();
+
+    // A failed I2S, model or buffer placement step leaves ERROR set
+    if (currentState != STATE_ERROR) {
+        currentState = STATE_SCAN;
+    }
+    setupDoneMs = millis();
+    Serial.printf("Initialization complete in %lu ms. Entering SCAN mode.\n", setupDoneMs);
+}
+
+// =============================================================================
+// BOOT STEPS
+// =============================================================================
+
+bool bootDsp() {
+    DspArena& arena = DspArena::instance();
+    if (!arena.begin()) {
+        currentState = STATE_ERROR;
+        return false;
+    }
+    audioBuffer = (float (*)[FFT_SIZE])arena.persistentArray<float>(4 * FFT_SIZE);
+    melSpectrogram = arena.persistentArray<float>(MEL_BINS * SPEC_TIME_FRAMES);
 
-    // Initialize subsystems
-    setupDisplay();
-    setupLEDs();
-    setupI2S();
-    setupModel();
+    // Filterbank generation, alongside tensor allocation on core 0
+    if (audioBuffer == nullptr || melSpectrogram == nullptr ||
+        !audioProcessor.begin(SAMPLE_RATE, FFT_SIZE, MEL_BINS)) {
+        currentState = STATE_ERROR;
+        return false;
+    }
+    memset(audioBuffer, 0, 4 * FFT_SIZE * sizeof(float));
+    memset(melSpectrogram, 0, MEL_BINS * SPEC_TIME_FRAMES * sizeof(float));
 
-    // Initialize processors
-    audioProcessor.begin(SAMPLE_RATE, FFT_SIZE, MEL_BINS);
+    #if DSP_FIXED_POINT
+    melQuantized = arena.persistentArray<uint8_t>(MEL_BINS * SPEC_TIME_FRAMES);
+    if (melQuantized == nullptr) {
+        currentState = STATE_ERROR;
+        return false;
+    }
+    memset(melQuantized, 0, MEL_BINS * SPEC_TIME_FRAMES);
+    #endif
     directionEstimator.begin(MIC_SPACING_MM, SPEED_OF_SOUND, SAMPLE_RATE);
+    #if WIND_ENABLED
+    windDetector.begin(SAMPLE_RATE);
+    #endif
+    return true;
+}
+
+bool bootPower() {
     alertManager.begin(BUZZER_PIN, VIBRATION_PIN);
+    batteryMonitor.begin(BATTERY_ADC_PIN, BATTERY_DIVIDER);
+    powerManager.begin(HOP_SIZE, SAMPLE_RATE);
 
-    // Self-test LED sequence
-    for (int i = 0; i < LED_COUNT; i++) {
-        ledRing.setPixelColor(i, ledRing.Color(0, 50, 0));
-        ledRing.show();
-        delay(100);
-        ledRing.setPixelColor(i, 0);
+    // Startup sound plays from alertManager.update() once the loop runs
+    alertManager.playPattern(AlertPatterns::STARTUP, AlertPatterns::STARTUP_LEN);
+    return true;
+}
+
+bool bootCalibration() {
+    if (calibration.begin()) {
+        applyCalibration();
+        Serial.println("Calibration restored from NVS");
+    } else {
+        Serial.println("Not calibrated - hold the button 3 s on site");
     }
-    ledRing.show();
+    return true;
+}
 
-    currentState = STATE_SCAN;
-    Serial.println("Initialization complete. Entering SCAN mode.");
+bool bootDisplay() {
+    if (!setupDisplay()) return false;
+    waterfall.begin();
 
     display.clearDisplay();
     display.setTextSize(1);
@@ -140,7 +339,41 @@ void setup() {
     display.setCursor(0, 0);
     display.println("VARTA READY");
     display.println("Mode: SCAN");
-    display.display();
+    displayManager.flush();
+    displayReady = true;
+    return true;
+}
+
+bool bootLeds() {
+    if (!setupLEDs()) return false;
+
+    // Self-test LED sequence (runs in the LED task, then falls back to SCAN)
+    ledEngine.setMode(LED_MODE_SELF_TEST);
+    return true;
+}
+
+bool bootStorage() {
+    // Recordings and journal entries carry the model they were made with
+    uint32_t modelCrc = crc32(drone_detector_tflite, drone_detector_tflite_len);
+    bool ok = true;
+    #if BLACKBOX_ENABLED
+    ok = blackBox.begin(modelCrc) && ok;
+    #endif
+    #if JOURNAL_ENABLED
+    ok = journal.begin(modelCrc) && ok;
+    #endif
+    return ok;
+}
+
+bool bootMesh() {
+    #if MESH_ENABLED
+    // A unit without a radio still detects on its own
+    if (!EspNowRadio::instance().begin(MESH_CHANNEL)) {
+        LOG_WARN("Mesh unavailable, running standalone");
+        return false;
+    }
+    #endif
+    return true;
 }
 
 // =============================================================================
@@ -153,11 +386,40 @@ void loop() {
 
     // Handle user input
     handleButton();
-
-    // Check battery
-    float batteryVoltage = readBatteryVoltage();
-    if (batteryVoltage < BATTERY_CRITICAL_VOLTAGE) {
+    handleSerialCommands();
+
+    #if MESH_ENABLED
+    meshLink.poll(currentTime);
+    #if TIME_SYNC_ENABLED
+    timeSync.poll(esp_timer_get_time());
+    #endif
+    handleMeshCues();
+    #endif
+    #if FUSION_ENABLED
+    updateFusion(currentTime);
+    #endif
+
+    // Check battery (filtered value cached by the battery task)
+    float batteryVoltage = batteryMonitor.getVoltage();
+    if (batteryMonitor.isCritical() && currentState != STATE_LOW_BATTERY) {
         currentState = STATE_LOW_BATTERY;
+        alertManager.playPattern(AlertPatterns::LOW_BATTERY, AlertPatterns::LOW_BATTERY_LEN,
+                                 ALERT_PRIORITY_BATTERY);
+    } else if (!batteryMonitor.isCritical() && currentState == STATE_LOW_BATTERY) {
+        // Recovered past the hysteresis margin (e.g. on charger)
+        currentState = STATE_SCAN;
+    }
+
+    switch (currentState) {
+        case STATE_ALERT:   batteryMonitor.setLoad(LOAD_ALERT); break;
+        case STATE_MONITOR: batteryMonitor.setLoad(LOAD_MONITOR); break;
+        case STATE_STANDBY: batteryMonitor.setLoad(LOAD_STANDBY); break;
+        default:            batteryMonitor.setLoad(LOAD_SCAN); break;
+    }
+
+    // Hand the screen back if something other than the button left MONITOR
+    if (currentState != STATE_MONITOR && waterfall.isActive()) {
+        waterfall.stop();
     }
 
     // State machine
@@ -169,25 +431,55 @@ void loop() {
                 lastProcessTime = currentTime;
                 
                 readAudioSamples();
+
+                // Full clock only for the DSP burst; idle at minimum in i2s_read
+                PROFILE_SCOPE(STAGE_HOP);
+                powerManager.beginBurst();
+                updateWind();
                 processAudio();
                 
-                // Run ML inference
+                // Run ML inference (not worth it while wind swamps the low band)
+                #if WIND_ENABLED
+                currentConfidence = windDetector.isGust() ? 0.0f : runInference();
+                #else
                 currentConfidence = runInference();
+                #endif
                 
                 // Estimate direction if detection
                 if (currentConfidence >= CONFIDENCE_THRESHOLD) {
+                    PROFILE_SCOPE(STAGE_DIRECTION);
+                    #if WIND_ENABLED
+                    // Correlate above the wind band only
+                    for (int ch = 0; ch < 4; ch++) {
+                        windDetector.suppress(audioBuffer[ch], FFT_SIZE);
+                    }
+                    #endif
                     currentDirection = directionEstimator.estimateDirection(
                         audioBuffer[0], audioBuffer[1], 
                         audioBuffer[2], audioBuffer[3], 
                         FFT_SIZE
                     );
+
+                    #if TELEMETRY_ENABLED
+                    telemetry.sendDirection(directionEstimator.getLastTdoa(),
+                                            directionEstimator.getConfidence(), currentDirection);
+                    #endif
+                    LOG_DEBUG("TDOA: [%.1f, %.1f, %.1f, %.1f] conf=%.2f -> %.1f°",
+                              directionEstimator.getLastTdoa()[0], directionEstimator.getLastTdoa()[1],
+                              directionEstimator.getLastTdoa()[2], directionEstimator.getLastTdoa()[3],
+                              directionEstimator.getConfidence(), currentDirection);
                     
                     detectionCount++;
                     lastDetectionTime = currentTime;
                     
-                    #if DEBUG_PRINT_DETECTION
-                    Serial.printf("DETECTION: conf=%.2f dir=%.1f° count=%d\n", 
-                                  currentConfidence, currentDirection, detectionCount);
+                    LOG_INFO("DETECTION: conf=%.2f dir=%.1f° count=%d",
+                             currentConfidence, currentDirection, detectionCount);
+
+                    #if JOURNAL_ENABLED
+                    journalDetection(currentTime);
+                    #endif
+                    #if FUSION_ENABLED
+                    publishBearing(currentTime);
                     #endif
                 }
                 
@@ -204,19 +496,69 @@ void loop() {
                         alertManager.triggerHapticOnly(ALERT_DURATION_MS);
                     }
                     
-                    Serial.println("*** ALERT: DRONE DETECTED ***");
+                    #if TELEMETRY_ENABLED
+                    telemetry.sendAlert(currentDirection, currentConfidence, audioMuted);
+                    #endif
+                    #if MESH_ENABLED
+                    bool sharedTime;
+                    uint32_t cueMs = blockTimeMs(&sharedTime);
+                    meshLink.sendAlert(cueMs, currentDirection + NODE_HEADING_DEG, currentConfidence,
+                                       sharedTime ? BEARING_FLAG_SHARED_TIME : 0);
+                    #endif
+                    #if BLACKBOX_ENABLED
+                    blackBox.trigger(BLACKBOX_REASON_ALERT);
+                    #endif
+                    #if JOURNAL_ENABLED
+                    journalEvent.alerted = 1;
+                    #endif
+                    LOG_INFO("*** ALERT: DRONE DETECTED ***");
                 }
                 
                 // Decay detection count over time
                 if (currentTime - lastDetectionTime > DETECTION_WINDOW_MS) {
                     detectionCount = 0;
+                    #if JOURNAL_ENABLED
+                    journalEventEnd();
+                    #endif
                     if (currentState == STATE_ALERT) {
                         currentState = STATE_SCAN;
                     }
                 }
+
+                #if TELEMETRY_ENABLED
+                telemetry.sendHop(currentConfidence, currentDirection,
+                                  (uint8_t)currentState, (uint8_t)min(detectionCount, 255));
+                #endif
+                #if BLACKBOX_ENABLED
+                blackBox.recordHop(currentConfidence, currentDirection, (uint8_t)currentState);
+                #endif
+
+                powerManager.endBurst();
+                DspArena::instance().endHop();
+
+                // Flash writes stall both cores; keep them out of the burst
+                #if BLACKBOX_ENABLED
+                blackBox.service();
+                #endif
+                #if JOURNAL_ENABLED
+                journal.service();
+                #endif
+                if (calibrationDirty) {
+                    calibrationDirty = false;
+                    calibration.save();
+                }
+
+                #if STANDBY_ENABLED
+                // Nothing heard for a while - hand over to the wake detector
+                if (currentState == STATE_SCAN && detectionCount == 0 &&
+                    currentTime - lastDetectionTime > STANDBY_IDLE_MS &&
+                    currentTime - lastWakeTime > STANDBY_IDLE_MS) {
+                    enterStandby();
+                }
+                #endif
             }
             
-            updateDisplay();
+            updateDisplay(batteryVoltage);
             updateLEDs(currentDirection, currentConfidence);
             break;
 
@@ -225,10 +567,31 @@ void loop() {
             if (currentTime - lastProcessTime >= (HOP_SIZE * 1000 / SAMPLE_RATE)) {
                 lastProcessTime = currentTime;
                 readAudioSamples();
+                powerManager.beginBurst();
+                updateWind();
                 processAudio();
-                // Display spectrogram on TFT if available
+
+                // Newest frame is the one just before the write index
+                int latest = (spectrogramIndex + SPEC_TIME_FRAMES - 1) % SPEC_TIME_FRAMES;
+                waterfall.pushFrame(&melSpectrogram[latest * MEL_BINS]);
+                powerManager.endBurst();
+                DspArena::instance().endHop();
+
+                #if BLACKBOX_ENABLED
+                blackBox.service();
+                #endif
+                #if JOURNAL_ENABLED
+                journal.service();
+                #endif
+            }
+            break;
+
+        case STATE_STANDBY:
+            // Single mic at minimum clock; blocks in i2s_read between blocks
+            if (readStandbySamples()) {
+                wakeFromStandby();
             }
-            updateDisplay();
+            updateDisplay(batteryVoltage);
             break;
 
         case STATE_CALIBRATE:
@@ -236,27 +599,32 @@ void loop() {
             currentState = STATE_SCAN;
             break;
 
-        case STATE_LOW_BATTERY:
+        case STATE_LOW_BATTERY: {
+            // Redraw at 1 Hz without blocking so the alert sequencer keeps running
+            static unsigned long lastLowBattDraw = 0;
+            if (currentTime - lastLowBattDraw < 1000) break;
+            lastLowBattDraw = currentTime;
+            ledEngine.setMode(LED_MODE_LOW_BATTERY);
+            if (!displayReady) break;
+            
             display.clearDisplay();
             display.setCursor(0, 20);
             display.setTextSize(2);
             display.println("LOW BATT");
             display.setTextSize(1);
             display.printf("%.1fV", batteryVoltage);
-            display.display();
-            
-            ledRing.fill(ledRing.Color(50, 0, 0));
-            ledRing.show();
-            
-            delay(1000);
+            displayManager.flush();
             break;
+        }
 
         case STATE_ERROR:
-            display.clearDisplay();
-            display.setCursor(0, 20);
-            display.setTextSize(2);
-            display.println("ERROR");
-            display.display();
+            if (displayReady) {
+                display.clearDisplay();
+                display.setCursor(0, 20);
+                display.setTextSize(2);
+                display.println("ERROR");
+                displayManager.flush();
+            }
             delay(1000);
             break;
 
@@ -266,13 +634,48 @@ void loop() {
 
     // Alert manager update
     alertManager.update();
+
+    #if TELEMETRY_ENABLED
+    static unsigned long lastProfileSend = 0;
+    if (currentTime - lastProfileSend >= TELEMETRY_PROFILE_MS) {
+        lastProfileSend = currentTime;
+        telemetry.sendProfile();
+    }
+
+    // Log lines ride in the telemetry stream so text never splits a frame
+    char logLine[LOG_LINE_MAX];
+    for (int i = 0; i < 4; i++) {
+        int level = Logger::instance().drain(logLine, sizeof(logLine));
+        if (level < 0) break;
+        telemetry.sendLog(level, logLine);
+    }
+    telemetry.pump();
+    #endif
+
+    #if DEBUG_ENABLED && PM_REPORT_INTERVAL_MS > 0
+    static unsigned long lastPowerReport = 0;
+    if (currentTime - lastPowerReport >= PM_REPORT_INTERVAL_MS) {
+        lastPowerReport = currentTime;
+        powerManager.printReport(batteryVoltage);
+
+        #if STANDBY_ENABLED
+        const WakeDetector::Stats& wake = wakeDetector.getStats();
+        unsigned long standbyMs = standbyTotalMs +
+            (currentState == STATE_STANDBY ? currentTime - standbyEnterTime : 0);
+        Serial.printf("Standby: frames=%lu energy=%lu harmonic=%lu wakes=%lu awake=%.0f%%\n",
+                      (unsigned long)wake.frames, (unsigned long)wake.energyHits,
+                      (unsigned long)wake.harmonicHits, (unsigned long)wake.triggers,
+                      100.0f * (1.0f - (float)standbyMs / max(currentTime, 1UL)));
+        #endif
+    }
+    #endif
 }
 
 // =============================================================================
 // I2S AUDIO SETUP
 // =============================================================================
 
-void setupI2S() {
+bool setupI2S() {
     Serial.println("Configuring I2S...");
 
     i2s_config_t i2s_config = {
@@ -300,32 +703,33 @@ void setupI2S() {
     if (err != ESP_OK) {
         Serial.printf("I2S driver install failed: %d\n", err);
         currentState = STATE_ERROR;
-        return;
+        return false;
     }
 
     err = i2s_set_pin(I2S_NUM_0, &pin_config);
     if (err != ESP_OK) {
         Serial.printf("I2S set pin failed: %d\n", err);
         currentState = STATE_ERROR;
-        return;
+        return false;
     }
 
     Serial.println("I2S configured successfully");
+    return true;
 }
 
 // =============================================================================
 // DISPLAY SETUP
 // =============================================================================
 
-void setupDisplay() {
+bool setupDisplay() {
     Serial.println("Initializing display...");
 
     Wire.begin(OLED_SDA_PIN, OLED_SCL_PIN);
 
+    // Detection carries on headless if the display is missing
     if (!display.begin(SSD1306_SWITCHCAPVCC, OLED_ADDRESS)) {
         Serial.println("SSD1306 allocation failed");
-        currentState = STATE_ERROR;
-        return;
+        return false;
     }
 
     display.clearDisplay();
@@ -336,26 +740,33 @@ void setupDisplay() {
     display.println("Initializing...");
     display.display();
 
+    // All later frames go through the asynchronous flush task
+    if (!displayManager.begin(OLED_ADDRESS)) {
+        return false;
+    }
+
     Serial.println("Display initialized");
+    return true;
 }
 
 // =============================================================================
 // LED SETUP
 // =============================================================================
 
-void setupLEDs() {
+bool setupLEDs() {
     Serial.println("Initializing LEDs...");
-    ledRing.begin();
-    ledRing.setBrightness(LED_BRIGHTNESS);
-    ledRing.show();
+    if (!ledEngine.begin(LED_PIN, LED_BRIGHTNESS)) {
+        return false;
+    }
     Serial.println("LEDs initialized");
+    return true;
 }
 
 // =============================================================================
 // ML MODEL SETUP
 // =============================================================================
 
-void setupModel() {
+bool setupModel() {
     Serial.println("Loading ML model...");
 
     model = tflite::GetModel(drone_detector_tflite);
@@ -363,7 +774,14 @@ void setupModel() {
         Serial.printf("Model schema mismatch: %d vs %d\n", 
                       model->version(), TFLITE_SCHEMA_VERSION);
         currentState = STATE_ERROR;
-        return;
+        return false;
+    }
+
+    tensorArena = (uint8_t*)MemoryPools::instance().allocate("tensor arena", MODEL_ARENA_SIZE,
+                                                             PLACE_TENSOR_ARENA, 16);
+    if (tensorArena == nullptr) {
+        currentState = STATE_ERROR;
+        return false;
     }
 
     interpreter = new tflite::MicroInterpreter(
@@ -373,15 +791,26 @@ void setupModel() {
     if (interpreter->AllocateTensors() != kTfLiteOk) {
         Serial.println("AllocateTensors() failed");
         currentState = STATE_ERROR;
-        return;
+        return false;
     }
 
     input = interpreter->input(0);
     output = interpreter->output(0);
 
+    #if DSP_FIXED_POINT
+    // An int8 model takes the fixed front end's codes through one lookup
+    if (input->type == kTfLiteInt8) {
+        for (int code = 0; code < 256; code++) {
+            float q = roundf(code / 255.0f / input->params.scale) + input->params.zero_point;
+            modelInputCode[code] = (int8_t)constrain(q, -128.0f, 127.0f);
+        }
+    }
+    #endif
+
     Serial.printf("Model loaded. Input shape: [%d, %d, %d]\n",
                   input->dims->data[1], input->dims->data[2], input->dims->data[3]);
     Serial.printf("Arena used: %d bytes\n", interpreter->arena_used_bytes());
+    return true;
 }
 
 // =============================================================================
@@ -390,44 +819,151 @@ void setupModel() {
 
 void readAudioSamples() {
     size_t bytesRead = 0;
-    int32_t rawSamples[FFT_SIZE];
+    ScratchFrame frame;
+    int32_t* rawSamples = DspArena::instance().scratchArray<int32_t>(FFT_SIZE);
+    if (rawSamples == nullptr) return;
 
     // Read from I2S
-    esp_err_t result = i2s_read(I2S_NUM_0, rawSamples, sizeof(rawSamples), 
-                                 &bytesRead, portMAX_DELAY);
+    esp_err_t result;
+    {
+        PROFILE_SCOPE(STAGE_CAPTURE);
+        result = i2s_read(I2S_NUM_0, rawSamples, FFT_SIZE * sizeof(int32_t),
+                          &bytesRead, portMAX_DELAY);
+    }
+    powerManager.endCapture();
+    uint64_t readUs = esp_timer_get_time();
 
     if (result == ESP_OK && bytesRead > 0) {
         int samplesRead = bytesRead / sizeof(int32_t);
-        
-        // Convert to float and normalize
-        for (int i = 0; i < samplesRead && i < FFT_SIZE; i++) {
+        blockStartSample = capturedSamples;
+        capturedSamples += samplesRead;
+        sampleClock.mark(capturedSamples, readUs);
+
+        {
+            // Own scope: the black box append below is timed as RECORD only
+            PROFILE_SCOPE(STAGE_CONVERT);
+
+            // Convert to float and normalize to [-1, 1], with each mic's
+            // calibrated trim folded into the conversion scale.
             // INMP441 is 24-bit in 32-bit frame, left-aligned
-            float sample = (float)(rawSamples[i] >> 8) / 8388608.0f;  // Normalize to [-1, 1]
-            audioBuffer[0][i] = sample;
+            const float* gain = calibration.data().micGain;
+            DspKernels::int32ToFloat(rawSamples, 8, gain[0] / 8388608.0f, audioBuffer[0],
+                                     min(samplesRead, FFT_SIZE));
+
+            #if DSP_FIXED_POINT
+            // The mel front end works from the integers; the float copies
+            // still feed direction finding, RMS and the black box
+            audioProcessor.loadFixed(rawSamples, samplesRead, calibration.data().micGain[0]);
+            #endif
+
+            // TODO: Read other 3 microphones via I2S multiplexing or additional I2S ports
+            // For prototype, convert mic 1 again for the others (direction estimation won't work)
+            for (int ch = 1; ch < 4; ch++) {
+                DspKernels::int32ToFloat(rawSamples, 8, gain[ch] / 8388608.0f, audioBuffer[ch],
+                                         min(samplesRead, FFT_SIZE));
+            }
         }
-        
-        // TODO: Read other 3 microphones via I2S multiplexing or additional I2S ports
-        // For prototype, copy mic 1 to others (direction estimation won't work)
-        memcpy(audioBuffer[1], audioBuffer[0], FFT_SIZE * sizeof(float));
-        memcpy(audioBuffer[2], audioBuffer[0], FFT_SIZE * sizeof(float));
-        memcpy(audioBuffer[3], audioBuffer[0], FFT_SIZE * sizeof(float));
+
+        #if BLACKBOX_ENABLED
+        PROFILE_SCOPE(STAGE_RECORD);
+        const float* channels[4] = { audioBuffer[0], audioBuffer[1], audioBuffer[2], audioBuffer[3] };
+        blackBox.append(channels, min(samplesRead, FFT_SIZE));
+        #endif
     }
 }
 
+/**
+ * Time of the current capture block's first sample: mesh time (ms) when
+ * this unit is synced, else its own uptime; `shared` says which
+ */
+uint32_t blockTimeMs(bool* shared) {
+    uint64_t nowUs = esp_timer_get_time();
+    uint64_t localUs = sampleClock.isValid() ? sampleClock.toLocalUs(blockStartSample) : nowUs;
+    *shared = false;
+    #if MESH_ENABLED && TIME_SYNC_ENABLED
+    if (timeSync.isSynced(nowUs)) {
+        *shared = true;
+        return (uint32_t)(timeSync.toMeshUs(localUs) / 1000);
+    }
+    #endif
+    return (uint32_t)(localUs / 1000);
+}
+
 // =============================================================================
 // AUDIO PROCESSING
 // =============================================================================
 
+void computeMelFrame(float* melFrame, uint8_t* codes) {
+    #if DSP_FIXED_POINT
+    // From the block loaded by readAudioSamples() or wakeFromStandby()
+    ScratchFrame frame;
+    int16_t* melDbQ8 = DspArena::instance().scratchArray<int16_t>(MEL_BINS);
+    if (melDbQ8 == nullptr) return;
+    audioProcessor.computeMelFixed(melDbQ8);
+    for (int m = 0; m < MEL_BINS; m++) {
+        melFrame[m] = melDbQ8[m] * (1.0f / 256.0f);
+        if (codes) codes[m] = FixedMelFrontend::quantizeDbQ8(melDbQ8[m]);
+    }
+    #else
+    audioProcessor.computeMelSpectrogram(audioBuffer[0], FFT_SIZE, melFrame);
+    #endif
+}
+
 void processAudio() {
     // Compute mel spectrogram from mic 1
-    float melFrame[MEL_BINS];
-    audioProcessor.computeMelSpectrogram(audioBuffer[0], FFT_SIZE, melFrame);
+    ScratchFrame frame;
+    float* melFrame = DspArena::instance().scratchArray<float>(MEL_BINS);
+    if (melFrame == nullptr) return;
+    #if DSP_FIXED_POINT
+    computeMelFrame(melFrame, &melQuantized[spectrogramIndex * MEL_BINS]);
+    #else
+    computeMelFrame(melFrame, nullptr);
+    #endif
 
     // Add to rolling spectrogram buffer
     memcpy(&melSpectrogram[spectrogramIndex * MEL_BINS], melFrame, 
            MEL_BINS * sizeof(float));
+
+    #if TELEMETRY_ENABLED && TELEMETRY_MEL_FRAMES
+    telemetry.sendMelFrame(melFrame, MEL_BINS);
+    #endif
     
     spectrogramIndex = (spectrogramIndex + 1) % SPEC_TIME_FRAMES;
+    if (spectrogramFilled < SPEC_TIME_FRAMES) {
+        spectrogramFilled++;
+    }
+}
+
+/**
+ * Coherence check on the new block; masks the wind-dominated FFT bins
+ * out of the next mel frame
+ */
+void updateWind() {
+    #if WIND_ENABLED
+    bool wasGust = windDetector.isGust();
+    const float* channels[4] = { audioBuffer[0], audioBuffer[1], audioBuffer[2], audioBuffer[3] };
+    windDetector.process(channels, FFT_SIZE);
+    audioProcessor.setBinMask(windDetector.getMask());
+
+    if (windDetector.isGust() != wasGust) {
+        LOG_INFO("Wind %s (level %.2f, below %.0f Hz)", windDetector.isGust() ? "gust" : "eased",
+                 windDetector.getLevel(), windDetector.getCutoffHz());
+    }
+
+    #if TELEMETRY_ENABLED
+    // Report in 5% steps, not every hop
+    static int lastStep = -1;
+    int step = (int)(windDetector.getLevel() * 20.0f);
+    if (step != lastStep || windDetector.isGust() != wasGust) {
+        lastStep = step;
+        uint32_t mask = windDetector.getMask();
+        int maskedBins = 0;
+        for (; mask != 0; mask &= mask - 1) maskedBins++;
+        telemetry.sendWind(windDetector.getLevel(), windDetector.getCutoffHz(), maskedBins,
+                           windDetector.isGust());
+    }
+    #endif
+    #endif
 }
 
 // =============================================================================
@@ -439,88 +975,275 @@ float runInference() {
         return 0.0f;
     }
 
-    // Copy spectrogram to model input (normalize to 0-1 range)
-    float* inputData = input->data.f;
-    for (int t = 0; t < SPEC_TIME_FRAMES; t++) {
-        int srcIndex = (spectrogramIndex + t) % SPEC_TIME_FRAMES;
-        for (int f = 0; f < MEL_BINS; f++) {
-            float val = melSpectrogram[srcIndex * MEL_BINS + f];
-            // Normalize dB to 0-1 range (assuming -80 to 0 dB)
-            val = (val + 80.0f) / 80.0f;
-            val = constrain(val, 0.0f, 1.0f);
-            inputData[t * MEL_BINS + f] = val;
+    // Nothing but real audio in the window; the zeroed buffer reads as loud
+    if (spectrogramFilled < SPEC_TIME_FRAMES) {
+        return 0.0f;
+    }
+
+    #if DSP_FIXED_POINT
+    if (input->type == kTfLiteInt8) {
+        // Codes straight from the fixed front end, no float on the way
+        int8_t* inputData = input->data.int8;
+        for (int t = 0; t < SPEC_TIME_FRAMES; t++) {
+            const uint8_t* codes = &melQuantized[((spectrogramIndex + t) % SPEC_TIME_FRAMES) * MEL_BINS];
+            for (int f = 0; f < MEL_BINS; f++) {
+                inputData[t * MEL_BINS + f] = modelInputCode[codes[f]];
+            }
+        }
+    } else
+    #endif
+    {
+        // Copy spectrogram to model input (normalize to 0-1 range)
+        float* inputData = input->data.f;
+        for (int t = 0; t < SPEC_TIME_FRAMES; t++) {
+            int srcIndex = (spectrogramIndex + t) % SPEC_TIME_FRAMES;
+            for (int f = 0; f < MEL_BINS; f++) {
+                float val = melSpectrogram[srcIndex * MEL_BINS + f];
+                // Normalize dB to 0-1 range
+                val = (val - MEL_DB_FLOOR) / MEL_DB_RANGE;
+                val = constrain(val, 0.0f, 1.0f);
+                inputData[t * MEL_BINS + f] = val;
+            }
         }
     }
 
     // Run inference
+    PROFILE_SCOPE(STAGE_INFERENCE);
     if (interpreter->Invoke() != kTfLiteOk) {
-        Serial.println("Inference failed");
+        LOG_ERROR("Inference failed");
         return 0.0f;
     }
 
     // Get drone class probability
-    float* outputData = output->data.f;
-    float droneConfidence = outputData[DRONE_CLASS_INDEX];
+    float droneConfidence;
+    if (output->type == kTfLiteInt8) {
+        droneConfidence = (output->data.int8[DRONE_CLASS_INDEX] - output->params.zero_point) *
+                          output->params.scale;
+    } else {
+        droneConfidence = output->data.f[DRONE_CLASS_INDEX];
+    }
+
+    // Time to first detection: the first inference over a full window
+    static bool firstInference = true;
+    if (firstInference) {
+        firstInference = false;
+        unsigned long now = millis();
+        if (now > BOOT_DETECT_BUDGET_MS) {
+            LOG_WARN("Boot: detecting %lu ms after reset, over the %d ms budget (setup %lu ms)",
+                     now, BOOT_DETECT_BUDGET_MS, setupDoneMs);
+        } else {
+            LOG_INFO("Boot: detecting %lu ms after reset (setup %lu ms)", now, setupDoneMs);
+        }
+    }
 
     return droneConfidence;
 }
 
 // =============================================================================
-// DISPLAY UPDATE
+// EVENT JOURNAL
 // =============================================================================
 
-void updateDisplay() {
-    static unsigned long lastDisplayUpdate = 0;
-    if (millis() - lastDisplayUpdate < 100) return;  // 10 Hz update
-    lastDisplayUpdate = millis();
-
-    display.clearDisplay();
-    display.setTextSize(1);
-    display.setCursor(0, 0);
+#if JOURNAL_ENABLED
+void journalDetection(unsigned long now) {
+    if (!journalEventOpen) {
+        memset(&journalEvent, 0, sizeof(journalEvent));
+        journalEvent.startMs = now;
+        bool sharedTime;
+        uint32_t meshMs = blockTimeMs(&sharedTime);
+        journalEvent.meshTimeMs = sharedTime ? meshMs : 0;
+        journalEvent.bearingStart = currentDirection;
+        journalBearingSin = 0.0f;
+        journalBearingCos = 0.0f;
+        journalEventOpen = true;
+    }
 
-    // Status line
-    display.print("VARTA ");
-    switch (currentState) {
-        case STATE_SCAN:    display.println("SCAN"); break;
-        case STATE_ALERT:   display.println("ALERT!"); break;
-        case STATE_MONITOR: display.println("MONITOR"); break;
-        default:            display.println("---"); break;
+    journalEvent.durationMs = now - journalEvent.startMs;
+    journalEvent.detections++;
+    journalEvent.bearingEnd = currentDirection;
+    journalBearingSin += sinf(currentDirection * DEG_TO_RAD);
+    journalBearingCos += cosf(currentDirection * DEG_TO_RAD);
+
+    if (currentConfidence <= journalEvent.peakConfidence) return;
+
+    // New peak: keep its f0 and a block-averaged copy of the spectrogram.
+    // The FFT magnitudes from this hop are still in the audio processor.
+    journalEvent.peakConfidence = currentConfidence;
+    journalEvent.fundamentalHz = audioProcessor.estimateFundamental(MOTOR_FUNDAMENTAL_MIN,
+                                                                    MOTOR_FUNDAMENTAL_MAX);
+
+    const int frameStep = SPEC_TIME_FRAMES / JOURNAL_SNAPSHOT_FRAMES;
+    const int binStep = MEL_BINS / JOURNAL_SNAPSHOT_BINS;
+    for (int t = 0; t < JOURNAL_SNAPSHOT_FRAMES; t++) {
+        for (int b = 0; b < JOURNAL_SNAPSHOT_BINS; b++) {
+            float sum = 0.0f;
+            for (int dt = 0; dt < frameStep; dt++) {
+                int frame = (spectrogramIndex + t * frameStep + dt) % SPEC_TIME_FRAMES;
+                for (int db = 0; db < binStep; db++) {
+                    sum += melSpectrogram[frame * MEL_BINS + b * binStep + db];
+                }
+            }
+            journalEvent.snapshot[t][b] = AudioProcessor::quantizeDb(sum / (frameStep * binStep));
+        }
     }
+}
 
-    // Confidence bar
-    display.setCursor(0, 12);
-    display.print("Conf: ");
-    int barWidth = (int)(currentConfidence * 60);
-    display.drawRect(35, 12, 62, 8, SSD1306_WHITE);
-    display.fillRect(36, 13, barWidth, 6, SSD1306_WHITE);
+void journalEventEnd() {
+    if (!journalEventOpen) return;
+    journalEventOpen = false;
 
-    // Direction
-    display.setCursor(0, 24);
-    display.printf("Dir: %.0f%c", currentDirection, 0xF8);  // Degree symbol
+    float n = (float)journalEvent.detections;
+    float mean = atan2f(journalBearingSin, journalBearingCos) * RAD_TO_DEG;
+    float r = sqrtf(journalBearingSin * journalBearingSin + journalBearingCos * journalBearingCos) / n;
+    journalEvent.bearingMean = mean < 0.0f ? mean + 360.0f : mean;
+    journalEvent.bearingSpread = sqrtf(-2.0f * logf(constrain(r, 1e-6f, 1.0f))) * RAD_TO_DEG;
+    journalEvent.batteryPercent = (uint8_t)(batteryMonitor.getStateOfCharge() * 100.0f + 0.5f);
+
+    if (!journal.append(journalEvent)) {
+        LOG_WARN("Journal queue full, event dropped");
+    }
+}
+#endif
 
-    // Detection count
-    display.setCursor(0, 36);
-    display.printf("Det: %d/%d", detectionCount, MIN_DETECTIONS_FOR_ALERT);
+// =============================================================================
+// BEARING FUSION
+// =============================================================================
 
-    // Battery
-    float batt = readBatteryVoltage();
-    display.setCursor(0, 48);
-    display.printf("Batt: %.1fV", batt);
-    if (audioMuted) {
-        display.setCursor(80, 48);
-        display.print("MUTE");
+#if FUSION_ENABLED
+void publishBearing(unsigned long now) {
+    // f0 lets the fusing node tell two sources apart
+    float f0 = audioProcessor.estimateFundamental(MOTOR_FUNDAMENTAL_MIN, MOTOR_FUNDAMENTAL_MAX);
+    bool sharedTime;
+    uint32_t timestampMs = blockTimeMs(&sharedTime);
+    BearingReport report = BearingFusion::makeReport(NODE_ID, bearingSeq++, timestampMs,
+                                                     NODE_EAST_M, NODE_NORTH_M,
+                                                     currentDirection + NODE_HEADING_DEG,
+                                                     currentConfidence, f0,
+                                                     sharedTime ? BEARING_FLAG_SHARED_TIME : 0);
+    bearingLink.send(report);
+    fusion.submit(report, now);
+}
+
+void updateFusion(unsigned long now) {
+    BearingReport report;
+    while (bearingLink.receive(&report)) {
+        unsigned long detectedMs = now;
+        #if MESH_ENABLED && TIME_SYNC_ENABLED
+        // On a shared clock, a report is as old as its detection, not its
+        // arrival: batching and relays can hold it for a while
+        uint64_t localUs = esp_timer_get_time();
+        if ((report.flags & BEARING_FLAG_SHARED_TIME) && timeSync.isSynced(localUs)) {
+            uint32_t meshNowMs = (uint32_t)(timeSync.toMeshUs(localUs) / 1000);
+            detectedMs = now - (int32_t)(meshNowMs - report.timestampMs);
+        }
+        #endif
+        fusion.submit(report, detectedMs);
     }
 
-    // Alert indicator
-    if (currentState == STATE_ALERT) {
-        display.fillRect(100, 0, 28, 10, SSD1306_WHITE);
-        display.setTextColor(SSD1306_BLACK);
-        display.setCursor(102, 1);
-        display.print("!!!");
-        display.setTextColor(SSD1306_WHITE);
+    static unsigned long lastSolve = 0;
+    if (now - lastSolve < FUSION_INTERVAL_MS) return;
+    lastSolve = now;
+
+    FusionFix fix;
+    if (!fusion.solve(now, &fix)) return;
+
+    #if TELEMETRY_ENABLED
+    telemetry.sendFix(fix);
+    #endif
+    LOG_INFO("FIX: %.0f m E, %.0f m N, 95%% ellipse %.0f x %.0f m, %d units, misfit %.1f°",
+             fix.eastM, fix.northM, fix.majorM, fix.minorM, fix.nodes, fix.residualDeg);
+}
+#endif
+
+// =============================================================================
+// MESH
+// =============================================================================
+
+#if MESH_ENABLED
+void handleMeshCues() {
+    AlertCue cue;
+    while (meshLink.receiveAlert(&cue)) {
+        LOG_INFO("CUE: unit %d alerted, bearing %.0f° conf=%.2f",
+                 cue.nodeId, cue.bearingCdeg * 0.01f, cue.confidence / 255.0f);
+
+        #if TIME_SYNC_ENABLED
+        // Repeats and relays can arrive late; on a shared clock, a cue
+        // from before the detection window is history, not a heads-up
+        uint64_t localUs = esp_timer_get_time();
+        if ((cue.flags & BEARING_FLAG_SHARED_TIME) && timeSync.isSynced(localUs)) {
+            uint32_t meshNowMs = (uint32_t)(timeSync.toMeshUs(localUs) / 1000);
+            int32_t ageMs = (int32_t)(meshNowMs - cue.timestampMs);
+            if (ageMs > DETECTION_WINDOW_MS) {
+                LOG_INFO("CUE: %d ms old, ignored", (int)ageMs);
+                continue;
+            }
+        }
+        #endif
+
+        // Heads-up only; this unit's own detection outranks it
+        if (currentState == STATE_SCAN) {
+            if (!audioMuted) {
+                alertManager.playPattern(AlertPatterns::NEIGHBOR_CUE, AlertPatterns::NEIGHBOR_CUE_LEN,
+                                         ALERT_PRIORITY_CUE, true);
+            } else {
+                alertManager.triggerHapticOnly(ALERT_DURATION_MS / 2);
+            }
+        }
     }
+}
 
-    display.display();
+void printMeshStatus() {
+    const MeshStats& s = meshLink.getStats();
+    Serial.printf("Mesh: unit %d, %lu frames out, %lu in (%lu rejected), %lu relayed "
+                  "(%lu suppressed), %lu duplicates, %lu rate-limited, %lu dropped\n",
+                  NODE_ID, (unsigned long)s.framesSent, (unsigned long)s.framesReceived,
+                  (unsigned long)s.framesRejected, (unsigned long)s.relayed, (unsigned long)s.suppressed,
+                  (unsigned long)s.duplicates, (unsigned long)s.rateLimited, (unsigned long)s.dropped);
+
+    #if TIME_SYNC_ENABLED
+    uint64_t nowUs = esp_timer_get_time();
+    const TimeSyncStats& t = timeSync.getStats();
+    Serial.printf("Time: %s, mesh time %.3f s, drift %+.1f ppm, path delay %lu us\n",
+                  timeSync.isMaster() ? "master" : (timeSync.isSynced(nowUs) ? "synced" : "not synced"),
+                  timeSync.toMeshUs(nowUs) * 1e-6, timeSync.getDriftPpm(),
+                  (unsigned long)timeSync.getPathDelayUs());
+    Serial.printf("      %lu syncs, %lu outliers, %lu refits, %lu/%lu delay replies\n",
+                  (unsigned long)t.syncs, (unsigned long)t.outliers, (unsigned long)t.resets,
+                  (unsigned long)t.delayReplies, (unsigned long)t.delayRequests);
+    #endif
+}
+#endif
+
+// =============================================================================
+// DISPLAY UPDATE
+// =============================================================================
+
+void updateDisplay(float batteryVoltage) {
+    if (!displayReady) return;
+
+    static unsigned long lastDisplayUpdate = 0;
+    if (millis() - lastDisplayUpdate < 100) return;  // 10 Hz update
+    lastDisplayUpdate = millis();
+
+    PROFILE_SCOPE(STAGE_DISPLAY);
+
+    // Only widgets whose values changed are redrawn and sent
+    switch (currentState) {
+        case STATE_SCAN:    displayManager.setStatus("SCAN", false); break;
+        case STATE_ALERT:   displayManager.setStatus("ALERT!", true); break;
+        case STATE_MONITOR: displayManager.setStatus("MONITOR", false); break;
+        case STATE_STANDBY: displayManager.setStatus("STANDBY", false); break;
+        default:            displayManager.setStatus("---", false); break;
+    }
+    displayManager.setConfidence(currentConfidence);
+    displayManager.setBearing(currentDirection);
+    displayManager.setDetections(detectionCount, MIN_DETECTIONS_FOR_ALERT);
+    displayManager.setBattery(batteryVoltage);
+    displayManager.setMuted(audioMuted);
+    #if WIND_ENABLED
+    displayManager.setWind(windDetector.getLevel());
+    #endif
+
+    displayManager.render();
 }
 
 // =============================================================================
@@ -528,38 +1251,17 @@ void updateDisplay() {
 // =============================================================================
 
 void updateLEDs(float direction, float confidence) {
-    ledRing.clear();
-
+    // Only publishes the model; frames are rendered by the LED task
     if (currentState == STATE_ALERT) {
-        // Map direction (0-360) to LED index (0-7)
-        // Assuming LED 0 is "forward"
-        int ledIndex = ((int)((direction + 22.5f) / 45.0f)) % LED_COUNT;
-        
-        // Intensity based on confidence
-        int intensity = (int)(confidence * 255);
-        
-        // Primary LED (threat direction)
-        ledRing.setPixelColor(ledIndex, ledRing.Color(intensity, 0, 0));
-        
-        // Adjacent LEDs at lower intensity
-        int prev = (ledIndex - 1 + LED_COUNT) % LED_COUNT;
-        int next = (ledIndex + 1) % LED_COUNT;
-        ledRing.setPixelColor(prev, ledRing.Color(intensity / 3, 0, 0));
-        ledRing.setPixelColor(next, ledRing.Color(intensity / 3, 0, 0));
-        
+        // LED 0 is "forward"; the bearing is interpolated between adjacent LEDs
+        ledEngine.setTargets(&direction, &confidence, 1);
+        ledEngine.setMode(LED_MODE_ALERT);
     } else if (currentState == STATE_SCAN) {
-        // Ambient level indicator - subtle blue pulse
-        static uint8_t breathe = 0;
-        static int8_t breatheDir = 1;
-        breathe += breatheDir * 2;
-        if (breathe >= 30 || breathe <= 0) breatheDir = -breatheDir;
-        
-        for (int i = 0; i < LED_COUNT; i++) {
-            ledRing.setPixelColor(i, ledRing.Color(0, 0, breathe));
+        // Let the startup chase finish before breathing
+        if (ledEngine.getMode() != LED_MODE_SELF_TEST) {
+            ledEngine.setMode(LED_MODE_SCAN);
         }
     }
-
-    ledRing.show();
 }
 
 // =============================================================================
@@ -586,9 +1288,15 @@ void handleButton() {
 
         if (pressDuration >= 3000) {
             // Long press - calibration mode
-            Serial.println("Long press - entering calibration");
+            LOG_INFO("Long press - entering calibration");
             currentState = STATE_CALIBRATE;
         }
+        else if (pressDuration >= 1000) {
+            // Hold - save the black box window around now
+            #if BLACKBOX_ENABLED
+            blackBox.trigger(BLACKBOX_REASON_MANUAL);
+            #endif
+        }
         else if (pressDuration >= 50) {
             // Short press
             if (millis() - lastQuickPress < 500) {
@@ -601,7 +1309,7 @@ void handleButton() {
             if (quickPressCount >= 2) {
                 // Double press - toggle mute
                 audioMuted = !audioMuted;
-                Serial.printf("Audio mute: %s\n", audioMuted ? "ON" : "OFF");
+                LOG_INFO("Audio mute: %s", audioMuted ? "ON" : "OFF");
                 quickPressCount = 0;
             }
         }
@@ -610,24 +1318,91 @@ void handleButton() {
     // Single press action (after timeout)
     if (quickPressCount == 1 && millis() - lastQuickPress > 500) {
         // Cycle display mode
-        if (currentState == STATE_SCAN) {
+        if (currentState == STATE_STANDBY) {
+            wakeFromStandby();
+        } else if (currentState == STATE_SCAN) {
             currentState = STATE_MONITOR;
+            waterfall.start();
         } else if (currentState == STATE_MONITOR) {
             currentState = STATE_SCAN;
+            waterfall.stop();
         }
-        Serial.printf("Mode changed to: %d\n", currentState);
+        LOG_INFO("Mode changed to: %d", (int)currentState);
         quickPressCount = 0;
     }
 }
 
 // =============================================================================
-// BATTERY MONITORING
+// SERIAL COMMANDS
 // =============================================================================
 
-float readBatteryVoltage() {
-    int adcValue = analogRead(BATTERY_ADC_PIN);
-    float voltage = (adcValue / 4095.0f) * 3.3f * BATTERY_DIVIDER;
-    return voltage;
+void handleSerialCommands() {
+    // Single-character commands: p = profiler report, r = reset profiler,
+    // b = save black box window, d = dump newest black box recording,
+    // c = benchmark the recording codecs, j = dump the event journal,
+    // m = memory placement report, k = kernel latency per memory pool,
+    // v = check and time the DSP kernels and fast math, q = fixed vs float mel front end,
+    // t = mesh link and time sync status, g = mic gain and delay calibration from the buzzer
+    while (Serial.available() > 0) {
+        int c = Serial.read();
+        switch (c) {
+            case 'p':
+                Profiler::instance().printReport();
+                break;
+            case 'r':
+                Profiler::instance().reset();
+                Serial.println("Profiler reset");
+                break;
+            #if BLACKBOX_ENABLED
+            case 'b':
+                blackBox.trigger(BLACKBOX_REASON_MANUAL);
+                break;
+            case 'd':
+                blackBox.dumpLatest();
+                break;
+            case 'c':
+                blackBox.benchmarkCodecs();
+                break;
+            #endif
+            #if JOURNAL_ENABLED
+            case 'j':
+                journal.dump();
+                break;
+            #endif
+            case 'm':
+                MemoryPools::instance().printReport();
+                DspArena::instance().printReport();
+                break;
+            case 'k':
+                MemoryPools::instance().benchmark();
+                break;
+            case 'v': {
+                ScratchFrame frame;
+                float* scratch = DspArena::instance().scratchArray<float>(
+                    max(4 * DSP_SELFTEST_SAMPLES, 2 * (FFT_SIZE / 2 + 1)));
+                if (scratch != nullptr) {
+                    DspKernels::selfTest(scratch);
+                    FastMath::selfTest(scratch);
+                }
+                break;
+            }
+            #if DSP_FIXED_POINT
+            case 'q':
+                audioProcessor.compareFixed(audioBuffer[0], FFT_SIZE);
+                break;
+            #endif
+            #if MESH_ENABLED
+            case 't':
+                printMeshStatus();
+                break;
+            #endif
+            case 'g':
+                calibrateMicsWithTone();
+                break;
+            default:
+                break;
+        }
+    }
 }
 
 // =============================================================================
@@ -637,34 +1412,47 @@ float readBatteryVoltage() {
 void enterCalibrationMode() {
     Serial.println("=== CALIBRATION MODE ===");
     
-    display.clearDisplay();
-    display.setCursor(0, 0);
-    display.println("CALIBRATING...");
-    display.println("Keep quiet for");
-    display.println("30 seconds");
-    display.display();
+    // The display step runs in the background and may have failed
+    bool showProgress = displayReady;
+    if (showProgress) {
+        display.clearDisplay();
+        display.setCursor(0, 0);
+        display.println("CALIBRATING...");
+        display.println("Keep quiet for");
+        display.println("30 seconds");
+        displayManager.flush();
+    }
 
     // Collect ambient noise profile
-    float noiseFloor[MEL_BINS] = {0};
+    DspArena& arena = DspArena::instance();
+    ScratchFrame frame;
+    float* noiseFloor = arena.scratchArray<float>(MEL_BINS);
+    float* melFrame = arena.scratchArray<float>(MEL_BINS);
+    if (noiseFloor == nullptr || melFrame == nullptr) return;
+    memset(noiseFloor, 0, MEL_BINS * sizeof(float));
+    micCalibrator.begin(SAMPLE_RATE, MIC_CAL_AMBIENT);
     int sampleCount = 0;
     unsigned long startTime = millis();
 
     while (millis() - startTime < 30000) {
         readAudioSamples();
         
-        float melFrame[MEL_BINS];
-        audioProcessor.computeMelSpectrogram(audioBuffer[0], FFT_SIZE, melFrame);
+        computeMelFrame(melFrame, nullptr);
         
         // Running average
         for (int i = 0; i < MEL_BINS; i++) {
             noiseFloor[i] = (noiseFloor[i] * sampleCount + melFrame[i]) / (sampleCount + 1);
         }
+        const float* channels[4] = { audioBuffer[0], audioBuffer[1], audioBuffer[2], audioBuffer[3] };
+        micCalibrator.process(channels, FFT_SIZE);
         sampleCount++;
 
         // Progress indicator
-        int progress = (millis() - startTime) / 300;  // 0-100
-        display.fillRect(0, 50, progress * 1.28, 10, SSD1306_WHITE);
-        display.display();
+        if (showProgress) {
+            int progress = (millis() - startTime) / 300;  // 0-100
+            display.fillRect(0, 50, progress * 1.28, 10, SSD1306_WHITE);
+            displayManager.flush();
+        }
 
         delay(10);
     }
@@ -672,12 +1460,200 @@ void enterCalibrationMode() {
     // Store noise profile
     audioProcessor.setNoiseFloor(noiseFloor);
 
-    display.clearDisplay();
-    display.setCursor(0, 20);
-    display.println("CALIBRATION");
-    display.println("COMPLETE");
-    display.display();
-    delay(2000);
+    // Trim each mic to the array mean; ambient noise is diffuse enough to
+    // reach all four at about the same level and phase
+    CalibrationData& cal = calibration.data();
+    applyMicCalibration();
+
+    memcpy(cal.noiseFloor, noiseFloor, MEL_BINS * sizeof(float));
+    if (calibration.save()) {
+        Serial.println("Calibration saved");
+    }
+
+    if (showProgress) {
+        display.clearDisplay();
+        display.setCursor(0, 20);
+        display.println("CALIBRATION");
+        display.println("COMPLETE");
+        displayManager.flush();
+        delay(2000);
+    }
+
+    // Played back from alertManager.update() once the main loop resumes
+    alertManager.playPattern(AlertPatterns::CALIBRATION_DONE, AlertPatterns::CALIBRATION_DONE_LEN);
 
     Serial.println("Calibration complete");
 }
+
+/**
+ * Fold a finished mic calibration run into the stored trims. Capture
+ * already applies the old gains, so the new ones scale them; delays are
+ * never applied to the samples, so they are replaced. False (trims kept)
+ * if the run was rejected.
+ */
+bool applyMicCalibration() {
+    MicCalResult result;
+    if (!micCalibrator.finish(&result)) {
+        Serial.printf("Mic calibration rejected (%d segments) - trims unchanged\n",
+                      micCalibrator.getSegments());
+        return false;
+    }
+
+    CalibrationData& cal = calibration.data();
+    for (int ch = 0; ch < 4; ch++) {
+        cal.micGain[ch] = constrain(cal.micGain[ch] * result.gain[ch],
+                                    1.0f / MIC_CAL_MAX_GAIN_RATIO, MIC_CAL_MAX_GAIN_RATIO);
+        cal.micDelay[ch] = result.delaySamples[ch];
+    }
+    directionEstimator.setMicDelays(cal.micDelay);
+
+    Serial.printf("Mic trims %.3f %.3f %.3f %.3f, delays %+.2f %+.2f %+.2f %+.2f samples (coherence %.2f)\n",
+                  cal.micGain[0], cal.micGain[1], cal.micGain[2], cal.micGain[3],
+                  cal.micDelay[0], cal.micDelay[1], cal.micDelay[2], cal.micDelay[3],
+                  result.coherence);
+    return true;
+}
+
+/**
+ * Mic gain and delay from the buzzer tone: quicker than the ambient run
+ * and independent of the site, but only as good as MIC_CAL_BUZZER_*
+ */
+void calibrateMicsWithTone() {
+    micCalibrator.begin(SAMPLE_RATE, MIC_CAL_TONE, MIC_CAL_TONE_HZ);
+    int toneHz = (int)(micCalibrator.getToneHz() + 0.5f);
+    Serial.printf("Mic calibration: %d Hz tone for %d ms\n", toneHz, MIC_CAL_TONE_MS);
+
+    alertManager.stopPatterns();
+    alertManager.playTone(toneHz, MIC_CAL_TONE_MS + 500);
+
+    // Let the buzzer settle before listening
+    unsigned long start = millis();
+    while (millis() - start < 250) {
+        alertManager.update();
+        readAudioSamples();
+    }
+    start = millis();
+    while (millis() - start < MIC_CAL_TONE_MS) {
+        alertManager.update();
+        readAudioSamples();
+        const float* channels[4] = { audioBuffer[0], audioBuffer[1], audioBuffer[2], audioBuffer[3] };
+        micCalibrator.process(channels, FFT_SIZE);
+    }
+    alertManager.stopPatterns();
+
+    if (applyMicCalibration()) {
+        calibration.save();
+    }
+}
+
+void applyCalibration() {
+    CalibrationData& cal = calibration.data();
+
+    // All-zero floor means the blob only carries a learned wake floor
+    for (int i = 0; i < MEL_BINS; i++) {
+        if (cal.noiseFloor[i] != 0.0f) {
+            audioProcessor.setNoiseFloor(cal.noiseFloor);
+            break;
+        }
+    }
+    wakeDetector.setFloorHint(cal.wakeFloorDb);
+    directionEstimator.setMicDelays(cal.micDelay);
+}
+
+// =============================================================================
+// STANDBY
+// =============================================================================
+
+bool setupStandby() {
+    #if STANDBY_ENABLED
+    wakeDetector.begin(SAMPLE_RATE, MOTOR_FUNDAMENTAL_MIN, MOTOR_FUNDAMENTAL_MAX);
+
+    // Pre-roll matches the spectrogram span so inference starts with full context
+    int capacity = STANDBY_PREROLL_FRAMES * FFT_SIZE;
+    int16_t* storage = (int16_t*)MemoryPools::instance().allocate("standby preroll",
+                                                                  capacity * sizeof(int16_t),
+                                                                  PLACE_PREROLL);
+    if (!preroll.begin(storage, capacity)) {
+        // Still wakes, just with nothing to replay
+        Serial.println("Standby pre-roll allocation failed");
+    }
+    #endif
+    return true;
+}
+
+void enterStandby() {
+    LOG_INFO("Entering STANDBY (wake-on-sound)");
+    currentState = STATE_STANDBY;
+    standbyEnterTime = millis();
+
+    wakeDetector.reset();
+    preroll.clear();
+    ledEngine.setMode(LED_MODE_OFF);
+    powerManager.setStandby(true);
+}
+
+bool readStandbySamples() {
+    size_t bytesRead = 0;
+    ScratchFrame frame;
+    int32_t* rawSamples = DspArena::instance().scratchArray<int32_t>(FFT_SIZE);
+    if (rawSamples == nullptr) return false;
+
+    esp_err_t result;
+    {
+        PROFILE_SCOPE(STAGE_CAPTURE);
+        result = i2s_read(I2S_NUM_0, rawSamples, FFT_SIZE * sizeof(int32_t),
+                          &bytesRead, portMAX_DELAY);
+    }
+    powerManager.endCapture();
+    uint64_t readUs = esp_timer_get_time();
+    if (result != ESP_OK || bytesRead == 0) {
+        return false;
+    }
+
+    // Keep the sample count running so capture stays on the same timebase
+    int samplesRead = bytesRead / sizeof(int32_t);
+    capturedSamples += samplesRead;
+    sampleClock.mark(capturedSamples, readUs);
+    preroll.push(rawSamples, samplesRead);
+    return wakeDetector.process(rawSamples, samplesRead);
+}
+
+void wakeFromStandby() {
+    unsigned long now = millis();
+    standbyTotalMs += now - standbyEnterTime;
+    lastWakeTime = now;
+
+    powerManager.setStandby(false);
+
+    // Keep the learned floor for the next standby and the next boot
+    float wakeFloor = wakeDetector.getNoiseFloorDb();
+    CalibrationData& cal = calibration.data();
+    if (fabsf(wakeFloor - cal.wakeFloorDb) > CALIBRATION_WAKE_SAVE_DB) {
+        cal.wakeFloorDb = wakeFloor;
+        wakeDetector.setFloorHint(wakeFloor);
+        calibrationDirty = true;
+    }
+
+    // Pre-roll is one mic: no coherence to judge wind by, so start clean
+    #if WIND_ENABLED
+    windDetector.reset();
+    audioProcessor.setBinMask(0);
+    #endif
+
+    // Rebuild the spectrogram from the triggering audio, in the same
+    // FFT_SIZE blocks and with the same mic 1 trim readAudioSamples()
+    // produces. Standby keeps one mic, and only mic 1 feeds the mel
+    // frames; the other channels (direction, wind) start from the first
+    // live block.
+    int frames = preroll.size() / FFT_SIZE;
+    for (int t = 0; t < frames; t++) {
+        preroll.read(t * FFT_SIZE, audioBuffer[0], FFT_SIZE, cal.micGain[0]);
+        #if DSP_FIXED_POINT
+        audioProcessor.loadFixed(audioBuffer[0], FFT_SIZE);
+        #endif
+        processAudio();
+    }
+
+    currentState = STATE_SCAN;
+    LOG_INFO("WAKE from standby (%d pre-roll frames)", frames);
+}
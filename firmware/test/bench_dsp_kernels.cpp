@@ -0,0 +1,127 @@
+/**
+ * Google Benchmark suite for the DSP kernels and the fast-math
+ * replacements, at the sizes the signal path uses per hop. Built when
+ * the benchmark library is installed; not part of ctest:
+ *   ./bench_dsp_kernels --benchmark_filter=dot
+ *
+ * Host numbers rank the scalar kernels against each other and against
+ * libm; on-device timings of the ESP-DSP path come from selfTest() ('v').
+ */
+
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+#include <vector>
+#include "dsp_kernels.h"
+
+static std::vector<float> randomBlock(int n, float lo, float hi) {
+    std::vector<float> x(n);
+    for (int i = 0; i < n; i++) x[i] = lo + (hi - lo) * (rand() / (float)RAND_MAX);
+    return x;
+}
+
+static void BM_Multiply(benchmark::State& state) {
+    int n = state.range(0);
+    std::vector<float> a = randomBlock(n, -1, 1), b = randomBlock(n, -1, 1), out(n);
+    for (auto _ : state) {
+        DspKernels::multiply(a.data(), b.data(), out.data(), n);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_Multiply)->Arg(FFT_SIZE)->Arg(HOP_SIZE);
+
+static void BM_Scale(benchmark::State& state) {
+    int n = state.range(0);
+    std::vector<float> a = randomBlock(n, -1, 1), out(n);
+    for (auto _ : state) {
+        DspKernels::scale(a.data(), 0.73f, out.data(), n);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_Scale)->Arg(FFT_SIZE);
+
+static void BM_Dot(benchmark::State& state) {
+    int n = state.range(0);
+    std::vector<float> a = randomBlock(n, 0, 1), b = randomBlock(n, 0, 1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(DspKernels::dot(a.data(), b.data(), n));
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_Dot)->Arg(FFT_SIZE / 2 + 1)->Arg(FFT_SIZE);
+
+static void BM_Magnitude(benchmark::State& state) {
+    int n = state.range(0);
+    std::vector<float> re = randomBlock(n, -1, 1), im = randomBlock(n, -1, 1), out(n);
+    for (auto _ : state) {
+        DspKernels::magnitude(re.data(), im.data(), out.data(), n);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_Magnitude)->Arg(FFT_SIZE / 2 + 1);
+
+static void BM_ScalarMagnitudeLibm(benchmark::State& state) {
+    int n = state.range(0);
+    std::vector<float> re = randomBlock(n, -1, 1), im = randomBlock(n, -1, 1), out(n);
+    for (auto _ : state) {
+        DspKernels::Scalar::magnitude(re.data(), im.data(), out.data(), n);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_ScalarMagnitudeLibm)->Arg(FFT_SIZE / 2 + 1);
+
+static void BM_Int32ToFloat(benchmark::State& state) {
+    int n = state.range(0);
+    std::vector<int32_t> raw(n);
+    for (int i = 0; i < n; i++) raw[i] = rand() - RAND_MAX / 2;
+    std::vector<float> out(n);
+    for (auto _ : state) {
+        DspKernels::int32ToFloat(raw.data(), 8, 1.0f / 8388608.0f, out.data(), n);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_Int32ToFloat)->Arg(FFT_SIZE);
+
+static void BM_FastLog2(benchmark::State& state) {
+    std::vector<float> x = randomBlock(MEL_BINS, 1e-6f, 1e3f), out(MEL_BINS);
+    for (auto _ : state) {
+        for (int i = 0; i < MEL_BINS; i++) out[i] = FastMath::Approx::log2(x[i]);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * MEL_BINS);
+}
+BENCHMARK(BM_FastLog2);
+
+static void BM_Log2f(benchmark::State& state) {
+    std::vector<float> x = randomBlock(MEL_BINS, 1e-6f, 1e3f), out(MEL_BINS);
+    for (auto _ : state) {
+        for (int i = 0; i < MEL_BINS; i++) out[i] = log2f(x[i]);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * MEL_BINS);
+}
+BENCHMARK(BM_Log2f);
+
+static void BM_FastAtan2(benchmark::State& state) {
+    std::vector<float> y = randomBlock(256, -1, 1), x = randomBlock(256, -1, 1);
+    for (auto _ : state) {
+        for (int i = 0; i < 256; i++) benchmark::DoNotOptimize(FastMath::Approx::atan2(y[i], x[i]));
+    }
+    state.SetItemsProcessed(state.iterations() * 256);
+}
+BENCHMARK(BM_FastAtan2);
+
+static void BM_Atan2f(benchmark::State& state) {
+    std::vector<float> y = randomBlock(256, -1, 1), x = randomBlock(256, -1, 1);
+    for (auto _ : state) {
+        for (int i = 0; i < 256; i++) benchmark::DoNotOptimize(atan2f(y[i], x[i]));
+    }
+    state.SetItemsProcessed(state.iterations() * 256);
+}
+BENCHMARK(BM_Atan2f);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,59 @@
+/**
+ * VARTA - Arduino core stand-in for host tests
+ * Only what the headers under test use. Time is virtual (hostMillis) and
+ * pin writes land in hostPins so tests can step the clock and inspect
+ * outputs.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+#define PI          3.1415926535897932384626433832795
+#define HIGH        1
+#define LOW         0
+#define OUTPUT      1
+#define INPUT       0
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+inline unsigned long hostMillis = 0;
+inline int hostPins[64];
+inline int hostToneHz = 0;
+
+inline unsigned long millis() { return hostMillis; }
+inline void delay(unsigned long ms) { hostMillis += ms; }
+
+inline void pinMode(int, int) {}
+inline void digitalWrite(int pin, int value) { if (pin >= 0 && pin < 64) hostPins[pin] = value; }
+inline int digitalRead(int pin) { return pin >= 0 && pin < 64 ? hostPins[pin] : LOW; }
+
+inline double ledcSetup(uint8_t, double frequency, uint8_t) { return frequency; }
+inline void ledcAttachPin(uint8_t, uint8_t) {}
+inline void ledcDetachPin(uint8_t) { hostToneHz = 0; }
+inline void ledcWrite(uint8_t, uint32_t duty) { if (duty == 0) hostToneHz = 0; }
+inline double ledcWriteTone(uint8_t, double frequency) { hostToneHz = (int)frequency; return frequency; }
+
+struct HostSerial {
+    void print(const char* s) { fputs(s, stdout); }
+    void println(const char* s = "") { puts(s); }
+    int printf(const char* format, ...) {
+        va_list args;
+        va_start(args, format);
+        int n = vprintf(format, args);
+        va_end(args);
+        return n;
+    }
+};
+inline HostSerial Serial;
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,95 @@
+/**
+ * AlertManager sequencer on a virtual clock: pattern steps, priority
+ * preemption and alert timing all follow setClock(), never the wall clock.
+ */
+
+#include "test_support.h"
+#include "alert_manager.h"
+
+static const int BUZZER = 38;
+static const int VIBRATION = 39;
+
+static unsigned long virtualMs = 0;
+static unsigned long virtualClock() { return virtualMs; }
+
+static void stepTo(AlertManager& alerts, unsigned long ms) {
+    while (virtualMs < ms) {
+        virtualMs++;
+        alerts.update();
+    }
+}
+
+static void testPatternFollowsClock() {
+    AlertManager alerts;
+    alerts.begin(BUZZER, VIBRATION);
+    virtualMs = 5000;
+    hostMillis = 0;                 // Wall clock parked far away
+    alerts.setClock(virtualClock);
+
+    const int pattern[] = { 1000, 100, 0, 50, 2000, 100 };
+    CHECK(alerts.playPattern(pattern, 6));
+    CHECK(hostToneHz == 1000);
+
+    stepTo(alerts, 5099);
+    CHECK(hostToneHz == 1000);
+    stepTo(alerts, 5100);
+    CHECK(hostToneHz == 0);         // Pause step
+    stepTo(alerts, 5150);
+    CHECK(hostToneHz == 2000);
+    stepTo(alerts, 5250);
+    CHECK(!alerts.isPlaying());
+}
+
+static void testAlertTimingFollowsClock() {
+    AlertManager alerts;
+    alerts.begin(BUZZER, VIBRATION);
+    virtualMs = 100000;
+    hostMillis = 0;
+    alerts.setClock(virtualClock);
+
+    alerts.triggerAlert(500);
+    CHECK(alerts.isAlerting());
+    CHECK(hostPins[BUZZER] == HIGH);
+
+    // 100 ms on, 50 ms off
+    stepTo(alerts, 100100);
+    CHECK(hostPins[BUZZER] == LOW);
+    stepTo(alerts, 100150);
+    CHECK(hostPins[BUZZER] == HIGH);
+
+    stepTo(alerts, 100499);
+    CHECK(alerts.isAlerting());
+    stepTo(alerts, 100500);
+    CHECK(!alerts.isAlerting());
+    CHECK(hostPins[VIBRATION] == LOW);
+}
+
+static void testPriorityPreemptsAndQueues() {
+    AlertManager alerts;
+    alerts.begin(BUZZER, VIBRATION);
+    virtualMs = 0;
+    alerts.setClock(virtualClock);
+
+    CHECK(alerts.playPattern(AlertPatterns::STARTUP, AlertPatterns::STARTUP_LEN));
+    CHECK(hostToneHz == 800);
+
+    // Cue preempts the startup sound
+    CHECK(alerts.playPattern(AlertPatterns::NEIGHBOR_CUE, AlertPatterns::NEIGHBOR_CUE_LEN,
+                             ALERT_PRIORITY_CUE));
+    CHECK(hostToneHz == 1500);
+
+    // Lower priority waits for the cue to finish
+    CHECK(alerts.playTone(440, 100));
+    CHECK(hostToneHz == 1500);
+    stepTo(alerts, 240);
+    CHECK(hostToneHz == 440);
+    stepTo(alerts, 340);
+    CHECK(!alerts.isPlaying());
+}
+
+int main() {
+    RUN_TEST(testPatternFollowsClock);
+    RUN_TEST(testAlertTimingFollowsClock);
+    RUN_TEST(testPriorityPreemptsAndQueues);
+    return testExit();
+}
@@ -0,0 +1,264 @@
+/**
+ * AudioEncoder round trips against an independent decoder written from
+ * the block format (the same one tools/blackbox_extract.py implements):
+ * LPC/Rice must come back bit-exact, IMA-ADPCM within the SNR stated in
+ * audio_codec.h for each kind of signal.
+ */
+
+#include <vector>
+#include "test_support.h"
+#include "test_signals.h"
+#include "audio_codec.h"
+
+static const int RATE = 22050;      // Black box rate: SAMPLE_RATE / 2
+
+struct BitReader {
+    const uint8_t* in;
+    size_t pos;                     // In bits
+
+    uint32_t take(int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++, pos++) {
+            value = (value << 1) | ((in[pos >> 3] >> (7 - (pos & 7))) & 1);
+        }
+        return value;
+    }
+};
+
+static int32_t predictFrom(const std::vector<int16_t>& s, int n, int order) {
+    switch (order) {
+        case 1:  return s[n - 1];
+        case 2:  return 2 * s[n - 1] - s[n - 2];
+        case 3:  return 3 * s[n - 1] - 3 * s[n - 2] + s[n - 3];
+        default: return 0;
+    }
+}
+
+static size_t decodeLpcRice(const uint8_t* in, int frames, std::vector<int16_t>& out) {
+    out.clear();
+    if (in[0] == CODEC_VERBATIM) {
+        for (int n = 0; n < frames; n++) {
+            out.push_back((int16_t)(in[1 + n * 2] | (in[2 + n * 2] << 8)));
+        }
+        return 1 + frames * 2;
+    }
+
+    BitReader r = { in, 0 };
+    int order = r.take(8);
+    for (int n = 0; n < order; n++) {
+        out.push_back((int16_t)r.take(16));
+    }
+    for (int start = order; start < frames; start += CODEC_RICE_PARTITION) {
+        int end = start + CODEC_RICE_PARTITION < frames ? start + CODEC_RICE_PARTITION : frames;
+        int k = r.take(4);
+        for (int n = start; n < end; n++) {
+            int q = 0;
+            while (q < CODEC_RICE_ESCAPE && r.take(1) == 0) q++;
+            uint32_t u = q == CODEC_RICE_ESCAPE ? r.take(CODEC_RICE_RAW_BITS) : ((uint32_t)q << k) | r.take(k);
+            int32_t residual = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+            out.push_back((int16_t)(predictFrom(out, n, order) + residual));
+        }
+    }
+    return (r.pos + 7) / 8;
+}
+
+static size_t decodeAdpcm(const uint8_t* in, int frames, std::vector<int16_t>& out) {
+    out.clear();
+    int32_t predictor = (int16_t)(in[0] | (in[1] << 8));
+    int index = in[2];
+    out.push_back((int16_t)predictor);
+    for (int n = 1; n < frames; n++) {
+        uint8_t byte = in[4 + (n - 1) / 2];
+        int code = (n & 1) ? (byte & 0x0F) : (byte >> 4);
+        int step = IMA_STEP_TABLE[index];
+        int32_t delta = step >> 3;
+        if (code & 4) delta += step;
+        if (code & 2) delta += step >> 1;
+        if (code & 1) delta += step >> 2;
+        predictor += (code & 8) ? -delta : delta;
+        if (predictor > 32767) predictor = 32767;
+        if (predictor < -32768) predictor = -32768;
+        index += IMA_INDEX_TABLE[code];
+        if (index < 0) index = 0;
+        if (index > 88) index = 88;
+        out.push_back((int16_t)predictor);
+    }
+    return 4 + frames / 2;
+}
+
+/**
+ * Encode `frames`-frame blocks, decode each on its own, and return the
+ * decoded interleaved signal. `ratio` gets raw / encoded bytes.
+ */
+static std::vector<int16_t> roundTrip(AudioCodec codec, const std::vector<int16_t>& in,
+                                      int channels, int blockFrames, double* ratio) {
+    AudioEncoder encoder;
+    encoder.begin(codec, channels);
+    std::vector<uint8_t> block(encoder.maxBlockBytes(blockFrames));
+    std::vector<int16_t> out(in.size());
+    std::vector<int16_t> samples;
+    size_t encodedBytes = 0;
+
+    int total = (int)in.size() / channels;
+    for (int start = 0; start < total; start += blockFrames) {
+        int frames = total - start < blockFrames ? total - start : blockFrames;
+        int bytes = encoder.encodeBlock(&in[start * channels], frames, block.data(), (int)block.size());
+        CHECK(bytes > 0);
+        encodedBytes += bytes;
+
+        CHECK((block[0] | (block[1] << 8)) == frames);
+        CHECK((block[2] | (block[3] << 8)) == bytes - CODEC_BLOCK_HEADER);
+        size_t pos = CODEC_BLOCK_HEADER;
+        for (int ch = 0; ch < channels; ch++) {
+            pos += codec == CODEC_IMA_ADPCM ? decodeAdpcm(&block[pos], frames, samples)
+                                            : decodeLpcRice(&block[pos], frames, samples);
+            for (int n = 0; n < frames; n++) {
+                out[(start + n) * channels + ch] = samples[n];
+            }
+        }
+        CHECK(pos == (size_t)bytes);
+    }
+    if (ratio) *ratio = (double)(in.size() * sizeof(int16_t)) / encodedBytes;
+    return out;
+}
+
+static double snrDb(const std::vector<int16_t>& ref, const std::vector<int16_t>& test) {
+    double signal = 0.0;
+    double noise = 0.0;
+    for (size_t i = 0; i < ref.size(); i++) {
+        double e = (double)ref[i] - test[i];
+        signal += (double)ref[i] * ref[i];
+        noise += e * e;
+    }
+    return noise > 0.0 ? 10.0 * log10(signal / noise) : 999.0;
+}
+
+static std::vector<int16_t> tone(double hz, double amplitude, int frames) {
+    std::vector<int16_t> x(frames);
+    for (int n = 0; n < frames; n++) x[n] = (int16_t)(amplitude * sin(2.0 * M_PI * hz * n / RATE));
+    return x;
+}
+
+static std::vector<int16_t> droneHarmonics(int frames) {
+    std::vector<int16_t> x(frames);
+    for (int n = 0; n < frames; n++) {
+        double v = 0.0;
+        for (int h = 1; h <= 10; h++) v += sin(2.0 * M_PI * 180.0 * h * n / RATE + h) / h;
+        x[n] = (int16_t)(5000.0 * v);
+    }
+    return x;
+}
+
+static std::vector<int16_t> noise(double lowpass, double amplitude, int frames) {
+    std::vector<int16_t> x(frames);
+    double y = 0.0;
+    for (int n = 0; n < frames; n++) {
+        y = lowpass * y + (1.0 - lowpass) * gaussian();
+        double v = amplitude * y;
+        x[n] = (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+    }
+    return x;
+}
+
+static void testLpcRiceIsLossless() {
+    srand(1);
+    const int frames = RATE;
+    std::vector<int16_t> signals[] = {
+        tone(1000.0, 16000.0, frames),
+        droneHarmonics(frames),
+        noise(0.9, 8000.0, frames),
+        noise(0.0, 12000.0, frames),            // Mostly escapes and verbatim
+        std::vector<int16_t>(frames, 0),
+    };
+    for (auto& x : signals) {
+        double ratio = 0.0;
+        CHECK(roundTrip(CODEC_LPC_RICE, x, 1, 1024, &ratio) == x);
+        CHECK(ratio >= 0.99);                   // Verbatim fallback caps the loss
+    }
+
+    // Full-scale square wave: order-3 residuals reach the 20-bit escape
+    std::vector<int16_t> square(frames);
+    for (int n = 0; n < frames; n++) square[n] = (n / 7) & 1 ? 32767 : -32768;
+    CHECK(roundTrip(CODEC_LPC_RICE, square, 1, 1024, nullptr) == square);
+}
+
+static void testLpcRiceBlockShapes() {
+    srand(2);
+    // Four interleaved channels, odd and tiny block lengths (no room for
+    // a predictor warm-up at 1-3 frames)
+    std::vector<int16_t> x(4 * 3001);
+    for (size_t i = 0; i < x.size(); i++) x[i] = (int16_t)(4000.0 * gaussian() + 500.0 * (i % 4));
+    const int blocks[] = { 1, 2, 3, 4, 255, 257, 1024 };
+    for (int b : blocks) {
+        CHECK(roundTrip(CODEC_LPC_RICE, x, 4, b, nullptr) == x);
+    }
+}
+
+static void testLpcRiceCompresses() {
+    double ratio = 0.0;
+    roundTrip(CODEC_LPC_RICE, droneHarmonics(RATE), 1, 1024, &ratio);
+    printf("  lpc-rice drone %.2f:1\n", ratio);
+    CHECK(ratio > 1.75);
+    roundTrip(CODEC_LPC_RICE, tone(1000.0, 3000.0, RATE), 1, 1024, &ratio);
+    printf("  lpc-rice tone %.2f:1\n", ratio);
+    CHECK(ratio > 1.8);
+}
+
+static void testAdpcmSnr() {
+    srand(3);
+    const int frames = 4 * RATE;
+    struct Case {
+        const char* name;
+        std::vector<int16_t> x;
+        double minDb;
+    } cases[] = {
+        { "tone 1 kHz -6 dBFS", tone(1000.0, 16000.0, frames), 30.0 },
+        { "tone 1 kHz -21 dBFS", tone(1000.0, 3000.0, frames), 30.0 },
+        { "drone harmonics", droneHarmonics(frames), 35.0 },
+        { "low-passed noise", noise(0.9, 8000.0, frames), 22.0 },
+        { "tone 5 kHz -6 dBFS", tone(5000.0, 16000.0, frames), 16.0 },
+        { "white noise", noise(0.0, 2000.0, frames), 13.0 },
+    };
+    for (auto& c : cases) {
+        double ratio = 0.0;
+        double snr = snrDb(c.x, roundTrip(CODEC_IMA_ADPCM, c.x, 1, 1024, &ratio));
+        printf("  adpcm %-22s %5.1f dB SNR, %.2f:1\n", c.name, snr, ratio);
+        CHECK(snr >= c.minDb);
+        CHECK(ratio > 3.9);
+    }
+}
+
+static void testAdpcmChannelsIndependent() {
+    // A loud channel next to a quiet one: each keeps its own step index
+    const int frames = RATE;
+    std::vector<int16_t> loud = tone(800.0, 20000.0, frames);
+    std::vector<int16_t> quiet = tone(800.0, 200.0, frames);
+    std::vector<int16_t> x(2 * frames);
+    for (int n = 0; n < frames; n++) {
+        x[2 * n] = loud[n];
+        x[2 * n + 1] = quiet[n];
+    }
+    std::vector<int16_t> y = roundTrip(CODEC_IMA_ADPCM, x, 2, 1024, nullptr);
+    std::vector<int16_t> quietOut(frames);
+    for (int n = 0; n < frames; n++) quietOut[n] = y[2 * n + 1];
+    CHECK(snrDb(quiet, quietOut) >= 25.0);
+}
+
+static void testEncodeRejectsSmallBuffer() {
+    AudioEncoder encoder;
+    encoder.begin(CODEC_LPC_RICE, 4);
+    std::vector<int16_t> x(4 * 256, 0);
+    std::vector<uint8_t> out(encoder.maxBlockBytes(256) - 1);
+    CHECK(encoder.encodeBlock(x.data(), 256, out.data(), (int)out.size()) == 0);
+    CHECK(encoder.encodeBlock(x.data(), 0, out.data(), (int)out.size()) == 0);
+}
+
+int main() {
+    RUN_TEST(testLpcRiceIsLossless);
+    RUN_TEST(testLpcRiceBlockShapes);
+    RUN_TEST(testLpcRiceCompresses);
+    RUN_TEST(testAdpcmSnr);
+    RUN_TEST(testAdpcmChannelsIndependent);
+    RUN_TEST(testEncodeRejectsSmallBuffer);
+    return testExit();
+}
@@ -0,0 +1,207 @@
+/**
+ * BearingFusion Monte Carlo: random unit layouts and sources with
+ * FUSION_BEARING_SIGMA_DEG bearing noise, checking how often each unit
+ * count solves, how often the 95 % ellipse holds the truth, and that the
+ * error falls as units are added; then the gates (other source, stale,
+ * behind, parallel) and the report packing.
+ */
+
+#include <vector>
+#include "test_support.h"
+#include "test_signals.h"
+#include "bearing_fusion.h"
+
+static float trueBearing(double fromE, double fromN, double toE, double toN) {
+    return (float)(atan2(toE - fromE, toN - fromN) * 180.0 / M_PI);
+}
+
+static bool insideEllipse(const FusionFix& fix, double e, double n) {
+    double de = e - fix.eastM;
+    double dn = n - fix.northM;
+    double axis = fix.axisDeg * M_PI / 180.0;          // Bearing of the major axis
+    double along = de * sin(axis) + dn * cos(axis);
+    double across = de * cos(axis) - dn * sin(axis);
+    return (along * along) / (fix.majorM * fix.majorM) +
+           (across * across) / (fix.minorM * fix.minorM) <= 1.0;
+}
+
+struct Outcome {
+    int trials;
+    int solved;
+    int inside;
+    double meanErrorM;
+};
+
+/**
+ * Units uniform over a 1 km square, the source uniform over 2 km
+ */
+static Outcome monteCarlo(int units, int trials) {
+    Outcome o = { trials, 0, 0, 0.0 };
+    for (int t = 0; t < trials; t++) {
+        BearingFusion fusion;
+        double sourceE = 1000.0 * uniform(-1.0, 1.0);
+        double sourceN = 1000.0 * uniform(-1.0, 1.0);
+        for (int i = 0; i < units; i++) {
+            double e = 500.0 * uniform(-1.0, 1.0);
+            double n = 500.0 * uniform(-1.0, 1.0);
+            float bearing = trueBearing(e, n, sourceE, sourceN) +
+                            FUSION_BEARING_SIGMA_DEG * (float)gaussian();
+            fusion.submit(BearingFusion::makeReport(i + 1, t, 0, e, n, bearing, 1.0f, 180.0f), 0);
+        }
+
+        FusionFix fix;
+        if (!fusion.solve(10, &fix)) continue;
+        CHECK(fix.nodes == units);
+        o.solved++;
+        o.inside += insideEllipse(fix, sourceE, sourceN);
+        o.meanErrorM += hypot(fix.eastM - sourceE, fix.northM - sourceN);
+    }
+    if (o.solved) o.meanErrorM /= o.solved;
+    return o;
+}
+
+static void testRandomGeometry() {
+    srand(1);
+    const int units[] = { 2, 3, 4, 8, 32 };
+    double previousError = 1e9;
+    for (int n : units) {
+        Outcome o = monteCarlo(n, 2000);
+        double solved = (double)o.solved / o.trials;
+        double coverage = (double)o.inside / o.solved;
+        printf("  %2d units: solved %4d/%d, 95 %% ellipse holds %.1f %%, mean error %.0f m\n",
+               n, o.solved, o.trials, 100.0 * coverage, o.meanErrorM);
+
+        // Two lines that are near-parallel, cross behind a unit or past
+        // FUSION_MAX_RANGE_M have no fix; two lines also have no spare
+        // degree of freedom to size the ellipse from
+        CHECK(solved >= (n == 2 ? 0.76 : n == 3 ? 0.92 : n == 4 ? 0.96 : 0.99));
+        CHECK(coverage >= (n == 2 ? 0.82 : 0.92));
+        CHECK(coverage <= 0.985);
+        CHECK(o.meanErrorM < previousError);
+        previousError = o.meanErrorM;
+    }
+}
+
+static void testRingAroundSource() {
+    // Units on a 300 m ring, source just outside it: every layout solves
+    srand(2);
+    const int units[] = { 2, 3, 5, 12, 32 };
+    for (int n : units) {
+        int solved = 0;
+        int inside = 0;
+        for (int t = 0; t < 500; t++) {
+            BearingFusion fusion;
+            for (int i = 0; i < n; i++) {
+                double a = 2.0 * M_PI * i / n;
+                double e = 300.0 * cos(a);
+                double north = 300.0 * sin(a);
+                float bearing = trueBearing(e, north, 420.0, -250.0) +
+                                FUSION_BEARING_SIGMA_DEG * (float)gaussian();
+                fusion.submit(BearingFusion::makeReport(i + 1, t, 0, e, north, bearing, 1.0f, 180.0f), 0);
+            }
+            FusionFix fix;
+            if (fusion.solve(10, &fix)) {
+                solved++;
+                inside += insideEllipse(fix, 420.0, -250.0);
+            }
+        }
+        CHECK(solved == 500);
+        CHECK(inside >= (n == 2 ? 0.88 : 0.92) * solved);
+    }
+}
+
+static void testExactBearings() {
+    BearingFusion fusion;
+    const double units[][2] = { { 0, 0 }, { 400, 0 }, { 0, 400 }, { -300, -200 } };
+    for (int i = 0; i < 4; i++) {
+        float bearing = trueBearing(units[i][0], units[i][1], 250.0, 650.0);
+        fusion.submit(BearingFusion::makeReport(i + 1, 0, 0, units[i][0], units[i][1], bearing, 1.0f, 0.0f), 0);
+    }
+    FusionFix fix;
+    CHECK(fusion.solve(0, &fix));
+    CHECK_NEAR(fix.eastM, 250.0, 0.5);      // Positions in decimetres, bearings in 0.01 degree
+    CHECK_NEAR(fix.northM, 650.0, 0.5);
+    CHECK(fix.residualDeg < 0.01f);
+    CHECK(fix.nodes == 4);
+}
+
+static void testGates() {
+    BearingFusion fusion;
+    FusionFix fix;
+    fusion.submit(BearingFusion::makeReport(1, 0, 0, 0.0f, 0.0f, 45.0f, 1.0f, 200.0f), 0);
+    fusion.submit(BearingFusion::makeReport(2, 0, 0, 100.0f, 0.0f, 315.0f, 1.0f, 200.0f), 0);
+    CHECK(fusion.solve(10, &fix));
+    CHECK_NEAR(fix.eastM, 50.0, 0.2);
+    CHECK_NEAR(fix.northM, 50.0, 0.2);
+
+    // Stale reports are not fused
+    CHECK(!fusion.solve(10 + FUSION_WINDOW_MS + 1, &fix));
+
+    // Lines that cross behind a unit
+    fusion.submit(BearingFusion::makeReport(2, 1, 0, 100.0f, 0.0f, 135.0f, 1.0f, 200.0f), 0);
+    CHECK(!fusion.solve(10, &fix));
+
+    // Another source's harmonics (weaker report, f0 60 Hz off)
+    fusion.submit(BearingFusion::makeReport(2, 2, 0, 100.0f, 0.0f, 315.0f, 0.5f, 260.0f), 0);
+    CHECK(!fusion.solve(10, &fix));
+
+    // Parallel lines
+    fusion.submit(BearingFusion::makeReport(2, 3, 0, 100.0f, 0.0f, 45.0f, 1.0f, 200.0f), 0);
+    CHECK(!fusion.solve(10, &fix));
+
+    // A newer report replaces its unit's old one
+    fusion.submit(BearingFusion::makeReport(2, 4, 0, 100.0f, 0.0f, 315.0f, 1.0f, 200.0f), 0);
+    CHECK(fusion.solve(10, &fix));
+    CHECK(fusion.getNodeCount() == 2);
+
+    // Unknown versions are refused
+    BearingReport old = BearingFusion::makeReport(3, 0, 0, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+    old.version = BEARING_REPORT_VERSION - 1;
+    CHECK(!fusion.submit(old, 0));
+}
+
+static void testReportPacking() {
+    BearingReport r = BearingFusion::makeReport(7, 300, 123456, -12.34f, 3276.8f, -10.0f, 1.5f, 187.26f,
+                                                BEARING_FLAG_SHARED_TIME);
+    CHECK(r.version == BEARING_REPORT_VERSION);
+    CHECK(r.eastDm == -123);
+    CHECK(r.northDm == 32767);              // Clamped
+    CHECK(r.bearingCdeg == 35000);          // Wrapped into [0, 360)
+    CHECK(r.confidence == 255);
+    CHECK(r.f0Dhz == 1873);
+    CHECK(r.flags == BEARING_FLAG_SHARED_TIME);
+    CHECK(BearingFusion::makeReport(1, 0, 0, 0, 0, 359.999f, 1, 0).bearingCdeg == 0);
+}
+
+static void testLoopback() {
+    LoopbackBus bus;
+    LoopbackTransport a(bus, 1);
+    LoopbackTransport b(bus, 2);
+    BearingReport r = BearingFusion::makeReport(1, 0, 0, 0, 0, 90, 1, 0);
+    a.send(r);
+    BearingReport got;
+    CHECK(!a.receive(&got));                // Own reports are skipped
+    CHECK(b.receive(&got) && got.nodeId == 1);
+    CHECK(!b.receive(&got));
+
+    // A reader a whole ring behind loses the oldest reports, counted
+    for (int i = 0; i < BEARING_LOOPBACK_DEPTH + 5; i++) {
+        r.seq = i;
+        a.send(r);
+    }
+    int received = 0;
+    while (b.receive(&got)) received++;
+    CHECK(received == BEARING_LOOPBACK_DEPTH);
+    CHECK(b.getDropped() == 5);
+    CHECK(got.seq == BEARING_LOOPBACK_DEPTH + 4);
+}
+
+int main() {
+    RUN_TEST(testRandomGeometry);
+    RUN_TEST(testRingAroundSource);
+    RUN_TEST(testExactBearings);
+    RUN_TEST(testGates);
+    RUN_TEST(testReportPacking);
+    RUN_TEST(testLoopback);
+    return testExit();
+}
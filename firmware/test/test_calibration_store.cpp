@@ -0,0 +1,94 @@
+/**
+ * CalibrationStore on the file-backed host stand-in: values survive a
+ * reload, and anything stale, truncated or corrupt is ignored in favour
+ * of defaults.
+ */
+
+#include "test_support.h"
+#include "calibration_store.h"
+
+static const char* BLOB = CALIBRATION_HOST_DIR "/" CALIBRATION_NAMESPACE "." CALIBRATION_KEY;
+
+static void testSaveAndReload() {
+    CalibrationStore store;
+    store.clear();
+    CHECK(!store.begin());
+    CHECK(!store.isLoaded());
+    CHECK(store.data().micGain[2] == 1.0f);
+
+    store.data().noiseFloor[5] = -62.5f;
+    store.data().micGain[2] = 1.12f;
+    store.data().micDelay[3] = -0.4f;
+    store.data().wakeFloorDb = -48.0f;
+    CHECK(store.save());
+
+    CalibrationStore reloaded;
+    CHECK(reloaded.begin());
+    CHECK(reloaded.isLoaded());
+    CHECK(reloaded.data().noiseFloor[5] == -62.5f);
+    CHECK(reloaded.data().micGain[2] == 1.12f);
+    CHECK(reloaded.data().micDelay[3] == -0.4f);
+    CHECK(reloaded.data().wakeFloorDb == -48.0f);
+    CHECK(reloaded.data().version == CALIBRATION_VERSION);
+    CHECK(reloaded.data().melBins == MEL_BINS);
+}
+
+static void rewriteBlob(long offset, uint8_t value, long truncateTo) {
+    FILE* f = fopen(BLOB, "rb");
+    CHECK(f != nullptr);
+    if (f == nullptr) return;
+    uint8_t buf[sizeof(CalibrationData)];
+    size_t n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+
+    if (offset >= 0) buf[offset] = value;
+    if (truncateTo >= 0) n = (size_t)truncateTo;
+    f = fopen(BLOB, "wb");
+    fwrite(buf, 1, n, f);
+    fclose(f);
+}
+
+static void testRejectsBadBlobs() {
+    CalibrationStore store;
+    store.clear();
+    store.data().micGain[0] = 0.9f;
+
+    // Flipped payload byte: CRC mismatch
+    CHECK(store.save());
+    rewriteBlob(offsetof(CalibrationData, micGain), 0x5A, -1);
+    CalibrationStore corrupt;
+    CHECK(!corrupt.begin());
+    CHECK(corrupt.data().micGain[0] == 1.0f);
+
+    // Older layout
+    CHECK(store.save());
+    rewriteBlob(offsetof(CalibrationData, version), CALIBRATION_VERSION - 1, -1);
+    CalibrationStore stale;
+    CHECK(!stale.begin());
+
+    // Short write
+    CHECK(store.save());
+    rewriteBlob(-1, 0, sizeof(CalibrationData) / 2);
+    CalibrationStore truncated;
+    CHECK(!truncated.begin());
+}
+
+static void testClearRemovesBlob() {
+    CalibrationStore store;
+    store.data().wakeFloorDb = -40.0f;
+    CHECK(store.save());
+    store.clear();
+    CHECK(!store.isLoaded());
+    CHECK(store.data().wakeFloorDb == 0.0f);
+
+    CalibrationStore reloaded;
+    CHECK(!reloaded.begin());
+    CHECK(fopen(BLOB, "rb") == nullptr);
+}
+
+int main() {
+    RUN_TEST(testSaveAndReload);
+    RUN_TEST(testRejectsBadBlobs);
+    RUN_TEST(testClearRemovesBlob);
+    return testExit();
+}
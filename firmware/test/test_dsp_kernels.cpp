@@ -0,0 +1,129 @@
+/**
+ * DSP kernels against double-precision references computed here, over
+ * lengths that exercise the unrolled body, the tail and the empty case,
+ * plus in-place use and the on-device selfTest() itself.
+ *
+ * Off-target the dispatched kernels are the scalar ones; the ESP-DSP
+ * path gets the same reference comparison on the unit through selfTest()
+ * ('v' on serial).
+ */
+
+#include <stdlib.h>
+#include <vector>
+#include "test_support.h"
+#include "dsp_kernels.h"
+
+static const int LENGTHS[] = { 0, 1, 2, 3, 4, 5, 7, 8, 31, 256, 1023, HOP_SIZE };
+static const double TOLERANCE = DSP_SELFTEST_TOLERANCE;
+
+static std::vector<float> randomBlock(int n, float lo, float hi) {
+    std::vector<float> x(n);
+    for (int i = 0; i < n; i++) x[i] = lo + (hi - lo) * (rand() / (float)RAND_MAX);
+    return x;
+}
+
+static double relative(double actual, double expected) {
+    return fabs(actual - expected) / (fabs(expected) > 1e-6 ? fabs(expected) : 1e-6);
+}
+
+static void testElementwiseKernels() {
+    srand(1);
+    for (int n : LENGTHS) {
+        std::vector<float> a = randomBlock(n, -1.0f, 1.0f);
+        std::vector<float> b = randomBlock(n, -1.0f, 1.0f);
+        std::vector<float> out(n + 1, 123.0f);      // Guard past the end
+
+        DspKernels::multiply(a.data(), b.data(), out.data(), n);
+        for (int i = 0; i < n; i++) CHECK(relative(out[i], (double)a[i] * b[i]) <= TOLERANCE);
+        CHECK(out[n] == 123.0f);
+
+        DspKernels::scale(a.data(), -2.5f, out.data(), n);
+        for (int i = 0; i < n; i++) CHECK(relative(out[i], a[i] * -2.5) <= TOLERANCE);
+        CHECK(out[n] == 123.0f);
+
+        DspKernels::power(a.data(), b.data(), out.data(), n);
+        for (int i = 0; i < n; i++) {
+            CHECK(relative(out[i], (double)a[i] * a[i] + (double)b[i] * b[i]) <= TOLERANCE);
+        }
+
+        // Fast square root: within its own bound on top of the float error
+        DspKernels::magnitude(a.data(), b.data(), out.data(), n);
+        for (int i = 0; i < n; i++) {
+            double ref = sqrt((double)a[i] * a[i] + (double)b[i] * b[i]);
+            CHECK(relative(out[i], ref) <= FAST_MATH_SQRT_MAX_ERROR + TOLERANCE);
+        }
+        CHECK(out[n] == 123.0f);
+    }
+}
+
+static void testDotAndEnergy() {
+    srand(2);
+    for (int n : LENGTHS) {
+        std::vector<float> a = randomBlock(n, 0.0f, 1.0f);     // Mel-like: positive terms
+        std::vector<float> b = randomBlock(n, 0.0f, 1.0f);
+        double dot = 0.0;
+        double energy = 0.0;
+        for (int i = 0; i < n; i++) {
+            dot += (double)a[i] * b[i];
+            energy += (double)a[i] * a[i];
+        }
+        CHECK(relative(DspKernels::dot(a.data(), b.data(), n), dot) <= TOLERANCE);
+        CHECK(relative(DspKernels::energy(a.data(), n), energy) <= TOLERANCE);
+    }
+
+    // Sine of amplitude A: RMS A / sqrt(2)
+    std::vector<float> sine(FFT_SIZE);
+    for (int i = 0; i < FFT_SIZE; i++) sine[i] = 0.5f * sinf(2.0f * (float)M_PI * 16 * i / FFT_SIZE);
+    CHECK_NEAR(DspKernels::rms(sine.data(), FFT_SIZE), 0.5 / sqrt(2.0), 1e-5);
+    CHECK(DspKernels::rms(sine.data(), 0) == 0.0f);
+}
+
+static void testInPlace() {
+    srand(3);
+    const int n = 257;
+    std::vector<float> a = randomBlock(n, -1.0f, 1.0f);
+    std::vector<float> b = randomBlock(n, -1.0f, 1.0f);
+
+    std::vector<float> x = a;
+    DspKernels::multiply(x.data(), b.data(), x.data(), n);
+    for (int i = 0; i < n; i++) CHECK(relative(x[i], (double)a[i] * b[i]) <= TOLERANCE);
+
+    x = a;
+    DspKernels::scale(x.data(), 3.0f, x.data(), n);
+    for (int i = 0; i < n; i++) CHECK(relative(x[i], a[i] * 3.0) <= TOLERANCE);
+
+    x = a;
+    DspKernels::magnitude(x.data(), b.data(), x.data(), n);
+    for (int i = 0; i < n; i++) {
+        CHECK(relative(x[i], sqrt((double)a[i] * a[i] + (double)b[i] * b[i])) <=
+              FAST_MATH_SQRT_MAX_ERROR + TOLERANCE);
+    }
+}
+
+static void testInt32ToFloat() {
+    // Left-aligned 24-bit I2S words; the shift floors negatives
+    const int32_t raw[] = { 0, 0x7FFFFF00, (int32_t)0x80000000, 0x00000100, -0x100, -1, 0x12345678 };
+    const int n = sizeof(raw) / sizeof(raw[0]);
+    float out[n];
+    DspKernels::int32ToFloat(raw, 8, 1.0f / 8388608.0f, out, n);
+    for (int i = 0; i < n; i++) {
+        CHECK_NEAR(out[i], floor(raw[i] / 256.0) / 8388608.0, 1e-9);
+    }
+    CHECK(out[1] < 1.0f);
+    CHECK(out[2] == -1.0f);
+    CHECK(out[5] == -1.0f / 8388608.0f);
+}
+
+static void testSelfTestPasses() {
+    std::vector<float> scratch(4 * DSP_SELFTEST_SAMPLES);
+    CHECK(DspKernels::selfTest(scratch.data()));
+}
+
+int main() {
+    RUN_TEST(testElementwiseKernels);
+    RUN_TEST(testDotAndEnergy);
+    RUN_TEST(testInPlace);
+    RUN_TEST(testInt32ToFloat);
+    RUN_TEST(testSelfTestPasses);
+    return testExit();
+}
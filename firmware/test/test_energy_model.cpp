@@ -0,0 +1,163 @@
+/**
+ * EnergyModel fed the way PowerManager feeds it: per-hop stage times go
+ * into the Profiler, and each capture books the change in its HOP and
+ * CAPTURE totals - hop time active at the governed clock, capture time
+ * idle, the rest of the wall time at the minimum clock. Replays a quiet
+ * watch, an alert and a mix of the two, and checks the average draw and
+ * runtime against the figures worked by hand, then the per-clock
+ * interpolation on its own.
+ */
+
+#include <vector>
+#include "test_support.h"
+#include "profiler.h"
+#include "energy_model.h"
+
+static const uint32_t HOP_US = (uint32_t)((uint64_t)HOP_SIZE * 1000000 / SAMPLE_RATE);
+static const float PACK_V = 7.4f;
+
+struct Hop {
+    uint32_t hopUs;             // STAGE_HOP
+    uint32_t captureUs;         // STAGE_CAPTURE
+};
+
+/**
+ * Stage times of a profiler trace, hop after hop: quiet at 80 MHz the
+ * burst is short and the loop waits out most of the hop in i2s_read;
+ * alerting at 240 MHz inference and display take most of it
+ */
+static const Hop QUIET[] = {
+    { 4210, 7080 }, { 4390, 6910 }, { 4180, 7120 }, { 4530, 6760 },
+    { 4260, 7030 }, { 4170, 7130 }, { 4880, 6420 }, { 4220, 7070 },
+};
+static const Hop ALERT[] = {
+    { 8940, 2350 }, { 9310, 1980 }, { 8870, 2420 }, { 9620, 1690 },
+    { 9050, 2240 }, { 8990, 2300 }, { 10140, 1170 }, { 9000, 2290 },
+};
+static const int TRACE = 8;
+
+/**
+ * PowerManager::account() off-target: wall time is the hop period, the
+ * loop's own time between reads is what neither stage covers
+ */
+class Replay {
+public:
+    Replay() {
+        Profiler::instance().reset();
+        _hopTotal = 0;
+        _captureTotal = 0;
+    }
+
+    void run(const Hop* trace, int hops, int cpuMhz) {
+        Profiler& profiler = Profiler::instance();
+        for (int i = 0; i < hops; i++) {
+            const Hop& h = trace[i % TRACE];
+            profiler.record(STAGE_CAPTURE, h.captureUs);
+            profiler.record(STAGE_HOP, h.hopUs);
+
+            uint32_t active = (uint32_t)(profiler.getTotalUs(STAGE_HOP) - _hopTotal);
+            uint32_t idle = (uint32_t)(profiler.getTotalUs(STAGE_CAPTURE) - _captureTotal);
+            energy.addActive(cpuMhz, active);
+            energy.addIdle(idle);
+            energy.addActive(CPU_FREQ_MIN_MHZ, HOP_US - active - idle);
+            _hopTotal = profiler.getTotalUs(STAGE_HOP);
+            _captureTotal = profiler.getTotalUs(STAGE_CAPTURE);
+        }
+    }
+
+    EnergyModel energy;
+
+private:
+    uint64_t _hopTotal;
+    uint64_t _captureTotal;
+};
+
+/**
+ * Pack draw worked by hand from the trace means
+ */
+static double expectedMw(const Hop* trace, float activeMw) {
+    double hop = 0.0;
+    double capture = 0.0;
+    for (int i = 0; i < TRACE; i++) {
+        hop += trace[i].hopUs / (double)TRACE;
+        capture += trace[i].captureUs / (double)TRACE;
+    }
+    double rest = HOP_US - hop - capture;
+    double coreMw = (activeMw * hop + ENERGY_IDLE_MW * capture + ENERGY_ACTIVE_80MHZ_MW * rest) / HOP_US;
+    return (coreMw + ENERGY_PERIPHERALS_MW) / ENERGY_CONVERTER_EFFICIENCY;
+}
+
+static void testQuietWatch() {
+    // A minute of hops
+    Replay replay;
+    int hops = 60 * SAMPLE_RATE / HOP_SIZE / TRACE * TRACE;
+    replay.run(QUIET, hops, 80);
+    double want = expectedMw(QUIET, ENERGY_ACTIVE_80MHZ_MW);
+    float mw = replay.energy.averagePowerMw();
+    float hours = replay.energy.predictRuntimeHours(BATTERY_CAPACITY_MAH, PACK_V);
+    printf("  quiet at 80 MHz: %.1f mW, %.0f %% active, %.2f h\n",
+           mw, 100.0f * replay.energy.activeFraction(), hours);
+    CHECK_NEAR(mw, want, 0.01);
+    CHECK_NEAR(hours, BATTERY_CAPACITY_MAH * PACK_V / want, 0.001);
+    CHECK(replay.energy.activeFraction() > 0.35f && replay.energy.activeFraction() < 0.45f);
+}
+
+static void testAlert() {
+    Replay replay;
+    replay.run(ALERT, 512, 240);
+    double want = expectedMw(ALERT, ENERGY_ACTIVE_240MHZ_MW);
+    float mw = replay.energy.averagePowerMw();
+    printf("  alert at 240 MHz: %.1f mW, %.0f %% active, %.2f h\n",
+           mw, 100.0f * replay.energy.activeFraction(),
+           replay.energy.predictRuntimeHours(BATTERY_CAPACITY_MAH, PACK_V));
+    CHECK_NEAR(mw, want, 0.01);
+    CHECK(replay.energy.activeFraction() > 0.8f);
+}
+
+static void testMixedWatch() {
+    // Nine parts quiet to one alerting: the averages weight by time
+    Replay replay;
+    replay.run(QUIET, 9 * 512, 80);
+    replay.run(ALERT, 512, 240);
+    double want = 0.9 * expectedMw(QUIET, ENERGY_ACTIVE_80MHZ_MW) +
+                  0.1 * expectedMw(ALERT, ENERGY_ACTIVE_240MHZ_MW);
+    float mw = replay.energy.averagePowerMw();
+    printf("  90 %% quiet, 10 %% alert: %.1f mW, %.2f h\n",
+           mw, replay.energy.predictRuntimeHours(BATTERY_CAPACITY_MAH, PACK_V));
+    CHECK_NEAR(mw, want, 0.01);
+
+    // Quieter is longer, and nothing is on the clock before any time is booked
+    Replay quiet;
+    quiet.run(QUIET, 512, 80);
+    CHECK(quiet.energy.predictRuntimeHours(BATTERY_CAPACITY_MAH, PACK_V) >
+          replay.energy.predictRuntimeHours(BATTERY_CAPACITY_MAH, PACK_V));
+    replay.energy.reset();
+    CHECK(replay.energy.averagePowerMw() == 0.0f);
+    CHECK(replay.energy.predictRuntimeHours(BATTERY_CAPACITY_MAH, PACK_V) == 0.0f);
+}
+
+static void testClockSteps() {
+    // Linear between the characterized clocks, clamped outside them
+    const int mhz[] = { 40, 80, 120, 160, 200, 240, 320 };
+    const float want[] = {
+        ENERGY_ACTIVE_80MHZ_MW, ENERGY_ACTIVE_80MHZ_MW,
+        (ENERGY_ACTIVE_80MHZ_MW + ENERGY_ACTIVE_160MHZ_MW) / 2, ENERGY_ACTIVE_160MHZ_MW,
+        (ENERGY_ACTIVE_160MHZ_MW + ENERGY_ACTIVE_240MHZ_MW) / 2, ENERGY_ACTIVE_240MHZ_MW,
+        ENERGY_ACTIVE_240MHZ_MW,
+    };
+    for (int i = 0; i < 7; i++) {
+        EnergyModel model;
+        model.addActive(mhz[i], 1000000);
+        double coreMw = model.averagePowerMw() * ENERGY_CONVERTER_EFFICIENCY - ENERGY_PERIPHERALS_MW;
+        CHECK_NEAR(coreMw, want[i], 0.01);
+        CHECK(model.activeFraction() == 1.0f);
+    }
+}
+
+int main() {
+    RUN_TEST(testQuietWatch);
+    RUN_TEST(testAlert);
+    RUN_TEST(testMixedWatch);
+    RUN_TEST(testClockSteps);
+    return testExit();
+}
@@ -0,0 +1,111 @@
+/**
+ * FastMath approximations against double-precision libm, for the bounds
+ * stated in fast_math.h: every mantissa at the lowest, unit and highest
+ * normal exponents, the exact points, every direction of atan2 over
+ * radii far outside what the bearings produce, and selfTest() itself.
+ */
+
+#include <vector>
+#include "test_support.h"
+#include "fast_math.h"
+
+static const int EXPONENTS[] = { 1, 127, 254 };     // 2^-126, 1, 2^127
+
+static void testLog2Bound() {
+    double worst = 0.0;
+    for (int e : EXPONENTS) {
+        for (uint32_t m = 0; m < (1u << 23); m++) {
+            float x = FastMath::Approx::fromBits(((uint32_t)e << 23) | m);
+            worst = fmax(worst, fabs(FastMath::Approx::log2(x) - log2((double)x)));
+        }
+    }
+    printf("  log2 max error %.2e octaves\n", worst);
+    CHECK(worst <= FAST_MATH_LOG2_MAX_ERROR);
+
+    // Exact at powers of two, so whole-octave steps (block exponents,
+    // dB offsets) add nothing
+    for (int p = -126; p <= 127; p++) {
+        CHECK(FastMath::Approx::log2(ldexpf(1.0f, p)) == (float)p);
+    }
+}
+
+static void testDbConversions() {
+    const float values[] = { 1e-10f, 1e-3f, 0.5f, 1.0f, 2.0f, 1234.5f, 1e12f };
+    for (float v : values) {
+        CHECK_NEAR(FastMath::db20(v), 20.0 * log10((double)v),
+                   FAST_MATH_DB20_PER_OCTAVE * FAST_MATH_LOG2_MAX_ERROR + 1e-4);
+        CHECK_NEAR(FastMath::db10(v), 10.0 * log10((double)v),
+                   FAST_MATH_DB10_PER_OCTAVE * FAST_MATH_LOG2_MAX_ERROR + 1e-4);
+    }
+}
+
+static void testSqrtBound() {
+    double worst = 0.0;
+    for (int e : EXPONENTS) {
+        for (uint32_t m = 0; m < (1u << 23); m++) {
+            float x = FastMath::Approx::fromBits(((uint32_t)e << 23) | m);
+            double ref = sqrt((double)x);
+            worst = fmax(worst, fabs(FastMath::Approx::sqrt(x) - ref) / ref);
+        }
+    }
+    printf("  sqrt max relative error %.2e\n", worst);
+    CHECK(worst <= FAST_MATH_SQRT_MAX_ERROR);
+
+    // Silent bins stay silent
+    CHECK(FastMath::Approx::sqrt(0.0f) == 0.0f);
+}
+
+static void testAtan2Bound() {
+    const double radii[] = { 1e-30, 1e-3, 1.0, 1e3, 1e30 };
+    const int steps = 1 << 20;
+    double worst = 0.0;
+    for (int i = 0; i < steps; i++) {
+        double angle = -M_PI + 2.0 * M_PI * i / steps;
+        for (double r : radii) {
+            float y = (float)(r * sin(angle));
+            float x = (float)(r * cos(angle));
+            double e = fabs(FastMath::Approx::atan2(y, x) - atan2((double)y, (double)x));
+            if (e > M_PI) e = fabs(e - 2.0 * M_PI);     // +-pi are the same direction
+            worst = fmax(worst, e);
+        }
+    }
+    printf("  atan2 max error %.2e rad\n", worst);
+    CHECK(worst <= FAST_MATH_ATAN2_MAX_ERROR);
+
+    // Axes, diagonals and the origin
+    CHECK_NEAR(FastMath::Approx::atan2(0.0f, 1.0f), 0.0, 1e-7);
+    CHECK_NEAR(FastMath::Approx::atan2(1.0f, 0.0f), M_PI / 2, FAST_MATH_ATAN2_MAX_ERROR);
+    CHECK_NEAR(FastMath::Approx::atan2(-1.0f, 0.0f), -M_PI / 2, FAST_MATH_ATAN2_MAX_ERROR);
+    CHECK_NEAR(fabs(FastMath::Approx::atan2(0.0f, -1.0f)), M_PI, FAST_MATH_ATAN2_MAX_ERROR);
+    CHECK_NEAR(FastMath::Approx::atan2(1.0f, 1.0f), M_PI / 4, FAST_MATH_ATAN2_MAX_ERROR);
+    CHECK_NEAR(FastMath::Approx::atan2(-1.0f, -1.0f), -3 * M_PI / 4, FAST_MATH_ATAN2_MAX_ERROR);
+    CHECK(FastMath::Approx::atan2(0.0f, 0.0f) == 0.0f);
+}
+
+static void testDispatch() {
+    // The entry points the signal path calls follow FAST_MATH_ENABLED
+#if FAST_MATH_ENABLED
+    CHECK(FastMath::log2(3.0f) == FastMath::Approx::log2(3.0f));
+    CHECK(FastMath::sqrt(3.0f) == FastMath::Approx::sqrt(3.0f));
+    CHECK(FastMath::atan2(1.0f, 3.0f) == FastMath::Approx::atan2(1.0f, 3.0f));
+#else
+    CHECK(FastMath::log2(3.0f) == log2f(3.0f));
+    CHECK(FastMath::sqrt(3.0f) == sqrtf(3.0f));
+    CHECK(FastMath::atan2(1.0f, 3.0f) == atan2f(1.0f, 3.0f));
+#endif
+}
+
+static void testSelfTestPasses() {
+    std::vector<float> scratch(2 * (FFT_SIZE / 2 + 1));
+    CHECK(FastMath::selfTest(scratch.data()));
+}
+
+int main() {
+    RUN_TEST(testLog2Bound);
+    RUN_TEST(testDbConversions);
+    RUN_TEST(testSqrtBound);
+    RUN_TEST(testAtan2Bound);
+    RUN_TEST(testDispatch);
+    RUN_TEST(testSelfTestPasses);
+    return testExit();
+}
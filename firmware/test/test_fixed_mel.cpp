@@ -0,0 +1,277 @@
+/**
+ * FixedMelFrontend against a double-precision DFT of the same window and
+ * filterbank, for the bounds stated in fixed_mel.h: how close bands stay
+ * relative to the block's loudest one, what broadband input gives from
+ * 0 to -80 dBFS, and that the DC band under a full-scale tone is not
+ * lifted by rounding bias.
+ *
+ * The window and filterbank are built here the way AudioProcessor builds
+ * them (it needs the Arduino core and arduinoFFT, so it is not compiled).
+ */
+
+#include <vector>
+#include "test_support.h"
+#include "test_signals.h"
+#include "fixed_mel.h"
+
+static const int BINS = FIXED_MEL_FFT_BINS;
+
+static std::vector<float> window(FFT_SIZE);
+static std::vector<float> filterbank(MEL_BINS * BINS);
+static std::vector<double> cosTable(FFT_SIZE);
+static std::vector<double> sinTable(FFT_SIZE);
+
+static float hzToMel(float hz) { return 2595.0f * log10f(1.0f + hz / 700.0f); }
+static float melToHz(float mel) { return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f); }
+
+static void buildTables() {
+    for (int i = 0; i < FFT_SIZE; i++) {
+        window[i] = 0.5f * (1.0f - cosf(2.0f * (float)M_PI * i / (FFT_SIZE - 1)));
+        cosTable[i] = cos(2.0 * M_PI * i / FFT_SIZE);
+        sinTable[i] = sin(2.0 * M_PI * i / FFT_SIZE);
+    }
+
+    float melMax = hzToMel(SAMPLE_RATE / 2.0f);
+    int points[MEL_BINS + 2];
+    for (int i = 0; i < MEL_BINS + 2; i++) {
+        int bin = (int)(melToHz(melMax * i / (MEL_BINS + 1)) / (SAMPLE_RATE / 2.0f) * BINS);
+        points[i] = bin < 0 ? 0 : (bin > BINS - 1 ? BINS - 1 : bin);
+    }
+    for (int m = 0; m < MEL_BINS; m++) {
+        int start = points[m], center = points[m + 1], end = points[m + 2];
+        for (int k = start; k < center; k++) {
+            filterbank[m * BINS + k] = (float)(k - start) / (center - start);
+        }
+        for (int k = center; k <= end && end != center; k++) {
+            filterbank[m * BINS + k] = (float)(end - k) / (end - center);
+        }
+    }
+}
+
+/**
+ * Mel bands in dB of `x` (full scale 1.0), same units as project()
+ */
+static void referenceMel(const std::vector<double>& x, double* melDb) {
+    std::vector<double> windowed(FFT_SIZE);
+    for (int n = 0; n < FFT_SIZE; n++) windowed[n] = x[n] * window[n];
+
+    std::vector<double> magnitude(BINS);
+    for (int k = 0; k < BINS; k++) {
+        double re = 0.0, im = 0.0;
+        for (int n = 0, phase = 0; n < FFT_SIZE; n++, phase = (phase + k) & (FFT_SIZE - 1)) {
+            re += windowed[n] * cosTable[phase];
+            im -= windowed[n] * sinTable[phase];
+        }
+        magnitude[k] = sqrt(re * re + im * im);
+    }
+    for (int m = 0; m < MEL_BINS; m++) {
+        double sum = 0.0;
+        for (int k = 0; k < BINS; k++) sum += filterbank[m * BINS + k] * magnitude[k];
+        melDb[m] = 20.0 * log10(sum > 1e-10 ? sum : 1e-10);
+    }
+}
+
+static int referenceCode(double db) {
+    double q = (db - MEL_DB_FLOOR) * 255.0 / MEL_DB_RANGE;
+    return q < 0.0 ? 0 : (q > 255.0 ? 255 : (int)q);
+}
+
+struct Block {
+    std::vector<double> x;          // What the 24-bit words hold
+    std::vector<int32_t> raw;       // Left-aligned I2S words
+    std::vector<float> samples;
+};
+
+/**
+ * Scale `shape` so its peak sits at `levelDb` dBFS and quantize it to
+ * 24-bit I2S words, keeping the exact values for the reference
+ */
+static Block makeBlock(const std::vector<double>& shape, double levelDb) {
+    double peak = 0.0;
+    for (double v : shape) peak = fmax(peak, fabs(v));
+    double scale = pow(10.0, levelDb / 20.0) * 8388607.0 / peak;
+
+    Block b;
+    for (double v : shape) {
+        long word = lrint(v * scale);
+        b.raw.push_back((int32_t)(word * 256));
+        b.x.push_back(word / 8388608.0);
+        b.samples.push_back((float)(word / 8388608.0));
+    }
+    return b;
+}
+
+static std::vector<double> tone(double hz, double phase) {
+    std::vector<double> x(FFT_SIZE);
+    for (int n = 0; n < FFT_SIZE; n++) x[n] = sin(2.0 * M_PI * hz * n / SAMPLE_RATE + phase);
+    return x;
+}
+
+static std::vector<double> whiteNoise() {
+    std::vector<double> x(FFT_SIZE);
+    for (double& v : x) v = gaussian();
+    return x;
+}
+
+static std::vector<double> droneOverBackground(double fundamental) {
+    std::vector<double> x(FFT_SIZE);
+    double background = 0.0;
+    for (int n = 0; n < FFT_SIZE; n++) {
+        double v = 0.0;
+        for (int h = 1; h <= 10; h++) v += sin(2.0 * M_PI * fundamental * h * n / SAMPLE_RATE + h) / h;
+        background = 0.9 * background + 0.1 * gaussian();
+        x[n] = v + 0.05 * background;
+    }
+    return x;
+}
+
+static FixedMelFrontend frontend;
+
+static void runBoth(const Block& b, int16_t* fromInt32, int16_t* fromFloat) {
+    frontend.loadInt32(b.raw.data(), FFT_SIZE, 8);
+    frontend.compute(fromInt32);
+    frontend.loadFloat(b.samples.data(), FFT_SIZE);
+    frontend.compute(fromFloat);
+}
+
+static void testRelativeToLoudestBand() {
+    const double hz[] = { 180.0, 440.0, 1000.0, 3000.0, 7000.0, 15000.0 };
+    const double levels[] = { 0.0, -1.0, -6.0, -20.0, -40.0, -60.0, -80.0 };
+    const double phases[] = { 0.0, 1.1, 2.3 };
+    double within50 = 0.0;
+    double within60 = 0.0;
+
+    for (double f : hz) {
+        for (double level : levels) {
+            for (double phase : phases) {
+                Block b = makeBlock(tone(f, phase), level);
+                double ref[MEL_BINS];
+                referenceMel(b.x, ref);
+                double loudest = ref[0];
+                for (int m = 1; m < MEL_BINS; m++) loudest = fmax(loudest, ref[m]);
+
+                int16_t q[2][MEL_BINS];
+                runBoth(b, q[0], q[1]);
+                for (int path = 0; path < 2; path++) {
+                    for (int m = 0; m < MEL_BINS; m++) {
+                        double error = fabs(q[path][m] / 256.0 - ref[m]);
+                        if (ref[m] >= loudest - 50.0) within50 = fmax(within50, error);
+                        if (ref[m] >= loudest - 60.0) within60 = fmax(within60, error);
+                    }
+                }
+            }
+        }
+    }
+    printf("  tones: %.2f dB within 50 dB of the loudest band, %.2f dB within 60 dB\n",
+           within50, within60);
+    CHECK(within50 <= 0.4);
+    CHECK(within60 <= 1.3);
+}
+
+static void testBroadbandLevels() {
+    srand(1);
+    const double levels[] = { 0.0, -1.0, -6.0, -20.0, -40.0, -60.0, -80.0 };
+    for (double level : levels) {
+        double worstDb = 0.0;
+        int worstCodes = 0;
+        for (int trial = 0; trial < 4; trial++) {
+            Block blocks[] = {
+                makeBlock(whiteNoise(), level),
+                makeBlock(droneOverBackground(170.0 + 7.0 * trial), level),
+            };
+            for (const Block& b : blocks) {
+                double ref[MEL_BINS];
+                referenceMel(b.x, ref);
+                double loudest = ref[0];
+                for (int m = 1; m < MEL_BINS; m++) loudest = fmax(loudest, ref[m]);
+
+                int16_t q[2][MEL_BINS];
+                runBoth(b, q[0], q[1]);
+                for (int path = 0; path < 2; path++) {
+                    for (int m = 0; m < MEL_BINS; m++) {
+                        // Single-bin bands of noise can null out past the
+                        // 16-bit floor; those are covered by the tone test
+                        if (ref[m] < loudest - 60.0) continue;
+                        worstDb = fmax(worstDb, fabs(q[path][m] / 256.0 - ref[m]));
+                        int codes = abs(FixedMelFrontend::quantizeDbQ8(q[path][m]) - referenceCode(ref[m]));
+                        if (codes > worstCodes) worstCodes = codes;
+                    }
+                }
+            }
+        }
+        printf("  broadband %4.0f dBFS: %.2f dB, %d codes\n", level, worstDb, worstCodes);
+        CHECK(worstDb <= 2.5);
+        CHECK(worstCodes <= 8);
+    }
+}
+
+static void testFullScaleDcBand() {
+    // Band 0 is the DC bin alone. Under a full-scale tone well away from
+    // DC the true bin is 20 dB or more under one LSB of the block, so it
+    // must round to zero; biased rounding used to leave one LSB there,
+    // a DC band 20+ dB too loud
+    const double hz[] = { 1000.0, 3000.0, 7000.0 };
+    for (double f : hz) {
+        for (int i = 0; i < 8; i++) {
+            for (double level : { 0.0, -1.0 }) {
+                Block b = makeBlock(tone(f, 0.4 * i), level);
+                int16_t q[MEL_BINS];
+                frontend.loadInt32(b.raw.data(), FFT_SIZE, 8);
+                frontend.compute(q);
+                CHECK(frontend.magnitude(0) == 0);
+                frontend.loadFloat(b.samples.data(), FFT_SIZE);
+                frontend.compute(q);
+                CHECK(frontend.magnitude(0) == 0);
+            }
+        }
+    }
+
+    // Full-scale DC itself: the largest bin 0 the loaders can produce
+    const double offsets[] = { 1.0, -1.0, 0.5, -0.5 };
+    for (double offset : offsets) {
+        std::vector<double> shape(FFT_SIZE, offset);
+        if (fabs(offset) < 1.0) {
+            for (int n = 0; n < FFT_SIZE; n++) shape[n] += 0.49 * sin(2.0 * M_PI * 1000.0 * n / SAMPLE_RATE);
+        }
+        double peak = 0.0;
+        for (double v : shape) peak = fmax(peak, fabs(v));
+        Block b = makeBlock(shape, 20.0 * log10(peak));
+        double ref[MEL_BINS];
+        referenceMel(b.x, ref);
+        int16_t q[2][MEL_BINS];
+        runBoth(b, q[0], q[1]);
+        for (int path = 0; path < 2; path++) {
+            CHECK_NEAR(q[path][0] / 256.0, ref[0], 0.05);
+            CHECK_NEAR(q[path][1] / 256.0, ref[1], 0.05);
+        }
+    }
+}
+
+static void testSilenceAndGain() {
+    std::vector<int32_t> silence(FFT_SIZE, 0);
+    int16_t q[MEL_BINS];
+    frontend.loadInt32(silence.data(), FFT_SIZE, 8);
+    frontend.compute(q);
+    for (int m = 0; m < MEL_BINS; m++) CHECK(q[m] == FIXED_MEL_DB_MIN_Q8);
+    CHECK(FixedMelFrontend::quantizeDbQ8(q[0]) == 0);
+
+    // The capture trim lands on every band unchanged
+    Block b = makeBlock(whiteNoise(), -20.0);
+    int16_t plain[MEL_BINS];
+    int16_t trimmed[MEL_BINS];
+    frontend.loadInt32(b.raw.data(), FFT_SIZE, 8);
+    frontend.compute(plain);
+    frontend.loadInt32(b.raw.data(), FFT_SIZE, 8, 3 * 256);
+    frontend.compute(trimmed);
+    for (int m = 0; m < MEL_BINS; m++) CHECK(trimmed[m] - plain[m] == 3 * 256);
+}
+
+int main() {
+    buildTables();
+    CHECK(frontend.begin(window.data(), filterbank.data()));
+    RUN_TEST(testRelativeToLoudestBand);
+    RUN_TEST(testBroadbandLevels);
+    RUN_TEST(testFullScaleDcBand);
+    RUN_TEST(testSilenceAndGain);
+    return testExit();
+}
@@ -0,0 +1,231 @@
+/**
+ * MeshLink over MemoryAir: airtime per bearing for two units, then 30
+ * units on a line (each hears two either side) and all in range of each
+ * other, at 0, 20 and 40 % frame loss, every unit sending four bearings
+ * a second and one of them a cue. Checks what arrives, how far the cue
+ * reaches, and that frames stay well under MESH_FRAMES_PER_S with relays
+ * suppressed rather than flooded; then dedup and time messages.
+ */
+
+#include <memory>
+#include <vector>
+#include "test_support.h"
+#include "mesh_link.h"
+
+static const int SPACING_M = 100;
+static const int RANGE_M = 250;
+
+static bool onLine(int from, int to) {
+    return abs(from - to) * SPACING_M <= RANGE_M;
+}
+
+struct Site {
+    MemoryAir air;
+    std::vector<std::unique_ptr<MemoryRadio>> radios;
+    std::vector<std::unique_ptr<MeshLink>> links;
+    std::vector<int> bearings;              // Delivered, per unit
+    std::vector<int> cues;
+
+    Site(int units, float loss, bool (*inRange)(int, int)) : air(loss, 7), bearings(units), cues(units) {
+        air.setRange(inRange);
+        for (int i = 0; i < units; i++) {
+            radios.emplace_back(new MemoryRadio(air));
+            links.emplace_back(new MeshLink(*radios[i], i + 1));
+        }
+    }
+
+    /**
+     * durationMs of 5 ms loop passes; a bearing from every unit each
+     * 250 ms, staggered a pass apart, and a cue from `cueFrom` (-1: none)
+     * at 1 s
+     */
+    void run(uint32_t durationMs, int cueFrom) {
+        int units = (int)links.size();
+        std::vector<uint16_t> seq(units);
+        for (uint32_t t = 0; t < durationMs; t += 5) {
+            air.setTime(t * 1000ull);
+            if (t == 1000 && cueFrom >= 0) links[cueFrom]->sendAlert(t, 123.4f, 0.9f);
+            for (int i = 0; i < units; i++) {
+                if (t % 250 == (uint32_t)(5 * i) % 250) {
+                    links[i]->send(BearingFusion::makeReport(i + 1, seq[i]++, t, i * SPACING_M, 0, 45, 0.8f, 180));
+                }
+            }
+            for (int i = 0; i < units; i++) {
+                links[i]->poll(t);
+                BearingReport r;
+                while (links[i]->receive(&r)) bearings[i]++;
+                AlertCue c;
+                while (links[i]->receiveAlert(&c)) cues[i]++;
+            }
+        }
+    }
+
+    uint32_t overflows() {
+        uint32_t sum = 0;
+        for (auto& radio : radios) sum += radio->getOverflows();
+        return sum;
+    }
+
+    MeshStats total() {
+        MeshStats sum = {};
+        for (auto& link : links) {
+            const MeshStats& s = link->getStats();
+            sum.framesSent += s.framesSent;
+            sum.duplicates += s.duplicates;
+            sum.relayed += s.relayed;
+            sum.suppressed += s.suppressed;
+            sum.rateLimited += s.rateLimited;
+            sum.dropped += s.dropped;
+        }
+        return sum;
+    }
+};
+
+static void testTwoUnits() {
+    // Nothing to batch with: one frame per bearing, none relayed
+    Site site(2, 0.0f, nullptr);
+    site.run(20000, -1);
+    MeshStats s = site.total();
+    double framesPerBearing = s.framesSent / (2.0 * 80);
+    printf("  2 units: %.2f frames per bearing\n", framesPerBearing);
+    CHECK(site.bearings[0] == 80 && site.bearings[1] == 80);
+    CHECK(framesPerBearing <= 1.01);
+    CHECK(s.relayed == 0);
+    CHECK(s.rateLimited == 0);
+}
+
+static void testLine() {
+    const float losses[] = { 0.0f, 0.2f, 0.4f };
+    const int units = 30;
+    const int cueFrom = 15;
+    for (float loss : losses) {
+        Site site(units, loss, onLine);
+        site.run(20000, cueFrom);
+        MeshStats s = site.total();
+
+        int reached = 0;
+        int beyond = 0;
+        int expected = 0;
+        long delivered = 0;
+        for (int i = 0; i < units; i++) {
+            CHECK(site.cues[i] <= 1);           // Repeats and relays deduplicated
+            if (i == cueFrom || !site.cues[i]) continue;
+            reached++;
+            // Direct range plus MESH_TTL relay hops, two units each
+            if (abs(i - cueFrom) > 2 * (MESH_TTL + 1)) beyond++;
+        }
+        for (int i = 0; i < units; i++) {
+            for (int j = 0; j < units; j++) {
+                if (j != i && onLine(j, i)) expected += 80;
+            }
+            delivered += site.bearings[i];
+        }
+        double framesPerUnit = s.framesSent / (units * 20.0);
+        printf("  line, %2.0f %% loss: cue reached %d, %ld/%d bearings, %.2f frames/s per unit, "
+               "%u relayed (%u suppressed), %u rate-limited\n",
+               100.0f * loss, reached, delivered, expected, framesPerUnit,
+               s.relayed, s.suppressed, s.rateLimited);
+
+        // Bearings stay one hop, so fusion sees the units that hear each other
+        CHECK(delivered <= expected);
+        CHECK(delivered >= 0.95 * (1.0 - loss) * expected);
+        CHECK(beyond == 0);
+        CHECK(reached >= (loss == 0.0f ? 2 * (MESH_TTL + 1) * 2 : 8));
+        CHECK(framesPerUnit < 0.5 * MESH_FRAMES_PER_S);
+        CHECK(s.rateLimited == 0);
+        CHECK(s.dropped == 0);
+        CHECK(site.overflows() == 0);
+    }
+}
+
+static void testAllInRange() {
+    // Every unit hears the cue first-hand: the relays it queues are
+    // cancelled by the first few that go out
+    const float losses[] = { 0.0f, 0.2f, 0.4f };
+    const int units = 30;
+    for (float loss : losses) {
+        Site site(units, loss, nullptr);
+        site.run(20000, 0);
+        MeshStats s = site.total();
+
+        int reached = 0;
+        for (int i = 1; i < units; i++) reached += site.cues[i] > 0;
+        long delivered = 0;
+        for (int b : site.bearings) delivered += b;
+        long expected = (long)units * (units - 1) * 80;
+        double framesPerUnit = s.framesSent / (units * 20.0);
+        printf("  all in range, %2.0f %% loss: cue reached %d, %ld/%ld bearings, %.2f frames/s per unit, "
+               "%u relayed (%u suppressed), %u rate-limited\n",
+               100.0f * loss, reached, delivered, expected, framesPerUnit,
+               s.relayed, s.suppressed, s.rateLimited);
+
+        CHECK(reached == units - 1);
+        CHECK(delivered >= 0.95 * (1.0 - loss) * expected);
+        CHECK(framesPerUnit < 0.5 * MESH_FRAMES_PER_S);
+        CHECK(s.relayed - s.suppressed <= 10);
+        CHECK(s.rateLimited == 0);
+        CHECK(site.overflows() == 0);
+    }
+}
+
+static bool adjacent(int from, int to) {
+    return abs(from - to) <= 1;
+}
+
+static void testTimeNotRelayed() {
+    // Three units in a row: the middle one hears both ends, the ends
+    // only it
+    Site site(3, 0.0f, adjacent);
+    TimeMessage m = {};
+    m.nodeId = 1;
+    m.seq = 1;
+    m.timeUs = 1234;
+    CHECK(site.links[0]->sendTime(m));
+    for (uint32_t t = 5; t < 200; t += 5) {        // A stamp of 0 reads as not sent
+        site.air.setTime(t * 1000ull);
+        for (auto& link : site.links) link->poll(t);
+    }
+    TimeMessage got;
+    uint64_t arrivalUs;
+    CHECK(site.links[1]->receiveTime(&got, &arrivalUs) && got.timeUs == 1234);
+    CHECK(!site.links[2]->receiveTime(&got, &arrivalUs));
+    CHECK(site.total().relayed == 0);
+
+    uint64_t sentUs;
+    CHECK(site.links[0]->timeSent(1, &sentUs));
+}
+
+static void testCueRepeatsDeliveredOnce() {
+    Site site(3, 0.0f, adjacent);
+    site.run(3000, 0);
+    CHECK(site.cues[1] == 1);
+    CHECK(site.cues[2] == 1);               // Through the middle unit's relay
+    CHECK(site.cues[0] == 0);               // Its own cue, relayed back, is dropped
+    CHECK(site.total().duplicates > 0);
+}
+
+static void testCueFlags() {
+    // Whether the timestamp is mesh time travels with the cue
+    Site site(2, 0.0f, nullptr);
+    site.links[0]->sendAlert(5000, 10.0f, 0.5f, BEARING_FLAG_SHARED_TIME);
+    site.links[0]->sendAlert(6000, 20.0f, 0.5f);
+    AlertCue cues[2];
+    int got = 0;
+    for (uint32_t t = 0; t < 500; t += 5) {
+        for (auto& link : site.links) link->poll(t);
+        while (got < 2 && site.links[1]->receiveAlert(&cues[got])) got++;
+    }
+    CHECK(got == 2);
+    CHECK(cues[0].timestampMs == 5000 && cues[0].flags == BEARING_FLAG_SHARED_TIME);
+    CHECK(cues[1].timestampMs == 6000 && cues[1].flags == 0);
+}
+
+int main() {
+    RUN_TEST(testTwoUnits);
+    RUN_TEST(testLine);
+    RUN_TEST(testAllInRange);
+    RUN_TEST(testTimeNotRelayed);
+    RUN_TEST(testCueRepeatsDeliveredOnce);
+    RUN_TEST(testCueFlags);
+    return testExit();
+}
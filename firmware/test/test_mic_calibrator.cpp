@@ -0,0 +1,198 @@
+/**
+ * MicCalibrator on simulated mismatched arrays: mics with different
+ * sensitivities and capture delays, in a diffuse field (ambient run) and
+ * under the buzzer (tone run). Checks that both runs recover the offsets
+ * relative to the array mean, and that runs which can't be trusted (too
+ * short, a dead mic, a fault-sized offset) are refused.
+ *
+ * The diffuse field is a ring of plane waves from evenly spaced
+ * directions, every direction carrying the same tones across the
+ * calibration band, offset about a hertz per direction so they beat
+ * rather than interfere over a run. Each mic's signal is computed at its
+ * own exact fractional delay.
+ */
+
+#include <vector>
+#include "test_support.h"
+#include "test_signals.h"
+#include "mic_calibrator.h"
+
+struct Array {
+    double gain[4];             // Sensitivity
+    double delay[4];            // Capture delay, samples
+    bool dead[4];               // Hears only its own noise
+};
+
+static const Array MISMATCHED = {
+    { 1.0, 1.25, 0.85, 1.1 },
+    { 0.0, 0.6, -0.3, 0.9 },
+    { false, false, false, false },
+};
+
+/**
+ * blocks capture blocks of each mic, back to back
+ */
+static std::vector<std::vector<float>> diffuseField(const Array& array, int blocks) {
+    const int directions = 24;
+    const int tones = 25;                   // Per direction
+    const double lowHz = MIC_CAL_MIN_HZ * 0.8;
+    const double bandHz = MIC_CAL_MAX_HZ * 1.1 - lowHz;
+    long samples = (long)blocks * FFT_SIZE;
+    std::vector<std::vector<double>> mic(4, std::vector<double>(samples, 0.0));
+    double rotation = 2.0 * M_PI * uniform();
+    for (int w = 0; w < directions * tones; w++) {
+        double hz = lowHz + (w % tones + 0.5) * bandHz / tones + 1.13 * (w / tones);
+        double azimuth = rotation + 2.0 * M_PI * (w / tones) / directions;
+        double phase0 = 2.0 * M_PI * uniform();
+        double step = 2.0 * M_PI * hz / SAMPLE_RATE;
+        for (int c = 0; c < 4; c++) {
+            double delay = micArrival(c, azimuth * 180.0 / M_PI) + array.delay[c];
+            // Rotating phasor: one complex multiply per sample
+            double re = cos(phase0 - step * delay);
+            double im = sin(phase0 - step * delay);
+            double cs = cos(step);
+            double sn = sin(step);
+            double amplitude = 0.01 * array.gain[c];
+            for (long i = 0; i < samples; i++) {
+                mic[c][i] += amplitude * im;
+                double next = re * cs - im * sn;
+                im = re * sn + im * cs;
+                re = next;
+            }
+        }
+    }
+
+    std::vector<std::vector<float>> out(4, std::vector<float>(samples));
+    for (int c = 0; c < 4; c++) {
+        for (long i = 0; i < samples; i++) {
+            out[c][i] = array.dead[c] ? (float)(0.1 * gaussian()) : (float)mic[c][i];
+        }
+    }
+    return out;
+}
+
+static std::vector<std::vector<float>> buzzer(const Array& array, int blocks, double hz) {
+    long samples = (long)blocks * FFT_SIZE;
+    std::vector<std::vector<float>> out(4, std::vector<float>(samples));
+    for (int c = 0; c < 4; c++) {
+        double dx = MIC_CAL_BUZZER_X_MM - MIC_X_MM[c];
+        double dy = MIC_CAL_BUZZER_Y_MM - MIC_Y_MM[c];
+        double r = sqrt(dx * dx + dy * dy);
+        double delay = r / 1000.0 / SPEED_OF_SOUND * SAMPLE_RATE + array.delay[c];
+        for (long i = 0; i < samples; i++) {
+            double v = array.gain[c] * (20.0 / r) * 0.3 * sin(2.0 * M_PI * hz * (i - delay) / SAMPLE_RATE);
+            out[c][i] = (float)(v + 0.002 * gaussian());
+        }
+    }
+    return out;
+}
+
+static bool calibrate(MicCalibrator& cal, const std::vector<std::vector<float>>& mics, MicCalResult* result) {
+    long blocks = (long)mics[0].size() / FFT_SIZE;
+    for (long b = 0; b < blocks; b++) {
+        const float* channels[4];
+        for (int c = 0; c < 4; c++) channels[c] = mics[c].data() + b * FFT_SIZE;
+        cal.process(channels, FFT_SIZE);
+    }
+    return cal.finish(result);
+}
+
+/**
+ * Worst gain error (fraction) and delay error (samples) against what a
+ * mic should be trimmed by, relative to the array mean
+ */
+static void compare(const Array& array, const MicCalResult& r, double* gainError, double* delayError) {
+    double gainMean = 0.0;
+    double delayMean = 0.0;
+    for (int c = 0; c < 4; c++) {
+        gainMean += 0.25 / array.gain[c];
+        delayMean += 0.25 * array.delay[c];
+    }
+    *gainError = 0.0;
+    *delayError = 0.0;
+    for (int c = 0; c < 4; c++) {
+        double wantGain = 1.0 / array.gain[c] / gainMean;
+        *gainError = fmax(*gainError, fabs(r.gain[c] / wantGain - 1.0));
+        *delayError = fmax(*delayError, fabs(r.delaySamples[c] - (array.delay[c] - delayMean)));
+    }
+}
+
+static void testAmbient() {
+    srand(1);
+    MicCalibrator cal;
+    cal.begin(SAMPLE_RATE, MIC_CAL_AMBIENT);
+    MicCalResult r;
+    CHECK(calibrate(cal, diffuseField(MISMATCHED, 80), &r));
+    double gainError, delayError;
+    compare(MISMATCHED, r, &gainError, &delayError);
+    printf("  ambient: gain within %.2f %%, delay within %.3f samples, coherence %.2f, %d segments\n",
+           100.0 * gainError, delayError, r.coherence, r.segments);
+    CHECK(gainError < 0.01);
+    CHECK(delayError < 0.03);
+    CHECK(r.segments == 80 * FFT_SIZE / MIC_CAL_SEGMENT);
+}
+
+static void testTone() {
+    srand(2);
+    MicCalibrator cal;
+    cal.begin(SAMPLE_RATE, MIC_CAL_TONE, MIC_CAL_TONE_HZ);
+    CHECK(fabsf(cal.getToneHz() - MIC_CAL_TONE_HZ) <= 0.5f * SAMPLE_RATE / MIC_CAL_SEGMENT);
+    MicCalResult r;
+    CHECK(calibrate(cal, buzzer(MISMATCHED, 30, cal.getToneHz()), &r));
+    double gainError, delayError;
+    compare(MISMATCHED, r, &gainError, &delayError);
+    printf("  tone: gain within %.3f %%, delay within %.4f samples\n", 100.0 * gainError, delayError);
+    CHECK(gainError < 0.005);
+    CHECK(delayError < 0.01);
+}
+
+static void testMatchedArray() {
+    srand(3);
+    Array matched = { { 1, 1, 1, 1 }, { 0, 0, 0, 0 }, { false, false, false, false } };
+    MicCalibrator cal;
+    cal.begin(SAMPLE_RATE, MIC_CAL_AMBIENT);
+    MicCalResult r;
+    CHECK(calibrate(cal, diffuseField(matched, 80), &r));
+    for (int c = 0; c < 4; c++) {
+        CHECK_NEAR(r.gain[c], 1.0, 0.01);
+        CHECK_NEAR(r.delaySamples[c], 0.0, 0.03);
+    }
+}
+
+static void testRejected() {
+    srand(4);
+    MicCalResult r;
+    r.segments = -1;
+
+    // Too short
+    MicCalibrator cal;
+    cal.begin(SAMPLE_RATE, MIC_CAL_AMBIENT);
+    CHECK(!calibrate(cal, diffuseField(MISMATCHED, MIC_CAL_MIN_SEGMENTS * MIC_CAL_SEGMENT / FFT_SIZE - 1), &r));
+
+    // A dead mic hears nothing the others do
+    Array dead = MISMATCHED;
+    dead.dead[2] = true;
+    dead.dead[3] = true;
+    cal.begin(SAMPLE_RATE, MIC_CAL_AMBIENT);
+    CHECK(!calibrate(cal, diffuseField(dead, 80), &r));
+
+    // Offsets a sealed port or a wrong part would give, not a spread
+    Array faulty = MISMATCHED;
+    faulty.gain[1] = 0.2;
+    cal.begin(SAMPLE_RATE, MIC_CAL_TONE, MIC_CAL_TONE_HZ);
+    CHECK(!calibrate(cal, buzzer(faulty, 30, cal.getToneHz()), &r));
+    faulty = MISMATCHED;
+    faulty.delay[3] = 3.0;
+    cal.begin(SAMPLE_RATE, MIC_CAL_TONE, MIC_CAL_TONE_HZ);
+    CHECK(!calibrate(cal, buzzer(faulty, 30, cal.getToneHz()), &r));
+
+    CHECK(r.segments == -1);                // Untouched
+}
+
+int main() {
+    RUN_TEST(testAmbient);
+    RUN_TEST(testTone);
+    RUN_TEST(testMatchedArray);
+    RUN_TEST(testRejected);
+    return testExit();
+}
@@ -0,0 +1,42 @@
+/**
+ * VARTA - Host test signals
+ * Random draws and the array geometry shared by the simulated captures.
+ * Draws come from rand(), so each test seeds with srand() for
+ * repeatable runs.
+ */
+
+#ifndef TEST_SIGNALS_H
+#define TEST_SIGNALS_H
+
+#include <stdlib.h>
+#include <math.h>
+#include "config.h"
+
+inline double uniform(double lo = 0.0, double hi = 1.0) {
+    return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+/**
+ * Unit variance, sum of twelve uniforms (bounded at +-6)
+ */
+inline double gaussian() {
+    double sum = 0.0;
+    for (int i = 0; i < 12; i++) sum += rand() / (double)RAND_MAX;
+    return sum - 6.0;
+}
+
+// Mics 1-4 front left, front right, rear right, rear left; +X right, +Y front
+static const double MIC_HALF_MM = MIC_SPACING_MM / 2.0;
+static const double MIC_X_MM[4] = { -MIC_HALF_MM, MIC_HALF_MM, MIC_HALF_MM, -MIC_HALF_MM };
+static const double MIC_Y_MM[4] = { MIC_HALF_MM, MIC_HALF_MM, -MIC_HALF_MM, -MIC_HALF_MM };
+
+/**
+ * How much later mic `c` hears a far source at `azimuthDeg` (clockwise
+ * from front) than the array centre, in samples
+ */
+inline double micArrival(int c, double azimuthDeg) {
+    double a = azimuthDeg * M_PI / 180.0;
+    return -(MIC_X_MM[c] * sin(a) + MIC_Y_MM[c] * cos(a)) / 1000.0 / SPEED_OF_SOUND * SAMPLE_RATE;
+}
+
+#endif // TEST_SIGNALS_H
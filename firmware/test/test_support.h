@@ -0,0 +1,44 @@
+/**
+ * VARTA - Host test helpers
+ * Minimal checks for the tests in this directory: each test is its own
+ * executable and returns non-zero if any check failed.
+ */
+
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <stdio.h>
+#include <math.h>
+
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        testFailures()++; \
+    } \
+} while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) do { \
+    double _a = (actual), _e = (expected); \
+    if (!(fabs(_a - _e) <= (tolerance))) { \
+        printf("%s:%d: %s = %g, expected %g +/- %g\n", __FILE__, __LINE__, #actual, \
+               _a, _e, (double)(tolerance)); \
+        testFailures()++; \
+    } \
+} while (0)
+
+#define RUN_TEST(fn) do { \
+    int _before = testFailures(); \
+    fn(); \
+    printf("%s %s\n", testFailures() == _before ? "PASS" : "FAIL", #fn); \
+} while (0)
+
+inline int testExit() {
+    return testFailures() == 0 ? 0 : 1;
+}
+
+#endif // TEST_SUPPORT_H
@@ -0,0 +1,190 @@
+/**
+ * TimeSync over MemoryAir: ten units with crystals up to 40 ppm apart and
+ * clocks started seconds apart, frame latency 600 us plus random jitter,
+ * some frames lost. Checks the mesh time every unit reads against the
+ * master's own clock, the drift estimate, a sound's stamp through each
+ * unit's SampleClock, and recovery after the master restarts; then
+ * ClockFit and SampleClock on their own.
+ */
+
+#include <memory>
+#include <vector>
+#include "test_support.h"
+#include "test_signals.h"
+#include "time_sync.h"
+
+struct Result {
+    int synced;
+    double worstUs;             // Mesh time against the master's clock
+    double worstEventUs;        // ... for a sample index through SampleClock
+    double worstDriftPpm;
+};
+
+class Site {
+public:
+    static const int UNITS = 10;
+
+    Site(float loss, uint32_t jitterUs) : _air(loss, 11) {
+        _air.setLatency(600, jitterUs);
+        for (int i = 0; i < UNITS; i++) {
+            _rate[i] = 1.0 + (uniform() * 80.0 - 40.0) * 1e-6;
+            _radios.emplace_back(new MemoryRadio(_air));
+            _radios[i]->setClock(_rate[i], (int64_t)(uniform() * 1e7) + 1000);
+            _links.emplace_back(new MeshLink(*_radios[i], i + 1));
+            _syncs.emplace_back(new TimeSync(*_links[i], i + 1, 1));
+            _clocks.emplace_back(new SampleClock(SAMPLE_RATE));
+            _captured[i] = 0;
+            _startUs[i] = uniform() * 46000.0;
+            _nextBlockUs[i] = _startUs[i] + blockUs(i);
+        }
+    }
+
+    /**
+     * Run 1 ms passes up to trueUs. Capture blocks reach the loop 0-3 ms
+     * late, one in twenty 40 ms late.
+     */
+    void runTo(uint64_t trueUs) {
+        for (; _nowUs <= trueUs; _nowUs += 1000) {
+            _air.setTime(_nowUs);
+            for (int i = 0; i < UNITS; i++) {
+                while (_nowUs >= _nextBlockUs[i]) {
+                    _captured[i] += FFT_SIZE;
+                    double late = uniform() < 0.05 ? 40000.0 : uniform() * 3000.0;
+                    _clocks[i]->mark(_captured[i], _radios[i]->localAt((uint64_t)(_nextBlockUs[i] + late)));
+                    _nextBlockUs[i] += blockUs(i);
+                }
+                uint64_t localUs = _radios[i]->clockUs();
+                _links[i]->poll((uint32_t)(localUs / 1000));
+                _syncs[i]->poll(localUs);
+            }
+        }
+    }
+
+    void restartMaster() { _radios[0]->setClock(_rate[0], 5000); }
+
+    Result measure() {
+        Result r = { 0, 0.0, 0.0, 0.0 };
+        uint64_t masterUs = _radios[0]->localAt(_nowUs);
+        for (int i = 1; i < UNITS; i++) {
+            uint64_t localUs = _radios[i]->localAt(_nowUs);
+            if (!_syncs[i]->isSynced(localUs)) continue;
+            r.synced++;
+            r.worstUs = fmax(r.worstUs, fabs((double)(int64_t)(_syncs[i]->toMeshUs(localUs) - masterUs)));
+
+            // A sound reaching every unit now, stamped from its sample index
+            uint64_t index = (uint64_t)((_nowUs - _startUs[i]) * 1e-6 * SAMPLE_RATE * _rate[i]);
+            uint64_t eventUs = _syncs[i]->toMeshUs(_clocks[i]->toLocalUs(index));
+            r.worstEventUs = fmax(r.worstEventUs, fabs((double)(int64_t)(eventUs - masterUs)));
+
+            double truePpm = (_rate[0] / _rate[i] - 1.0) * 1e6;
+            r.worstDriftPpm = fmax(r.worstDriftPpm, fabs(_syncs[i]->getDriftPpm() - truePpm));
+        }
+        return r;
+    }
+
+    const TimeSyncStats& stats(int unit) { return _syncs[unit]->getStats(); }
+
+private:
+    MemoryAir _air;
+    std::vector<std::unique_ptr<MemoryRadio>> _radios;
+    std::vector<std::unique_ptr<MeshLink>> _links;
+    std::vector<std::unique_ptr<TimeSync>> _syncs;
+    std::vector<std::unique_ptr<SampleClock>> _clocks;
+    double _rate[UNITS];
+    uint64_t _captured[UNITS];
+    double _startUs[UNITS];
+    double _nextBlockUs[UNITS];
+    uint64_t _nowUs = 0;
+
+    double blockUs(int unit) { return FFT_SIZE * 1e6 / SAMPLE_RATE / _rate[unit]; }
+};
+
+struct Case {
+    float loss;
+    uint32_t jitterUs;
+    double maxErrorUs;          // Clock and event stamps, once settled
+    double maxDriftPpm;
+};
+
+static void testSkewAndJitter() {
+    // The error follows the jitter: the fit averages arrival stamps that
+    // are each up to jitterUs late, and the path delay is a median
+    const Case cases[] = {
+        { 0.1f, 800, 500.0, 15.0 },
+        { 0.3f, 3000, 1500.0, 90.0 },
+    };
+    srand(3);
+    for (const Case& c : cases) {
+        Site site(c.loss, c.jitterUs);
+        for (int s = 60; s <= 240; s += 30) {
+            if (s == 120) {
+                site.runTo(120000000ull);
+                site.restartMaster();
+                continue;
+            }
+            site.runTo(s * 1000000ull);
+            Result r = site.measure();
+            printf("  loss %2.0f %%, jitter %4u us, t=%3d s: synced %d/%d, worst %4.0f us, "
+                   "event %4.0f us, drift %5.2f ppm\n",
+                   100.0f * c.loss, c.jitterUs, s, r.synced, Site::UNITS - 1,
+                   r.worstUs, r.worstEventUs, r.worstDriftPpm);
+
+            // 150 s is 30 s after the master restarted: refitted by then
+            // on the clean link, still settling on the noisy one
+            if (s == 150 && c.jitterUs > 1000) continue;
+            CHECK(r.synced == Site::UNITS - 1);
+            CHECK(r.worstUs <= c.maxErrorUs);
+            CHECK(r.worstEventUs <= c.maxErrorUs);
+            CHECK(r.worstDriftPpm <= c.maxDriftPpm);
+        }
+        CHECK(site.stats(3).resets >= 1);           // The restart refitted rather than dragging the fit
+        CHECK(site.stats(3).delayReplies > 0);
+    }
+}
+
+static void testClockFit() {
+    // Exact pairs: the line comes back, drift included
+    ClockFit fit;
+    const double rate = 1.0 + 25e-6;
+    for (int i = 0; i < TIME_SYNC_FIT_POINTS; i++) {
+        uint64_t local = 5000000ull + i * 1000000ull;
+        CHECK(fit.add(local, (uint64_t)(123456789.0 + rate * local)));
+    }
+    CHECK_NEAR(fit.getDriftPpm(), 25.0, 0.05);
+    uint64_t local = 60000000ull;
+    CHECK_NEAR((double)fit.toRef(local), 123456789.0 + rate * local, 2.0);
+    CHECK_NEAR((double)fit.toLocal(fit.toRef(local)), (double)local, 2.0);
+
+    // One pair far off is rejected; a run of them means a new reference
+    uint64_t next = 5000000ull + TIME_SYNC_FIT_POINTS * 1000000ull;
+    CHECK(!fit.add(next, (uint64_t)(123456789.0 + rate * next) + 10 * TIME_SYNC_OUTLIER_US));
+    CHECK(fit.getResets() == 0);
+    for (int i = 0; i < TIME_SYNC_MAX_REJECTS; i++) {
+        next += 1000000ull;
+        fit.add(next, 777 + next);
+    }
+    CHECK(fit.getResets() == 1);
+}
+
+static void testSampleClock() {
+    // Blocks handed over 0-5 ms late: the earliest stamp sets the offset
+    SampleClock clock(SAMPLE_RATE);
+    CHECK(!clock.isValid());
+    const double usPerSample = 1e6 / SAMPLE_RATE;
+    srand(4);
+    for (int b = 1; b <= SAMPLE_CLOCK_MARKS; b++) {
+        uint64_t end = (uint64_t)b * FFT_SIZE;
+        double late = b == 7 ? 0.0 : 200.0 + uniform() * 5000.0;
+        clock.mark(end, (uint64_t)(1000000.0 + end * usPerSample + late));
+    }
+    CHECK(clock.isValid());
+    uint64_t index = 40 * FFT_SIZE;
+    CHECK_NEAR((double)clock.toLocalUs(index), 1000000.0 + index * usPerSample, 1.0);
+}
+
+int main() {
+    RUN_TEST(testSkewAndJitter);
+    RUN_TEST(testClockFit);
+    RUN_TEST(testSampleClock);
+    return testExit();
+}
@@ -0,0 +1,293 @@
+/**
+ * WakeDetector on replayed single-mic standby capture, in the FFT_SIZE
+ * blocks readStandbySamples() hands it: field ambience, wind (low-passed
+ * turbulence, steady and gusting) and a motor's harmonic stack at
+ * several fundamentals and levels. Checks that quiet and wind never
+ * wake the pipeline, how fast a motor does, the floor hint after a
+ * restart, and the pre-roll ring; then a long watch through the standby
+ * state machine for the wake statistics and the duty cycle.
+ */
+
+#include <vector>
+#include "test_support.h"
+#include "test_signals.h"
+#include "calibration_store.h"
+#include "wake_detector.h"
+
+static const double BLOCK_S = (double)FFT_SIZE / SAMPLE_RATE;
+static const double AMBIENT = 3e-4;                 // About -70 dBFS
+
+/**
+ * One mic's capture. Levels are linear full scale: ambient and wind RMS,
+ * motor fundamental amplitude (harmonics at 1/h)
+ */
+class Field {
+public:
+    Field() : _phase(0.0), _wind1(0.0), _wind2(0.0), _gust(1.0) {
+        _raw.resize(FFT_SIZE);
+    }
+
+    const int32_t* next(double wind, double motor, double f0Hz) {
+        // Turbulence below ~80 Hz; the gust envelope wanders over seconds
+        const double a = 1.0 - exp(-2.0 * M_PI * 80.0 / SAMPLE_RATE);
+        const double norm = sqrt(4.0 / a);          // Two poles: RMS back to one
+        _gust += 0.05 * (uniform(0.2, 1.8) - _gust);
+        double step = 2.0 * M_PI * f0Hz / SAMPLE_RATE;
+        for (int i = 0; i < FFT_SIZE; i++) {
+            _wind1 += a * (uniform(-1.7320508, 1.7320508) - _wind1);
+            _wind2 += a * (_wind1 - _wind2);
+            double x = AMBIENT * uniform(-1.7320508, 1.7320508) + wind * _gust * norm * _wind2;
+            if (motor > 0.0) {
+                _phase = fmod(_phase + step, 2.0 * M_PI);
+                for (int h = 1; h <= 6; h++) x += motor / h * sin(h * _phase);
+            }
+            x = fmax(-1.0, fmin(x, 1.0));
+            _raw[i] = (int32_t)(x * 8388607.0) * 256;           // 24-bit, left-aligned
+        }
+        return _raw.data();
+    }
+
+private:
+    double _phase;
+    double _wind1;
+    double _wind2;
+    double _gust;
+    std::vector<int32_t> _raw;
+};
+
+static double dbfs(double rms) {
+    return 20.0 * log10(rms);
+}
+
+static void begin(WakeDetector& wake) {
+    wake.begin(SAMPLE_RATE, MOTOR_FUNDAMENTAL_MIN, MOTOR_FUNDAMENTAL_MAX);
+}
+
+static void testQuietAndWind() {
+    // A minute each: nothing here is a motor, so nothing may wake
+    srand(1);
+    const double winds[] = { 0.0, 0.003, 0.03, 0.2 };
+    for (double wind : winds) {
+        WakeDetector wake;
+        begin(wake);
+        Field field;
+        int wakes = 0;
+        int blocks = (int)(60.0 / BLOCK_S);
+        for (int b = 0; b < blocks; b++) wakes += wake.process(field.next(wind, 0.0, 0.0), FFT_SIZE);
+        const WakeDetector::Stats& s = wake.getStats();
+        printf("  wind %5.1f dBFS: floor %.1f dB, %u frames, %u energy hits, %u harmonic, %d wakes\n",
+               wind > 0.0 ? dbfs(wind) : -999.0, wake.getNoiseFloorDb(), s.frames, s.energyHits,
+               s.harmonicHits, wakes);
+        CHECK(wakes == 0);
+        CHECK(s.triggers == 0);
+        CHECK(s.frames == (uint32_t)(blocks * FFT_SIZE / WAKE_DECIMATION / WAKE_FRAME_SAMPLES));
+        if (wind == 0.0) {
+            // White ambience loses about 6 dB to the boxcar
+            CHECK(wake.getNoiseFloorDb() > dbfs(AMBIENT) - 10.0 && wake.getNoiseFloorDb() < dbfs(AMBIENT));
+            CHECK(s.energyHits == 0);
+        }
+    }
+}
+
+/**
+ * Blocks from the motor's onset to the wake (-1: none in `seconds`),
+ * after `quietS` of ambience to learn the floor
+ */
+static int wakeDelay(double motor, double f0Hz, double wind, double quietS, double seconds) {
+    WakeDetector wake;
+    begin(wake);
+    Field field;
+    for (int b = 0; b < (int)(quietS / BLOCK_S); b++) wake.process(field.next(wind, 0.0, 0.0), FFT_SIZE);
+    for (int b = 0; b < (int)(seconds / BLOCK_S); b++) {
+        if (wake.process(field.next(wind, motor, f0Hz), FFT_SIZE)) return b;
+    }
+    return -1;
+}
+
+static void testMotorWakes() {
+    // Every fundamental the detector covers, 15 dB and more over the ambience
+    srand(2);
+    const double f0s[] = { MOTOR_FUNDAMENTAL_MIN, 210.0, 280.0, MOTOR_FUNDAMENTAL_MAX };
+    const double levels[] = { 0.0017, 0.01, 0.1 };      // About -55, -40, -20 dBFS
+    int worst = 0;
+    for (double f0 : f0s) {
+        for (double motor : levels) {
+            int delay = wakeDelay(motor, f0, 0.0, 10.0, 2.0);
+            CHECK(delay >= 0);
+            worst = delay > worst ? delay : worst;
+        }
+    }
+    // WAKE_HOLD_FRAMES frames of ~23 ms, so the third block in
+    double worstMs = (worst + 1) * BLOCK_S * 1000.0;
+    printf("  motor 150-400 Hz, -55 to -20 dBFS: woke within %.0f ms\n", worstMs);
+    CHECK(worstMs <= 150.0);
+
+    // Under the margin it stays asleep
+    CHECK(wakeDelay(0.0004, 210.0, 0.0, 10.0, 5.0) < 0);
+
+    // In a breeze, a motor over it still wakes
+    CHECK(wakeDelay(0.02, 210.0, 0.003, 10.0, 2.0) >= 0);
+
+    // A drone closing in at 0.5 dB/s: a motor never lifts the floor, so
+    // it clears the margin rather than being tracked into it
+    WakeDetector wake;
+    begin(wake);
+    Field field;
+    for (int b = 0; b < (int)(10.0 / BLOCK_S); b++) wake.process(field.next(0.0, 0.0, 0.0), FFT_SIZE);
+    double wokeDb = 0.0;
+    for (int b = 0; b < (int)(80.0 / BLOCK_S) && wokeDb == 0.0; b++) {
+        double db = dbfs(AMBIENT) - 20.0 + 0.5 * b * BLOCK_S;
+        if (wake.process(field.next(0.0, pow(10.0, db / 20.0), 240.0), FFT_SIZE)) wokeDb = db;
+    }
+    printf("  drone closing at 0.5 dB/s: woke at %.1f dBFS, %.1f dB over the ambience\n",
+           wokeDb, wokeDb - dbfs(AMBIENT));
+    CHECK(wokeDb != 0.0 && wokeDb - dbfs(AMBIENT) < WAKE_ENERGY_MARGIN_DB + 3.0);
+}
+
+static void testFloorHint() {
+    // A restart with the drone already audible: unhinted, the first frame
+    // becomes the floor and the drone hides under it
+    srand(3);
+    for (int hinted = 0; hinted < 2; hinted++) {
+        WakeDetector wake;
+        begin(wake);
+        if (hinted) wake.setFloorHint(dbfs(AMBIENT) - 6.0f);
+        Field field;
+        int wakes = 0;
+        for (int b = 0; b < (int)(3.0 / BLOCK_S); b++) wakes += wake.process(field.next(0.0, 0.01, 210.0), FFT_SIZE);
+        printf("  drone from the first frame, %s: %d wakes\n", hinted ? "floor hint" : "no hint", wakes);
+        CHECK(hinted ? wakes > 0 : wakes == 0);
+    }
+
+    // A hint from a louder site doesn't hold the floor up
+    WakeDetector wake;
+    begin(wake);
+    wake.setFloorHint(-30.0f);
+    Field field;
+    for (int b = 0; b < (int)(2.0 / BLOCK_S); b++) wake.process(field.next(0.0, 0.0, 0.0), FFT_SIZE);
+    CHECK(wake.getNoiseFloorDb() < dbfs(AMBIENT));
+    CHECK(wakeDelay(0.01, 210.0, 0.0, 2.0, 2.0) >= 0);
+}
+
+static void testPreroll() {
+    // Holds the newest `capacity` samples, oldest first, at 16-bit precision
+    const int capacity = 3 * FFT_SIZE;
+    std::vector<int16_t> storage(capacity);
+    PrerollBuffer preroll;
+    CHECK(preroll.begin(storage.data(), capacity));
+    std::vector<int32_t> raw(FFT_SIZE);
+    for (int b = 0; b < 5; b++) {
+        for (int i = 0; i < FFT_SIZE; i++) raw[i] = (int32_t)((b * FFT_SIZE + i) % 30000) << 16;
+        preroll.push(raw.data(), FFT_SIZE);
+        CHECK(preroll.size() == (b + 1 < 3 ? b + 1 : 3) * FFT_SIZE);
+    }
+    std::vector<float> out(FFT_SIZE);
+    preroll.read(FFT_SIZE, out.data(), FFT_SIZE, 2.0f);
+    CHECK_NEAR(out[0], 2.0 * ((3 * FFT_SIZE) % 30000) / 32768.0, 1e-6);
+    CHECK_NEAR(out[FFT_SIZE - 1], 2.0 * ((4 * FFT_SIZE - 1) % 30000) / 32768.0, 1e-6);
+    preroll.clear();
+    CHECK(preroll.size() == 0);
+}
+
+struct Segment {
+    double seconds;
+    double wind;
+    double motor;               // Peak, rising and falling over the segment
+    double f0Hz;
+};
+
+static void testLongWatch() {
+    // Half an hour: quiet, breeze, two gusty spells, three motor passes
+    // (one in the wind). Standby follows main.cpp: a wake keeps the
+    // pipeline up until STANDBY_IDLE_MS after both the wake and the last
+    // detection; the pipeline detects while the motor is over the margin.
+    const Segment watch[] = {
+        { 240.0, 0.0, 0.0, 0.0 },
+        { 180.0, 0.003, 0.0, 0.0 },
+        { 60.0, 0.0, 0.02, 190.0 },
+        { 240.0, 0.0, 0.0, 0.0 },
+        { 300.0, 0.2, 0.0, 0.0 },
+        { 60.0, 0.03, 0.1, 260.0 },
+        { 300.0, 0.0, 0.0, 0.0 },
+        { 45.0, 0.0, 0.01, 330.0 },
+        { 375.0, 0.1, 0.0, 0.0 },
+    };
+    srand(4);
+    WakeDetector wake;
+    begin(wake);
+    Field field;
+    bool standby = true;
+    double wakeS = 0.0;
+    double lastDetectionS = 0.0;
+    double awakeS = 0.0;
+    double t = 0.0;
+    int passes = 0;
+    int wakes = 0;
+    int falseWakes = 0;
+    int passesWoken = 0;
+    const double idleS = STANDBY_IDLE_MS / 1000.0;
+    float floorHint = 0.0f;
+
+    for (const Segment& seg : watch) {
+        bool woken = false;
+        passes += seg.motor > 0.0;
+        int blocks = (int)(seg.seconds / BLOCK_S);
+        for (int b = 0; b < blocks; b++, t += BLOCK_S) {
+            double motor = seg.motor * sin(M_PI * (b + 0.5) / blocks);
+            const int32_t* raw = field.next(seg.wind, motor, seg.f0Hz);
+            bool audible = motor > AMBIENT * 3.0;
+
+            if (!standby) {
+                awakeS += BLOCK_S;
+                if (audible) lastDetectionS = t;
+                if (t - wakeS > idleS && t - lastDetectionS > idleS) {
+                    // enterStandby()
+                    standby = true;
+                    wake.reset();
+                }
+                continue;
+            }
+            if (wake.process(raw, FFT_SIZE)) {
+                // wakeFromStandby(): the floor carries to the next standby
+                standby = false;
+                wakeS = t;
+                lastDetectionS = t;
+                wakes++;
+                falseWakes += seg.motor == 0.0;
+                woken = woken || seg.motor > 0.0;
+                float floor = wake.getNoiseFloorDb();
+                if (fabsf(floor - floorHint) > CALIBRATION_WAKE_SAVE_DB) {
+                    floorHint = floor;
+                    wake.setFloorHint(floor);
+                }
+            }
+        }
+        passesWoken += woken;
+    }
+
+    double duty = awakeS / t;
+    double currentMa = duty * CURRENT_SCAN_MA + (1.0 - duty) * CURRENT_STANDBY_MA;
+    const WakeDetector::Stats& s = wake.getStats();
+    printf("  %.0f min watch: %d/%d passes woke, %d wakes, %d false; awake %.1f %% "
+           "(%.0f mA against %d mA always on); last standby %u frames, %u energy, %u harmonic\n",
+           t / 60.0, passesWoken, passes, wakes, falseWakes, 100.0 * duty, currentMa, CURRENT_SCAN_MA,
+           s.frames, s.energyHits, s.harmonicHits);
+    CHECK(passesWoken == passes);
+    CHECK(wakes == passes);
+    CHECK(falseWakes == 0);
+
+    // Each pass keeps the pipeline up for its own length plus the idle time
+    double expected = 0.0;
+    for (const Segment& seg : watch) expected += seg.motor > 0.0 ? seg.seconds + idleS : 0.0;
+    CHECK(awakeS <= expected + 1.0);
+    CHECK(duty < 0.2);
+}
+
+int main() {
+    RUN_TEST(testQuietAndWind);
+    RUN_TEST(testMotorWakes);
+    RUN_TEST(testFloorHint);
+    RUN_TEST(testPreroll);
+    RUN_TEST(testLongWatch);
+    return testExit();
+}
@@ -0,0 +1,213 @@
+/**
+ * WindDetector on replayed four-mic scenes, block by block as the capture
+ * task hands them over: a drone-like source with real inter-mic delays,
+ * plus wind as turbulence local to each mic port. Checks that calm and
+ * loud coherent sound (a truck rumbling through the same band) are left
+ * alone, that breeze flags bins without a gust, that a gust starts
+ * within a few hops and ends within half a second, and what suppress()
+ * takes out.
+ */
+
+#include <vector>
+#include "test_support.h"
+#include "test_signals.h"
+#include "wind_detector.h"
+
+static const int HISTORY = 16;                  // Samples of source kept for the delays
+
+/**
+ * One unit's mics hearing a far source; delays are rounded to whole
+ * samples (up to 9 across the diagonal).
+ */
+class Scene {
+public:
+    Scene(float sourceDeg) : _t(0), _source(FFT_SIZE + HISTORY), _rumble(0.0) {
+        double earliest = 1e9;
+        for (int c = 0; c < 4; c++) earliest = fmin(earliest, micArrival(c, sourceDeg));
+        for (int c = 0; c < 4; c++) {
+            _delay[c] = (int)lround(micArrival(c, sourceDeg) - earliest);
+            _wind[c] = 0.0;
+            _mics[c].resize(FFT_SIZE);
+        }
+    }
+
+    /**
+     * Next block. drone: amplitude of a 200 Hz fundamental and harmonics;
+     * rumble: of coherent low-passed noise; wind: of each mic's own
+     */
+    const float* const* next(double drone, double rumble, double wind) {
+        // Keep the tail of the last block so delays reach back across it
+        for (int i = 0; i < HISTORY; i++) _source[i] = _source[FFT_SIZE + i];
+        for (int i = 0; i < FFT_SIZE; i++, _t++) {
+            double v = 0.0;
+            for (int h = 1; h <= 5; h++) v += sin(2.0 * M_PI * 200.0 * h * _t / SAMPLE_RATE) / h;
+            _rumble += 0.02 * (gaussian() - _rumble);
+            _source[HISTORY + i] = drone * v + rumble * 5.0 * _rumble;
+        }
+        for (int c = 0; c < 4; c++) {
+            for (int i = 0; i < FFT_SIZE; i++) {
+                _wind[c] += 0.02 * (gaussian() - _wind[c]);
+                _mics[c][i] = (float)(_source[HISTORY + i - _delay[c]] + wind * 5.0 * _wind[c]);
+            }
+            _pointers[c] = _mics[c].data();
+        }
+        return _pointers;
+    }
+
+private:
+    long _t;
+    std::vector<double> _source;
+    double _rumble;
+    double _wind[4];
+    int _delay[4];
+    std::vector<float> _mics[4];
+    const float* _pointers[4];
+};
+
+static int popcount(uint32_t mask) {
+    int n = 0;
+    for (; mask; mask &= mask - 1) n++;
+    return n;
+}
+
+static int binOf(float hz) {
+    return (int)lroundf(hz * FFT_SIZE / SAMPLE_RATE);
+}
+
+static void testCalmAndCoherentSound() {
+    // A drone, and a truck as loud as a gust in the same band, from
+    // several directions: nothing the array hears as one sound is wind
+    srand(1);
+    const float directions[] = { 0.0f, 37.0f, 90.0f, 215.0f };
+    for (float deg : directions) {
+        WindDetector w;
+        w.begin(SAMPLE_RATE);
+        Scene scene(deg);
+        float worstLevel = 0.0f;
+        for (int b = 0; b < 40; b++) {
+            w.process(scene.next(0.05, b < 20 ? 0.0 : 0.3, 0.0), FFT_SIZE);
+            if (b >= 5) worstLevel = fmaxf(worstLevel, w.getLevel());
+            CHECK(!w.isGust());
+        }
+        printf("  coherent from %3.0f deg: level %.2f, %d bins flagged\n", deg, worstLevel, popcount(w.getMask()));
+        CHECK(worstLevel < 0.15f);
+        CHECK(!(w.getMask() & (1u << binOf(200.0f))));
+    }
+}
+
+static void testBreezeAndGust() {
+    srand(2);
+    const double winds[] = { 0.02, 0.2, 0.6 };
+    for (double wind : winds) {
+        WindDetector w;
+        w.begin(SAMPLE_RATE);
+        Scene scene(30.0f);
+        int gusts = 0;
+        for (int b = 0; b < 40; b++) {
+            w.process(scene.next(0.05, 0.0, wind), FFT_SIZE);
+            gusts += w.isGust();
+        }
+        bool droneBin = w.getMask() & (1u << binOf(200.0f));
+        printf("  wind %.2f: level %.2f, %d bins, cutoff %.0f Hz, gust %d/40 hops, 200 Hz bin %s\n",
+               wind, w.getLevel(), popcount(w.getMask()), w.getCutoffHz(), gusts,
+               droneBin ? "flagged" : "kept");
+        if (wind < 0.1) {
+            // Breeze: the bins it owns go, the drone's stays, inference runs
+            CHECK(w.getMask() != 0);
+            CHECK(!droneBin);
+            CHECK(gusts == 0);
+        } else {
+            CHECK(w.getLevel() > WIND_GUST_LEVEL);
+            CHECK(droneBin);
+            CHECK(gusts >= 36);
+            CHECK(w.getCutoffHz() >= WIND_MAX_HZ * 0.9f);
+        }
+    }
+}
+
+static void testGustOnsetAndRelease() {
+    // 2 s calm, 3 s gust, 3 s calm, at ~21.5 hops per second
+    srand(3);
+    WindDetector w;
+    w.begin(SAMPLE_RATE);
+    Scene scene(120.0f);
+    int firstGust = -1;
+    int lastGust = -1;
+    const int gustStart = 43;
+    const int gustEnd = 108;
+    for (int b = 0; b < 172; b++) {
+        double wind = b >= gustStart && b < gustEnd ? 0.4 : 0.0;
+        w.process(scene.next(0.05, 0.0, wind), FFT_SIZE);
+        if (w.isGust()) {
+            if (firstGust < 0) firstGust = b;
+            lastGust = b;
+        }
+    }
+    printf("  gust hops %d-%d: flagged from %d to %d\n", gustStart, gustEnd - 1, firstGust, lastGust);
+    CHECK(firstGust >= gustStart && firstGust <= gustStart + 3);
+
+    // The averaged spectra forget a gust 20 dB over the drone in about
+    // half a second (WIND_SMOOTHING per hop, down to the release level)
+    CHECK(lastGust >= gustEnd - 1 && lastGust <= gustEnd + 12);
+    CHECK(w.getMask() == 0);
+}
+
+static void testQuietBand() {
+    // Below WIND_MIN_DBFS nothing is flagged, however incoherent
+    srand(4);
+    WindDetector w;
+    w.begin(SAMPLE_RATE);
+    Scene scene(0.0f);
+    for (int b = 0; b < 20; b++) w.process(scene.next(0.0, 0.0, 1e-5), FFT_SIZE);
+    CHECK(w.getMask() == 0);
+    CHECK(w.getLevel() == 0.0f);
+    CHECK(!w.isGust());
+}
+
+static double rms(const float* x, int from, int to) {
+    double sum = 0.0;
+    for (int i = from; i < to; i++) sum += (double)x[i] * x[i];
+    return sqrt(sum / (to - from));
+}
+
+static void testSuppress() {
+    srand(5);
+    WindDetector w;
+    w.begin(SAMPLE_RATE);
+    Scene scene(0.0f);
+    for (int b = 0; b < 10; b++) w.process(scene.next(0.0, 0.0, 0.6), FFT_SIZE);
+    float cutoff = w.getCutoffHz();
+    CHECK(cutoff > 0.0f);
+
+    // Past the start-up transient: second order, so an octave under the
+    // cutoff is 12 dB down, and two octaves over it passes
+    const int settle = 256;
+    const double hz[] = { cutoff / 2.0, cutoff * 4.0 };
+    double gain[2];
+    for (int n = 0; n < 2; n++) {
+        std::vector<float> x(FFT_SIZE);
+        for (int i = 0; i < FFT_SIZE; i++) x[i] = (float)sin(2.0 * M_PI * hz[n] * i / SAMPLE_RATE);
+        double before = rms(x.data(), settle, FFT_SIZE);
+        w.suppress(x.data(), FFT_SIZE);
+        gain[n] = 20.0 * log10(rms(x.data(), settle, FFT_SIZE) / before);
+    }
+    printf("  suppress at %.0f Hz: %.1f dB an octave under, %.2f dB two octaves over\n", cutoff, gain[0], gain[1]);
+    CHECK(gain[0] < -10.0);
+    CHECK(fabs(gain[1]) < 0.2);
+
+    // No wind, no filtering
+    WindDetector calm;
+    calm.begin(SAMPLE_RATE);
+    std::vector<float> x(FFT_SIZE, 0.25f);
+    calm.suppress(x.data(), FFT_SIZE);
+    CHECK(x[FFT_SIZE - 1] == 0.25f);
+}
+
+int main() {
+    RUN_TEST(testCalmAndCoherentSound);
+    RUN_TEST(testBreezeAndGust);
+    RUN_TEST(testGustOnsetAndRelease);
+    RUN_TEST(testQuietBand);
+    RUN_TEST(testSuppress);
+    return testExit();
+}
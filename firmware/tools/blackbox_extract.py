@@ -0,0 +1,301 @@
+#!/usr/bin/env python3
+"""
+VARTA - Black Box Extractor
+Fetch black box recordings from the detector and convert them to WAV plus
+a CSV of the per-hop detector trace.
+
+Usage:
+    python blackbox_extract.py --port /dev/ttyACM0 --output recordings/
+    python blackbox_extract.py --input 00012.vbb --output recordings/
+
+Over serial, the 'd' command returns the newest recording. Use 'b' (or
+hold the button 1-3 s) to save one on demand.
+"""
+
+import argparse
+import array
+import csv
+import struct
+import sys
+import time
+import wave
+from pathlib import Path
+
+
+# Must match BlackBoxHeader / BlackBoxHop in firmware/include/blackbox.h
+HEADER = struct.Struct('<4sHHIIIIIIBB2x16s')
+HOP = struct.Struct('<iffB3x')
+
+REASONS = ['alert', 'manual']
+CODECS = ['none', 'lpc-rice', 'ima-adpcm']
+
+# Must match firmware/include/audio_codec.h
+CODEC_NONE, CODEC_LPC_RICE, CODEC_IMA_ADPCM = 0, 1, 2
+RICE_PARTITION = 256
+RICE_ESCAPE = 16
+RICE_RAW_BITS = 20
+VERBATIM = 0x80
+
+IMA_STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+]
+IMA_INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def decode_lpc_rice(payload, offset, frames):
+    """Decode one LPC/Rice subframe; returns (samples, next byte offset)."""
+    order = payload[offset]
+    if order == VERBATIM:
+        raw = array.array('h', payload[offset + 1:offset + 1 + frames * 2])
+        if sys.byteorder == 'big':
+            raw.byteswap()
+        return list(raw), offset + 1 + frames * 2
+
+    # Bit string of the rest of the block; unary runs become str.find()
+    tail = payload[offset:]
+    bits = bin(int.from_bytes(tail, 'big') | (1 << (len(tail) * 8)))[3:]
+    pos = 8
+
+    def take(n):
+        nonlocal pos
+        value = int(bits[pos:pos + n], 2) if n else 0
+        pos += n
+        return value
+
+    samples = []
+    for _ in range(order):
+        v = take(16)
+        samples.append(v - 0x10000 if v & 0x8000 else v)
+
+    for start in range(order, frames, RICE_PARTITION):
+        end = min(start + RICE_PARTITION, frames)
+        k = take(4)
+        for n in range(start, end):
+            one = bits.find('1', pos, pos + RICE_ESCAPE)
+            if one < 0:
+                pos += RICE_ESCAPE
+                u = take(RICE_RAW_BITS)
+            else:
+                q = one - pos
+                pos = one + 1
+                u = (q << k) | take(k)
+            r = (u >> 1) ^ -(u & 1)
+
+            if order == 0:
+                p = 0
+            elif order == 1:
+                p = samples[n - 1]
+            elif order == 2:
+                p = 2 * samples[n - 1] - samples[n - 2]
+            else:
+                p = 3 * samples[n - 1] - 3 * samples[n - 2] + samples[n - 3]
+            samples.append(p + r)
+
+    return samples, offset + (pos + 7) // 8
+
+
+def decode_adpcm(payload, offset, frames):
+    """Decode one IMA ADPCM subframe; returns (samples, next byte offset)."""
+    predictor, index = struct.unpack_from('<hB', payload, offset)
+    offset += 4
+    samples = [predictor]
+
+    for n in range(1, frames):
+        byte = payload[offset + (n - 1) // 2]
+        code = byte & 0x0F if (n & 1) else byte >> 4
+
+        step = IMA_STEP_TABLE[index]
+        delta = step >> 3
+        if code & 4:
+            delta += step
+        if code & 2:
+            delta += step >> 1
+        if code & 1:
+            delta += step >> 2
+        predictor += -delta if code & 8 else delta
+        predictor = max(-32768, min(32767, predictor))
+        index = max(0, min(88, index + IMA_INDEX_TABLE[code]))
+        samples.append(predictor)
+
+    return samples, offset + frames // 2
+
+
+def decode_audio(data, offset, frames, channels, codec):
+    """Return interleaved little-endian int16 PCM for the audio section."""
+    if codec == CODEC_NONE:
+        return data[offset:offset + frames * channels * 2]
+
+    decoder = decode_lpc_rice if codec == CODEC_LPC_RICE else decode_adpcm
+    pcm = array.array('h')
+    decoded = 0
+    while decoded < frames and offset + 4 <= len(data):
+        block_frames, payload_bytes = struct.unpack_from('<HH', data, offset)
+        payload = data[offset + 4:offset + 4 + payload_bytes]
+        offset += 4 + payload_bytes
+
+        per_channel = []
+        pos = 0
+        for _ in range(channels):
+            samples, pos = decoder(payload, pos, block_frames)
+            per_channel.append(samples)
+
+        block = array.array('h', [0] * (block_frames * channels))
+        for ch, samples in enumerate(per_channel):
+            block[ch::channels] = array.array('h', samples)
+        pcm.extend(block)
+        decoded += block_frames
+
+    if sys.byteorder == 'big':
+        pcm.byteswap()
+    return pcm.tobytes()
+
+
+STATES = ['INIT', 'SCAN', 'ALERT', 'MONITOR', 'CALIBRATE', 'LOW_BATTERY', 'STANDBY', 'ERROR']
+
+
+def parse_recording(data):
+    """Split a .vbb file into (metadata dict, hop list, raw interleaved PCM)."""
+    if len(data) < HEADER.size:
+        raise ValueError('file too short')
+
+    (magic, version, channels, sample_rate, frame_count, trigger_frame,
+     hop_count, uptime_ms, model_crc, reason, codec, firmware) = HEADER.unpack_from(data)
+
+    if magic != b'VBB1':
+        raise ValueError(f'bad magic {magic!r}')
+
+    meta = {
+        'version': version,
+        'channels': channels,
+        'sample_rate': sample_rate,
+        'frames': frame_count,
+        'trigger_s': trigger_frame / sample_rate,
+        'uptime_s': uptime_ms / 1000.0,
+        'model_crc': f'{model_crc:08x}',
+        'reason': REASONS[reason] if reason < len(REASONS) else reason,
+        'codec': CODECS[codec] if codec < len(CODECS) else codec,
+        'firmware': firmware.split(b'\0', 1)[0].decode('ascii', errors='replace'),
+    }
+
+    offset = HEADER.size
+    hops = []
+    for _ in range(hop_count):
+        frame, confidence, bearing, state = HOP.unpack_from(data, offset)
+        offset += HOP.size
+        hops.append({
+            'time_s': frame / sample_rate,
+            'confidence': confidence,
+            'bearing': bearing,
+            'state': STATES[state] if state < len(STATES) else state,
+        })
+
+    meta['stored_bytes'] = len(data) - offset
+    pcm = decode_audio(data, offset, frame_count, channels, codec)
+    if len(pcm) < frame_count * channels * 2:
+        print(f"Warning: recording truncated ({len(pcm)} of {frame_count * channels * 2} audio bytes)")
+    return meta, hops, pcm
+
+
+def fetch_latest(port_name, baud, timeout):
+    """Ask the detector for its newest recording and return (name, bytes)."""
+    try:
+        import serial
+    except ImportError:
+        sys.exit("pyserial is required for --port: pip install pyserial")
+
+    port = serial.Serial(port_name, baud, timeout=1)
+    port.reset_input_buffer()
+    port.write(b'd')
+
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        line = port.readline().decode('ascii', errors='replace').strip()
+        if line.startswith('BLACKBOX '):
+            break
+    else:
+        sys.exit('No response from detector')
+
+    parts = line.split()
+    if parts[1] == 'none':
+        sys.exit('Detector has no recordings')
+    if parts[1] == 'busy':
+        sys.exit('Detector is already sending a recording')
+
+    # One chunk per hop, each behind its own line; log lines can fall
+    # between chunks
+    name, size = Path(parts[1]).name, int(parts[2])
+    data = bytearray()
+    while len(data) < size and time.time() < deadline:
+        line = port.readline().decode('ascii', errors='replace').strip()
+        if not line.startswith('BLACKBOX-DATA '):
+            continue
+        offset, length = (int(v) for v in line.split()[1:3])
+        if offset != len(data):
+            sys.exit(f'Chunk at {offset} while expecting {len(data)}')
+        chunk = bytearray()
+        while len(chunk) < length and time.time() < deadline:
+            chunk += port.read(length - len(chunk))
+        data += chunk
+    if len(data) < size:
+        sys.exit(f'Timed out after {len(data)} of {size} bytes')
+    return name, bytes(data)
+
+
+def write_outputs(name, data, output_dir):
+    meta, hops, pcm = parse_recording(data)
+    output_dir.mkdir(parents=True, exist_ok=True)
+    stem = output_dir / Path(name).stem
+
+    with wave.open(str(stem.with_suffix('.wav')), 'wb') as wav:
+        wav.setnchannels(meta['channels'])
+        wav.setsampwidth(2)
+        wav.setframerate(meta['sample_rate'])
+        wav.writeframes(pcm)
+
+    with open(stem.with_suffix('.csv'), 'w', newline='') as f:
+        writer = csv.writer(f)
+        writer.writerow(['time_s', 'confidence', 'bearing', 'state'])
+        for hop in hops:
+            writer.writerow([f"{hop['time_s']:.4f}", f"{hop['confidence']:.4f}",
+                             f"{hop['bearing']:.1f}", hop['state']])
+
+    print(f"{name}: {meta['reason']} at uptime {meta['uptime_s']:.1f} s, "
+          f"firmware {meta['firmware']}, model {meta['model_crc']}")
+    print(f"  {meta['frames'] / meta['sample_rate']:.2f} s x {meta['channels']} ch "
+          f"@ {meta['sample_rate']} Hz, trigger at {meta['trigger_s']:.2f} s, {len(hops)} hops")
+    if meta['codec'] != 'none':
+        print(f"  {meta['codec']}: {len(pcm) / max(meta['stored_bytes'], 1):.2f}:1")
+    print(f"  -> {stem}.wav, {stem}.csv")
+
+
+def main():
+    parser = argparse.ArgumentParser(description='VARTA black box extractor')
+    parser.add_argument('--port', help='Serial port to fetch the newest recording from')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--input', nargs='*', default=[], help='.vbb files to convert')
+    parser.add_argument('--output', default='recordings', help='Output directory')
+    parser.add_argument('--timeout', type=float, default=120.0, help='Serial transfer timeout (s)')
+    args = parser.parse_args()
+
+    if not args.port and not args.input:
+        parser.error('one of --port or --input is required')
+
+    output_dir = Path(args.output)
+
+    if args.port:
+        name, data = fetch_latest(args.port, args.baud, args.timeout)
+        output_dir.mkdir(parents=True, exist_ok=True)
+        (output_dir / name).write_bytes(data)
+        write_outputs(name, data, output_dir)
+
+    for path in args.input:
+        write_outputs(Path(path).name, Path(path).read_bytes(), output_dir)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,225 @@
+#!/usr/bin/env python3
+"""
+VARTA - Event Journal Reader
+Fetch the detection event journal from the detector and list the events,
+optionally as CSV and with a PNG of each event's mel snapshot.
+
+Usage:
+    python journal_reader.py --port /dev/ttyACM0 --save journal.bin
+    python journal_reader.py --input journal.bin --csv events.csv --snapshots events/
+
+Over serial, the 'j' command returns the raw journal partition. Events
+still queued on the detector appear after its next flush (JOURNAL_FLUSH_MS).
+"""
+
+import argparse
+import csv
+import struct
+import sys
+import time
+import zlib
+from pathlib import Path
+
+
+# Must match firmware/include/event_journal.h
+SECTOR_SIZE = 4096
+MAGIC = 0x314E4A56
+SECTOR = struct.Struct('<II')
+RECORD = struct.Struct('<HBx')
+JOURNAL_BOOT = 1
+JOURNAL_DETECTION = 2
+BOOT = struct.Struct('<16sI')
+
+# Must match JOURNAL_SNAPSHOT_* and MEL_DB_* in config.h
+SNAPSHOT_FRAMES = 16
+SNAPSHOT_BINS = 32
+MEL_DB_FLOOR = -80.0
+MEL_DB_RANGE = 80.0
+
+DETECTION = struct.Struct(f'<IIHBBffffff{SNAPSHOT_FRAMES * SNAPSHOT_BINS}sI')
+DETECTION_V1 = struct.Struct(f'<IIHBBffffff{SNAPSHOT_FRAMES * SNAPSHOT_BINS}s')   # Before mesh time
+
+
+def iter_records(data):
+    """Yield (type, payload) for every valid record, oldest first."""
+    sectors = []
+    for offset in range(0, len(data) - SECTOR_SIZE + 1, SECTOR_SIZE):
+        magic, sequence = SECTOR.unpack_from(data, offset)
+        if magic == MAGIC:
+            sectors.append((sequence, offset))
+
+    for _, base in sorted(sectors):
+        offset = base + SECTOR.size
+        end = base + SECTOR_SIZE
+        while offset + RECORD.size <= end:
+            length, rec_type = RECORD.unpack_from(data, offset)
+            if length == 0xFFFF:
+                break
+            body = RECORD.size + length
+            size = (body + 4 + 3) & ~3
+            if offset + size > end:
+                break
+            (crc,) = struct.unpack_from('<I', data, offset + body)
+            if zlib.crc32(data[offset:offset + body]) != crc:
+                break   # Torn write; the firmware moved on to the next sector
+            yield rec_type, data[offset + RECORD.size:offset + body]
+            offset += size
+
+
+def parse_journal(data):
+    """Return the detection events as dicts, numbered by boot."""
+    events = []
+    boot = 0
+    firmware = model_crc = '?'
+    for rec_type, payload in iter_records(data):
+        if rec_type == JOURNAL_BOOT and len(payload) >= BOOT.size:
+            name, crc = BOOT.unpack_from(payload)
+            boot += 1
+            firmware = name.split(b'\0', 1)[0].decode('ascii', errors='replace')
+            model_crc = f'{crc:08x}'
+        elif rec_type == JOURNAL_DETECTION and len(payload) in (DETECTION.size, DETECTION_V1.size):
+            if len(payload) == DETECTION.size:
+                (start_ms, duration_ms, detections, battery, alerted, peak, b_start, b_end,
+                 b_mean, b_spread, f0, snapshot, mesh_ms) = DETECTION.unpack(payload)
+            else:
+                (start_ms, duration_ms, detections, battery, alerted, peak, b_start, b_end,
+                 b_mean, b_spread, f0, snapshot) = DETECTION_V1.unpack(payload)
+                mesh_ms = 0
+            events.append({
+                'boot': boot,
+                'firmware': firmware,
+                'model_crc': model_crc,
+                'start_s': start_ms / 1000.0,
+                'mesh_time_s': mesh_ms / 1000.0 if mesh_ms else None,
+                'duration_s': duration_ms / 1000.0,
+                'detections': detections,
+                'alerted': bool(alerted),
+                'peak_confidence': peak,
+                'bearing_start': b_start,
+                'bearing_end': b_end,
+                'bearing_mean': b_mean,
+                'bearing_spread': b_spread,
+                'f0_hz': f0,
+                'battery_percent': battery,
+                'snapshot': snapshot,
+            })
+    return events
+
+
+def fetch_journal(port_name, baud, timeout):
+    """Ask the detector for its journal partition and return the bytes."""
+    try:
+        import serial
+    except ImportError:
+        sys.exit("pyserial is required for --port: pip install pyserial")
+
+    port = serial.Serial(port_name, baud, timeout=1)
+    port.reset_input_buffer()
+    port.write(b'j')
+
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        line = port.readline().decode('ascii', errors='replace').strip()
+        if line.startswith('JOURNAL '):
+            break
+    else:
+        sys.exit('No response from detector')
+
+    parts = line.split()
+    if parts[1] == 'none':
+        sys.exit('Detector has no journal partition')
+    if parts[1] == 'busy':
+        sys.exit('Detector is already sending its journal')
+
+    # One chunk per hop, each behind its own line; log lines can fall
+    # between chunks
+    size = int(parts[1])
+    data = bytearray()
+    while len(data) < size and time.time() < deadline:
+        line = port.readline().decode('ascii', errors='replace').strip()
+        if not line.startswith('JOURNAL-DATA '):
+            continue
+        offset, length = (int(v) for v in line.split()[1:3])
+        if offset != len(data):
+            sys.exit(f'Chunk at {offset} while expecting {len(data)}')
+        chunk = bytearray()
+        while len(chunk) < length and time.time() < deadline:
+            chunk += port.read(length - len(chunk))
+        data += chunk
+    if len(data) < size:
+        sys.exit(f'Timed out after {len(data)} of {size} bytes')
+    return bytes(data)
+
+
+def save_snapshots(events, output_dir):
+    try:
+        import matplotlib
+        matplotlib.use('Agg')
+        import matplotlib.pyplot as plt
+        import numpy as np
+    except ImportError:
+        sys.exit("matplotlib and numpy are required for --snapshots")
+
+    output_dir.mkdir(parents=True, exist_ok=True)
+    for i, event in enumerate(events):
+        q = np.frombuffer(event['snapshot'], dtype=np.uint8).reshape(SNAPSHOT_FRAMES, SNAPSHOT_BINS)
+        db = MEL_DB_FLOOR + q.astype(np.float32) * (MEL_DB_RANGE / 255.0)
+
+        fig, ax = plt.subplots(figsize=(5, 4))
+        ax.imshow(db.T, origin='lower', aspect='auto',
+                  vmin=MEL_DB_FLOOR, vmax=MEL_DB_FLOOR + MEL_DB_RANGE)
+        ax.set_title(f"boot {event['boot']} +{event['start_s']:.1f} s  "
+                     f"conf {event['peak_confidence']:.2f}  f0 {event['f0_hz']:.0f} Hz")
+        ax.set_xlabel('frame (1 s window)')
+        ax.set_ylabel('mel band')
+        fig.tight_layout()
+        fig.savefig(output_dir / f'event_{i:04d}.png')
+        plt.close(fig)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='VARTA event journal reader')
+    parser.add_argument('--port', help='Serial port to fetch the journal from')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--input', help='Raw journal saved with --save')
+    parser.add_argument('--save', help='Keep the raw journal fetched with --port')
+    parser.add_argument('--csv', help='Write the events to this CSV file')
+    parser.add_argument('--snapshots', help='Directory for per-event mel snapshot PNGs')
+    parser.add_argument('--timeout', type=float, default=60.0, help='Serial transfer timeout (s)')
+    args = parser.parse_args()
+
+    if not args.port and not args.input:
+        parser.error('one of --port or --input is required')
+
+    if args.port:
+        data = fetch_journal(args.port, args.baud, args.timeout)
+        if args.save:
+            Path(args.save).write_bytes(data)
+    else:
+        data = Path(args.input).read_bytes()
+
+    events = parse_journal(data)
+
+    print(f"{'#':>4} {'boot':>4} {'start_s':>9} {'dur_s':>6} {'det':>4} {'peak':>5} "
+          f"{'bearing start/end/mean':>23} {'spread':>6} {'f0_hz':>6} {'batt':>4}")
+    for i, e in enumerate(events):
+        print(f"{i:4d} {e['boot']:4d} {e['start_s']:9.1f} {e['duration_s']:6.1f} "
+              f"{e['detections']:4d} {e['peak_confidence']:5.2f} "
+              f"{e['bearing_start']:7.1f}/{e['bearing_end']:5.1f}/{e['bearing_mean']:5.1f}"
+              f" {e['bearing_spread']:6.1f} {e['f0_hz']:6.0f} {e['battery_percent']:3d}%"
+              f"{'  ALERT' if e['alerted'] else ''}")
+    print(f"\n{len(events)} events")
+
+    if args.csv:
+        columns = [k for k in events[0] if k != 'snapshot'] if events else []
+        with open(args.csv, 'w', newline='') as f:
+            writer = csv.DictWriter(f, fieldnames=columns, extrasaction='ignore')
+            writer.writeheader()
+            writer.writerows(events)
+
+    if args.snapshots and events:
+        save_snapshots(events, Path(args.snapshots))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,330 @@
+#!/usr/bin/env python3
+"""
+VARTA - Telemetry Monitor
+Decode the binary telemetry stream from the detector (TELEMETRY_ENABLED in
+config.h), plot it live, and record or replay raw captures.
+
+Usage:
+    python telemetry_monitor.py --port /dev/ttyACM0 --plot
+    python telemetry_monitor.py --port /dev/ttyACM0 --record session.bin
+    python telemetry_monitor.py --replay session.bin --csv session.csv
+
+Frame format (see firmware/include/telemetry.h):
+    0x00 | COBS( version u8 | type u8 | seq u16 | timestamp_ms u32 | payload | crc16 u16 ) | 0x00
+    All fields little-endian. Anything between delimiters that does not
+    decode is shown as plain text (boot messages, profiler reports).
+"""
+
+import argparse
+import csv
+import struct
+import sys
+import time
+from collections import deque
+
+import numpy as np
+
+
+TELEMETRY_VERSION = 1
+
+TLM_HOP = 0x01
+TLM_MEL_FRAME = 0x02
+TLM_DIRECTION = 0x03
+TLM_PROFILE = 0x04
+TLM_ALERT = 0x05
+TLM_LOG = 0x06
+TLM_FIX = 0x07
+TLM_WIND = 0x08
+
+HEADER = struct.Struct('<BBHI')
+
+# Must match SystemState in main.cpp and ProfileStage in profiler.h
+STATES = ['INIT', 'SCAN', 'ALERT', 'MONITOR', 'CALIBRATE', 'LOW_BATTERY', 'STANDBY', 'ERROR']
+STAGES = ['capture', 'convert', 'fft', 'mel', 'inference', 'direction', 'display', 'leds', 'record', 'hop']
+
+# Must match MEL_DB_FLOOR / MEL_DB_RANGE in config.h
+MEL_DB_FLOOR = -80.0
+MEL_DB_RANGE = 80.0
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as computed by the firmware."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    """Decode one COBS block; returns None if it is malformed."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def parse_frame(chunk):
+    """Return a message dict for a valid frame, or None."""
+    raw = cobs_decode(chunk)
+    if raw is None or len(raw) < HEADER.size + 2:
+        return None
+
+    body, crc = raw[:-2], struct.unpack('<H', raw[-2:])[0]
+    if crc16(body) != crc:
+        return None
+
+    version, msg_type, seq, timestamp = HEADER.unpack_from(body)
+    if version != TELEMETRY_VERSION:
+        return None
+
+    payload = body[HEADER.size:]
+    msg = {'type': msg_type, 'seq': seq, 'time_ms': timestamp}
+
+    try:
+        if msg_type == TLM_HOP:
+            conf, bearing, state, count = struct.unpack('<ffBB', payload)
+            msg.update(confidence=conf, bearing=bearing,
+                       state=STATES[state] if state < len(STATES) else state,
+                       detections=count)
+        elif msg_type == TLM_MEL_FRAME:
+            q = np.frombuffer(payload, dtype=np.uint8)
+            msg['mel_db'] = MEL_DB_FLOOR + q.astype(np.float32) * (MEL_DB_RANGE / 255.0)
+        elif msg_type == TLM_DIRECTION:
+            values = struct.unpack('<6f', payload)
+            msg.update(tdoa=values[:4], correlation=values[4], azimuth=values[5])
+        elif msg_type == TLM_PROFILE:
+            stage, count, mean, p50, p90, p99, peak = struct.unpack('<B6I', payload)
+            msg.update(stage=STAGES[stage] if stage < len(STAGES) else stage,
+                       count=count, mean_us=mean, p50_us=p50, p90_us=p90,
+                       p99_us=p99, max_us=peak)
+        elif msg_type == TLM_ALERT:
+            bearing, conf, muted = struct.unpack('<ffB', payload)
+            msg.update(bearing=bearing, confidence=conf, muted=bool(muted))
+        elif msg_type == TLM_LOG:
+            msg.update(level=payload[0], text=payload[1:].decode('utf-8', errors='replace'))
+        elif msg_type == TLM_FIX:
+            east, north, major, minor, axis, residual, nodes = struct.unpack('<6fB', payload)
+            msg.update(east_m=east, north_m=north, major_m=major, minor_m=minor,
+                       axis_deg=axis, residual_deg=residual, nodes=nodes)
+        elif msg_type == TLM_WIND:
+            level, cutoff, masked, gust = struct.unpack('<ffBB', payload)
+            msg.update(level=level, cutoff_hz=cutoff, masked_bins=masked, gust=bool(gust))
+    except struct.error:
+        return None
+
+    return msg
+
+
+class StreamDecoder:
+    """Splits a byte stream on 0x00 and yields ('msg', dict) or ('text', str)."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.last_seq = None
+        self.lost = 0
+
+    def feed(self, data):
+        self.buffer += data
+        while True:
+            end = self.buffer.find(b'\x00')
+            if end < 0:
+                return
+            chunk = bytes(self.buffer[:end])
+            del self.buffer[:end + 1]
+            if not chunk:
+                continue
+
+            msg = parse_frame(chunk)
+            if msg is not None:
+                if self.last_seq is not None:
+                    self.lost += (msg['seq'] - self.last_seq - 1) & 0xFFFF
+                self.last_seq = msg['seq']
+                yield 'msg', msg
+            else:
+                text = chunk.decode('utf-8', errors='replace')
+                for line in text.splitlines():
+                    if line.strip():
+                        yield 'text', line.rstrip()
+
+
+def open_source(args):
+    """Return a callable that produces the next block of bytes, or b'' at EOF."""
+    if args.replay:
+        f = open(args.replay, 'rb')
+        return lambda: f.read(4096)
+
+    try:
+        import serial
+    except ImportError:
+        sys.exit("pyserial is required for live capture: pip install pyserial")
+
+    port = serial.Serial(args.port, args.baud, timeout=0.05)
+
+    def read():
+        data = port.read(max(1, port.in_waiting))
+        return data if data else None
+    return read
+
+
+class LivePlot:
+    def __init__(self, history):
+        import matplotlib.pyplot as plt
+        self.plt = plt
+        self.times = deque(maxlen=history)
+        self.confidence = deque(maxlen=history)
+        self.bearing = deque(maxlen=history)
+        self.mel = deque(maxlen=history)
+
+        plt.ion()
+        self.fig, (self.ax_conf, self.ax_bearing, self.ax_mel) = plt.subplots(
+            3, 1, figsize=(10, 8), sharex=False)
+        self.fig.canvas.manager.set_window_title('VARTA telemetry')
+        self.last_draw = 0
+
+    def update(self, msg):
+        if msg['type'] == TLM_HOP:
+            self.times.append(msg['time_ms'] / 1000.0)
+            self.confidence.append(msg['confidence'])
+            self.bearing.append(msg['bearing'])
+        elif msg['type'] == TLM_MEL_FRAME:
+            self.mel.append(msg['mel_db'])
+
+    def draw(self):
+        now = time.time()
+        if now - self.last_draw < 0.2:
+            return
+        self.last_draw = now
+
+        self.ax_conf.clear()
+        self.ax_conf.plot(self.times, self.confidence)
+        self.ax_conf.set_ylim(0, 1)
+        self.ax_conf.set_ylabel('confidence')
+
+        self.ax_bearing.clear()
+        self.ax_bearing.plot(self.times, self.bearing, '.')
+        self.ax_bearing.set_ylim(0, 360)
+        self.ax_bearing.set_ylabel('bearing (deg)')
+
+        if self.mel:
+            self.ax_mel.clear()
+            self.ax_mel.imshow(np.array(self.mel).T, origin='lower', aspect='auto',
+                               vmin=MEL_DB_FLOOR, vmax=MEL_DB_FLOOR + MEL_DB_RANGE)
+            self.ax_mel.set_ylabel('mel bin')
+
+        self.plt.pause(0.001)
+
+
+def format_message(msg):
+    t = msg['time_ms'] / 1000.0
+    kind = msg['type']
+    if kind == TLM_HOP:
+        return f"{t:9.3f} HOP   conf={msg['confidence']:.2f} bearing={msg['bearing']:.1f} " \
+               f"state={msg['state']} count={msg['detections']}"
+    if kind == TLM_DIRECTION:
+        tdoa = ', '.join(f'{d:.1f}' for d in msg['tdoa'])
+        return f"{t:9.3f} DIR   tdoa=[{tdoa}] corr={msg['correlation']:.2f} az={msg['azimuth']:.1f}"
+    if kind == TLM_PROFILE:
+        return f"{t:9.3f} PROF  {msg['stage']:<10} n={msg['count']} mean={msg['mean_us']} " \
+               f"p50={msg['p50_us']} p90={msg['p90_us']} p99={msg['p99_us']} max={msg['max_us']} us"
+    if kind == TLM_ALERT:
+        return f"{t:9.3f} ALERT bearing={msg['bearing']:.1f} conf={msg['confidence']:.2f} " \
+               f"muted={msg['muted']}"
+    if kind == TLM_LOG:
+        return f"{t:9.3f} LOG   {msg['text']}"
+    if kind == TLM_FIX:
+        return f"{t:9.3f} FIX   E={msg['east_m']:.0f} N={msg['north_m']:.0f} m " \
+               f"95%={msg['major_m']:.0f}x{msg['minor_m']:.0f} m @{msg['axis_deg']:.0f} " \
+               f"units={msg['nodes']} misfit={msg['residual_deg']:.1f}"
+    if kind == TLM_WIND:
+        return f"{t:9.3f} WIND  level={msg['level']:.2f} cutoff={msg['cutoff_hz']:.0f} Hz " \
+               f"bins={msg['masked_bins']} gust={msg['gust']}"
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description='VARTA telemetry monitor')
+    parser.add_argument('--port', help='Serial port (e.g. /dev/ttyACM0, COM5)')
+    parser.add_argument('--baud', type=int, default=115200,
+                        help='Baud rate (ignored by USB CDC)')
+    parser.add_argument('--record', help='Save the raw byte stream to this file')
+    parser.add_argument('--replay', help='Decode a file saved with --record')
+    parser.add_argument('--csv', help='Write hop messages to this CSV file')
+    parser.add_argument('--plot', action='store_true',
+                        help='Live confidence, bearing and mel waterfall')
+    parser.add_argument('--history', type=int, default=300,
+                        help='Hops kept in the live plot')
+    parser.add_argument('--quiet', action='store_true',
+                        help='Do not print decoded messages')
+    args = parser.parse_args()
+
+    if not args.port and not args.replay:
+        parser.error('one of --port or --replay is required')
+
+    read = open_source(args)
+    decoder = StreamDecoder()
+    record = open(args.record, 'wb') if args.record else None
+    plot = LivePlot(args.history) if args.plot else None
+
+    csv_file = open(args.csv, 'w', newline='') if args.csv else None
+    writer = None
+    if csv_file:
+        writer = csv.writer(csv_file)
+        writer.writerow(['time_ms', 'seq', 'confidence', 'bearing', 'state', 'detections'])
+
+    messages = 0
+    try:
+        while True:
+            data = read()
+            if data is None:
+                if plot:
+                    plot.draw()
+                continue
+            if not data:
+                break
+            if record:
+                record.write(data)
+
+            for kind, item in decoder.feed(data):
+                if kind == 'text':
+                    if not args.quiet:
+                        print(f"          TEXT  {item}")
+                    continue
+
+                messages += 1
+                if writer and item['type'] == TLM_HOP:
+                    writer.writerow([item['time_ms'], item['seq'], f"{item['confidence']:.4f}",
+                                     f"{item['bearing']:.1f}", item['state'], item['detections']])
+                if plot:
+                    plot.update(item)
+                if not args.quiet:
+                    line = format_message(item)
+                    if line:
+                        print(line)
+
+            if plot:
+                plot.draw()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        for f in (record, csv_file):
+            if f:
+                f.close()
+
+    print(f"\n{messages} messages decoded, {decoder.lost} lost (sequence gaps)")
+    if plot:
+        plot.plt.ioff()
+        plot.plt.show()
+
+
+if __name__ == '__main__':
+    main()